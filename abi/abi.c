@@ -58,6 +58,14 @@
 #endif /* ! TM_DTMC */
 extern void _ITM_CALL_CONVENTION _ITM_siglongjmp(int val, sigjmp_buf env) __attribute__ ((noreturn));
 
+/* Skip the transaction body when giving up (deadline or cancellation) */
+#define GIVE_UP_PATH  (a_abortTransaction | a_restoreLiveVariables)
+
+#ifdef CALL_SITES
+/* Call sites are recorded by the ABI barriers (not by the functions they use) */
+# define SET_CALL_SITE(tx)
+#endif /* CALL_SITES */
+
 #include "stm.c"
 #include "mod_cb_mem.c"
 #ifdef TM_GCC
@@ -86,6 +94,12 @@ extern void _ITM_CALL_CONVENTION _ITM_siglongjmp(int val, sigjmp_buf env) __attr
 # error "No ABI defined"
 #endif
 
+#ifdef CALL_SITES
+# define TX_GET_ABI_SITE  TX_GET_ABI; tx->site = __builtin_return_address(0)
+#else /* ! CALL_SITES */
+# define TX_GET_ABI_SITE  TX_GET_ABI
+#endif /* ! CALL_SITES */
+
 /* ################################################################### *
  * VARIABLES
  * ################################################################### */
@@ -546,8 +560,17 @@ uint32_t _ITM_CALL_CONVENTION GTM_begin_transaction(TX_ARGS uint32_t attr, jmp_b
   env = int_stm_start(tx, _a);
   /* Save thread context only when outermost transaction */
   /* TODO check that the memcpy is fast. */
-  if (likely(env != NULL))
+  if (likely(env != NULL)) {
     memcpy(env, buf, sizeof(jmp_buf)); /* TODO limit size to real size */
+#ifdef DEADLINES
+    /* The code only checks a_abortTransaction if it may be cancelled */
+# ifdef TM_DTMC
+    tx->no_give_up = 1;
+# else /* !TM_DTMC */
+    tx->no_give_up = ((attr & pr_hasNoAbort) != 0);
+# endif /* !TM_DTMC */
+#endif /* DEADLINES */
+  }
 
   return ret;
 }
@@ -691,17 +714,25 @@ void _ITM_CALL_CONVENTION _ITM_commitTransactionEH(void *exc_ptr)
 
 /**** LOAD STORE LOG FUNCTIONS ****/
 
+/* Scratch memory (stm_scratch_alloc) is private to the transaction and
+ * released upon commit or abort: it is accessed without barriers. */
+#define IS_SCRATCH(addr)        unlikely(stm_scratch_contains(tx, addr))
+
 #define TM_LOAD(F, T, WF, WT) \
   T _ITM_CALL_CONVENTION F(TX_ARGS const T *addr) \
   { \
-    return (WT)WF((volatile WT *)addr); \
+    TX_GET_ABI_SITE; \
+    if (IS_SCRATCH(addr)) return *addr; \
+    return (WT)WF(tx, (volatile WT *)addr); \
   }
 
 #define TM_LOAD_GENERIC(F, T) \
   T _ITM_CALL_CONVENTION F(TX_ARGS const T *addr) \
   { \
     union { T d; uint8_t s[sizeof(T)]; } c; \
-    stm_load_bytes((volatile uint8_t *)addr, c.s, sizeof(T)); \
+    TX_GET_ABI_SITE; \
+    if (IS_SCRATCH(addr)) return *addr; \
+    stm_load_bytes_tx(tx, (volatile uint8_t *)addr, c.s, sizeof(T)); \
     return c.d; \
   }
 
@@ -714,14 +745,17 @@ not enough because if we abort and restore -> stack can be corrupted
 #define TM_STORE(F, T, WF, WT) \
   void _ITM_CALL_CONVENTION F(TX_ARGS const T *addr, T val) \
   { \
-    if (on_stack(addr)) *((T*)addr) = val; \
-    else WF((volatile WT *)addr, (WT)val); \
+    TX_GET_ABI_SITE; \
+    if (on_stack(addr) || IS_SCRATCH(addr)) *((T*)addr) = val; \
+    else WF(tx, (volatile WT *)addr, (WT)val); \
   }
 #else /* !STACK_CHECK */
 #define TM_STORE(F, T, WF, WT) \
   void _ITM_CALL_CONVENTION F(TX_ARGS const T *addr, T val) \
   { \
-    WF((volatile WT *)addr, (WT)val); \
+    TX_GET_ABI_SITE; \
+    if (IS_SCRATCH(addr)) *((T*)addr) = val; \
+    else WF(tx, (volatile WT *)addr, (WT)val); \
   }
 #endif /* !STACK_CHECK */
 
@@ -729,52 +763,64 @@ not enough because if we abort and restore -> stack can be corrupted
   void _ITM_CALL_CONVENTION F(TX_ARGS const T *addr, T val) \
   { \
     union { T d; uint8_t s[sizeof(T)]; } c; \
+    TX_GET_ABI_SITE; \
+    if (IS_SCRATCH(addr)) { *((T*)addr) = val; return; } \
     c.d = val; \
-    stm_store_bytes((volatile uint8_t *)addr, c.s, sizeof(T)); \
+    stm_store_bytes_tx(tx, (volatile uint8_t *)addr, c.s, sizeof(T)); \
   }
 
 #define TM_LOG(F, T, WF, WT) \
   void _ITM_CALL_CONVENTION F(TX_ARGS const T *addr) \
   { \
-    WF((WT *)addr); \
+    TX_GET_ABI; \
+    if (!IS_SCRATCH(addr)) WF((WT *)addr); \
   }
 
 #define TM_LOG_GENERIC(F, T) \
   void _ITM_CALL_CONVENTION F(TX_ARGS const T *addr) \
   { \
-    stm_log_bytes((uint8_t *)addr, sizeof(T));    \
+    TX_GET_ABI; \
+    if (!IS_SCRATCH(addr)) stm_log_bytes((uint8_t *)addr, sizeof(T)); \
   }
 
 #define TM_STORE_BYTES(F) \
   void _ITM_CALL_CONVENTION F(TX_ARGS void *dst, const void *src, size_t size) \
   { \
-    stm_store_bytes((volatile uint8_t *)dst, (uint8_t *)src, size); \
+    TX_GET_ABI_SITE; \
+    if (IS_SCRATCH(dst)) memcpy(dst, src, size); \
+    else stm_store_bytes_tx(tx, (volatile uint8_t *)dst, (uint8_t *)src, size); \
   }
 
 #define TM_LOAD_BYTES(F) \
   void _ITM_CALL_CONVENTION F(TX_ARGS void *dst, const void *src, size_t size) \
   { \
-    stm_load_bytes((volatile uint8_t *)src, (uint8_t *)dst, size); \
+    TX_GET_ABI_SITE; \
+    if (IS_SCRATCH(src)) memcpy(dst, src, size); \
+    else stm_load_bytes_tx(tx, (volatile uint8_t *)src, (uint8_t *)dst, size); \
   }
 
 #define TM_LOG_BYTES(F) \
   void _ITM_CALL_CONVENTION F(TX_ARGS const void *addr, size_t size) \
   { \
-    stm_log_bytes((uint8_t *)addr, size); \
+    TX_GET_ABI; \
+    if (!IS_SCRATCH(addr)) stm_log_bytes((uint8_t *)addr, size); \
   }
 
 #ifdef STACK_CHECK
 #define TM_SET_BYTES(F) \
   void _ITM_CALL_CONVENTION F(TX_ARGS void *dst, int val, size_t count) \
   { \
-    if (on_stack(dst)) memset(dst, val, count); \
-    else stm_set_bytes((volatile uint8_t *)dst, val, count); \
+    TX_GET_ABI_SITE; \
+    if (on_stack(dst) || IS_SCRATCH(dst)) memset(dst, val, count); \
+    else stm_set_bytes_tx(tx, (volatile uint8_t *)dst, val, count); \
   }
 #else /* !STACK_CHECK */
 #define TM_SET_BYTES(F) \
   void _ITM_CALL_CONVENTION F(TX_ARGS void *dst, int val, size_t count) \
   { \
-    stm_set_bytes((volatile uint8_t *)dst, val, count); \
+    TX_GET_ABI_SITE; \
+    if (IS_SCRATCH(dst)) memset(dst, val, count); \
+    else stm_set_bytes_tx(tx, (volatile uint8_t *)dst, val, count); \
   }
 #endif /* !STACK_CHECK */
 
@@ -783,18 +829,22 @@ not enough because if we abort and restore -> stack can be corrupted
   void _ITM_CALL_CONVENTION F(TX_ARGS void *dst, const void *src, size_t size) \
   { \
     uint8_t *buf = (uint8_t *)alloca(size); \
-    if (on_stack(src)) memcpy(buf, src, size); \
-    stm_load_bytes((volatile uint8_t *)src, buf, size); \
-    if (on_stack(dst)) memcpy(dst, buf, size); \
-    else stm_store_bytes((volatile uint8_t *)dst, buf, size); \
+    TX_GET_ABI_SITE; \
+    if (on_stack(src) || IS_SCRATCH(src)) memcpy(buf, src, size); \
+    else stm_load_bytes_tx(tx, (volatile uint8_t *)src, buf, size); \
+    if (on_stack(dst) || IS_SCRATCH(dst)) memcpy(dst, buf, size); \
+    else stm_store_bytes_tx(tx, (volatile uint8_t *)dst, buf, size); \
   }
 #else /* !STACK_CHECK */
 #define TM_COPY_BYTES(F) \
   void _ITM_CALL_CONVENTION F(TX_ARGS void *dst, const void *src, size_t size) \
   { \
     uint8_t *buf = (uint8_t *)alloca(size); \
-    stm_load_bytes((volatile uint8_t *)src, buf, size); \
-    stm_store_bytes((volatile uint8_t *)dst, buf, size); \
+    TX_GET_ABI_SITE; \
+    if (IS_SCRATCH(src)) memcpy(buf, src, size); \
+    else stm_load_bytes_tx(tx, (volatile uint8_t *)src, buf, size); \
+    if (IS_SCRATCH(dst)) memcpy(dst, buf, size); \
+    else stm_store_bytes_tx(tx, (volatile uint8_t *)dst, buf, size); \
   }
 #endif /* !STACK_CHECK */
 
@@ -802,23 +852,72 @@ not enough because if we abort and restore -> stack can be corrupted
   void _ITM_CALL_CONVENTION F(TX_ARGS void *dst, const void *src, size_t size) \
   { \
     uint8_t *buf = (uint8_t *)alloca(size); \
+    TX_GET_ABI_SITE; \
     memcpy(buf, src, size); \
-    stm_store_bytes((volatile uint8_t *)dst, buf, size); \
+    if (IS_SCRATCH(dst)) memcpy(dst, buf, size); \
+    else stm_store_bytes_tx(tx, (volatile uint8_t *)dst, buf, size); \
   }
 
 #define TM_COPY_BYTES_RT_WN(F) \
   void _ITM_CALL_CONVENTION F(TX_ARGS void *dst, const void *src, size_t size) \
   { \
     uint8_t *buf = (uint8_t *)alloca(size); \
-    stm_load_bytes((volatile uint8_t *)src, buf, size); \
+    TX_GET_ABI_SITE; \
+    if (IS_SCRATCH(src)) memcpy(buf, src, size); \
+    else stm_load_bytes_tx(tx, (volatile uint8_t *)src, buf, size); \
     memcpy(dst, buf, size); \
   }
 
+/* Accesses with a known pattern (RaR, RaW, RfW, WaR, WaW) use the
+ * specialized barriers of the core when the data fits in a single word,
+ * and the regular path otherwise. */
+#define TM_LOAD_PATTERN(F, T, RF, WF, WT) \
+  T _ITM_CALL_CONVENTION F(TX_ARGS const T *addr) \
+  { \
+    uintptr_t off = (uintptr_t)addr & (sizeof(stm_word_t) - 1); \
+    TX_GET_ABI_SITE; \
+    if (IS_SCRATCH(addr)) return *addr; \
+    if (likely(off + sizeof(T) <= sizeof(stm_word_t))) { \
+      union { stm_word_t w; uint8_t b[sizeof(stm_word_t)]; } c; \
+      T val; \
+      c.w = RF(tx, (volatile stm_word_t *)((uintptr_t)addr - off)); \
+      memcpy(&val, &c.b[off], sizeof(T)); \
+      return val; \
+    } \
+    return (WT)WF(tx, (volatile WT *)addr); \
+  }
+
+#ifdef STACK_CHECK
+# define TM_STORE_PATTERN_STACK(T, addr, val) \
+    if (on_stack(addr)) { *((T*)addr) = val; return; }
+#else /* !STACK_CHECK */
+# define TM_STORE_PATTERN_STACK(T, addr, val)
+#endif /* !STACK_CHECK */
+
+#define TM_STORE_PATTERN(F, T, WPF, WF, WT) \
+  void _ITM_CALL_CONVENTION F(TX_ARGS const T *addr, T val) \
+  { \
+    uintptr_t off = (uintptr_t)addr & (sizeof(stm_word_t) - 1); \
+    TX_GET_ABI_SITE; \
+    TM_STORE_PATTERN_STACK(T, addr, val) \
+    if (IS_SCRATCH(addr)) { *((T*)addr) = val; return; } \
+    if (likely(off + sizeof(T) <= sizeof(stm_word_t))) { \
+      union { stm_word_t w; uint8_t b[sizeof(stm_word_t)]; } c, m; \
+      c.w = 0; \
+      m.w = 0; \
+      memcpy(&c.b[off], &val, sizeof(T)); \
+      memset(&m.b[off], 0xFF, sizeof(T)); \
+      WPF(tx, (volatile stm_word_t *)((uintptr_t)addr - off), c.w, m.w); \
+      return; \
+    } \
+    WF(tx, (volatile WT *)addr, (WT)val); \
+  }
+
 #define TM_LOAD_ALL(E, T, WF, WT) \
   TM_LOAD(_ITM_R##E, T, WF, WT) \
-  TM_LOAD(_ITM_RaR##E, T, WF, WT) \
-  TM_LOAD(_ITM_RaW##E, T, WF, WT) \
-  TM_LOAD(_ITM_RfW##E, T, WF, WT)
+  TM_LOAD_PATTERN(_ITM_RaR##E, T, int_stm_RaR, WF, WT) \
+  TM_LOAD_PATTERN(_ITM_RaW##E, T, int_stm_RaW, WF, WT) \
+  TM_LOAD_PATTERN(_ITM_RfW##E, T, int_stm_RfW, WF, WT)
 
 #define TM_LOAD_GENERIC_ALL(E, T) \
   TM_LOAD_GENERIC(_ITM_R##E, T) \
@@ -828,8 +927,8 @@ not enough because if we abort and restore -> stack can be corrupted
 
 #define TM_STORE_ALL(E, T, WF, WT) \
   TM_STORE(_ITM_W##E, T, WF, WT) \
-  TM_STORE(_ITM_WaR##E, T, WF, WT) \
-  TM_STORE(_ITM_WaW##E, T, WF, WT)
+  TM_STORE_PATTERN(_ITM_WaR##E, T, int_stm_WaR, WF, WT) \
+  TM_STORE_PATTERN(_ITM_WaW##E, T, int_stm_WaW, WF, WT)
 
 #define TM_STORE_GENERIC_ALL(E, T) \
   TM_STORE_GENERIC(_ITM_W##E, T) \
@@ -842,8 +941,8 @@ TM_LOAD_ALL(U1, uint8_t, int_stm_load_u8, uint8_t)
 TM_LOAD_ALL(U2, uint16_t, int_stm_load_u16, uint16_t)
 TM_LOAD_ALL(U4, uint32_t, int_stm_load_u32, uint32_t)
 TM_LOAD_ALL(U8, uint64_t, int_stm_load_u64, uint64_t)
-TM_LOAD_ALL(F, float, stm_load_float, float)
-TM_LOAD_ALL(D, double, stm_load_double, double)
+TM_LOAD_ALL(F, float, stm_load_float_tx, float)
+TM_LOAD_ALL(D, double, stm_load_double_tx, double)
 #ifdef __SSE__
 TM_LOAD_GENERIC_ALL(M64, __m64)
 TM_LOAD_GENERIC_ALL(M128, __m128)
@@ -856,8 +955,8 @@ TM_STORE_ALL(U1, uint8_t, int_stm_store_u8, uint8_t)
 TM_STORE_ALL(U2, uint16_t, int_stm_store_u16, uint16_t)
 TM_STORE_ALL(U4, uint32_t, int_stm_store_u32, uint32_t)
 TM_STORE_ALL(U8, uint64_t, int_stm_store_u64, uint64_t)
-TM_STORE_ALL(F, float, stm_store_float, float)
-TM_STORE_ALL(D, double, stm_store_double, double)
+TM_STORE_ALL(F, float, stm_store_float_tx, float)
+TM_STORE_ALL(D, double, stm_store_double_tx, double)
 #ifdef __SSE__
 TM_STORE_GENERIC_ALL(M64, __m64)
 TM_STORE_GENERIC_ALL(M128, __m128)
@@ -0,0 +1,177 @@
+/*
+ * File:
+ *   mod_cdc.h
+ * Author(s):
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *   Patrick Marlier <patrick.marlier@unine.ch>
+ * Description:
+ *   Module for capturing committed updates (change data capture).
+ *
+ * Copyright (c) 2007-2014.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * This program has a dual license and can also be distributed
+ * under the terms of the MIT license.
+ */
+
+/**
+ * @file
+ *   Module for capturing committed updates (change data capture).  When
+ *   the library is compiled with CDC, each update transaction appends
+ *   its write set (offset, new value, mask and commit timestamp of each
+ *   written word) to a ring buffer upon commit, after validation and
+ *   while its locks are still held.  The ring can be placed in shared
+ *   memory so that caches or replicas in other processes can consume
+ *   the stream.  Producers never block: if the ring is full, the
+ *   transaction's records are dropped and the lost counter of the ring
+ *   is incremented, and consumers must then resynchronize by other
+ *   means.  The stream does not include transactions executed by the
+ *   write-through design.
+ *
+ *   Transactions appear in the ring in an order that is compatible with
+ *   their commit timestamps: a transaction always appears after the
+ *   transactions it conflicts with and that committed before it (i.e.,
+ *   that wrote a location it reads or writes), so applying transactions
+ *   in ring order produces the same state as applying them in timestamp
+ *   order.
+ * @author
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *   Patrick Marlier <patrick.marlier@unine.ch>
+ * @date
+ *   2007-2014
+ */
+
+#ifndef _MOD_CDC_H_
+# define _MOD_CDC_H_
+
+# include "stm.h"
+
+# ifdef __cplusplus
+extern "C" {
+# endif
+
+/**
+ * Magic number identifying a change ring.
+ */
+# define MOD_CDC_MAGIC                  0x54434443UL
+
+/**
+ * Record describing one word written by a committed transaction.
+ */
+typedef struct mod_cdc_record {
+  /**
+   * Sequence number (set last by the producer; position + 1 when the
+   * record is ready).
+   */
+  volatile stm_word_t seq;
+  /**
+   * Commit timestamp of the transaction.
+   */
+  stm_word_t ts;
+  /**
+   * Number of records of the same transaction that follow this one.
+   */
+  stm_word_t left;
+  /**
+   * Offset of the word from the base address of the ring (or absolute
+   * address if the base is NULL).
+   */
+  stm_word_t offset;
+  /**
+   * New value of the word.
+   */
+  stm_word_t value;
+  /**
+   * Bytes of the word that have been written.
+   */
+  stm_word_t mask;
+} mod_cdc_record_t;
+
+/**
+ * Ring of change records (the records follow the header).
+ */
+typedef struct mod_cdc_ring {
+  stm_word_t magic;                     /**< Magic number (MOD_CDC_MAGIC) */
+  stm_word_t size;                      /**< Number of records (power of 2) */
+  stm_word_t base;                      /**< Base address for offsets */
+  volatile stm_word_t lost;             /**< Number of transactions dropped because the ring was full */
+  char pad1[64 - 4 * sizeof(stm_word_t)];
+  volatile stm_word_t tail;             /**< Next position reserved by producers */
+  char pad2[64 - sizeof(stm_word_t)];
+  volatile stm_word_t head;             /**< Next position read by the consumer */
+  char pad3[64 - sizeof(stm_word_t)];
+  mod_cdc_record_t records[];           /**< Records */
+} mod_cdc_ring_t;
+
+/**
+ * Create a change ring and start capturing committed updates.  This
+ * function must be called once, from the main thread, after
+ * initializing the STM library and before performing any transactional
+ * operation.
+ *
+ * @param name
+ *   Name of the POSIX shared memory object holding the ring, or NULL
+ *   for a ring in private memory.
+ * @param size
+ *   Number of records (rounded up to a power of 2).
+ * @param base
+ *   Base address subtracted from written addresses (e.g., start of a
+ *   replicated heap), or NULL to record absolute addresses.
+ * @return
+ *   The ring, or NULL upon error.
+ */
+mod_cdc_ring_t *mod_cdc_init(const char *name, size_t size, void *base);
+
+/**
+ * Attach to a change ring created by another process.
+ *
+ * @param name
+ *   Name of the POSIX shared memory object holding the ring.
+ * @return
+ *   The ring, or NULL upon error.
+ */
+mod_cdc_ring_t *mod_cdc_open(const char *name);
+
+/**
+ * Consume committed transactions from a change ring (single consumer).
+ * The callback is invoked for each record of each available
+ * transaction, in ring order; it can filter records or apply them
+ * (e.g., with mod_cdc_apply()).
+ *
+ * @param ring
+ *   Change ring.
+ * @param f
+ *   Function called for each record.
+ * @param arg
+ *   Argument passed to the function.
+ * @param max
+ *   Maximum number of transactions to consume (0 for no limit).
+ * @return
+ *   Number of transactions consumed.
+ */
+int mod_cdc_consume(mod_cdc_ring_t *ring, void (*f)(const mod_cdc_record_t *r, void *arg), void *arg, int max);
+
+/**
+ * Apply a record to a replica of the captured memory.
+ *
+ * @param r
+ *   Record.
+ * @param base
+ *   Base address of the replica (or NULL for absolute addresses).
+ */
+void mod_cdc_apply(const mod_cdc_record_t *r, void *base);
+
+# ifdef __cplusplus
+}
+# endif
+
+#endif /* _MOD_CDC_H_ */
@@ -45,6 +45,7 @@
 extern "C" {
 # endif
 
+//@{
 /**
  * Log word-sized value in transaction log.
  *
@@ -52,7 +53,10 @@ extern "C" {
  *   Address of the memory location.
  */
 void stm_log(stm_word_t *addr);
+void stm_log_tx(struct stm_tx *tx, stm_word_t *addr);
+//@}
 
+//@{
 /**
  * Log char 8-bit value in transaction log.
  *
@@ -60,7 +64,10 @@ void stm_log(stm_word_t *addr);
  *   Address of the memory location.
  */
 void stm_log_u8(uint8_t *addr);
+void stm_log_u8_tx(struct stm_tx *tx, uint8_t *addr);
+//@}
 
+//@{
 /**
  * Log char 16-bit value in transaction log.
  *
@@ -68,7 +75,10 @@ void stm_log_u8(uint8_t *addr);
  *   Address of the memory location.
  */
 void stm_log_u16(uint16_t *addr);
+void stm_log_u16_tx(struct stm_tx *tx, uint16_t *addr);
+//@}
 
+//@{
 /**
  * Log char 32-bit value in transaction log.
  *
@@ -76,7 +86,10 @@ void stm_log_u16(uint16_t *addr);
  *   Address of the memory location.
  */
 void stm_log_u32(uint32_t *addr);
+void stm_log_u32_tx(struct stm_tx *tx, uint32_t *addr);
+//@}
 
+//@{
 /**
  * Log char 64-bit value in transaction log.
  *
@@ -84,7 +97,10 @@ void stm_log_u32(uint32_t *addr);
  *   Address of the memory location.
  */
 void stm_log_u64(uint64_t *addr);
+void stm_log_u64_tx(struct stm_tx *tx, uint64_t *addr);
+//@}
 
+//@{
 /**
  * Log char value in transaction log.
  *
@@ -92,7 +108,10 @@ void stm_log_u64(uint64_t *addr);
  *   Address of the memory location.
  */
 void stm_log_char(char *addr);
+void stm_log_char_tx(struct stm_tx *tx, char *addr);
+//@}
 
+//@{
 /**
  * Log unsigned char value in transaction log.
  *
@@ -100,7 +119,10 @@ void stm_log_char(char *addr);
  *   Address of the memory location.
  */
 void stm_log_uchar(unsigned char *addr);
+void stm_log_uchar_tx(struct stm_tx *tx, unsigned char *addr);
+//@}
 
+//@{
 /**
  * Log short value in transaction log.
  *
@@ -108,7 +130,10 @@ void stm_log_uchar(unsigned char *addr);
  *   Address of the memory location.
  */
 void stm_log_short(short *addr);
+void stm_log_short_tx(struct stm_tx *tx, short *addr);
+//@}
 
+//@{
 /**
  * Log unsigned short value in transaction log.
  *
@@ -116,7 +141,10 @@ void stm_log_short(short *addr);
  *   Address of the memory location.
  */
 void stm_log_ushort(unsigned short *addr);
+void stm_log_ushort_tx(struct stm_tx *tx, unsigned short *addr);
+//@}
 
+//@{
 /**
  * Log int value in transaction log.
  *
@@ -124,7 +152,10 @@ void stm_log_ushort(unsigned short *addr);
  *   Address of the memory location.
  */
 void stm_log_int(int *addr);
+void stm_log_int_tx(struct stm_tx *tx, int *addr);
+//@}
 
+//@{
 /**
  * Log unsigned int value in transaction log.
  *
@@ -132,7 +163,10 @@ void stm_log_int(int *addr);
  *   Address of the memory location.
  */
 void stm_log_uint(unsigned int *addr);
+void stm_log_uint_tx(struct stm_tx *tx, unsigned int *addr);
+//@}
 
+//@{
 /**
  * Log long value in transaction log.
  *
@@ -140,7 +174,10 @@ void stm_log_uint(unsigned int *addr);
  *   Address of the memory location.
  */
 void stm_log_long(long *addr);
+void stm_log_long_tx(struct stm_tx *tx, long *addr);
+//@}
 
+//@{
 /**
  * Log unsigned long value in transaction log.
  *
@@ -148,7 +185,10 @@ void stm_log_long(long *addr);
  *   Address of the memory location.
  */
 void stm_log_ulong(unsigned long *addr);
+void stm_log_ulong_tx(struct stm_tx *tx, unsigned long *addr);
+//@}
 
+//@{
 /**
  * Log float value in transaction log.
  *
@@ -156,7 +196,10 @@ void stm_log_ulong(unsigned long *addr);
  *   Address of the memory location.
  */
 void stm_log_float(float *addr);
+void stm_log_float_tx(struct stm_tx *tx, float *addr);
+//@}
 
+//@{
 /**
  * Log double value in transaction log.
  *
@@ -164,7 +207,10 @@ void stm_log_float(float *addr);
  *   Address of the memory location.
  */
 void stm_log_double(double *addr);
+void stm_log_double_tx(struct stm_tx *tx, double *addr);
+//@}
 
+//@{
 /**
  * Log pointer value in transaction log.
  *
@@ -172,7 +218,10 @@ void stm_log_double(double *addr);
  *   Address of the memory location.
  */
 void stm_log_ptr(void **addr);
+void stm_log_ptr_tx(struct stm_tx *tx, void **addr);
+//@}
 
+//@{
 /**
  * Log memory region in transaction log.
  *
@@ -182,6 +231,8 @@ void stm_log_ptr(void **addr);
  *   Number of bytes to log.
  */
 void stm_log_bytes(uint8_t *addr, size_t size);
+void stm_log_bytes_tx(struct stm_tx *tx, uint8_t *addr, size_t size);
+//@}
 
 /**
  * Initialize the module.  This function must be called once, from the
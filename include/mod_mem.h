@@ -60,6 +60,22 @@ void *stm_malloc(size_t size);
 void *stm_malloc_tx(struct stm_tx *tx, size_t size);
 //@}
 
+//@{
+/**
+ * Allocate memory aligned on a cache line from inside a transaction.
+ * Allocated memory is implicitly freed upon abort.  Since lock stripes
+ * are not larger than cache lines, the block also starts on a stripe
+ * boundary.
+ *
+ * @param size
+ *   Number of bytes to allocate.
+ * @return
+ *   Pointer to the allocated memory block.
+ */
+void *stm_malloc_aligned(size_t size);
+void *stm_malloc_aligned_tx(struct stm_tx *tx, size_t size);
+//@}
+
 //@{
 /**
  * Allocate initialized memory from inside a transaction.  Allocated
@@ -112,6 +128,58 @@ void stm_free2(void *addr, size_t idx, size_t size);
 void stm_free2_tx(struct stm_tx *tx, void *addr, size_t idx, size_t size);
 //@}
 
+/**
+ * Enter a read-side critical section for accessing snapshots published
+ * with stm_rcu_publish() outside of a transaction.  Snapshots must be
+ * immutable once published and are read with plain loads.  Retired
+ * snapshots are not reclaimed before all readers that might have seen
+ * them have left their critical section.  Entering costs one store and
+ * a memory barrier, and leaving costs one store.  The calling thread
+ * must have been initialized with stm_init_thread() and must not be
+ * executing a transaction; critical sections cannot be nested.
+ * (Working only with EPOCH_GC)
+ */
+void stm_rcu_read_begin(void);
+
+/**
+ * Leave a read-side critical section.  Pointers to snapshots read in
+ * the critical section must not be used afterward.
+ * (Working only with EPOCH_GC)
+ */
+void stm_rcu_read_end(void);
+
+//@{
+/**
+ * Publish a new snapshot from inside a transaction.  The pointer is
+ * updated transactionally, so transactional readers are unaffected,
+ * and the snapshot becomes visible to non-transactional readers when
+ * the transaction commits (with write-back designs).  The snapshot must
+ * be fully initialized before being published.
+ *
+ * @param ptr
+ *   Address of the shared pointer.
+ * @param snapshot
+ *   New snapshot.
+ */
+void stm_rcu_publish(void **ptr, void *snapshot);
+void stm_rcu_publish_tx(struct stm_tx *tx, void **ptr, void *snapshot);
+//@}
+
+//@{
+/**
+ * Retire a snapshot from inside a transaction, typically the one just
+ * replaced by stm_rcu_publish().  Upon commit, the memory is handed to
+ * the epoch-based garbage collector and freed once no read-side
+ * critical section or transaction can still access it.  Nothing happens
+ * upon abort.  (Working only with EPOCH_GC)
+ *
+ * @param snapshot
+ *   Snapshot to retire (allocated with malloc() or stm_malloc()).
+ */
+void stm_rcu_retire(void *snapshot);
+void stm_rcu_retire_tx(struct stm_tx *tx, void *snapshot);
+//@}
+
 /**
  * Initialize the module.  This function must be called once, from the
  * main thread, after initializing the STM library and before
@@ -0,0 +1,179 @@
+/*
+ * File:
+ *   mod_replay.h
+ * Author(s):
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *   Patrick Marlier <patrick.marlier@unine.ch>
+ * Description:
+ *   Module for recording and replaying transaction interleavings.
+ *
+ * Copyright (c) 2007-2014.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * This program has a dual license and can also be distributed
+ * under the terms of the MIT license.
+ */
+
+/**
+ * @file
+ *   Module for recording and replaying transaction interleavings.  In
+ *   record mode, the begin, commit and abort events of all threads
+ *   initialized after the module are appended to a compact binary log,
+ *   together with their position in the stream of the thread, a
+ *   timestamp of the global clock (start timestamp for begins and
+ *   aborts, commit timestamp for commits), the abort reason and the
+ *   size of the read and write sets when the transaction committed or
+ *   aborted.  Events are buffered per thread and recording does not
+ *   add any shared access besides writing full buffers to the log.  The
+ *   application can attach a tag (e.g., the key of the operation) to
+ *   the next transaction of the current thread so that its inputs can
+ *   be reproduced.
+ *
+ *   When the log is loaded, the streams of the threads are merged by
+ *   timestamp to recover the begin order (transactions that started
+ *   with the same timestamp were concurrent and are ordered by thread).
+ *   In replay mode, each thread initialized after the module is bound
+ *   to the stream of a recorded thread and obtains the identifier and
+ *   tag of its successive transactions from mod_replay_next(), which
+ *   also blocks until the transaction can start in the recorded begin
+ *   order.  If the begin order cannot make progress (e.g., because a
+ *   stream is not replayed by any thread), it is no longer enforced
+ *   after a timeout and a warning is printed.  Conflicts are then resolved by the current contention
+ *   manager and lock mapping, so that their effect on the same conflict
+ *   pattern can be measured by comparing the recorded and replayed
+ *   aborts.  Commits are not forced in the recorded order (use mod_order
+ *   for that purpose).  The sequence is only preserved if each call to
+ *   mod_replay_next() is followed by the start of a transaction.
+ * @author
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *   Patrick Marlier <patrick.marlier@unine.ch>
+ * @date
+ *   2007-2014
+ */
+
+#ifndef _MOD_REPLAY_H_
+# define _MOD_REPLAY_H_
+
+# include <stdint.h>
+
+# include "stm.h"
+
+# ifdef __cplusplus
+extern "C" {
+# endif
+
+/**
+ * Magic number identifying a replay log.
+ */
+# define MOD_REPLAY_MAGIC               0x59504c52UL
+
+/**
+ * Event types.
+ */
+enum {
+  MOD_REPLAY_BEGIN = 0,                 /**< Transaction started (first attempt) */
+  MOD_REPLAY_COMMIT = 1,                /**< Transaction committed */
+  MOD_REPLAY_ABORT = 2                  /**< Transaction aborted */
+};
+
+/**
+ * Event stored in the log (in native byte order, 40 bytes).
+ */
+typedef struct mod_replay_event {
+  uint64_t value;                       /**< Tag (begin) or commit timestamp (commit) */
+  uint64_t ts;                          /**< Start (begin, abort) or commit timestamp (commit) */
+  uint32_t seq;                         /**< Sequence number in the stream of the thread */
+  uint16_t thread;                      /**< Thread (stream) index */
+  uint16_t id;                          /**< Transaction identifier (attribute) */
+  uint16_t type;                        /**< Event type (MOD_REPLAY_*) */
+  uint16_t reason;                      /**< Abort reason (STM_ABORT_*) */
+  uint32_t retries;                     /**< Number of previous attempts */
+  uint32_t reads;                       /**< Number of read set entries */
+  uint32_t writes;                      /**< Number of write set entries */
+} mod_replay_event_t;
+
+/**
+ * Comparison of recorded and replayed executions.  Aborts are broken
+ * down by abort reason (indexed by (reason >> 8) & 0x0F).
+ */
+typedef struct mod_replay_stats {
+  unsigned long recorded_commits;       /**< Commits in the log */
+  unsigned long recorded_aborts;        /**< Aborts in the log */
+  unsigned long recorded_aborts_r[16];  /**< Aborts in the log per reason */
+  unsigned long commits;                /**< Commits during replay */
+  unsigned long aborts;                 /**< Aborts during replay */
+  unsigned long aborts_r[16];           /**< Aborts during replay per reason */
+} mod_replay_stats_t;
+
+/**
+ * Start recording transactions into a log file.  This function must be
+ * called once, from the main thread, after initializing the STM library
+ * and before creating the threads to record.  The log is complete once
+ * all recorded threads have been cleaned up.
+ *
+ * @param file
+ *   Name of the log file (created or truncated).
+ */
+void mod_replay_record(const char *file);
+
+/**
+ * Load a log file for replay.  This function must be called once, from
+ * the main thread, after initializing the STM library and before
+ * creating the threads that replay the recorded streams.
+ *
+ * @param file
+ *   Name of the log file.
+ * @return
+ *   Number of recorded threads (streams).
+ */
+int mod_replay_load(const char *file);
+
+/**
+ * Attach a tag to the next transaction started by the current thread
+ * (record mode).
+ *
+ * @param tag
+ *   Application-specific value stored with the begin event.
+ */
+void mod_replay_tag(stm_word_t tag);
+
+/**
+ * Get the next transaction of the stream of the current thread (replay
+ * mode) and wait until it can start in the recorded order.  The caller
+ * must start the corresponding transaction immediately after.
+ *
+ * @param tag
+ *   Pointer to the variable that should hold the recorded tag.
+ * @return
+ *   Identifier of the recorded transaction, or -1 if the stream is
+ *   exhausted.  The order is no longer enforced once it has not
+ *   progressed for a second while a thread was waiting.
+ */
+int mod_replay_next(stm_word_t *tag);
+
+/**
+ * Get the number of commits and aborts of the recorded and replayed
+ * executions (replay mode).  Replayed statistics only include threads
+ * that have been cleaned up.
+ *
+ * @param stats
+ *   Pointer to the structure that should hold the statistics.
+ * @return
+ *   1 upon success, 0 otherwise.
+ */
+int mod_replay_get_stats(mod_replay_stats_t *stats);
+
+# ifdef __cplusplus
+}
+# endif
+
+#endif /* _MOD_REPLAY_H_ */
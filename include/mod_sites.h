@@ -0,0 +1,83 @@
+/*
+ * File:
+ *   mod_sites.h
+ * Author(s):
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *   Patrick Marlier <patrick.marlier@unine.ch>
+ * Description:
+ *   Module for attributing conflicts to call sites.
+ *
+ * Copyright (c) 2007-2014.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * This program has a dual license and can also be distributed
+ * under the terms of the MIT license.
+ */
+
+/**
+ * @file
+ *   Module for attributing conflicts to call sites.  This module
+ *   requires the library to be compiled with CONFLICT_TRACKING and
+ *   CALL_SITES.  Each conflict detected by a transaction is counted per
+ *   pair of call sites: the barrier of the transaction that detected
+ *   the conflict (victim) and the barrier of the first write of the
+ *   transaction that owns the lock (aggressor).  Call sites of reads
+ *   detected as conflicting upon validation are only known for sampled
+ *   transactions and are otherwise reported as unknown.  Counts are
+ *   kept per thread and aggregated when threads are cleaned up.
+ *
+ *   The report shows call sites as an object file and an address in
+ *   that object, which can be symbolized offline, e.g., with
+ *   "addr2line -f -i -e <object> <address>".
+ * @author
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *   Patrick Marlier <patrick.marlier@unine.ch>
+ * @date
+ *   2007-2014
+ */
+
+#ifndef _MOD_SITES_H_
+# define _MOD_SITES_H_
+
+# include <stdio.h>
+
+# ifdef __cplusplus
+extern "C" {
+# endif
+
+/**
+ * Initialize the module.  This function must be called once, from the
+ * main thread, after initializing the STM library and before creating
+ * the threads to observe.  The module uses the conflict callback of the
+ * library.
+ */
+void mod_sites_init(void);
+
+/**
+ * Print the pairs of call sites involved in conflicts, by decreasing
+ * number of conflicts.  Only threads that have been cleaned up are
+ * included.
+ *
+ * @param f
+ *   Output stream.
+ * @param max
+ *   Maximal number of pairs to print (0 for all).
+ * @return
+ *   Number of distinct pairs of call sites.
+ */
+int mod_sites_report(FILE *f, int max);
+
+# ifdef __cplusplus
+}
+# endif
+
+#endif /* _MOD_SITES_H_ */
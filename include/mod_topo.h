@@ -0,0 +1,124 @@
+/*
+ * File:
+ *   mod_topo.h
+ * Author(s):
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *   Patrick Marlier <patrick.marlier@unine.ch>
+ * Description:
+ *   Module for topology-aware thread placement.
+ *
+ * Copyright (c) 2007-2014.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * This program has a dual license and can also be distributed
+ * under the terms of the MIT license.
+ */
+
+/**
+ * @file
+ *   Module for topology-aware thread placement.  This module reads the
+ *   CPU and NUMA topology from /sys (Linux only) and pins threads to
+ *   processors according to a placement policy.  Threads should be
+ *   pinned before calling stm_init_thread(): the transaction descriptor
+ *   and its read and write sets are then allocated and first touched by
+ *   a thread that already runs on its final node, so that the operating
+ *   system places them in local memory.  This module does not depend on
+ *   the STM and can also be used by non-transactional code.
+ * @author
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *   Patrick Marlier <patrick.marlier@unine.ch>
+ * @date
+ *   2007-2014
+ */
+
+#ifndef _MOD_TOPO_H_
+# define _MOD_TOPO_H_
+
+# ifdef __cplusplus
+extern "C" {
+# endif
+
+/**
+ * Thread placement policies.
+ */
+enum {
+  /**
+   * Do not pin threads.
+   */
+  MOD_TOPO_NONE = 0,
+  /**
+   * Pin threads to processors as close as possible to each other:
+   * hardware threads of a core first, then cores of a node, then
+   * other nodes.
+   */
+  MOD_TOPO_COMPACT = 1,
+  /**
+   * Pin threads to processors as far as possible from each other:
+   * one per node first, then one per core, then hardware threads.
+   */
+  MOD_TOPO_SCATTER = 2,
+  /**
+   * Bind threads to all processors of a node, filling nodes one after
+   * the other (the scheduler chooses the processor within the node).
+   */
+  MOD_TOPO_NUMA = 3
+};
+
+/**
+ * Initialize the module.  This function must be called once, from the
+ * main thread, before pinning any thread.  Only the processors the
+ * process is allowed to run on are considered.
+ *
+ * @return
+ *   Number of processors available for placement.
+ */
+int mod_topo_init(void);
+
+/**
+ * Get the number of NUMA nodes with available processors.
+ *
+ * @return
+ *   Number of nodes (1 if the topology is not known).
+ */
+int mod_topo_nb_nodes(void);
+
+/**
+ * Get a placement policy from its name ("none", "compact", "scatter"
+ * or "numa").
+ *
+ * @param name
+ *   Name of the policy (case insensitive).
+ * @return
+ *   Policy (MOD_TOPO_*), or -1 if the name is unknown.
+ */
+int mod_topo_policy(const char *name);
+
+/**
+ * Pin the calling thread according to a placement policy.  Threads
+ * are numbered from 0; when there are more threads than processors,
+ * placement wraps around.
+ *
+ * @param policy
+ *   Placement policy (MOD_TOPO_*).
+ * @param index
+ *   Index of the calling thread.
+ * @return
+ *   Node of the processor(s) the thread has been pinned to, or -1 if
+ *   the thread has not been pinned.
+ */
+int mod_topo_pin(int policy, int index);
+
+# ifdef __cplusplus
+}
+# endif
+
+#endif /* _MOD_TOPO_H_ */
@@ -0,0 +1,137 @@
+/*
+ * File:
+ *   mod_watch.h
+ * Author(s):
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *   Patrick Marlier <patrick.marlier@unine.ch>
+ * Description:
+ *   Module for watching transactional memory ranges.
+ *
+ * Copyright (c) 2007-2014.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * This program has a dual license and can also be distributed
+ * under the terms of the MIT license.
+ */
+
+/**
+ * @file
+ *   Module for watching transactional memory ranges.  This module lets
+ *   threads register a callback that is invoked asynchronously after
+ *   transactions that wrote into a memory range have committed, instead
+ *   of polling shared state.  The library must be compiled with WATCH:
+ *   committing transactions then check their written addresses against
+ *   a bitmap of watched lock stripes (a single test per write, and no
+ *   test at all when nothing is watched) and enqueue one notification
+ *   per watched lock stripe written into a lock-free queue, without
+ *   ever blocking.  Notifications are delivered by a dispatcher thread
+ *   outside of any transaction, and are coalesced per range and commit
+ *   timestamp.  If the notification queue overflows, notifications are
+ *   dropped and counted, and every registration is notified once with a
+ *   NULL address, meaning that the range may have changed.
+ * @author
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *   Patrick Marlier <patrick.marlier@unine.ch>
+ * @date
+ *   2007-2014
+ */
+
+#ifndef _MOD_WATCH_H_
+# define _MOD_WATCH_H_
+
+# include <stddef.h>
+
+# include "stm.h"
+
+# ifdef __cplusplus
+extern "C" {
+# endif
+
+/**
+ * Maximum number of simultaneous registrations.
+ */
+# define MOD_WATCH_MAX                  64
+
+/**
+ * Watch callback.
+ *
+ * @param addr
+ *   First address of the range written by the transaction, or NULL if
+ *   notifications have been lost.
+ * @param ts
+ *   Commit timestamp of the transaction (0 if notifications have been
+ *   lost).
+ * @param arg
+ *   Argument given upon registration.
+ */
+typedef void (*stm_watch_cb_t)(void *addr, stm_word_t ts, void *arg);
+
+/**
+ * Register a watch on a memory range.  The callback is called by the
+ * dispatcher thread, which is a regular transactional thread: it can
+ * itself execute transactions (but should not write into the ranges
+ * it watches).
+ *
+ * @param addr
+ *   Start of the range.
+ * @param len
+ *   Length of the range in bytes.
+ * @param cb
+ *   Function called after a transaction writing into the range has
+ *   committed.
+ * @param arg
+ *   Argument passed to the callback.
+ * @return
+ *   Identifier of the registration, or -1 if there are too many
+ *   registrations.
+ */
+int stm_watch(void *addr, size_t len, stm_watch_cb_t cb, void *arg);
+
+/**
+ * Cancel a watch registration.  The callback may still be called for
+ * notifications that were already being delivered.
+ *
+ * @param id
+ *   Identifier returned by stm_watch().
+ * @return
+ *   1 upon success, 0 if the identifier is not valid.
+ */
+int stm_unwatch(int id);
+
+/**
+ * Get the number of notifications dropped because the queue was full.
+ *
+ * @return
+ *   Number of notifications lost since the module was initialized.
+ */
+unsigned long stm_watch_dropped(void);
+
+/**
+ * Initialize the module and start the dispatcher thread.  This
+ * function must be called once, from the main thread, after
+ * initializing the STM library and before performing any transactional
+ * operation.
+ */
+void mod_watch_init(void);
+
+/**
+ * Deliver pending notifications and stop the dispatcher thread.  This
+ * function must be called from the main thread before shutting down
+ * the STM library.
+ */
+void mod_watch_exit(void);
+
+# ifdef __cplusplus
+}
+# endif
+
+#endif /* _MOD_WATCH_H_ */
@@ -169,6 +169,12 @@ typedef union stm_tx_attr {
    * mechanism. (Working only with UNIT_TX)
    */
   unsigned int no_extend : 1;
+  /**
+   * Selects the set of retry policies applied when the transaction
+   * aborts (see stm_set_retry_policy()).  Set 0 is the default one.
+   * (Working only with RETRY_POLICIES)
+   */
+  unsigned int retry_policy : 4;
   /**
    * Indicates that the transaction is irrevocable.
    * 1 is simple irrevocable and 3 is serial irrevocable.
@@ -258,6 +264,16 @@ enum {
    * Abort due to reaching the write set size limit.
    */
   STM_ABORT_EXTEND_WS = (1 << 6) | (0x0C << 8),
+  /**
+   * Abort and no retry due to exceeding the deadline of the transaction
+   * (see stm_set_deadline()).
+   */
+  STM_ABORT_DEADLINE = (1 << 6) | (0x0D << 8),
+  /**
+   * Abort and no retry due to a cancellation request from another thread
+   * (see stm_cancel()).
+   */
+  STM_ABORT_CANCELLED = (1 << 6) | (0x0E << 8),
   /**
    * Abort due to other reasons (internal to the protocol).
    */
@@ -362,6 +378,28 @@ stm_word_t stm_load(volatile stm_word_t *addr) _CALLCONV;
 stm_word_t stm_load_tx(struct stm_tx *tx, volatile stm_word_t *addr) _CALLCONV;
 //@}
 
+//@{
+/**
+ * Transactional load of consecutive words.  Read the specified memory
+ * locations in the context of the current transaction, with the same
+ * guarantees as stm_load().  The first word of each lock stripe goes
+ * through the regular read barrier, and the other words of the stripe
+ * are copied and validated with a single check of the stripe's lock
+ * (the stripe covers 2^LOCK_SHIFT_EXTRA words, see the "lock_shift"
+ * parameter).  Data structures whose nodes are aligned on stripes can
+ * thus be read with one check and one read set entry per stripe.
+ *
+ * @param addr
+ *   Address of the first memory location.
+ * @param buf
+ *   Buffer that should hold the values read.
+ * @param nb
+ *   Number of words to read.
+ */
+void stm_load_range(volatile stm_word_t *addr, stm_word_t *buf, size_t nb) _CALLCONV;
+void stm_load_range_tx(struct stm_tx *tx, volatile stm_word_t *addr, stm_word_t *buf, size_t nb) _CALLCONV;
+//@}
+
 //@{
 /**
  * Transactional store.  Write a word-sized value to the specified
@@ -556,6 +594,172 @@ void stm_set_specific(int key, void *data) _CALLCONV;
 void stm_set_specific_tx(struct stm_tx *tx, int key, void *data) _CALLCONV;
 //@}
 
+//@{
+/**
+ * Allocate scratch memory private to the current transaction.  The
+ * memory comes from a per-thread bump-pointer arena and is released as
+ * a whole, in constant time, when the transaction commits or aborts.
+ * There is no logging and no callback involved.  Scratch memory must
+ * be accessed directly (not through transactional loads and stores),
+ * and the ABI layer skips barriers for it.  Its content is lost when
+ * the transaction restarts.
+ *
+ * @param size
+ *   Number of bytes to allocate.
+ * @return
+ *   Pointer to the allocated memory block (16-byte aligned).
+ */
+void *stm_scratch_alloc(size_t size) _CALLCONV;
+void *stm_scratch_alloc_tx(struct stm_tx *tx, size_t size) _CALLCONV;
+//@}
+
+/**
+ * Retry policies applied upon abort (see stm_set_retry_policy()).
+ */
+enum {
+  /**
+   * Use the contention manager the library has been compiled with.
+   */
+  STM_RETRY_DEFAULT = 0,
+  /**
+   * Restart immediately.
+   */
+  STM_RETRY_IMMEDIATE = 1,
+  /**
+   * Wait until the lock that caused the abort (if any) is released.
+   */
+  STM_RETRY_WAIT_LOCK = 2,
+  /**
+   * Randomized exponential backoff.  The argument is the maximum
+   * backoff (0 for the compiled-in MAX_BACKOFF).
+   */
+  STM_RETRY_BACKOFF = 3,
+  /**
+   * Restart with visible reads.  (Working only with CM_MODULAR)
+   */
+  STM_RETRY_VISIBLE_READS = 4,
+  /**
+   * Restart in irrevocable mode once the transaction has aborted as
+   * many times in a row as the argument, and use the default policy
+   * before.  (Working only with IRREVOCABLE_ENABLED)
+   */
+  STM_RETRY_IRREVOCABLE = 5
+};
+
+/**
+ * Set the retry policy applied when a transaction aborts for a given
+ * reason.  Policies are grouped in sets and each atomic block selects
+ * its set using the retry_policy transaction attribute.  The number of
+ * times each policy has been applied is reported by stm_get_stats()
+ * ("nb_retry_immediate", "nb_retry_wait_lock", etc.) when compiled
+ * with TM_STATISTICS.  This function should be called before
+ * transactions that use the set are started.
+ * (Working only with RETRY_POLICIES)
+ *
+ * @param set
+ *   Policy set (from 0 to 15).
+ * @param reason
+ *   Abort reason (STM_ABORT_*), or -1 for all reasons.  Explicit aborts
+ *   share the policy of STM_ABORT_EXPLICIT, or of STM_ABORT_NO_RETRY if
+ *   they do not retry.
+ * @param policy
+ *   Retry policy (STM_RETRY_*).
+ * @param arg
+ *   Policy-specific argument.
+ * @return
+ *   1 upon success, 0 otherwise (e.g., the policy is not supported).
+ */
+int stm_set_retry_policy(unsigned int set, int reason, int policy, unsigned int arg) _CALLCONV;
+
+/**
+ * Get the call sites of the accesses involved in the last conflict
+ * detected by a transaction, i.e., the return addresses of the
+ * barriers (stm_load(), stm_store(), ABI barriers, etc.) that performed
+ * the access of the transaction and the first write of the other
+ * transaction to the conflicting lock stripe.  The call site of a read
+ * detected as conflicting upon validation is only known if the read
+ * has been sampled.  This function is meant to be called from the
+ * conflict callback ("conflict_cb" parameter, see also mod_sites.h).
+ * (Working only with CALL_SITES)
+ *
+ * @param tx
+ *   Transaction that detected the conflict.
+ * @param site
+ *   Pointer to the variable that should hold the call site of the
+ *   transaction (NULL if unknown).
+ * @param other_site
+ *   Pointer to the variable that should hold the call site of the
+ *   other transaction (NULL if unknown).
+ * @return
+ *   1 upon success, 0 otherwise.
+ */
+int stm_get_conflict_sites(struct stm_tx *tx, void **site, void **other_site) _CALLCONV;
+
+/**
+ * Actions taken when a transaction exceeds its deadline (see
+ * stm_set_deadline()).
+ */
+enum {
+  /**
+   * Give up: the transaction is rolled back and not retried.
+   */
+  STM_DEADLINE_ABORT = 0,
+  /**
+   * Retry once more in irrevocable mode, which cannot abort.  (Working
+   * only with IRREVOCABLE_ENABLED)
+   */
+  STM_DEADLINE_IRREVOCABLE = 1
+};
+
+//@{
+/**
+ * Set the deadline of the transactions executed by the current thread.
+ * The deadline is checked each time a transaction aborts and while it
+ * waits for a contended lock before restarting.  Once it is exceeded,
+ * the transaction either gives up or restarts in irrevocable mode,
+ * depending on the action.  When giving up, the transaction is rolled
+ * back and execution continues at the point where sigsetjmp() has been
+ * called after starting the outermost transaction, with the abort
+ * reason STM_ABORT_DEADLINE and no STM_PATH_* bit set: the transaction
+ * is no longer active and its code must not be executed (unless the
+ * attributes indicate that the transaction should not retry, in which
+ * case the function that aborted returns).  With the ABI, the compiled
+ * code is asked to skip the transaction (a_abortTransaction) if it may
+ * be cancelled, and otherwise the transaction restarts in irrevocable
+ * mode (or retries if IRREVOCABLE_ENABLED is not set).  The deadline
+ * remains in effect for the subsequent transactions of the thread until
+ * it is changed.  (Working only with DEADLINES)
+ *
+ * @param deadline
+ *   Absolute time in microseconds since the Epoch (as returned by
+ *   gettimeofday()), or 0 for no time limit.
+ * @param max_retries
+ *   Maximal number of aborts of a transaction, or 0 for no limit.
+ * @param action
+ *   Action taken when the deadline is exceeded (STM_DEADLINE_*).
+ * @return
+ *   1 upon success, 0 otherwise (e.g., the action is not supported).
+ */
+int stm_set_deadline(uint64_t deadline, unsigned int max_retries, int action) _CALLCONV;
+int stm_set_deadline_tx(struct stm_tx *tx, uint64_t deadline, unsigned int max_retries, int action) _CALLCONV;
+//@}
+
+/**
+ * Request the cancellation of the transaction being executed by another
+ * thread (e.g., by a supervisor thread).  The victim aborts with reason
+ * STM_ABORT_CANCELLED at its next load, store or commit, and does not
+ * retry: execution continues at the point where sigsetjmp() has been
+ * called with no STM_PATH_* bit set, as when exceeding a deadline.
+ * Irrevocable transactions cannot be cancelled.  A request issued while
+ * the thread is not executing a transaction is ignored, and a request
+ * never affects transactions started after the one it targeted.
+ * (Working only with DEADLINES)
+ *
+ * @param tx
+ *   Descriptor of the victim (see stm_current_tx()).
+ */
+void stm_cancel(struct stm_tx *tx) _CALLCONV;
+
 /**
  * Register application-specific callbacks that are triggered each time
  * particular events occur.
@@ -46,6 +46,7 @@
 extern "C" {
 # endif
 
+//@{
 /**
  * Transactional load of an unsigned 8-bit value.
  *
@@ -55,7 +56,10 @@ extern "C" {
  *   Value read from the specified address.
  */
 uint8_t stm_load_u8(volatile uint8_t *addr) _CALLCONV;
+uint8_t stm_load_u8_tx(struct stm_tx *tx, volatile uint8_t *addr) _CALLCONV;
+//@}
 
+//@{
 /**
  * Transactional load of an unsigned 16-bit value.
  *
@@ -65,7 +69,10 @@ uint8_t stm_load_u8(volatile uint8_t *addr) _CALLCONV;
  *   Value read from the specified address.
  */
 uint16_t stm_load_u16(volatile uint16_t *addr) _CALLCONV;
+uint16_t stm_load_u16_tx(struct stm_tx *tx, volatile uint16_t *addr) _CALLCONV;
+//@}
 
+//@{
 /**
  * Transactional load of an unsigned 32-bit value.
  *
@@ -75,7 +82,10 @@ uint16_t stm_load_u16(volatile uint16_t *addr) _CALLCONV;
  *   Value read from the specified address.
  */
 uint32_t stm_load_u32(volatile uint32_t *addr) _CALLCONV;
+uint32_t stm_load_u32_tx(struct stm_tx *tx, volatile uint32_t *addr) _CALLCONV;
+//@}
 
+//@{
 /**
  * Transactional load of an unsigned 64-bit value.
  *
@@ -85,7 +95,10 @@ uint32_t stm_load_u32(volatile uint32_t *addr) _CALLCONV;
  *   Value read from the specified address.
  */
 uint64_t stm_load_u64(volatile uint64_t *addr) _CALLCONV;
+uint64_t stm_load_u64_tx(struct stm_tx *tx, volatile uint64_t *addr) _CALLCONV;
+//@}
 
+//@{
 /**
  * Transactional load of a char value.
  *
@@ -95,7 +108,10 @@ uint64_t stm_load_u64(volatile uint64_t *addr) _CALLCONV;
  *   Value read from the specified address.
  */
 char stm_load_char(volatile char *addr) _CALLCONV;
+char stm_load_char_tx(struct stm_tx *tx, volatile char *addr) _CALLCONV;
+//@}
 
+//@{
 /**
  * Transactional load of an unsigned char value.
  *
@@ -105,7 +121,10 @@ char stm_load_char(volatile char *addr) _CALLCONV;
  *   Value read from the specified address.
  */
 unsigned char stm_load_uchar(volatile unsigned char *addr) _CALLCONV;
+unsigned char stm_load_uchar_tx(struct stm_tx *tx, volatile unsigned char *addr) _CALLCONV;
+//@}
 
+//@{
 /**
  * Transactional load of a short value.
  *
@@ -115,7 +134,10 @@ unsigned char stm_load_uchar(volatile unsigned char *addr) _CALLCONV;
  *   Value read from the specified address.
  */
 short stm_load_short(volatile short *addr) _CALLCONV;
+short stm_load_short_tx(struct stm_tx *tx, volatile short *addr) _CALLCONV;
+//@}
 
+//@{
 /**
  * Transactional load of an unsigned short value.
  *
@@ -125,7 +147,10 @@ short stm_load_short(volatile short *addr) _CALLCONV;
  *   Value read from the specified address.
  */
 unsigned short stm_load_ushort(volatile unsigned short *addr) _CALLCONV;
+unsigned short stm_load_ushort_tx(struct stm_tx *tx, volatile unsigned short *addr) _CALLCONV;
+//@}
 
+//@{
 /**
  * Transactional load of an int value.
  *
@@ -135,7 +160,10 @@ unsigned short stm_load_ushort(volatile unsigned short *addr) _CALLCONV;
  *   Value read from the specified address.
  */
 int stm_load_int(volatile int *addr) _CALLCONV;
+int stm_load_int_tx(struct stm_tx *tx, volatile int *addr) _CALLCONV;
+//@}
 
+//@{
 /**
  * Transactional load of an unsigned int value.
  *
@@ -145,7 +173,10 @@ int stm_load_int(volatile int *addr) _CALLCONV;
  *   Value read from the specified address.
  */
 unsigned int stm_load_uint(volatile unsigned int *addr) _CALLCONV;
+unsigned int stm_load_uint_tx(struct stm_tx *tx, volatile unsigned int *addr) _CALLCONV;
+//@}
 
+//@{
 /**
  * Transactional load of a long value.
  *
@@ -155,7 +186,10 @@ unsigned int stm_load_uint(volatile unsigned int *addr) _CALLCONV;
  *   Value read from the specified address.
  */
 long stm_load_long(volatile long *addr) _CALLCONV;
+long stm_load_long_tx(struct stm_tx *tx, volatile long *addr) _CALLCONV;
+//@}
 
+//@{
 /**
  * Transactional load of an unsigned long value.
  *
@@ -165,7 +199,10 @@ long stm_load_long(volatile long *addr) _CALLCONV;
  *   Value read from the specified address.
  */
 unsigned long stm_load_ulong(volatile unsigned long *addr) _CALLCONV;
+unsigned long stm_load_ulong_tx(struct stm_tx *tx, volatile unsigned long *addr) _CALLCONV;
+//@}
 
+//@{
 /**
  * Transactional load of a float value.
  *
@@ -175,7 +212,10 @@ unsigned long stm_load_ulong(volatile unsigned long *addr) _CALLCONV;
  *   Value read from the specified address.
  */
 float stm_load_float(volatile float *addr) _CALLCONV;
+float stm_load_float_tx(struct stm_tx *tx, volatile float *addr) _CALLCONV;
+//@}
 
+//@{
 /**
  * Transactional load of a double value.
  *
@@ -185,7 +225,10 @@ float stm_load_float(volatile float *addr) _CALLCONV;
  *   Value read from the specified address.
  */
 double stm_load_double(volatile double *addr) _CALLCONV;
+double stm_load_double_tx(struct stm_tx *tx, volatile double *addr) _CALLCONV;
+//@}
 
+//@{
 /**
  * Transactional load of a pointer value.
  *
@@ -195,7 +238,10 @@ double stm_load_double(volatile double *addr) _CALLCONV;
  *   Value read from the specified address.
  */
 void *stm_load_ptr(volatile void **addr) _CALLCONV;
+void *stm_load_ptr_tx(struct stm_tx *tx, volatile void **addr) _CALLCONV;
+//@}
 
+//@{
 /**
  * Transactional load of a memory region.  The address of the region
  * does not need to be word aligned and its size may be longer than a
@@ -210,7 +256,10 @@ void *stm_load_ptr(volatile void **addr) _CALLCONV;
  *   Number of bytes to read.
  */
 void stm_load_bytes(volatile uint8_t *addr, uint8_t *buf, size_t size) _CALLCONV;
+void stm_load_bytes_tx(struct stm_tx *tx, volatile uint8_t *addr, uint8_t *buf, size_t size) _CALLCONV;
+//@}
 
+//@{
 /**
  * Transactional store of an unsigned 8-bit value.
  *
@@ -220,7 +269,10 @@ void stm_load_bytes(volatile uint8_t *addr, uint8_t *buf, size_t size) _CALLCONV
  *   Value to be written.
  */
 void stm_store_u8(volatile uint8_t *addr, uint8_t value) _CALLCONV;
+void stm_store_u8_tx(struct stm_tx *tx, volatile uint8_t *addr, uint8_t value) _CALLCONV;
+//@}
 
+//@{
 /**
  * Transactional store of an unsigned 16-bit value.
  *
@@ -230,7 +282,10 @@ void stm_store_u8(volatile uint8_t *addr, uint8_t value) _CALLCONV;
  *   Value to be written.
  */
 void stm_store_u16(volatile uint16_t *addr, uint16_t value) _CALLCONV;
+void stm_store_u16_tx(struct stm_tx *tx, volatile uint16_t *addr, uint16_t value) _CALLCONV;
+//@}
 
+//@{
 /**
  * Transactional store of an unsigned 32-bit value.
  *
@@ -240,7 +295,10 @@ void stm_store_u16(volatile uint16_t *addr, uint16_t value) _CALLCONV;
  *   Value to be written.
  */
 void stm_store_u32(volatile uint32_t *addr, uint32_t value) _CALLCONV;
+void stm_store_u32_tx(struct stm_tx *tx, volatile uint32_t *addr, uint32_t value) _CALLCONV;
+//@}
 
+//@{
 /**
  * Transactional store of an unsigned 64-bit value.
  *
@@ -250,7 +308,10 @@ void stm_store_u32(volatile uint32_t *addr, uint32_t value) _CALLCONV;
  *   Value to be written.
  */
 void stm_store_u64(volatile uint64_t *addr, uint64_t value) _CALLCONV;
+void stm_store_u64_tx(struct stm_tx *tx, volatile uint64_t *addr, uint64_t value) _CALLCONV;
+//@}
 
+//@{
 /**
  * Transactional store of a char value.
  *
@@ -260,7 +321,10 @@ void stm_store_u64(volatile uint64_t *addr, uint64_t value) _CALLCONV;
  *   Value to be written.
  */
 void stm_store_char(volatile char *addr, char value) _CALLCONV;
+void stm_store_char_tx(struct stm_tx *tx, volatile char *addr, char value) _CALLCONV;
+//@}
 
+//@{
 /**
  * Transactional store of an unsigned char value.
  *
@@ -270,7 +334,10 @@ void stm_store_char(volatile char *addr, char value) _CALLCONV;
  *   Value to be written.
  */
 void stm_store_uchar(volatile unsigned char *addr, unsigned char value) _CALLCONV;
+void stm_store_uchar_tx(struct stm_tx *tx, volatile unsigned char *addr, unsigned char value) _CALLCONV;
+//@}
 
+//@{
 /**
  * Transactional store of a short value.
  *
@@ -280,7 +347,10 @@ void stm_store_uchar(volatile unsigned char *addr, unsigned char value) _CALLCON
  *   Value to be written.
  */
 void stm_store_short(volatile short *addr, short value) _CALLCONV;
+void stm_store_short_tx(struct stm_tx *tx, volatile short *addr, short value) _CALLCONV;
+//@}
 
+//@{
 /**
  * Transactional store of an unsigned short value.
  *
@@ -290,7 +360,10 @@ void stm_store_short(volatile short *addr, short value) _CALLCONV;
  *   Value to be written.
  */
 void stm_store_ushort(volatile unsigned short *addr, unsigned short value) _CALLCONV;
+void stm_store_ushort_tx(struct stm_tx *tx, volatile unsigned short *addr, unsigned short value) _CALLCONV;
+//@}
 
+//@{
 /**
  * Transactional store of an int value.
  *
@@ -300,7 +373,10 @@ void stm_store_ushort(volatile unsigned short *addr, unsigned short value) _CALL
  *   Value to be written.
  */
 void stm_store_int(volatile int *addr, int value) _CALLCONV;
+void stm_store_int_tx(struct stm_tx *tx, volatile int *addr, int value) _CALLCONV;
+//@}
 
+//@{
 /**
  * Transactional store of an unsigned int value.
  *
@@ -310,7 +386,10 @@ void stm_store_int(volatile int *addr, int value) _CALLCONV;
  *   Value to be written.
  */
 void stm_store_uint(volatile unsigned int *addr, unsigned int value) _CALLCONV;
+void stm_store_uint_tx(struct stm_tx *tx, volatile unsigned int *addr, unsigned int value) _CALLCONV;
+//@}
 
+//@{
 /**
  * Transactional store of a long value.
  *
@@ -320,7 +399,10 @@ void stm_store_uint(volatile unsigned int *addr, unsigned int value) _CALLCONV;
  *   Value to be written.
  */
 void stm_store_long(volatile long *addr, long value) _CALLCONV;
+void stm_store_long_tx(struct stm_tx *tx, volatile long *addr, long value) _CALLCONV;
+//@}
 
+//@{
 /**
  * Transactional store of an unsigned long value.
  *
@@ -330,7 +412,10 @@ void stm_store_long(volatile long *addr, long value) _CALLCONV;
  *   Value to be written.
  */
 void stm_store_ulong(volatile unsigned long *addr, unsigned long value) _CALLCONV;
+void stm_store_ulong_tx(struct stm_tx *tx, volatile unsigned long *addr, unsigned long value) _CALLCONV;
+//@}
 
+//@{
 /**
  * Transactional store of a float value.
  *
@@ -340,7 +425,10 @@ void stm_store_ulong(volatile unsigned long *addr, unsigned long value) _CALLCON
  *   Value to be written.
  */
 void stm_store_float(volatile float *addr, float value) _CALLCONV;
+void stm_store_float_tx(struct stm_tx *tx, volatile float *addr, float value) _CALLCONV;
+//@}
 
+//@{
 /**
  * Transactional store of a double value.
  *
@@ -350,7 +438,10 @@ void stm_store_float(volatile float *addr, float value) _CALLCONV;
  *   Value to be written.
  */
 void stm_store_double(volatile double *addr, double value) _CALLCONV;
+void stm_store_double_tx(struct stm_tx *tx, volatile double *addr, double value) _CALLCONV;
+//@}
 
+//@{
 /**
  * Transactional store of a pointer value.
  *
@@ -360,7 +451,10 @@ void stm_store_double(volatile double *addr, double value) _CALLCONV;
  *   Value to be written.
  */
 void stm_store_ptr(volatile void **addr, void *value) _CALLCONV;
+void stm_store_ptr_tx(struct stm_tx *tx, volatile void **addr, void *value) _CALLCONV;
+//@}
 
+//@{
 /**
  * Transactional store of a memory region.  The address of the region
  * does not need to be word aligned and its size may be longer than a
@@ -374,7 +468,10 @@ void stm_store_ptr(volatile void **addr, void *value) _CALLCONV;
  *   Number of bytes to write.
  */
 void stm_store_bytes(volatile uint8_t *addr, uint8_t *buf, size_t size) _CALLCONV;
+void stm_store_bytes_tx(struct stm_tx *tx, volatile uint8_t *addr, uint8_t *buf, size_t size) _CALLCONV;
+//@}
 
+//@{
 /**
  * Transactional write of a byte to a memory region.  The address of the
  * region does not need to be word aligned and its size may be longer
@@ -389,6 +486,8 @@ void stm_store_bytes(volatile uint8_t *addr, uint8_t *buf, size_t size) _CALLCON
  *   Number of bytes to write.
  */
 void stm_set_bytes(volatile uint8_t *addr, uint8_t byte, size_t count) _CALLCONV;
+void stm_set_bytes_tx(struct stm_tx *tx, volatile uint8_t *addr, uint8_t byte, size_t count) _CALLCONV;
+//@}
 
 # ifdef __cplusplus
 }
@@ -97,4 +97,23 @@ typedef AO_t atomic_t;
 #  endif /* ! SAFE */
 # endif /* ! NO_AO */
 
+/*
+ * Operations on 32-bit words (used for compact lock words on 64-bit
+ * architectures).  atomic_ops does not provide them on all platforms,
+ * so we use the GCC builtins (GCC 4.7+ and ICC 14+).
+ */
+# include <stdint.h>
+# define ATOMIC_CAS_FULL_32(a, e, v)    (__sync_bool_compare_and_swap((volatile uint32_t *)(a), (uint32_t)(e), (uint32_t)(v)))
+# ifdef SAFE
+#  define ATOMIC_LOAD_ACQ_32(a)         (__atomic_load_n((volatile uint32_t *)(a), __ATOMIC_SEQ_CST))
+#  define ATOMIC_LOAD_32(a)             (__atomic_load_n((volatile uint32_t *)(a), __ATOMIC_SEQ_CST))
+#  define ATOMIC_STORE_REL_32(a, v)     (__atomic_store_n((volatile uint32_t *)(a), (uint32_t)(v), __ATOMIC_SEQ_CST))
+#  define ATOMIC_STORE_32(a, v)         (__atomic_store_n((volatile uint32_t *)(a), (uint32_t)(v), __ATOMIC_SEQ_CST))
+# else /* ! SAFE */
+#  define ATOMIC_LOAD_ACQ_32(a)         (__atomic_load_n((volatile uint32_t *)(a), __ATOMIC_ACQUIRE))
+#  define ATOMIC_LOAD_32(a)             (*((volatile uint32_t *)(a)))
+#  define ATOMIC_STORE_REL_32(a, v)     (__atomic_store_n((volatile uint32_t *)(a), (uint32_t)(v), __ATOMIC_RELEASE))
+#  define ATOMIC_STORE_32(a, v)         (*((volatile uint32_t *)(a)) = (uint32_t)(v))
+# endif /* ! SAFE */
+
 #endif /* _ATOMIC_H_ */
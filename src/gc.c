@@ -331,6 +331,34 @@ void gc_set_epoch(gc_word_t epoch)
   ATOMIC_STORE(&gc_threads.slots[idx].ts, epoch);
 }
 
+/*
+ * Announce the current epoch before reading shared data outside of a
+ * transaction.  Unlike transactions, such readers do not validate, so
+ * the announcement must be visible before any subsequent load.
+ */
+void gc_enter_epoch(void)
+{
+  int idx = gc_get_idx();
+
+  PRINT_DEBUG("==> gc_enter_epoch(%d)\n", idx);
+
+  ATOMIC_STORE(&gc_threads.slots[idx].ts, gc_current_epoch());
+  ATOMIC_MB_FULL;
+}
+
+/*
+ * Stop protecting data read since gc_enter_epoch() (previous loads
+ * must complete before the new lower bound is visible).
+ */
+void gc_leave_epoch(void)
+{
+  int idx = gc_get_idx();
+
+  PRINT_DEBUG("==> gc_leave_epoch(%d)\n", idx);
+
+  ATOMIC_STORE_REL(&gc_threads.slots[idx].ts, gc_current_epoch());
+}
+
 /*
  * Free memory (the thread must indicate the current timestamp).
  */
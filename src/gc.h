@@ -43,6 +43,9 @@ void gc_exit_thread(void);
 
 void gc_set_epoch(gc_word_t epoch);
 
+void gc_enter_epoch(void);
+void gc_leave_epoch(void);
+
 void gc_free(void *addr, gc_word_t epoch);
 
 void gc_cleanup(void);
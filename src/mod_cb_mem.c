@@ -32,6 +32,7 @@
 
 /* TODO use stm_internal.h for faster accesses */
 #include "stm.h"
+#include "atomic.h"
 #include "utils.h"
 #include "gc.h"
 
@@ -138,7 +139,7 @@ int_stm_malloc(struct stm_tx *tx, size_t size)
   void *addr;
 
   assert(mod_cb.key >= 0);
-  icb = (mod_cb_info_t *)stm_get_specific(mod_cb.key);
+  icb = (mod_cb_info_t *)stm_get_specific_tx(tx, mod_cb.key);
   assert(icb != NULL);
 
   /* Round up size */
@@ -169,6 +170,41 @@ void *stm_malloc_tx(struct stm_tx *tx, size_t size)
   return int_stm_malloc(tx, size);
 }
 
+static INLINE void *
+int_stm_malloc_aligned(struct stm_tx *tx, size_t size)
+{
+  /* Memory will be freed upon abort */
+  mod_cb_info_t *icb;
+  void *addr;
+
+  assert(mod_cb.key >= 0);
+  icb = (mod_cb_info_t *)stm_get_specific_tx(tx, mod_cb.key);
+  assert(icb != NULL);
+
+  /* Round up size */
+  size = (size + CACHELINE_SIZE - 1) & ~(size_t)(CACHELINE_SIZE - 1);
+
+  addr = xmalloc_aligned(size);
+
+  mod_cb_add_on_abort(icb, free, addr);
+
+  return addr;
+}
+
+/*
+ * Called by the CURRENT thread to allocate aligned memory within a transaction.
+ */
+void *stm_malloc_aligned(size_t size)
+{
+  struct stm_tx *tx = stm_current_tx();
+  return int_stm_malloc_aligned(tx, size);
+}
+
+void *stm_malloc_aligned_tx(struct stm_tx *tx, size_t size)
+{
+  return int_stm_malloc_aligned(tx, size);
+}
+
 static inline
 void *int_stm_calloc(struct stm_tx *tx, size_t nm, size_t size)
 {
@@ -177,7 +213,7 @@ void *int_stm_calloc(struct stm_tx *tx, size_t nm, size_t size)
   void *addr;
 
   assert(mod_cb.key >= 0);
-  icb = (mod_cb_info_t *)stm_get_specific(mod_cb.key);
+  icb = (mod_cb_info_t *)stm_get_specific_tx(tx, mod_cb.key);
   assert(icb != NULL);
 
   /* Round up size */
@@ -229,7 +265,7 @@ void int_stm_free2(struct stm_tx *tx, void *addr, size_t idx, size_t size)
   mod_cb_info_t *icb;
 
   assert(mod_cb.key >= 0);
-  icb = (mod_cb_info_t *)stm_get_specific(mod_cb.key);
+  icb = (mod_cb_info_t *)stm_get_specific_tx(tx, mod_cb.key);
   assert(icb != NULL);
 
   /* TODO: if block allocated in same transaction => no need to overwrite */
@@ -285,6 +321,86 @@ void stm_free_tx(struct stm_tx *tx, void *addr, size_t size)
   int_stm_free2(tx, addr, 0, size);
 }
 
+/* ################################################################### *
+ * RCU FUNCTIONS
+ * ################################################################### */
+
+/*
+ * Called by the CURRENT thread to enter a read-side critical section.
+ */
+void stm_rcu_read_begin(void)
+{
+#ifdef EPOCH_GC
+  assert(!stm_active());
+  gc_enter_epoch();
+#else /* ! EPOCH_GC */
+  fprintf(stderr, "RCU requires EPOCH_GC\n");
+  exit(1);
+#endif /* ! EPOCH_GC */
+}
+
+/*
+ * Called by the CURRENT thread to leave a read-side critical section.
+ */
+void stm_rcu_read_end(void)
+{
+#ifdef EPOCH_GC
+  gc_leave_epoch();
+#endif /* EPOCH_GC */
+}
+
+void stm_rcu_publish(void **ptr, void *snapshot)
+{
+  stm_store((volatile stm_word_t *)ptr, (stm_word_t)snapshot);
+}
+
+void stm_rcu_publish_tx(struct stm_tx *tx, void **ptr, void *snapshot)
+{
+  stm_store_tx(tx, (volatile stm_word_t *)ptr, (stm_word_t)snapshot);
+}
+
+#ifdef EPOCH_GC
+static void
+rcu_free(void *addr)
+{
+  /* Write-back must be visible before reading the retirement epoch */
+  ATOMIC_MB_FULL;
+  gc_free(addr, stm_get_clock());
+}
+#endif /* EPOCH_GC */
+
+static inline
+void int_stm_rcu_retire(struct stm_tx *tx, void *snapshot)
+{
+#ifdef EPOCH_GC
+  mod_cb_info_t *icb;
+
+  assert(mod_cb.key >= 0);
+  icb = (mod_cb_info_t *)stm_get_specific_tx(tx, mod_cb.key);
+  assert(icb != NULL);
+
+  /* Readers do not validate: always go through the GC */
+  mod_cb_add_on_commit(icb, rcu_free, snapshot);
+#else /* ! EPOCH_GC */
+  fprintf(stderr, "RCU requires EPOCH_GC\n");
+  exit(1);
+#endif /* ! EPOCH_GC */
+}
+
+/*
+ * Called by the CURRENT thread to retire a snapshot within a transaction.
+ */
+void stm_rcu_retire(void *snapshot)
+{
+  struct stm_tx *tx = stm_current_tx();
+  int_stm_rcu_retire(tx, snapshot);
+}
+
+void stm_rcu_retire_tx(struct stm_tx *tx, void *snapshot)
+{
+  int_stm_rcu_retire(tx, snapshot);
+}
+
 
 /*
  * Called upon transaction commit.
@@ -0,0 +1,191 @@
+/*
+ * File:
+ *   mod_cdc.c
+ * Author(s):
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *   Patrick Marlier <patrick.marlier@unine.ch>
+ * Description:
+ *   Module for capturing committed updates (change data capture).
+ *
+ * Copyright (c) 2007-2014.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * This program has a dual license and can also be distributed
+ * under the terms of the MIT license.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mod_cdc.h"
+
+#include "atomic.h"
+#include "stm.h"
+#include "utils.h"
+
+/* ################################################################### *
+ * FUNCTIONS
+ * ################################################################### */
+
+/*
+ * Map a ring (create it if size is not 0).
+ */
+static mod_cdc_ring_t *mod_cdc_map(const char *name, size_t size)
+{
+  mod_cdc_ring_t *ring;
+  struct stat st;
+  size_t bytes;
+  int fd;
+
+  if (name == NULL) {
+    /* Private memory */
+    bytes = sizeof(mod_cdc_ring_t) + size * sizeof(mod_cdc_record_t);
+    if ((ring = (mod_cdc_ring_t *)xmalloc_aligned(bytes)) == NULL)
+      return NULL;
+    memset(ring, 0, bytes);
+    return ring;
+  }
+
+  if ((fd = shm_open(name, size == 0 ? O_RDWR : O_RDWR | O_CREAT | O_TRUNC, 0600)) < 0) {
+    perror("shm_open");
+    return NULL;
+  }
+  if (size == 0) {
+    /* Use existing size */
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(mod_cdc_ring_t)) {
+      close(fd);
+      return NULL;
+    }
+    bytes = (size_t)st.st_size;
+  } else {
+    bytes = sizeof(mod_cdc_ring_t) + size * sizeof(mod_cdc_record_t);
+    if (ftruncate(fd, bytes) < 0) {
+      perror("ftruncate");
+      close(fd);
+      return NULL;
+    }
+  }
+  ring = (mod_cdc_ring_t *)mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (ring == MAP_FAILED) {
+    perror("mmap");
+    return NULL;
+  }
+  return ring;
+}
+
+/*
+ * Unmap and remove a ring created by mod_cdc_map().
+ */
+static void mod_cdc_unmap(const char *name, mod_cdc_ring_t *ring, size_t size)
+{
+  if (name == NULL) {
+    xfree(ring);
+    return;
+  }
+  munmap(ring, sizeof(mod_cdc_ring_t) + size * sizeof(mod_cdc_record_t));
+  shm_unlink(name);
+}
+
+/*
+ * Create ring and register it with the STM.
+ */
+mod_cdc_ring_t *mod_cdc_init(const char *name, size_t size, void *base)
+{
+  mod_cdc_ring_t *ring;
+  size_t n;
+
+  /* Round up to a power of 2 */
+  for (n = 1; n < size; n <<= 1)
+    ;
+
+  if ((ring = mod_cdc_map(name, n)) == NULL)
+    return NULL;
+  ring->size = n;
+  ring->base = (stm_word_t)base;
+  ring->lost = 0;
+  ring->tail = 0;
+  ring->head = 0;
+  ATOMIC_STORE_REL(&ring->magic, MOD_CDC_MAGIC);
+
+  if (!stm_set_parameter("cdc_ring", ring)) {
+    fprintf(stderr, "Module mod_cdc requires the library to be compiled with CDC\n");
+    mod_cdc_unmap(name, ring, n);
+    return NULL;
+  }
+
+  return ring;
+}
+
+/*
+ * Attach to an existing ring.
+ */
+mod_cdc_ring_t *mod_cdc_open(const char *name)
+{
+  mod_cdc_ring_t *ring;
+
+  if ((ring = mod_cdc_map(name, 0)) == NULL)
+    return NULL;
+  if (ATOMIC_LOAD_ACQ(&ring->magic) != MOD_CDC_MAGIC) {
+    fprintf(stderr, "Invalid change ring \"%s\"\n", name);
+    return NULL;
+  }
+  return ring;
+}
+
+/*
+ * Consume available transactions.
+ */
+int mod_cdc_consume(mod_cdc_ring_t *ring, void (*f)(const mod_cdc_record_t *r, void *arg), void *arg, int max)
+{
+  mod_cdc_record_t *r;
+  stm_word_t head, pos;
+  int nb = 0;
+
+  head = ring->head;
+  while (max == 0 || nb < max) {
+    /* Wait until all records of the next transaction are ready */
+    pos = head;
+    do {
+      r = &ring->records[pos & (ring->size - 1)];
+      if (ATOMIC_LOAD_ACQ(&r->seq) != pos + 1)
+        goto done;
+      pos++;
+    } while (r->left != 0);
+    /* Deliver records */
+    for (; head != pos; head++)
+      f(&ring->records[head & (ring->size - 1)], arg);
+    /* Free records for producers */
+    ATOMIC_STORE_REL(&ring->head, head);
+    nb++;
+  }
+ done:
+  return nb;
+}
+
+/*
+ * Apply record to replica.
+ */
+void mod_cdc_apply(const mod_cdc_record_t *r, void *base)
+{
+  volatile stm_word_t *a = (volatile stm_word_t *)((stm_word_t)base + r->offset);
+
+  if (r->mask == ~(stm_word_t)0)
+    *a = r->value;
+  else
+    *a = (*a & ~r->mask) | (r->value & r->mask);
+}
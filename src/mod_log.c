@@ -99,9 +99,9 @@ static int mod_log_initialized = 0;
  * ################################################################### */
 
 /*
- * Called by the CURRENT thread to obtain log entry.
+ * Called by the thread owning the transaction to obtain log entry.
  */
-static inline mod_log_w_entry_t *get_entry(void)
+static inline mod_log_w_entry_t *get_entry(struct stm_tx *tx)
 {
   mod_log_w_set_t *ws;
 
@@ -111,7 +111,7 @@ static inline mod_log_w_entry_t *get_entry(void)
   }
 
   /* Store in undo log */
-  ws = (mod_log_w_set_t *)stm_get_specific(mod_log_key);
+  ws = (mod_log_w_set_t *)stm_get_specific_tx(tx, mod_log_key);
   assert(ws != NULL);
 
   if (ws->nb_entries == ws->size) {
@@ -129,7 +129,12 @@ static inline mod_log_w_entry_t *get_entry(void)
 
 void stm_log(stm_word_t *addr)
 {
-  mod_log_w_entry_t *w = get_entry();
+  stm_log_tx(stm_current_tx(), addr);
+}
+
+void stm_log_tx(struct stm_tx *tx, stm_word_t *addr)
+{
+  mod_log_w_entry_t *w = get_entry(tx);
 
   w->type = TYPE_WORD;
   w->data.w.a = addr;
@@ -138,7 +143,12 @@ void stm_log(stm_word_t *addr)
 
 void stm_log_u8(uint8_t *addr)
 {
-  mod_log_w_entry_t *w = get_entry();
+  stm_log_u8_tx(stm_current_tx(), addr);
+}
+
+void stm_log_u8_tx(struct stm_tx *tx, uint8_t *addr)
+{
+  mod_log_w_entry_t *w = get_entry(tx);
 
   w->type = TYPE_U8;
   w->data.u8.a = addr;
@@ -147,7 +157,12 @@ void stm_log_u8(uint8_t *addr)
 
 void stm_log_u16(uint16_t *addr)
 {
-  mod_log_w_entry_t *w = get_entry();
+  stm_log_u16_tx(stm_current_tx(), addr);
+}
+
+void stm_log_u16_tx(struct stm_tx *tx, uint16_t *addr)
+{
+  mod_log_w_entry_t *w = get_entry(tx);
 
   w->type = TYPE_U16;
   w->data.u16.a = addr;
@@ -156,7 +171,12 @@ void stm_log_u16(uint16_t *addr)
 
 void stm_log_u32(uint32_t *addr)
 {
-  mod_log_w_entry_t *w = get_entry();
+  stm_log_u32_tx(stm_current_tx(), addr);
+}
+
+void stm_log_u32_tx(struct stm_tx *tx, uint32_t *addr)
+{
+  mod_log_w_entry_t *w = get_entry(tx);
 
   w->type = TYPE_U32;
   w->data.u32.a = addr;
@@ -165,7 +185,12 @@ void stm_log_u32(uint32_t *addr)
 
 void stm_log_u64(uint64_t *addr)
 {
-  mod_log_w_entry_t *w = get_entry();
+  stm_log_u64_tx(stm_current_tx(), addr);
+}
+
+void stm_log_u64_tx(struct stm_tx *tx, uint64_t *addr)
+{
+  mod_log_w_entry_t *w = get_entry(tx);
 
   w->type = TYPE_U64;
   w->data.u64.a = addr;
@@ -174,7 +199,12 @@ void stm_log_u64(uint64_t *addr)
 
 void stm_log_char(char *addr)
 {
-  mod_log_w_entry_t *w = get_entry();
+  stm_log_char_tx(stm_current_tx(), addr);
+}
+
+void stm_log_char_tx(struct stm_tx *tx, char *addr)
+{
+  mod_log_w_entry_t *w = get_entry(tx);
 
   w->type = TYPE_CHAR;
   w->data.c.a = addr;
@@ -183,7 +213,12 @@ void stm_log_char(char *addr)
 
 void stm_log_uchar(unsigned char *addr)
 {
-  mod_log_w_entry_t *w = get_entry();
+  stm_log_uchar_tx(stm_current_tx(), addr);
+}
+
+void stm_log_uchar_tx(struct stm_tx *tx, unsigned char *addr)
+{
+  mod_log_w_entry_t *w = get_entry(tx);
 
   w->type = TYPE_UCHAR;
   w->data.uc.a = addr;
@@ -192,7 +227,12 @@ void stm_log_uchar(unsigned char *addr)
 
 void stm_log_short(short *addr)
 {
-  mod_log_w_entry_t *w = get_entry();
+  stm_log_short_tx(stm_current_tx(), addr);
+}
+
+void stm_log_short_tx(struct stm_tx *tx, short *addr)
+{
+  mod_log_w_entry_t *w = get_entry(tx);
 
   w->type = TYPE_SHORT;
   w->data.s.a = addr;
@@ -201,7 +241,12 @@ void stm_log_short(short *addr)
 
 void stm_log_ushort(unsigned short *addr)
 {
-  mod_log_w_entry_t *w = get_entry();
+  stm_log_ushort_tx(stm_current_tx(), addr);
+}
+
+void stm_log_ushort_tx(struct stm_tx *tx, unsigned short *addr)
+{
+  mod_log_w_entry_t *w = get_entry(tx);
 
   w->type = TYPE_USHORT;
   w->data.us.a = addr;
@@ -210,7 +255,12 @@ void stm_log_ushort(unsigned short *addr)
 
 void stm_log_int(int *addr)
 {
-  mod_log_w_entry_t *w = get_entry();
+  stm_log_int_tx(stm_current_tx(), addr);
+}
+
+void stm_log_int_tx(struct stm_tx *tx, int *addr)
+{
+  mod_log_w_entry_t *w = get_entry(tx);
 
   w->type = TYPE_INT;
   w->data.i.a = addr;
@@ -219,7 +269,12 @@ void stm_log_int(int *addr)
 
 void stm_log_uint(unsigned int *addr)
 {
-  mod_log_w_entry_t *w = get_entry();
+  stm_log_uint_tx(stm_current_tx(), addr);
+}
+
+void stm_log_uint_tx(struct stm_tx *tx, unsigned int *addr)
+{
+  mod_log_w_entry_t *w = get_entry(tx);
 
   w->type = TYPE_UINT;
   w->data.ui.a = addr;
@@ -228,7 +283,12 @@ void stm_log_uint(unsigned int *addr)
 
 void stm_log_long(long *addr)
 {
-  mod_log_w_entry_t *w = get_entry();
+  stm_log_long_tx(stm_current_tx(), addr);
+}
+
+void stm_log_long_tx(struct stm_tx *tx, long *addr)
+{
+  mod_log_w_entry_t *w = get_entry(tx);
 
   w->type = TYPE_LONG;
   w->data.l.a = addr;
@@ -237,7 +297,12 @@ void stm_log_long(long *addr)
 
 void stm_log_ulong(unsigned long *addr)
 {
-  mod_log_w_entry_t *w = get_entry();
+  stm_log_ulong_tx(stm_current_tx(), addr);
+}
+
+void stm_log_ulong_tx(struct stm_tx *tx, unsigned long *addr)
+{
+  mod_log_w_entry_t *w = get_entry(tx);
 
   w->type = TYPE_ULONG;
   w->data.ul.a = addr;
@@ -246,7 +311,12 @@ void stm_log_ulong(unsigned long *addr)
 
 void stm_log_float(float *addr)
 {
-  mod_log_w_entry_t *w = get_entry();
+  stm_log_float_tx(stm_current_tx(), addr);
+}
+
+void stm_log_float_tx(struct stm_tx *tx, float *addr)
+{
+  mod_log_w_entry_t *w = get_entry(tx);
 
   w->type = TYPE_FLOAT;
   w->data.f.a = addr;
@@ -255,7 +325,12 @@ void stm_log_float(float *addr)
 
 void stm_log_double(double *addr)
 {
-  mod_log_w_entry_t *w = get_entry();
+  stm_log_double_tx(stm_current_tx(), addr);
+}
+
+void stm_log_double_tx(struct stm_tx *tx, double *addr)
+{
+  mod_log_w_entry_t *w = get_entry(tx);
 
   w->type = TYPE_DOUBLE;
   w->data.d.a = addr;
@@ -264,7 +339,12 @@ void stm_log_double(double *addr)
 
 void stm_log_ptr(void **addr)
 {
-  mod_log_w_entry_t *w = get_entry();
+  stm_log_ptr_tx(stm_current_tx(), addr);
+}
+
+void stm_log_ptr_tx(struct stm_tx *tx, void **addr)
+{
+  mod_log_w_entry_t *w = get_entry(tx);
 
   w->type = TYPE_PTR;
   w->data.p.a = addr;
@@ -273,7 +353,12 @@ void stm_log_ptr(void **addr)
 
 void stm_log_bytes(uint8_t *addr, size_t size)
 {
-  mod_log_w_entry_t *w = get_entry();
+  stm_log_bytes_tx(stm_current_tx(), addr, size);
+}
+
+void stm_log_bytes_tx(struct stm_tx *tx, uint8_t *addr, size_t size)
+{
+  mod_log_w_entry_t *w = get_entry(tx);
 
   w->type = TYPE_BYTES;
   w->data.b.a = addr;
@@ -282,7 +367,7 @@ void stm_log_bytes(uint8_t *addr, size_t size)
   memcpy(w->data.b.v, addr, size);
 
   /* Remember we have allocated memory */
-  ((mod_log_w_set_t *)stm_get_specific(mod_log_key))->allocated++;
+  ((mod_log_w_set_t *)stm_get_specific_tx(tx, mod_log_key))->allocated++;
 }
 
 /*
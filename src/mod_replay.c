@@ -0,0 +1,494 @@
+/*
+ * File:
+ *   mod_replay.c
+ * Author(s):
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *   Patrick Marlier <patrick.marlier@unine.ch>
+ * Description:
+ *   Module for recording and replaying transaction interleavings.
+ *
+ * Copyright (c) 2007-2014.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * This program has a dual license and can also be distributed
+ * under the terms of the MIT license.
+ */
+
+#include <assert.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "mod_replay.h"
+
+#include "atomic.h"
+#include "utils.h"
+
+#define REPLAY_VERSION                  2
+#define REPLAY_BUFFER_SIZE              4096    /* Events buffered per thread */
+#define REPLAY_TIMEOUT_NS               1000000000ULL /* Give up ordering without progress (1 s) */
+
+/* ################################################################### *
+ * TYPES
+ * ################################################################### */
+
+typedef struct replay_header {          /* Header of log file */
+  uint32_t magic;
+  uint32_t version;
+} replay_header_t;
+
+typedef struct replay_tx {              /* Recorded transaction */
+  stm_word_t tag;
+  unsigned int rank;                    /* Position in global begin order */
+  int id;
+} replay_tx_t;
+
+typedef struct replay_stream {          /* Recorded thread */
+  replay_tx_t *txs;
+  unsigned int nb;
+  mod_replay_event_t *events;           /* Events (when loading) */
+  unsigned int nb_events;
+  unsigned int head;                    /* Next event to merge (when loading) */
+} replay_stream_t;
+
+typedef struct replay_thread {          /* Per-thread data */
+  unsigned int id;                      /* Stream index */
+  stm_word_t tag;                       /* Tag of next transaction */
+  unsigned int retries;                 /* Aborts of current transaction */
+  mod_replay_event_t *buffer;           /* Buffered events (record) */
+  unsigned int nb;
+  uint32_t seq;                         /* Events recorded (record) */
+  unsigned int next;                    /* Next transaction in stream (replay) */
+  int pending;                          /* Transaction waiting to start (replay) */
+  unsigned long commits;
+  unsigned long aborts;
+  unsigned long aborts_r[16];
+} replay_thread_t;
+
+/* ################################################################### *
+ * VARIABLES
+ * ################################################################### */
+
+enum {
+  REPLAY_NONE,
+  REPLAY_RECORD,
+  REPLAY_REPLAY
+};
+
+ALIGNED static volatile stm_word_t replay_seq = 0;      /* Next begin (replay) */
+ALIGNED static volatile stm_word_t replay_nb_threads = 0;
+static volatile int replay_unordered = 0;               /* Begin order no longer enforced (replay) */
+static int replay_mode = REPLAY_NONE;
+static int replay_key;
+static FILE *replay_file = NULL;
+static pthread_mutex_t replay_mutex = PTHREAD_MUTEX_INITIALIZER;
+static replay_stream_t *replay_streams = NULL;
+static unsigned int replay_nb_streams = 0;
+static mod_replay_stats_t replay_stats;
+
+/* ################################################################### *
+ * RECORD
+ * ################################################################### */
+
+/*
+ * Write buffered events of a thread to the log.
+ */
+static void replay_flush(replay_thread_t *t)
+{
+  if (t->nb == 0)
+    return;
+  pthread_mutex_lock(&replay_mutex);
+  if (fwrite(t->buffer, sizeof(mod_replay_event_t), t->nb, replay_file) != t->nb)
+    perror("fwrite");
+  pthread_mutex_unlock(&replay_mutex);
+  t->nb = 0;
+}
+
+/*
+ * Append an event to the buffer of a thread.
+ */
+static void replay_append(replay_thread_t *t, unsigned int type, stm_word_t value, unsigned int reason)
+{
+  mod_replay_event_t *e;
+  stm_tx_attr_t attr;
+  stm_word_t ts;
+  unsigned int reads, writes;
+
+  if (t->nb == REPLAY_BUFFER_SIZE)
+    replay_flush(t);
+  attr = stm_get_attributes();
+  reads = writes = 0;
+  if (type != MOD_REPLAY_BEGIN) {
+    stm_get_stats("read_set_nb_entries", &reads);
+    stm_get_stats("write_set_nb_entries", &writes);
+  }
+  /* Order is recovered offline from the global clock */
+  if (type == MOD_REPLAY_COMMIT)
+    stm_get_stats("commit_timestamp", &ts);
+  else
+    stm_get_stats("start_timestamp", &ts);
+  e = &t->buffer[t->nb++];
+  e->value = (uint64_t)value;
+  e->ts = (uint64_t)ts;
+  e->seq = t->seq++;
+  e->thread = (uint16_t)t->id;
+  e->id = (uint16_t)attr.id;
+  e->type = (uint16_t)type;
+  e->reason = (uint16_t)reason;
+  e->retries = t->retries;
+  e->reads = reads;
+  e->writes = writes;
+}
+
+/* ################################################################### *
+ * REPLAY
+ * ################################################################### */
+
+/*
+ * Compare the next events of two streams: the timestamps of the events
+ * of a thread never decrease, and a commit precedes the events of other
+ * threads with the same timestamp (which started after it).
+ */
+static int replay_before(const mod_replay_event_t *a, const mod_replay_event_t *b)
+{
+  if (a->ts != b->ts)
+    return a->ts < b->ts;
+  if ((a->type == MOD_REPLAY_COMMIT) != (b->type == MOD_REPLAY_COMMIT))
+    return a->type == MOD_REPLAY_COMMIT;
+  return a->thread < b->thread;
+}
+
+/*
+ * Get the current time in nanoseconds.
+ */
+static unsigned long long replay_now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Stop enforcing the begin order.
+ */
+static void replay_give_up(const char *why)
+{
+  if (!replay_unordered) {
+    replay_unordered = 1;
+    fprintf(stderr, "Replay order no longer enforced: %s\n", why);
+  }
+}
+
+/* ################################################################### *
+ * CALLBACKS
+ * ################################################################### */
+
+static void mod_replay_on_thread_init(void *arg)
+{
+  replay_thread_t *t;
+
+  t = (replay_thread_t *)xcalloc(1, sizeof(replay_thread_t));
+  t->id = (unsigned int)ATOMIC_FETCH_INC_FULL(&replay_nb_threads);
+  if (replay_mode == REPLAY_RECORD)
+    t->buffer = (mod_replay_event_t *)xmalloc(REPLAY_BUFFER_SIZE * sizeof(mod_replay_event_t));
+  stm_set_specific(replay_key, t);
+}
+
+static void mod_replay_on_thread_exit(void *arg)
+{
+  replay_thread_t *t;
+  int i;
+
+  t = (replay_thread_t *)stm_get_specific(replay_key);
+  if (t == NULL)
+    return;
+  if (replay_mode == REPLAY_RECORD) {
+    replay_flush(t);
+    pthread_mutex_lock(&replay_mutex);
+    fflush(replay_file);
+    pthread_mutex_unlock(&replay_mutex);
+    xfree(t->buffer);
+  } else {
+    /* Transactions that have not been replayed would block other threads */
+    if (t->id < replay_nb_streams && t->next < replay_streams[t->id].nb)
+      replay_give_up("thread exited before the end of its stream");
+    pthread_mutex_lock(&replay_mutex);
+    replay_stats.commits += t->commits;
+    replay_stats.aborts += t->aborts;
+    for (i = 0; i < 16; i++)
+      replay_stats.aborts_r[i] += t->aborts_r[i];
+    pthread_mutex_unlock(&replay_mutex);
+  }
+  xfree(t);
+}
+
+static void mod_replay_on_start(void *arg)
+{
+  replay_thread_t *t;
+
+  t = (replay_thread_t *)stm_get_specific(replay_key);
+  if (t == NULL)
+    return;
+  t->retries = 0;
+  if (replay_mode == REPLAY_RECORD) {
+    replay_append(t, MOD_REPLAY_BEGIN, t->tag, 0);
+    t->tag = 0;
+  } else if (t->pending) {
+    /* Let the next recorded transaction start */
+    t->pending = 0;
+    ATOMIC_FETCH_INC_FULL(&replay_seq);
+  }
+}
+
+static void mod_replay_on_commit(void *arg)
+{
+  replay_thread_t *t;
+  stm_word_t ts;
+
+  t = (replay_thread_t *)stm_get_specific(replay_key);
+  if (t == NULL)
+    return;
+  if (replay_mode == REPLAY_RECORD) {
+    stm_get_stats("commit_timestamp", &ts);
+    replay_append(t, MOD_REPLAY_COMMIT, ts, 0);
+  } else {
+    t->commits++;
+  }
+}
+
+static void mod_replay_on_abort(void *arg)
+{
+  replay_thread_t *t;
+  unsigned int reason;
+
+  t = (replay_thread_t *)stm_get_specific(replay_key);
+  if (t == NULL)
+    return;
+  stm_get_stats("abort_reason", &reason);
+  if (replay_mode == REPLAY_RECORD) {
+    replay_append(t, MOD_REPLAY_ABORT, 0, reason);
+  } else {
+    t->aborts++;
+    t->aborts_r[(reason >> 8) & 0x0F]++;
+  }
+  t->retries++;
+}
+
+/* ################################################################### *
+ * INITIALIZATION
+ * ################################################################### */
+
+static void replay_init(int mode)
+{
+  if (replay_mode != REPLAY_NONE) {
+    fprintf(stderr, "Module 'mod_replay' already initialized. Exiting.\n");
+    exit(1);
+  }
+  if (!stm_register(mod_replay_on_thread_init, mod_replay_on_thread_exit, mod_replay_on_start, NULL, mod_replay_on_commit, mod_replay_on_abort, NULL)) {
+    fprintf(stderr, "Could not set callbacks for module 'mod_replay'. Exiting.\n");
+    exit(1);
+  }
+  replay_key = stm_create_specific();
+  if (replay_key < 0) {
+    fprintf(stderr, "Cannot create specific key\n");
+    exit(1);
+  }
+  replay_mode = mode;
+}
+
+/*
+ * Start recording.
+ */
+void mod_replay_record(const char *file)
+{
+  replay_header_t h;
+
+  if ((replay_file = fopen(file, "wb")) == NULL) {
+    perror("fopen");
+    exit(1);
+  }
+  h.magic = MOD_REPLAY_MAGIC;
+  h.version = REPLAY_VERSION;
+  if (fwrite(&h, sizeof(h), 1, replay_file) != 1) {
+    perror("fwrite");
+    exit(1);
+  }
+  replay_init(REPLAY_RECORD);
+}
+
+/*
+ * Load log for replay.
+ */
+int mod_replay_load(const char *file)
+{
+  FILE *f;
+  replay_header_t h;
+  mod_replay_event_t *events, *e;
+  replay_stream_t *s;
+  size_t nb, size;
+  unsigned int i, rank;
+
+  if ((f = fopen(file, "rb")) == NULL) {
+    perror("fopen");
+    exit(1);
+  }
+  if (fread(&h, sizeof(h), 1, f) != 1 || h.magic != MOD_REPLAY_MAGIC || h.version != REPLAY_VERSION) {
+    fprintf(stderr, "Invalid replay log '%s'. Exiting.\n", file);
+    exit(1);
+  }
+  /* Read all events (threads flush their buffers in any order, but the
+   * events of each thread are in order) */
+  nb = 0;
+  size = REPLAY_BUFFER_SIZE;
+  events = (mod_replay_event_t *)xmalloc(size * sizeof(mod_replay_event_t));
+  while ((i = fread(&events[nb], sizeof(mod_replay_event_t), size - nb, f)) > 0) {
+    nb += i;
+    if (nb == size) {
+      size *= 2;
+      events = (mod_replay_event_t *)xrealloc(events, size * sizeof(mod_replay_event_t));
+    }
+  }
+  fclose(f);
+
+  /* Split into streams */
+  memset(&replay_stats, 0, sizeof(replay_stats));
+  for (i = 0; i < nb; i++) {
+    if (events[i].thread >= replay_nb_streams)
+      replay_nb_streams = events[i].thread + 1;
+  }
+  replay_streams = (replay_stream_t *)xcalloc(replay_nb_streams, sizeof(replay_stream_t));
+  for (i = 0; i < nb; i++) {
+    s = &replay_streams[events[i].thread];
+    s->nb_events++;
+    if (events[i].type == MOD_REPLAY_BEGIN)
+      s->nb++;
+  }
+  for (i = 0; i < replay_nb_streams; i++) {
+    s = &replay_streams[i];
+    s->txs = (replay_tx_t *)xmalloc((s->nb + 1) * sizeof(replay_tx_t));
+    s->events = (mod_replay_event_t *)xmalloc((s->nb_events + 1) * sizeof(mod_replay_event_t));
+    s->nb = s->nb_events = 0;
+  }
+  for (i = 0; i < nb; i++) {
+    s = &replay_streams[events[i].thread];
+    if (events[i].seq != s->nb_events) {
+      fprintf(stderr, "Missing events in stream %u of replay log '%s'. Exiting.\n", (unsigned int)events[i].thread, file);
+      exit(1);
+    }
+    s->events[s->nb_events++] = events[i];
+  }
+  xfree(events);
+
+  /* Merge streams and number begins in global order */
+  for (rank = 0; ; ) {
+    s = NULL;
+    for (i = 0; i < replay_nb_streams; i++) {
+      if (replay_streams[i].head < replay_streams[i].nb_events &&
+          (s == NULL || replay_before(&replay_streams[i].events[replay_streams[i].head], &s->events[s->head])))
+        s = &replay_streams[i];
+    }
+    if (s == NULL)
+      break;
+    e = &s->events[s->head++];
+    switch (e->type) {
+      case MOD_REPLAY_BEGIN:
+        s->txs[s->nb].tag = (stm_word_t)e->value;
+        s->txs[s->nb].id = e->id;
+        s->txs[s->nb].rank = rank++;
+        s->nb++;
+        break;
+      case MOD_REPLAY_COMMIT:
+        replay_stats.recorded_commits++;
+        break;
+      case MOD_REPLAY_ABORT:
+        replay_stats.recorded_aborts++;
+        replay_stats.recorded_aborts_r[(e->reason >> 8) & 0x0F]++;
+        break;
+    }
+  }
+  for (i = 0; i < replay_nb_streams; i++) {
+    xfree(replay_streams[i].events);
+    replay_streams[i].events = NULL;
+  }
+
+  replay_init(REPLAY_REPLAY);
+
+  return replay_nb_streams;
+}
+
+/*
+ * Tag next transaction.
+ */
+void mod_replay_tag(stm_word_t tag)
+{
+  replay_thread_t *t;
+
+  if (replay_mode != REPLAY_RECORD)
+    return;
+  t = (replay_thread_t *)stm_get_specific(replay_key);
+  if (t != NULL)
+    t->tag = tag;
+}
+
+/*
+ * Get next transaction to replay.
+ */
+int mod_replay_next(stm_word_t *tag)
+{
+  replay_thread_t *t;
+  replay_stream_t *s;
+  replay_tx_t *tx;
+  stm_word_t seq, last;
+  unsigned long long since;
+
+  assert(replay_mode == REPLAY_REPLAY);
+  t = (replay_thread_t *)stm_get_specific(replay_key);
+  if (t == NULL || t->id >= replay_nb_streams)
+    return -1;
+  s = &replay_streams[t->id];
+  if (t->next == s->nb)
+    return -1;
+  tx = &s->txs[t->next++];
+  /* Wait until all transactions that started before have started */
+  last = ATOMIC_LOAD(&replay_seq);
+  since = 0;
+  while ((seq = ATOMIC_LOAD(&replay_seq)) != tx->rank && !replay_unordered) {
+    /* The threads we wait for may not be running */
+    sched_yield();
+    if (seq != last || since == 0) {
+      last = seq;
+      since = replay_now();
+    } else if (replay_now() - since > REPLAY_TIMEOUT_NS) {
+      replay_give_up("no progress (missing stream?)");
+    }
+  }
+  t->pending = 1;
+  *tag = tx->tag;
+  return tx->id;
+}
+
+/*
+ * Compare recorded and replayed executions.
+ */
+int mod_replay_get_stats(mod_replay_stats_t *stats)
+{
+  if (replay_mode != REPLAY_REPLAY)
+    return 0;
+  pthread_mutex_lock(&replay_mutex);
+  *stats = replay_stats;
+  pthread_mutex_unlock(&replay_mutex);
+  return 1;
+}
@@ -0,0 +1,279 @@
+/*
+ * File:
+ *   mod_sites.c
+ * Author(s):
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *   Patrick Marlier <patrick.marlier@unine.ch>
+ * Description:
+ *   Module for attributing conflicts to call sites.
+ *
+ * Copyright (c) 2007-2014.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * This program has a dual license and can also be distributed
+ * under the terms of the MIT license.
+ */
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif /* ! _GNU_SOURCE */
+#include <assert.h>
+#include <link.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mod_sites.h"
+
+#include "stm.h"
+#include "utils.h"
+
+#define MOD_SITES_SIZE                  1024                /* Pairs per thread (power of 2) */
+#define MOD_SITES_GLOBAL_SIZE           16384               /* Pairs in aggregate (power of 2) */
+
+/* ################################################################### *
+ * TYPES
+ * ################################################################### */
+
+typedef struct mod_sites_entry {        /* Pair of call sites */
+  void *site;                           /* Call site of victim (NULL if unknown) */
+  void *other_site;                     /* Call site of aggressor (NULL if unknown) */
+  unsigned long count;                  /* Number of conflicts (0 if free) */
+} mod_sites_entry_t;
+
+typedef struct mod_sites_data {         /* Per-thread conflicts */
+  mod_sites_entry_t entries[MOD_SITES_SIZE];
+  unsigned long dropped;                /* Conflicts not counted (table full) */
+} mod_sites_data_t;
+
+typedef struct mod_sites_object {       /* Lookup of the object containing an address */
+  uintptr_t addr;                       /* Address */
+  const char *name;                     /* Name of object (empty for executable) */
+  uintptr_t offset;                     /* Address relative to object base */
+} mod_sites_object_t;
+
+static int mod_sites_key;
+static int mod_sites_initialized = 0;
+static int mod_sites_sample;
+
+static mod_sites_entry_t mod_sites_global[MOD_SITES_GLOBAL_SIZE];
+static unsigned long mod_sites_dropped = 0;
+static pthread_mutex_t mod_sites_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* ################################################################### *
+ * FUNCTIONS
+ * ################################################################### */
+
+/*
+ * Count conflicts for a pair of call sites (return 0 if table is full).
+ */
+static int mod_sites_add(mod_sites_entry_t *entries, unsigned int size, void *site, void *other_site, unsigned long count)
+{
+  unsigned int i, n;
+
+  i = (unsigned int)(((uintptr_t)site >> 2) * 31 + ((uintptr_t)other_site >> 2)) & (size - 1);
+  for (n = 0; n < size; n++, i = (i + 1) & (size - 1)) {
+    if (entries[i].count == 0) {
+      entries[i].site = site;
+      entries[i].other_site = other_site;
+      entries[i].count = count;
+      return 1;
+    }
+    if (entries[i].site == site && entries[i].other_site == other_site) {
+      entries[i].count += count;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*
+ * Called upon conflict (by the thread of the victim).
+ */
+static void mod_sites_on_conflict(struct stm_tx *tx, struct stm_tx *other)
+{
+  mod_sites_data_t *data;
+  void *site, *other_site;
+
+  data = (mod_sites_data_t *)stm_get_specific_tx(tx, mod_sites_key);
+  if (data == NULL) {
+    /* Thread initialized before the module */
+    return;
+  }
+
+  if (!stm_get_conflict_sites(tx, &site, &other_site))
+    site = other_site = NULL;
+  if (!mod_sites_add(data->entries, MOD_SITES_SIZE, site, other_site, 1))
+    data->dropped++;
+}
+
+/*
+ * Called upon thread creation.
+ */
+static void mod_sites_on_thread_init(void *arg)
+{
+  mod_sites_data_t *data;
+
+  data = (mod_sites_data_t *)xmalloc(sizeof(mod_sites_data_t));
+  memset(data, 0, sizeof(mod_sites_data_t));
+
+  stm_set_specific(mod_sites_key, data);
+}
+
+/*
+ * Called upon thread deletion.
+ */
+static void mod_sites_on_thread_exit(void *arg)
+{
+  mod_sites_data_t *data;
+  int i;
+
+  data = (mod_sites_data_t *)stm_get_specific(mod_sites_key);
+  assert(data != NULL);
+
+  pthread_mutex_lock(&mod_sites_mutex);
+  for (i = 0; i < MOD_SITES_SIZE; i++) {
+    if (data->entries[i].count != 0 &&
+        !mod_sites_add(mod_sites_global, MOD_SITES_GLOBAL_SIZE, data->entries[i].site, data->entries[i].other_site, data->entries[i].count))
+      mod_sites_dropped += data->entries[i].count;
+  }
+  mod_sites_dropped += data->dropped;
+  pthread_mutex_unlock(&mod_sites_mutex);
+
+  xfree(data);
+}
+
+/*
+ * Find the object containing an address.
+ */
+static int mod_sites_find(struct dl_phdr_info *info, size_t size, void *arg)
+{
+  mod_sites_object_t *o = (mod_sites_object_t *)arg;
+  uintptr_t start;
+  int i;
+
+  for (i = 0; i < info->dlpi_phnum; i++) {
+    if (info->dlpi_phdr[i].p_type != PT_LOAD)
+      continue;
+    start = info->dlpi_addr + info->dlpi_phdr[i].p_vaddr;
+    if (o->addr >= start && o->addr < start + info->dlpi_phdr[i].p_memsz) {
+      o->name = info->dlpi_name;
+      /* Load bias is 0 for non-PIE executables */
+      o->offset = o->addr - info->dlpi_addr;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*
+ * Print a call site as object and address for offline symbolization.
+ */
+static void mod_sites_print_site(FILE *f, void *site, const char *exe)
+{
+  mod_sites_object_t o;
+
+  if (site == NULL) {
+    fprintf(f, "\t?");
+    return;
+  }
+  /* Return address: point inside the call instruction */
+  o.addr = (uintptr_t)site - 1;
+  o.name = NULL;
+  if (dl_iterate_phdr(mod_sites_find, &o) == 0) {
+    fprintf(f, "\t%p", (void *)o.addr);
+    return;
+  }
+  fprintf(f, "\t%s 0x%lx", (o.name[0] != '\0' ? o.name : exe), (unsigned long)o.offset);
+}
+
+/*
+ * Compare pairs by decreasing number of conflicts.
+ */
+static int mod_sites_compare(const void *a, const void *b)
+{
+  unsigned long ca = ((const mod_sites_entry_t *)a)->count;
+  unsigned long cb = ((const mod_sites_entry_t *)b)->count;
+
+  return (ca < cb) - (ca > cb);
+}
+
+/*
+ * Print the pairs of call sites involved in conflicts.
+ */
+int mod_sites_report(FILE *f, int max)
+{
+  mod_sites_entry_t *pairs;
+  char exe[1024];
+  ssize_t len;
+  int i, n;
+
+  if (!mod_sites_initialized) {
+    fprintf(stderr, "Module mod_sites not initialized\n");
+    exit(1);
+  }
+
+  if ((len = readlink("/proc/self/exe", exe, sizeof(exe) - 1)) < 0)
+    len = 0;
+  exe[len] = '\0';
+
+  pairs = (mod_sites_entry_t *)xmalloc(MOD_SITES_GLOBAL_SIZE * sizeof(mod_sites_entry_t));
+  pthread_mutex_lock(&mod_sites_mutex);
+  for (i = n = 0; i < MOD_SITES_GLOBAL_SIZE; i++) {
+    if (mod_sites_global[i].count != 0)
+      pairs[n++] = mod_sites_global[i];
+  }
+  pthread_mutex_unlock(&mod_sites_mutex);
+  qsort(pairs, n, sizeof(mod_sites_entry_t), mod_sites_compare);
+
+  fprintf(f, "# Conflicts by call sites (reads sampled 1/%d; symbolize with addr2line -f -i -e <object> <address>)\n", mod_sites_sample);
+  fprintf(f, "# conflicts\tvictim\taggressor\n");
+  for (i = 0; i < n && (max <= 0 || i < max); i++) {
+    fprintf(f, "%lu", pairs[i].count);
+    mod_sites_print_site(f, pairs[i].site, exe);
+    mod_sites_print_site(f, pairs[i].other_site, exe);
+    fprintf(f, "\n");
+  }
+  if (mod_sites_dropped != 0)
+    fprintf(f, "# %lu conflicts not counted (tables full)\n", mod_sites_dropped);
+
+  xfree(pairs);
+  return n;
+}
+
+/*
+ * Initialize module.
+ */
+void mod_sites_init(void)
+{
+  if (mod_sites_initialized)
+    return;
+
+  if (!stm_get_parameter("call_sites_sample", &mod_sites_sample) ||
+      !stm_set_parameter("conflict_cb", (void *)mod_sites_on_conflict)) {
+    fprintf(stderr, "Module mod_sites requires the library to be compiled with CONFLICT_TRACKING and CALL_SITES\n");
+    exit(1);
+  }
+  if (!stm_register(mod_sites_on_thread_init, mod_sites_on_thread_exit, NULL, NULL, NULL, NULL, NULL)) {
+    fprintf(stderr, "Cannot register callbacks\n");
+    exit(1);
+  }
+  mod_sites_key = stm_create_specific();
+  if (mod_sites_key < 0) {
+    fprintf(stderr, "Cannot create specific key\n");
+    exit(1);
+  }
+  mod_sites_initialized = 1;
+}
@@ -0,0 +1,331 @@
+/*
+ * File:
+ *   mod_topo.c
+ * Author(s):
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *   Patrick Marlier <patrick.marlier@unine.ch>
+ * Description:
+ *   Module for topology-aware thread placement.
+ *
+ * Copyright (c) 2007-2014.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * This program has a dual license and can also be distributed
+ * under the terms of the MIT license.
+ */
+
+#ifdef __linux__
+# define _GNU_SOURCE
+# include <dirent.h>
+# include <sched.h>
+#endif /* __linux__ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include "mod_topo.h"
+
+#define SYS_CPU                         "/sys/devices/system/cpu"
+#define SYS_NODE                        "/sys/devices/system/node"
+
+/* ################################################################### *
+ * TYPES
+ * ################################################################### */
+
+typedef struct mod_topo_cpu {           /* Processor */
+  int id;                               /* Processor number (for the OS) */
+  int node;                             /* NUMA node */
+  int core;                             /* Rank of the core in the node */
+  int thread;                           /* Rank of the hardware thread in the core */
+  int package;                          /* Physical package (socket) */
+  int core_id;                          /* Core identifier (in the package) */
+} mod_topo_cpu_t;
+
+static mod_topo_cpu_t *mod_topo_compact = NULL;
+static mod_topo_cpu_t *mod_topo_scatter = NULL;
+static int mod_topo_nb_cpus = 0;
+static int mod_topo_nodes = 1;
+static int mod_topo_initialized = 0;
+
+static const char *mod_topo_names[] = {
+  /* 0 */ "none",
+  /* 1 */ "compact",
+  /* 2 */ "scatter",
+  /* 3 */ "numa"
+};
+
+/* ################################################################### *
+ * FUNCTIONS
+ * ################################################################### */
+
+#ifdef __linux__
+/*
+ * Read an integer from a sysfs file (return -1 on error).
+ */
+static int mod_topo_read_int(const char *fmt, int cpu)
+{
+  char path[256];
+  FILE *f;
+  int v;
+
+  snprintf(path, sizeof(path), fmt, cpu);
+  if ((f = fopen(path, "r")) == NULL)
+    return -1;
+  if (fscanf(f, "%d", &v) != 1)
+    v = -1;
+  fclose(f);
+  return v;
+}
+
+/*
+ * Parse a sysfs CPU list (e.g., "0-3,8-11") and add it to a set.
+ */
+static int mod_topo_read_list(const char *path, cpu_set_t *set)
+{
+  FILE *f;
+  int lo, hi, c;
+
+  CPU_ZERO(set);
+  if ((f = fopen(path, "r")) == NULL)
+    return 0;
+  while (fscanf(f, "%d", &lo) == 1) {
+    hi = lo;
+    if ((c = fgetc(f)) == '-') {
+      if (fscanf(f, "%d", &hi) != 1)
+        break;
+      c = fgetc(f);
+    }
+    for (; lo <= hi && lo < CPU_SETSIZE; lo++)
+      CPU_SET(lo, set);
+    if (c != ',')
+      break;
+  }
+  fclose(f);
+  return 1;
+}
+#endif /* __linux__ */
+
+static int mod_topo_cmp_compact(const void *a, const void *b)
+{
+  const mod_topo_cpu_t *x = (const mod_topo_cpu_t *)a;
+  const mod_topo_cpu_t *y = (const mod_topo_cpu_t *)b;
+
+  if (x->node != y->node)
+    return x->node - y->node;
+  if (x->core != y->core)
+    return x->core - y->core;
+  return x->thread - y->thread;
+}
+
+static int mod_topo_cmp_scatter(const void *a, const void *b)
+{
+  const mod_topo_cpu_t *x = (const mod_topo_cpu_t *)a;
+  const mod_topo_cpu_t *y = (const mod_topo_cpu_t *)b;
+
+  if (x->thread != y->thread)
+    return x->thread - y->thread;
+  if (x->core != y->core)
+    return x->core - y->core;
+  return x->node - y->node;
+}
+
+/*
+ * Discover processors and their position in the topology.
+ */
+int mod_topo_init(void)
+{
+  mod_topo_cpu_t *c;
+  int i, j, n;
+#ifdef __linux__
+  cpu_set_t allowed, online, node;
+  struct dirent *e;
+  DIR *d;
+  char path[512];
+#endif /* __linux__ */
+
+  if (mod_topo_initialized)
+    return mod_topo_nb_cpus;
+
+  n = (int)sysconf(_SC_NPROCESSORS_CONF);
+  if (n <= 0)
+    n = 1;
+#ifdef __linux__
+  if (n < CPU_SETSIZE)
+    n = CPU_SETSIZE;
+#endif /* __linux__ */
+  if ((mod_topo_compact = (mod_topo_cpu_t *)malloc(n * sizeof(mod_topo_cpu_t))) == NULL ||
+      (mod_topo_scatter = (mod_topo_cpu_t *)malloc(n * sizeof(mod_topo_cpu_t))) == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  c = mod_topo_compact;
+
+#ifdef __linux__
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    CPU_ZERO(&allowed);
+  if (!mod_topo_read_list(SYS_CPU "/online", &online))
+    online = allowed;
+  for (i = 0; i < CPU_SETSIZE; i++) {
+    if (!CPU_ISSET(i, &allowed) || !CPU_ISSET(i, &online))
+      continue;
+    c[mod_topo_nb_cpus].id = i;
+    c[mod_topo_nb_cpus].node = 0;
+    c[mod_topo_nb_cpus].package = mod_topo_read_int(SYS_CPU "/cpu%d/topology/physical_package_id", i);
+    c[mod_topo_nb_cpus].core_id = mod_topo_read_int(SYS_CPU "/cpu%d/topology/core_id", i);
+    if (c[mod_topo_nb_cpus].core_id < 0) {
+      /* Unknown topology: one core per processor */
+      c[mod_topo_nb_cpus].core_id = i;
+    }
+    mod_topo_nb_cpus++;
+  }
+  /* NUMA nodes */
+  if ((d = opendir(SYS_NODE)) != NULL) {
+    while ((e = readdir(d)) != NULL) {
+      if (strncmp(e->d_name, "node", 4) != 0 || sscanf(e->d_name + 4, "%d", &j) != 1)
+        continue;
+      snprintf(path, sizeof(path), SYS_NODE "/%s/cpulist", e->d_name);
+      if (!mod_topo_read_list(path, &node))
+        continue;
+      for (i = 0; i < mod_topo_nb_cpus; i++) {
+        if (CPU_ISSET(c[i].id, &node))
+          c[i].node = j;
+      }
+    }
+    closedir(d);
+  }
+#endif /* __linux__ */
+
+  if (mod_topo_nb_cpus == 0) {
+    /* No topology information: flat machine */
+    j = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (j <= 0 || j > n)
+      j = 1;
+    for (i = 0; i < j; i++) {
+      c[i].id = i;
+      c[i].node = c[i].package = 0;
+      c[i].core_id = i;
+    }
+    mod_topo_nb_cpus = i;
+  }
+
+  /* Rank cores within nodes and hardware threads within cores */
+  for (i = 0; i < mod_topo_nb_cpus; i++) {
+    c[i].core = c[i].thread = 0;
+    for (j = 0; j < i; j++) {
+      if (c[j].package == c[i].package && c[j].core_id == c[i].core_id)
+        break;
+    }
+    if (j < i) {
+      /* Sibling of an earlier processor */
+      c[i].core = c[j].core;
+      for (j = 0; j < i; j++) {
+        if (c[j].package == c[i].package && c[j].core_id == c[i].core_id)
+          c[i].thread++;
+      }
+    } else {
+      /* First processor of a new core */
+      for (j = 0; j < i; j++) {
+        if (c[j].node == c[i].node && c[j].thread == 0)
+          c[i].core++;
+      }
+    }
+  }
+
+  /* Count nodes */
+  mod_topo_nodes = 0;
+  for (i = 0; i < mod_topo_nb_cpus; i++) {
+    for (j = 0; j < i; j++) {
+      if (c[j].node == c[i].node)
+        break;
+    }
+    if (j == i)
+      mod_topo_nodes++;
+  }
+
+  memcpy(mod_topo_scatter, mod_topo_compact, mod_topo_nb_cpus * sizeof(mod_topo_cpu_t));
+  qsort(mod_topo_compact, mod_topo_nb_cpus, sizeof(mod_topo_cpu_t), mod_topo_cmp_compact);
+  qsort(mod_topo_scatter, mod_topo_nb_cpus, sizeof(mod_topo_cpu_t), mod_topo_cmp_scatter);
+
+  mod_topo_initialized = 1;
+
+  return mod_topo_nb_cpus;
+}
+
+/*
+ * Return the number of nodes.
+ */
+int mod_topo_nb_nodes(void)
+{
+  return mod_topo_nodes;
+}
+
+/*
+ * Return a placement policy given its name.
+ */
+int mod_topo_policy(const char *name)
+{
+  int i;
+
+  for (i = MOD_TOPO_NONE; i <= MOD_TOPO_NUMA; i++) {
+    if (strcasecmp(mod_topo_names[i], name) == 0)
+      return i;
+  }
+  return -1;
+}
+
+/*
+ * Pin calling thread.
+ */
+int mod_topo_pin(int policy, int index)
+{
+  mod_topo_cpu_t *c;
+#ifdef __linux__
+  cpu_set_t set;
+  int i;
+#endif /* __linux__ */
+
+  if (!mod_topo_initialized) {
+    fprintf(stderr, "Module mod_topo not initialized\n");
+    exit(1);
+  }
+
+  switch (policy) {
+    case MOD_TOPO_COMPACT:
+    case MOD_TOPO_NUMA:
+      c = &mod_topo_compact[index % mod_topo_nb_cpus];
+      break;
+    case MOD_TOPO_SCATTER:
+      c = &mod_topo_scatter[index % mod_topo_nb_cpus];
+      break;
+    default:
+      return -1;
+  }
+
+#ifdef __linux__
+  CPU_ZERO(&set);
+  if (policy == MOD_TOPO_NUMA) {
+    /* All processors of the node */
+    for (i = 0; i < mod_topo_nb_cpus; i++) {
+      if (mod_topo_compact[i].node == c->node)
+        CPU_SET(mod_topo_compact[i].id, &set);
+    }
+  } else
+    CPU_SET(c->id, &set);
+  if (sched_setaffinity(0, sizeof(set), &set) != 0)
+    return -1;
+  return c->node;
+#else /* ! __linux__ */
+  return -1;
+#endif /* ! __linux__ */
+}
@@ -0,0 +1,421 @@
+/*
+ * File:
+ *   mod_watch.c
+ * Author(s):
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *   Patrick Marlier <patrick.marlier@unine.ch>
+ * Description:
+ *   Module for watching transactional memory ranges.
+ *
+ * Copyright (c) 2007-2014.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * This program has a dual license and can also be distributed
+ * under the terms of the MIT license.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mod_watch.h"
+
+#include "atomic.h"
+#include "stm.h"
+#include "utils.h"
+
+#define MOD_WATCH_QUEUE_SIZE            4096                /* Must be a power of 2 */
+#define MOD_WATCH_BITS                  (sizeof(stm_word_t) * 8)
+#define MOD_WATCH_IDLE_NS               10000000            /* Dispatcher polling period (10 ms) */
+
+/* ################################################################### *
+ * TYPES
+ * ################################################################### */
+
+typedef struct mod_watch_reg {          /* Registration */
+  stm_word_t start;                     /* First address of the range */
+  stm_word_t end;                       /* Address after the range */
+  stm_watch_cb_t cb;                    /* Callback (NULL if free) */
+  void *arg;                            /* Callback argument */
+  stm_word_t last;                      /* Timestamp of last notification (for coalescing) */
+} mod_watch_reg_t;
+
+typedef struct mod_watch_event {        /* Notification */
+  volatile stm_word_t seq;              /* Sequence number of the slot */
+  stm_word_t addr;                      /* Address of the lock stripe written */
+  stm_word_t bits;                      /* Words of the stripe written */
+  stm_word_t ts;                        /* Commit timestamp */
+} mod_watch_event_t;
+
+static mod_watch_reg_t mod_watch_regs[MOD_WATCH_MAX];
+static pthread_mutex_t mod_watch_regs_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Bounded lock-free queue: committers reserve a slot by incrementing
+ * the tail, and publish it by updating its sequence number */
+static mod_watch_event_t mod_watch_queue[MOD_WATCH_QUEUE_SIZE];
+static volatile stm_word_t mod_watch_tail = 0;
+static stm_word_t mod_watch_head = 0;
+static volatile stm_word_t mod_watch_dropped = 0;
+static volatile stm_word_t mod_watch_sleeping = 0;
+static int mod_watch_stop = 0;
+static pthread_mutex_t mod_watch_queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t mod_watch_queue_cond = PTHREAD_COND_INITIALIZER;
+
+static volatile stm_word_t *mod_watch_bitmap = NULL;
+static int mod_watch_shift;
+static stm_word_t mod_watch_mask;
+static pthread_t mod_watch_thread;
+static int mod_watch_initialized = 0;
+
+/* ################################################################### *
+ * FUNCTIONS
+ * ################################################################### */
+
+/*
+ * Called by committing transactions (may run concurrently) once per
+ * watched lock stripe written.  Never blocks: if the queue is full, the
+ * notification is dropped and counted, and the dispatcher is only woken
+ * up if its mutex is free (otherwise it notices the notification when
+ * its wait times out).
+ */
+static void mod_watch_notify(void *addr, stm_word_t bits, stm_word_t ts)
+{
+  mod_watch_event_t *ev;
+  stm_word_t pos, seq;
+
+  pos = ATOMIC_LOAD(&mod_watch_tail);
+  for (;;) {
+    ev = &mod_watch_queue[pos & (MOD_WATCH_QUEUE_SIZE - 1)];
+    seq = ATOMIC_LOAD_ACQ(&ev->seq);
+    if (seq == pos) {
+      if (ATOMIC_CAS_FULL(&mod_watch_tail, pos, pos + 1))
+        break;
+    } else if ((long)(seq - pos) < 0) {
+      /* Queue full */
+      ATOMIC_FETCH_INC_FULL(&mod_watch_dropped);
+      goto wake;
+    }
+    pos = ATOMIC_LOAD(&mod_watch_tail);
+  }
+  ev->addr = (stm_word_t)addr;
+  ev->bits = bits;
+  ev->ts = ts;
+  ATOMIC_STORE_REL(&ev->seq, pos + 1);
+
+ wake:
+  ATOMIC_MB_FULL;
+  if (ATOMIC_LOAD(&mod_watch_sleeping) && pthread_mutex_trylock(&mod_watch_queue_mutex) == 0) {
+    pthread_cond_signal(&mod_watch_queue_cond);
+    pthread_mutex_unlock(&mod_watch_queue_mutex);
+  }
+}
+
+/*
+ * Dequeue a notification (dispatcher only).
+ */
+static int mod_watch_dequeue(mod_watch_event_t *ev)
+{
+  mod_watch_event_t *e;
+
+  e = &mod_watch_queue[mod_watch_head & (MOD_WATCH_QUEUE_SIZE - 1)];
+  if (ATOMIC_LOAD_ACQ(&e->seq) != mod_watch_head + 1)
+    return 0;
+  ev->addr = e->addr;
+  ev->bits = e->bits;
+  ev->ts = e->ts;
+  /* Release the slot for the next round */
+  ATOMIC_STORE_REL(&e->seq, mod_watch_head + MOD_WATCH_QUEUE_SIZE);
+  mod_watch_head++;
+  return 1;
+}
+
+/*
+ * Check whether a notification is for words of a registration.
+ */
+static int mod_watch_matches(mod_watch_reg_t *reg, mod_watch_event_t *ev)
+{
+  stm_word_t lo, hi;
+  unsigned int i;
+
+  for (i = 0; i < MOD_WATCH_BITS; i++) {
+    if (((ev->bits >> i) & 1) == 0)
+      continue;
+    lo = ev->addr + i * sizeof(stm_word_t);
+    /* The last bit covers the rest of the stripe */
+    hi = (i == MOD_WATCH_BITS - 1 ? ev->addr + ((stm_word_t)1 << mod_watch_shift) : lo + sizeof(stm_word_t));
+    if (lo < reg->end && hi > reg->start)
+      return 1;
+  }
+  return 0;
+}
+
+/*
+ * Check whether a registration covers a stripe.
+ */
+static int mod_watch_covers(mod_watch_reg_t *reg, stm_word_t idx)
+{
+  stm_word_t first, last;
+
+  first = reg->start >> mod_watch_shift;
+  last = (reg->end - 1) >> mod_watch_shift;
+  if (last - first >= mod_watch_mask)
+    return 1;
+  first &= mod_watch_mask;
+  last &= mod_watch_mask;
+  if (first <= last)
+    return (first <= idx && idx <= last);
+  /* Wraps around the lock array */
+  return (idx >= first || idx <= last);
+}
+
+/*
+ * Set or clear the bits of the stripes covering a registration (must
+ * hold the registrations mutex).
+ */
+static void mod_watch_update(mod_watch_reg_t *reg, int set)
+{
+  stm_word_t a, idx, n, bit;
+  int i;
+
+  for (a = reg->start >> mod_watch_shift, n = 0; a <= (reg->end - 1) >> mod_watch_shift && n <= mod_watch_mask; a++, n++) {
+    idx = a & mod_watch_mask;
+    bit = (stm_word_t)1 << (idx % MOD_WATCH_BITS);
+    if (set) {
+      ATOMIC_STORE(&mod_watch_bitmap[idx / MOD_WATCH_BITS], mod_watch_bitmap[idx / MOD_WATCH_BITS] | bit);
+    } else {
+      /* Keep the stripe if another registration covers it */
+      for (i = 0; i < MOD_WATCH_MAX; i++) {
+        if (&mod_watch_regs[i] != reg && mod_watch_regs[i].cb != NULL && mod_watch_covers(&mod_watch_regs[i], idx))
+          break;
+      }
+      if (i == MOD_WATCH_MAX)
+        ATOMIC_STORE(&mod_watch_bitmap[idx / MOD_WATCH_BITS], mod_watch_bitmap[idx / MOD_WATCH_BITS] & ~bit);
+    }
+  }
+  /* Make the bitmap visible to committing transactions */
+  ATOMIC_MB_FULL;
+}
+
+/*
+ * Deliver a batch of notifications.
+ */
+static void mod_watch_deliver(mod_watch_event_t *ev, unsigned int nb, int overflow)
+{
+  mod_watch_reg_t todo[MOD_WATCH_MAX];
+  unsigned int e;
+  int i, n;
+
+  for (e = 0; e < nb || (e == nb && overflow); e++) {
+    /* Collect matching registrations */
+    n = 0;
+    pthread_mutex_lock(&mod_watch_regs_mutex);
+    for (i = 0; i < MOD_WATCH_MAX; i++) {
+      if (mod_watch_regs[i].cb == NULL)
+        continue;
+      if (e == nb) {
+        /* Lost notifications: report to everybody */
+        todo[n].start = 0;
+        todo[n].last = 0;
+      } else {
+        /* Coalesce writes of the same transaction */
+        if (mod_watch_regs[i].last == ev[e].ts)
+          continue;
+        if (!mod_watch_matches(&mod_watch_regs[i], &ev[e]))
+          continue;
+        mod_watch_regs[i].last = ev[e].ts;
+        todo[n].start = mod_watch_regs[i].start;
+        todo[n].last = ev[e].ts;
+      }
+      todo[n].cb = mod_watch_regs[i].cb;
+      todo[n].arg = mod_watch_regs[i].arg;
+      n++;
+    }
+    pthread_mutex_unlock(&mod_watch_regs_mutex);
+    /* Call outside of the lock (callbacks may register or cancel watches) */
+    for (i = 0; i < n; i++)
+      todo[i].cb((void *)todo[i].start, todo[i].last, todo[i].arg);
+  }
+}
+
+/*
+ * Dispatcher thread.
+ */
+static void *mod_watch_dispatcher(void *arg)
+{
+  mod_watch_event_t ev[64];
+  struct timespec ts;
+  stm_word_t dropped, seen;
+  unsigned int nb;
+  int overflow, stop;
+
+  /* Callbacks may use transactions */
+  stm_init_thread();
+
+  seen = 0;
+  do {
+    for (nb = 0; nb < sizeof(ev) / sizeof(ev[0]) && mod_watch_dequeue(&ev[nb]); nb++)
+      ;
+    dropped = ATOMIC_LOAD(&mod_watch_dropped);
+    overflow = (nb == 0 && dropped != seen);
+    if (overflow)
+      seen = dropped;
+
+    stop = 0;
+    if (nb == 0 && !overflow) {
+      /* Nothing to deliver: wait for committers (they only signal if
+       * they can acquire the mutex, hence the timeout) */
+      pthread_mutex_lock(&mod_watch_queue_mutex);
+      ATOMIC_STORE(&mod_watch_sleeping, 1);
+      ATOMIC_MB_FULL;
+      if (mod_watch_stop) {
+        stop = 1;
+      } else if (ATOMIC_LOAD_ACQ(&mod_watch_queue[mod_watch_head & (MOD_WATCH_QUEUE_SIZE - 1)].seq) != mod_watch_head + 1 &&
+                 ATOMIC_LOAD(&mod_watch_dropped) == seen) {
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += MOD_WATCH_IDLE_NS;
+        if (ts.tv_nsec >= 1000000000) {
+          ts.tv_sec++;
+          ts.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&mod_watch_queue_cond, &mod_watch_queue_mutex, &ts);
+      }
+      ATOMIC_STORE(&mod_watch_sleeping, 0);
+      pthread_mutex_unlock(&mod_watch_queue_mutex);
+      continue;
+    }
+
+    mod_watch_deliver(ev, nb, overflow);
+  } while (!stop);
+
+  stm_exit_thread();
+
+  return NULL;
+}
+
+/*
+ * Number of notifications lost because the queue was full.
+ */
+unsigned long stm_watch_dropped(void)
+{
+  return (unsigned long)ATOMIC_LOAD(&mod_watch_dropped);
+}
+
+/*
+ * Register a watch.
+ */
+int stm_watch(void *addr, size_t len, stm_watch_cb_t cb, void *arg)
+{
+  int i;
+
+  if (!mod_watch_initialized) {
+    fprintf(stderr, "Module mod_watch not initialized\n");
+    exit(1);
+  }
+  if (len == 0 || cb == NULL)
+    return -1;
+
+  pthread_mutex_lock(&mod_watch_regs_mutex);
+  for (i = 0; i < MOD_WATCH_MAX; i++) {
+    if (mod_watch_regs[i].cb == NULL) {
+      mod_watch_regs[i].start = (stm_word_t)addr;
+      mod_watch_regs[i].end = (stm_word_t)addr + len;
+      mod_watch_regs[i].arg = arg;
+      mod_watch_regs[i].last = 0;
+      mod_watch_regs[i].cb = cb;
+      mod_watch_update(&mod_watch_regs[i], 1);
+      break;
+    }
+  }
+  pthread_mutex_unlock(&mod_watch_regs_mutex);
+
+  return (i < MOD_WATCH_MAX ? i : -1);
+}
+
+/*
+ * Cancel a watch.
+ */
+int stm_unwatch(int id)
+{
+  if (!mod_watch_initialized) {
+    fprintf(stderr, "Module mod_watch not initialized\n");
+    exit(1);
+  }
+  if (id < 0 || id >= MOD_WATCH_MAX)
+    return 0;
+
+  pthread_mutex_lock(&mod_watch_regs_mutex);
+  if (mod_watch_regs[id].cb == NULL) {
+    pthread_mutex_unlock(&mod_watch_regs_mutex);
+    return 0;
+  }
+  mod_watch_update(&mod_watch_regs[id], 0);
+  mod_watch_regs[id].cb = NULL;
+  pthread_mutex_unlock(&mod_watch_regs_mutex);
+
+  return 1;
+}
+
+/*
+ * Initialize module.
+ */
+void mod_watch_init(void)
+{
+  int i, size;
+
+  if (mod_watch_initialized)
+    return;
+
+  if (!stm_get_parameter("lock_shift", &mod_watch_shift) ||
+      !stm_get_parameter("lock_array_size", &size)) {
+    fprintf(stderr, "Cannot get lock array geometry\n");
+    exit(1);
+  }
+  mod_watch_mask = (stm_word_t)size - 1;
+  for (i = 0; i < MOD_WATCH_QUEUE_SIZE; i++)
+    mod_watch_queue[i].seq = i;
+  if ((mod_watch_bitmap = (volatile stm_word_t *)calloc((size + MOD_WATCH_BITS - 1) / MOD_WATCH_BITS, sizeof(stm_word_t))) == NULL) {
+    perror("calloc");
+    exit(1);
+  }
+  if (!stm_set_parameter("watch_notify", (void *)mod_watch_notify) ||
+      !stm_set_parameter("watch_bitmap", (void *)mod_watch_bitmap)) {
+    fprintf(stderr, "Module mod_watch requires the library to be compiled with WATCH\n");
+    exit(1);
+  }
+  if (pthread_create(&mod_watch_thread, NULL, mod_watch_dispatcher, NULL) != 0) {
+    fprintf(stderr, "Error creating thread\n");
+    exit(1);
+  }
+
+  mod_watch_initialized = 1;
+}
+
+/*
+ * Clean up module.
+ */
+void mod_watch_exit(void)
+{
+  if (!mod_watch_initialized)
+    return;
+
+  stm_set_parameter("watch_bitmap", NULL);
+
+  pthread_mutex_lock(&mod_watch_queue_mutex);
+  mod_watch_stop = 1;
+  pthread_cond_signal(&mod_watch_queue_cond);
+  pthread_mutex_unlock(&mod_watch_queue_mutex);
+  pthread_join(mod_watch_thread, NULL);
+
+  mod_watch_initialized = 0;
+}
@@ -50,6 +50,15 @@ static const char *design_names[] = {
   /* 3 */ "WRITE-MODULAR"
 };
 
+#if DESIGN == MODULAR
+/* Names used to select the design at runtime */
+static const char *design_ids[] = {
+  /* 0 */ "WRITE_BACK_ETL",
+  /* 1 */ "WRITE_BACK_CTL",
+  /* 2 */ "WRITE_THROUGH"
+};
+#endif /* DESIGN == MODULAR */
+
 static const char *cm_names[] = {
   /* 0 */ "SUICIDE",
   /* 1 */ "DELAY",
@@ -113,8 +122,8 @@ global_t _tinystm =
 pthread_key_t thread_tx;
 pthread_key_t thread_gc;
 #elif defined(TLS_COMPILER)
-__thread stm_tx_t* thread_tx = NULL;
-__thread long thread_gc = 0;
+__thread stm_tx_t* thread_tx TLS_MODEL = NULL;
+__thread long thread_gc TLS_MODEL = 0;
 #endif /* defined(TLS_COMPILER) */
 
 /* ################################################################### *
@@ -233,9 +242,9 @@ signal_catcher(int sig)
 _CALLCONV void
 stm_init(void)
 {
-#if CM == CM_MODULAR
+#if DESIGN == MODULAR || CM == CM_MODULAR || defined(IRREVOCABLE_BATCH)
   char *s;
-#endif /* CM == CM_MODULAR */
+#endif /* DESIGN == MODULAR || CM == CM_MODULAR || defined(IRREVOCABLE_BATCH) */
 #ifdef SIGNAL_HANDLER
   struct sigaction act;
 #endif /* SIGNAL_HANDLER */
@@ -265,12 +274,37 @@ stm_init(void)
   PRINT_DEBUG("\tVR_THRESHOLD=%d\n", _tinystm.vr_threshold);
 #endif /* CM == CM_MODULAR */
 
+#ifdef IRREVOCABLE_BATCH
+  s = getenv(IRREVOCABLE_WINDOW);
+  if (s != NULL)
+    _tinystm.irrevocable_window = (int)strtol(s, NULL, 10);
+  else
+    _tinystm.irrevocable_window = IRREVOCABLE_WINDOW_DEFAULT;
+  PRINT_DEBUG("\tIRREVOCABLE_WINDOW=%d\n", _tinystm.irrevocable_window);
+#endif /* IRREVOCABLE_BATCH */
+
   /* Set locks and clock but should be already to 0 */
-  memset((void *)_tinystm.locks, 0, LOCK_ARRAY_SIZE * sizeof(stm_word_t));
+  memset((void *)_tinystm.locks, 0, LOCK_ARRAY_SIZE * sizeof(stm_lock_t));
+#ifdef REGION_SUMMARIES
+  memset((void *)_tinystm.regions, 0, REGION_ARRAY_SIZE * sizeof(stm_word_t));
+#endif /* REGION_SUMMARIES */
   CLOCK = 0;
 
   stm_quiesce_init();
 
+#if DESIGN == MODULAR
+  /* Select design and contention manager (only once, before any thread) */
+  _tinystm.design = WRITE_BACK_ETL;
+  _tinystm.cm = CM;
+  s = getenv(STM_DESIGN);
+  if (s != NULL && stm_set_parameter("design", s) == 0)
+    fprintf(stderr, "Warning: unknown design %s\n", s);
+  PRINT_DEBUG("\tdesign=%s\n", design_names[_tinystm.design]);
+  s = getenv(STM_CM);
+  if (s != NULL && stm_set_parameter("contention_manager", s) == 0)
+    fprintf(stderr, "Warning: unknown contention manager %s\n", s);
+#endif /* DESIGN == MODULAR */
+
   tls_init();
 
 #ifdef SIGNAL_HANDLER
@@ -389,15 +423,35 @@ _CALLCONV ALIGNED stm_word_t
 stm_load(volatile stm_word_t *addr)
 {
   TX_GET;
+  SET_CALL_SITE(tx);
   return int_stm_load(tx, addr);
 }
 
 _CALLCONV stm_word_t
 stm_load_tx(stm_tx_t *tx, volatile stm_word_t *addr)
 {
+  SET_CALL_SITE(tx);
   return int_stm_load(tx, addr);
 }
 
+/*
+ * Called by the CURRENT thread to load consecutive word-sized values.
+ */
+_CALLCONV void
+stm_load_range(volatile stm_word_t *addr, stm_word_t *buf, size_t nb)
+{
+  TX_GET;
+  SET_CALL_SITE(tx);
+  int_stm_load_range(tx, addr, buf, nb);
+}
+
+_CALLCONV void
+stm_load_range_tx(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t *buf, size_t nb)
+{
+  SET_CALL_SITE(tx);
+  int_stm_load_range(tx, addr, buf, nb);
+}
+
 /*
  * Called by the CURRENT thread to store a word-sized value.
  */
@@ -405,12 +459,14 @@ _CALLCONV ALIGNED void
 stm_store(volatile stm_word_t *addr, stm_word_t value)
 {
   TX_GET;
+  SET_CALL_SITE(tx);
   int_stm_store(tx, addr, value);
 }
 
 _CALLCONV void
 stm_store_tx(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t value)
 {
+  SET_CALL_SITE(tx);
   int_stm_store(tx, addr, value);
 }
 
@@ -421,12 +477,14 @@ _CALLCONV ALIGNED void
 stm_store2(volatile stm_word_t *addr, stm_word_t value, stm_word_t mask)
 {
   TX_GET;
+  SET_CALL_SITE(tx);
   int_stm_store2(tx, addr, value, mask);
 }
 
 _CALLCONV void
 stm_store2_tx(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t value, stm_word_t mask)
 {
+  SET_CALL_SITE(tx);
   int_stm_store2(tx, addr, value, mask);
 }
 
@@ -553,6 +611,16 @@ stm_get_stats_tx(stm_tx_t *tx, const char *name, void *val)
 _CALLCONV int
 stm_get_parameter(const char *name, void *val)
 {
+#if DESIGN == MODULAR
+  if (strcmp("contention_manager", name) == 0) {
+    *(const char **)val = cm_names[_tinystm.cm];
+    return 1;
+  }
+  if (strcmp("design", name) == 0) {
+    *(const char **)val = design_names[_tinystm.design];
+    return 1;
+  }
+#else /* DESIGN != MODULAR */
   if (strcmp("contention_manager", name) == 0) {
     *(const char **)val = cm_names[CM];
     return 1;
@@ -561,11 +629,20 @@ stm_get_parameter(const char *name, void *val)
     *(const char **)val = design_names[DESIGN];
     return 1;
   }
+#endif /* DESIGN != MODULAR */
   if (strcmp("initial_rw_set_size", name) == 0) {
     *(int *)val = RW_SET_SIZE;
     return 1;
   }
-#if CM == CM_BACKOFF
+  if (strcmp("lock_shift", name) == 0) {
+    *(int *)val = LOCK_SHIFT;
+    return 1;
+  }
+  if (strcmp("lock_array_size", name) == 0) {
+    *(int *)val = LOCK_ARRAY_SIZE;
+    return 1;
+  }
+#if CM == CM_BACKOFF || DESIGN == MODULAR || defined(RETRY_POLICIES)
   if (strcmp("min_backoff", name) == 0) {
     *(unsigned long *)val = MIN_BACKOFF;
     return 1;
@@ -574,13 +651,25 @@ stm_get_parameter(const char *name, void *val)
     *(unsigned long *)val = MAX_BACKOFF;
     return 1;
   }
-#endif /* CM == CM_BACKOFF */
+#endif /* CM == CM_BACKOFF || DESIGN == MODULAR || defined(RETRY_POLICIES) */
 #if CM == CM_MODULAR
   if (strcmp("vr_threshold", name) == 0) {
     *(int *)val = _tinystm.vr_threshold;
     return 1;
   }
 #endif /* CM == CM_MODULAR */
+#ifdef IRREVOCABLE_BATCH
+  if (strcmp("irrevocable_window", name) == 0) {
+    *(int *)val = _tinystm.irrevocable_window;
+    return 1;
+  }
+#endif /* IRREVOCABLE_BATCH */
+#ifdef CALL_SITES
+  if (strcmp("call_sites_sample", name) == 0) {
+    *(int *)val = CALL_SITES_SAMPLE;
+    return 1;
+  }
+#endif /* CALL_SITES */
 #ifdef COMPILE_FLAGS
   if (strcmp("compile_flags", name) == 0) {
     *(const char **)val = XSTR(COMPILE_FLAGS);
@@ -596,8 +685,68 @@ stm_get_parameter(const char *name, void *val)
 _CALLCONV int
 stm_set_parameter(const char *name, void *val)
 {
-#if CM == CM_MODULAR
+#if DESIGN == MODULAR || CM == CM_MODULAR
   int i;
+#endif /* DESIGN == MODULAR || CM == CM_MODULAR */
+
+#if DESIGN == MODULAR
+  if (strcmp("design", name) == 0) {
+    for (i = WRITE_BACK_ETL; i <= WRITE_THROUGH; i++) {
+      if (strcasecmp(design_ids[i], (const char *)val) == 0) {
+        /* Threads must all use the same design */
+        pthread_mutex_lock(&_tinystm.quiesce_mutex);
+        if (_tinystm.threads != NULL)
+          i = MODULAR;
+        else
+          _tinystm.design = i;
+        pthread_mutex_unlock(&_tinystm.quiesce_mutex);
+        return (i != MODULAR);
+      }
+    }
+    return 0;
+  }
+  if (strcmp("contention_manager", name) == 0) {
+    for (i = CM_SUICIDE; i <= CM_BACKOFF; i++) {
+      if (strcasecmp(cm_names[i], (const char *)val) == 0) {
+        _tinystm.cm = i;
+        return 1;
+      }
+    }
+    return 0;
+  }
+#endif /* DESIGN == MODULAR */
+#ifdef CDC
+  if (strcmp("cdc_ring", name) == 0) {
+    _tinystm.cdc = (mod_cdc_ring_t *)val;
+    return 1;
+  }
+#endif /* CDC */
+#ifdef IRREVOCABLE_BATCH
+  if (strcmp("irrevocable_window", name) == 0) {
+    _tinystm.irrevocable_window = *(int *)val;
+    return 1;
+  }
+#endif /* IRREVOCABLE_BATCH */
+#ifdef CONFLICT_TRACKING
+  if (strcmp("conflict_cb", name) == 0) {
+    _tinystm.conflict_cb = (void (*)(stm_tx_t *, stm_tx_t *))val;
+    return 1;
+  }
+#endif /* CONFLICT_TRACKING */
+#ifdef WATCH
+  if (strcmp("watch_notify", name) == 0) {
+    _tinystm.watch_notify = (void (*)(void *, stm_word_t, stm_word_t))val;
+    return 1;
+  }
+  if (strcmp("watch_bitmap", name) == 0) {
+    /* The notification function must be set first */
+    if (val != NULL && _tinystm.watch_notify == NULL)
+      return 0;
+    ATOMIC_STORE_REL(&_tinystm.watch, (volatile stm_word_t *)val);
+    return 1;
+  }
+#endif /* WATCH */
+#if CM == CM_MODULAR
 
   if (strcmp("cm_policy", name) == 0) {
     for (i = 0; cms[i].name != NULL; i++) {
@@ -672,6 +821,106 @@ stm_get_specific_tx(stm_tx_t *tx, int key)
   return int_stm_get_specific(tx, key);
 }
 
+/*
+ * Allocate scratch memory for the current transaction.
+ */
+_CALLCONV void *
+stm_scratch_alloc(size_t size)
+{
+  TX_GET;
+  return int_stm_scratch_alloc(tx, size);
+}
+
+/*
+ * Allocate scratch memory for a specific transaction.
+ */
+_CALLCONV void *
+stm_scratch_alloc_tx(stm_tx_t *tx, size_t size)
+{
+  return int_stm_scratch_alloc(tx, size);
+}
+
+/*
+ * Get the call sites of the last conflict of a transaction.
+ */
+_CALLCONV int
+stm_get_conflict_sites(stm_tx_t *tx, void **site, void **other_site)
+{
+#ifdef CALL_SITES
+  *site = tx->conflict_site;
+  *other_site = tx->conflict_other_site;
+  return 1;
+#else /* ! CALL_SITES */
+  return 0;
+#endif /* ! CALL_SITES */
+}
+
+/*
+ * Set the deadline of the current thread.
+ */
+_CALLCONV int
+stm_set_deadline(uint64_t deadline, unsigned int max_retries, int action)
+{
+  TX_GET;
+  return int_stm_set_deadline(tx, deadline, max_retries, action);
+}
+
+/*
+ * Set the deadline of a specific thread.
+ */
+_CALLCONV int
+stm_set_deadline_tx(stm_tx_t *tx, uint64_t deadline, unsigned int max_retries, int action)
+{
+  return int_stm_set_deadline(tx, deadline, max_retries, action);
+}
+
+/*
+ * Request the cancellation of the transaction of another thread.
+ */
+_CALLCONV void
+stm_cancel(stm_tx_t *tx)
+{
+  int_stm_cancel(tx);
+}
+
+/*
+ * Set the retry policy for an abort reason.
+ */
+_CALLCONV int
+stm_set_retry_policy(unsigned int set, int reason, int policy, unsigned int arg)
+{
+#ifdef RETRY_POLICIES
+  unsigned int r;
+
+  if (set >= RETRY_SETS)
+    return 0;
+  switch (policy) {
+    case STM_RETRY_DEFAULT:
+    case STM_RETRY_IMMEDIATE:
+    case STM_RETRY_WAIT_LOCK:
+    case STM_RETRY_BACKOFF:
+# if CM == CM_MODULAR
+    case STM_RETRY_VISIBLE_READS:
+# endif /* CM == CM_MODULAR */
+# ifdef IRREVOCABLE_ENABLED
+    case STM_RETRY_IRREVOCABLE:
+# endif /* IRREVOCABLE_ENABLED */
+      break;
+    default:
+      return 0;
+  }
+  for (r = 0; r < RETRY_REASONS; r++) {
+    if (reason == -1 || r == RETRY_REASON((unsigned int)reason)) {
+      _tinystm.retry[set][r].arg = arg;
+      _tinystm.retry[set][r].policy = policy;
+    }
+  }
+  return 1;
+#else /* ! RETRY_POLICIES */
+  return 0;
+#endif /* ! RETRY_POLICIES */
+}
+
 /*
  * Register callbacks for an external module (must be called before creating transactions).
  */
@@ -734,7 +983,7 @@ _CALLCONV stm_word_t
 stm_unit_load(volatile stm_word_t *addr, stm_word_t *timestamp)
 {
 #ifdef UNIT_TX
-  volatile stm_word_t *lock;
+  volatile stm_lock_t *lock;
   stm_word_t l, l2, value;
 
   PRINT_DEBUG2("==> stm_unit_load(a=%p)\n", addr);
@@ -744,7 +993,7 @@ stm_unit_load(volatile stm_word_t *addr, stm_word_t *timestamp)
 
   /* Read lock, value, lock */
  restart:
-  l = ATOMIC_LOAD_ACQ(lock);
+  l = LOCK_LOAD_ACQ(lock);
  restart_no_load:
   if (LOCK_GET_OWNED(l)) {
     /* Locked: wait until lock is free */
@@ -755,7 +1004,7 @@ stm_unit_load(volatile stm_word_t *addr, stm_word_t *timestamp)
   }
   /* Not locked */
   value = ATOMIC_LOAD_ACQ(addr);
-  l2 = ATOMIC_LOAD_ACQ(lock);
+  l2 = LOCK_LOAD_ACQ(lock);
   if (l != l2) {
     l = l2;
     goto restart_no_load;
@@ -779,7 +1028,7 @@ static INLINE int
 stm_unit_write(volatile stm_word_t *addr, stm_word_t value, stm_word_t mask, stm_word_t *timestamp)
 {
 #ifdef UNIT_TX
-  volatile stm_word_t *lock;
+  volatile stm_lock_t *lock;
   stm_word_t l;
 
   PRINT_DEBUG2("==> stm_unit_write(a=%p,d=%p-%lu,m=0x%lx)\n",
@@ -790,7 +1039,7 @@ stm_unit_write(volatile stm_word_t *addr, stm_word_t value, stm_word_t mask, stm
 
   /* Try to acquire lock */
  restart:
-  l = ATOMIC_LOAD_ACQ(lock);
+  l = LOCK_LOAD_ACQ(lock);
   if (LOCK_GET_OWNED(l)) {
     /* Locked: wait until lock is free */
 #ifdef WAIT_YIELD
@@ -805,7 +1054,7 @@ stm_unit_write(volatile stm_word_t *addr, stm_word_t value, stm_word_t mask, stm
     return 0;
   }
   /* TODO: would need to store thread ID to be able to kill it (for wait freedom) */
-  if (ATOMIC_CAS_FULL(lock, l, LOCK_UNIT) == 0)
+  if (LOCK_CAS_FULL(lock, l, LOCK_UNIT) == 0)
     goto restart;
   ATOMIC_STORE(addr, value);
   /* Update timestamp with newer value (may exceed VERSION_MAX by up to MAX_THREADS) */
@@ -813,7 +1062,7 @@ stm_unit_write(volatile stm_word_t *addr, stm_word_t value, stm_word_t mask, stm
   if (timestamp != NULL)
     *timestamp = l;
   /* Make sure that lock release becomes visible */
-  ATOMIC_STORE_REL(lock, LOCK_SET_TIMESTAMP(l));
+  LOCK_STORE_REL(lock, LOCK_SET_TIMESTAMP(l));
   if (unlikely(l >= VERSION_MAX)) {
     /* Block all transactions and reset clock (current thread is not in active transaction) */
     stm_quiesce_barrier(NULL, rollover_clock, NULL);
@@ -927,6 +1176,9 @@ int_stm_set_irrevocable(stm_tx_t *tx, int serial)
 # if CM == CM_MODULAR
   stm_word_t t;
 # endif /* CM == CM_MODULAR */
+# ifdef IRREVOCABLE_BATCH
+  int batched = 0;
+# endif /* IRREVOCABLE_BATCH */
 
   if (!IS_ACTIVE(tx->status) && serial != -1) {
     /* Request irrevocability outside of a transaction or in abort handler (for next execution) */
@@ -967,9 +1219,9 @@ int_stm_set_irrevocable(stm_tx_t *tx, int serial)
       return 0;
     }
 #elif DESIGN == MODULAR
-    if ((tx->attr.id == WRITE_BACK_CTL && stm_wbctl_validate(tx))
-       || (tx->attr.id == WRITE_THROUGH && stm_wt_validate(tx))
-       || (tx->attr.id != WRITE_BACK_CTL && tx->attr.id != WRITE_THROUGH && stm_wbetl_validate(tx))) {
+    if ((tx->design == WRITE_BACK_CTL && !stm_wbctl_validate(tx))
+       || (tx->design == WRITE_THROUGH && !stm_wt_validate(tx))
+       || (tx->design == WRITE_BACK_ETL && !stm_wbetl_validate(tx))) {
       stm_rollback(tx, STM_ABORT_VALIDATE);
       return 0;
     }
@@ -991,6 +1243,21 @@ int_stm_set_irrevocable(stm_tx_t *tx, int serial)
     }
   } else if ((tx->irrevocable & 0x07) == 1) {
     /* Acquire irrevocability after restart (no need to validate) */
+# ifdef IRREVOCABLE_BATCH
+    if ((tx->irrevocable & 0x08) != 0) {
+      ATOMIC_FETCH_INC_FULL(&_tinystm.irrevocable_pending);
+      while (1) {
+        /* Join the window of a committed serial transaction, if any */
+        if (_tinystm.irrevocable_batch == 1 && ATOMIC_CAS_FULL(&_tinystm.irrevocable_batch, 1, 2) != 0) {
+          batched = 1;
+          break;
+        }
+        if (_tinystm.irrevocable == 0 && ATOMIC_CAS_FULL(&_tinystm.irrevocable, 0, 1) != 0)
+          break;
+      }
+      ATOMIC_FETCH_DEC_FULL(&_tinystm.irrevocable_pending);
+    } else
+# endif /* IRREVOCABLE_BATCH */
     while (_tinystm.irrevocable == 1 || ATOMIC_CAS_FULL(&_tinystm.irrevocable, 0, 1) == 0)
       ;
     /* Success: remember we have the lock */
@@ -999,7 +1266,12 @@ int_stm_set_irrevocable(stm_tx_t *tx, int serial)
   assert((tx->irrevocable & 0x07) == 2);
 
   /* Are we in serial irrevocable mode? */
+# ifdef IRREVOCABLE_BATCH
+  /* Other threads are already stopped when executing in a window */
+  if ((tx->irrevocable & 0x08) != 0 && !batched) {
+# else /* ! IRREVOCABLE_BATCH */
   if ((tx->irrevocable & 0x08) != 0) {
+# endif /* ! IRREVOCABLE_BATCH */
     /* Stop all other threads */
     if (stm_quiesce(tx, 1) != 0) {
       /* Another thread is quiescing and we are active (trying to acquire irrevocability) */
@@ -28,11 +28,20 @@
 
 #include <pthread.h>
 #include <string.h>
+#if defined(IRREVOCABLE_BATCH) || defined(DEADLINES)
+# include <sys/time.h>
+#endif /* defined(IRREVOCABLE_BATCH) || defined(DEADLINES) */
 #include <stm.h>
 #include "tls.h"
 #include "utils.h"
 #include "atomic.h"
 #include "gc.h"
+#ifdef CDC
+# include "mod_cdc.h"
+#endif /* CDC */
+#if defined(NT_WRITE_BACK) && defined(__SSE2__)
+# include <immintrin.h>
+#endif /* defined(NT_WRITE_BACK) && defined(__SSE2__) */
 
 /* ################################################################### *
  * DEFINES
@@ -66,6 +75,10 @@
 # error "CONFLICT_TRACKING requires EPOCH_GC"
 #endif /* defined(CONFLICT_TRACKING) && ! defined(EPOCH_GC) */
 
+#if defined(CALL_SITES) && ! defined(CONFLICT_TRACKING)
+# error "CALL_SITES requires CONFLICT_TRACKING"
+#endif /* defined(CALL_SITES) && ! defined(CONFLICT_TRACKING) */
+
 #if CM == CM_MODULAR && ! defined(EPOCH_GC)
 # error "MODULAR contention manager requires EPOCH_GC"
 #endif /* CM == CM_MODULAR && ! defined(EPOCH_GC) */
@@ -78,12 +91,65 @@
 # error "SIGNAL_HANDLER can only be used without EPOCH_GC"
 #endif /* defined(EPOCH_GC) && defined(SIGNAL_HANDLER) */
 
+#if defined(IRREVOCABLE_BATCH) && !defined(IRREVOCABLE_ENABLED)
+# error "IRREVOCABLE_BATCH requires IRREVOCABLE_ENABLED"
+#endif /* defined(IRREVOCABLE_BATCH) && !defined(IRREVOCABLE_ENABLED) */
+
+#if defined(CDC) && DESIGN == WRITE_THROUGH
+# error "CDC can only be used with write-back designs"
+#endif /* defined(CDC) && DESIGN == WRITE_THROUGH */
+
+/* With the MODULAR design, the design and the simple contention managers
+ * (SUICIDE, DELAY and BACKOFF) are selected at runtime; CM is only the
+ * default contention manager. */
+#if DESIGN == MODULAR
+# define CM_ACTIVE(c)                   (_tinystm.cm == (c))
+#else /* DESIGN != MODULAR */
+# define CM_ACTIVE(c)                   (CM == (c))
+#endif /* DESIGN != MODULAR */
+
 #define TX_GET                          stm_tx_t *tx = tls_get_tx()
 
 #ifndef RW_SET_SIZE
 # define RW_SET_SIZE                    4096                /* Initial size of read/write sets */
 #endif /* ! RW_SET_SIZE */
 
+#ifndef CALL_SITES_SAMPLE
+# define CALL_SITES_SAMPLE              16                  /* Transactions recording read sites (one out of) */
+#endif /* ! CALL_SITES_SAMPLE */
+
+/* Record the call site of a barrier (the ABI records its own) */
+#ifndef SET_CALL_SITE
+# ifdef CALL_SITES
+#  define SET_CALL_SITE(tx)             ((tx)->site = __builtin_return_address(0))
+# else /* ! CALL_SITES */
+#  define SET_CALL_SITE(tx)
+# endif /* ! CALL_SITES */
+#endif /* ! SET_CALL_SITE */
+
+#ifndef GIVE_UP_PATH
+# define GIVE_UP_PATH                   0                   /* Bits added to the abort reason when giving up */
+#endif /* ! GIVE_UP_PATH */
+
+#ifndef SCRATCH_SIZE
+# define SCRATCH_SIZE                   4096                /* Initial size of scratch arena */
+#endif /* ! SCRATCH_SIZE */
+
+#ifdef REGION_SUMMARIES
+# if DESIGN != WRITE_BACK_ETL || CM == CM_MODULAR || defined(UNIT_TX)
+#  error "REGION_SUMMARIES requires the WRITE_BACK_ETL design, a simple contention manager and no UNIT_TX"
+# endif /* DESIGN != WRITE_BACK_ETL || CM == CM_MODULAR || defined(UNIT_TX) */
+# ifndef REGION_ARRAY_LOG_SIZE
+#  define REGION_ARRAY_LOG_SIZE         12                  /* Size of region array: 2^12 = 4K */
+# endif /* ! REGION_ARRAY_LOG_SIZE */
+# ifndef REGION_SHIFT
+#  define REGION_SHIFT                  12                  /* Size of a region: 2^12 = 4KB */
+# endif /* ! REGION_SHIFT */
+# ifndef REGION_SET_SIZE
+#  define REGION_SET_SIZE               8                   /* Regions tracked per transaction */
+# endif /* ! REGION_SET_SIZE */
+#endif /* REGION_SUMMARIES */
+
 #ifndef LOCK_ARRAY_LOG_SIZE
 # define LOCK_ARRAY_LOG_SIZE            20                  /* Size of lock array: 2^20 = 1M */
 #endif /* LOCK_ARRAY_LOG_SIZE */
@@ -92,14 +158,14 @@
 # define LOCK_SHIFT_EXTRA               2                   /* 2 extra shift */
 #endif /* LOCK_SHIFT_EXTRA */
 
-#if CM == CM_BACKOFF
+#if CM == CM_BACKOFF || DESIGN == MODULAR || defined(RETRY_POLICIES)
 # ifndef MIN_BACKOFF
 #  define MIN_BACKOFF                   (1UL << 2)
 # endif /* MIN_BACKOFF */
 # ifndef MAX_BACKOFF
 #  define MAX_BACKOFF                   (1UL << 31)
 # endif /* MAX_BACKOFF */
-#endif /* CM == CM_BACKOFF */
+#endif /* CM == CM_BACKOFF || DESIGN == MODULAR || defined(RETRY_POLICIES) */
 
 #if CM == CM_MODULAR
 # define VR_THRESHOLD                   "VR_THRESHOLD"
@@ -108,7 +174,44 @@
 # endif /* VR_THRESHOLD_DEFAULT */
 #endif /* CM == CM_MODULAR */
 
+#ifdef NT_WRITE_BACK
+# ifndef NT_THRESHOLD
+#  define NT_THRESHOLD                  8192                /* Written words */
+# endif /* NT_THRESHOLD */
+#endif /* NT_WRITE_BACK */
+
+#ifdef WRITE_PREDICTION
+# define PREDICT_BLOCKS                 256                 /* Atomic blocks (indexed by attr.id) */
+# define PREDICT_STRIPES                8                   /* Stripes remembered per atomic block */
+# define PREDICT_WAIT                   1024                /* WRITE_BACK_CTL: spins on a predicted stripe being committed */
+#endif /* WRITE_PREDICTION */
+
+#ifdef LOG_PRESIZE
+# define LOG_BLOCKS                     256                 /* Atomic blocks (indexed by attr.id) */
+# define LOG_SHRINK_PERIOD              65536               /* Commits with logs less than a quarter full before shrinking */
+# define LOG_PAGE_SIZE                  4096
+#endif /* LOG_PRESIZE */
+
+#ifdef IRREVOCABLE_BATCH
+# define IRREVOCABLE_WINDOW             "IRREVOCABLE_WINDOW"
+# ifndef IRREVOCABLE_WINDOW_DEFAULT
+#  define IRREVOCABLE_WINDOW_DEFAULT    1000                /* Microseconds */
+# endif /* IRREVOCABLE_WINDOW_DEFAULT */
+#endif /* IRREVOCABLE_BATCH */
+
+#ifdef RETRY_POLICIES
+# define RETRY_SETS                     16                  /* Selected by the retry_policy attribute (4 bits) */
+# define RETRY_REASONS                  18                  /* See RETRY_REASON() */
+/* Implicit aborts are indexed by their detailed reason, and explicit
+ * aborts by whether they retry (the detailed reasons overlap) */
+# define RETRY_REASON(r)                (((r) & STM_ABORT_IMPLICIT) != 0 ? ((r) >> 8) & 0x0F : \
+                                         16 + (((r) & STM_ABORT_NO_RETRY) == STM_ABORT_NO_RETRY))
+# define RETRY_POLICY_NB                (STM_RETRY_IRREVOCABLE + 1)
+#endif /* RETRY_POLICIES */
+
 #define NO_SIGNAL_HANDLER               "NO_SIGNAL_HANDLER"
+#define STM_DESIGN                      "STM_DESIGN"
+#define STM_CM                          "STM_CM"
 
 #if defined(CTX_LONGJMP)
 # define JMP_BUF                        jmp_buf
@@ -174,8 +277,31 @@ enum {                                  /* Transaction status */
  *     upon abort while writing the covered memory addresses).
  * When visible reads are enabled, two bits are used as read and write
  * locks. A read-locked address can be read by an invisible reader.
+ *
+ * With COMPACT_LOCKS, locks are 32-bit words on all architectures (the
+ * lock array takes half the space on 64-bit architectures).  Instead of
+ * a pointer, an owned lock holds the index of the owner thread and the
+ * index of the entry in its write set, which are resolved through the
+ * table of thread descriptors.  Versions have fewer bits and the clock
+ * rolls over more often.
  */
 
+#ifdef COMPACT_LOCKS
+typedef uint32_t stm_lock_t;
+# define LOCK_LOAD(a)                   ATOMIC_LOAD_32(a)
+# define LOCK_LOAD_ACQ(a)               ATOMIC_LOAD_ACQ_32(a)
+# define LOCK_STORE(a, v)               ATOMIC_STORE_32(a, v)
+# define LOCK_STORE_REL(a, v)           ATOMIC_STORE_REL_32(a, v)
+# define LOCK_CAS_FULL(a, e, v)         ATOMIC_CAS_FULL_32(a, e, v)
+#else /* ! COMPACT_LOCKS */
+typedef stm_word_t stm_lock_t;
+# define LOCK_LOAD(a)                   ATOMIC_LOAD(a)
+# define LOCK_LOAD_ACQ(a)               ATOMIC_LOAD_ACQ(a)
+# define LOCK_STORE(a, v)               ATOMIC_STORE(a, v)
+# define LOCK_STORE_REL(a, v)           ATOMIC_STORE_REL(a, v)
+# define LOCK_CAS_FULL(a, e, v)         ATOMIC_CAS_FULL(a, e, v)
+#endif /* ! COMPACT_LOCKS */
+
 #if CM == CM_MODULAR
 # define OWNED_BITS                     2                   /* 2 bits */
 # define WRITE_MASK                     0x01                /* 1 bit */
@@ -191,12 +317,26 @@ enum {                                  /* Transaction status */
 #define INCARNATION_MASK                (INCARNATION_MAX << 1)
 #define LOCK_BITS                       (OWNED_BITS + INCARNATION_BITS)
 #define MAX_THREADS                     8192                /* Upper bound (large enough) */
-#define VERSION_MAX                     ((~(stm_word_t)0 >> LOCK_BITS) - MAX_THREADS)
+#define VERSION_MAX                     ((stm_word_t)(~(stm_lock_t)0 >> LOCK_BITS) - MAX_THREADS)
 
 #define LOCK_GET_OWNED(l)               (l & OWNED_MASK)
 #define LOCK_GET_WRITE(l)               (l & WRITE_MASK)
 #define LOCK_SET_ADDR_WRITE(a)          (a | WRITE_MASK)    /* WRITE bit set */
-#define LOCK_GET_ADDR(l)                (l & ~(stm_word_t)OWNED_MASK)
+#ifdef COMPACT_LOCKS
+# define LOCK_THREAD_BITS               13                  /* MAX_THREADS (last index is reserved) */
+# define LOCK_ENTRY_BITS                (32 - OWNED_BITS - LOCK_THREAD_BITS)
+# define LOCK_ENTRY_MAX                 (1 << LOCK_ENTRY_BITS) /* Maximal size of write set */
+# if RW_SET_SIZE > LOCK_ENTRY_MAX
+#  error "RW_SET_SIZE exceeds the maximal size of the write set with COMPACT_LOCKS"
+# endif /* RW_SET_SIZE > LOCK_ENTRY_MAX */
+# define WS_EXTENSIBLE(tx)              ((tx)->w_set.size <= LOCK_ENTRY_MAX / 2)
+# define LOCK_ENTRY(tx, w)              ((((stm_word_t)(tx)->lock_id << LOCK_ENTRY_BITS) | (stm_word_t)((w) - (tx)->w_set.entries)) << OWNED_BITS)
+# define LOCK_GET_ADDR(l)               ((stm_word_t)(_tinystm.threads_tab[(l) >> (OWNED_BITS + LOCK_ENTRY_BITS)]->w_set.entries + \
+                                                      (((l) >> OWNED_BITS) & (LOCK_ENTRY_MAX - 1))))
+#else /* ! COMPACT_LOCKS */
+# define LOCK_ENTRY(tx, w)              ((stm_word_t)(w))
+# define LOCK_GET_ADDR(l)               (l & ~(stm_word_t)OWNED_MASK)
+#endif /* ! COMPACT_LOCKS */
 #if CM == CM_MODULAR
 # define LOCK_GET_READ(l)               (l & READ_MASK)
 # define LOCK_SET_ADDR_READ(a)          (a | READ_MASK)     /* READ bit set */
@@ -208,7 +348,7 @@ enum {                                  /* Transaction status */
 #define LOCK_SET_INCARNATION(i)         (i << OWNED_BITS)   /* OWNED bit not set */
 #define LOCK_UPD_INCARNATION(l, i)      ((l & ~(stm_word_t)(INCARNATION_MASK | OWNED_MASK)) | LOCK_SET_INCARNATION(i))
 #ifdef UNIT_TX
-# define LOCK_UNIT                       (~(stm_word_t)0)
+# define LOCK_UNIT                       ((stm_word_t)~(stm_lock_t)0)
 #endif /* UNIT_TX */
 
 /*
@@ -237,6 +377,18 @@ enum {                                  /* Transaction status */
 # define GET_LOCK(a)                    (_tinystm.locks + LOCK_IDX(a))
 #endif /* ! LOCK_IDX_SWAP */
 
+#ifdef REGION_SUMMARIES
+/*
+ * Coarse-grained counters covering large address ranges.  Writers
+ * increment the counters of the regions they update before getting
+ * their commit timestamp.  A transaction that reads a region only
+ * records the counter once instead of one read set entry per stripe.
+ */
+# define REGION_ARRAY_SIZE              (1 << REGION_ARRAY_LOG_SIZE)
+# define REGION_MASK                    (REGION_ARRAY_SIZE - 1)
+# define GET_REGION(a)                  (_tinystm.regions + (((stm_word_t)(a) >> REGION_SHIFT) & REGION_MASK))
+#endif /* REGION_SUMMARIES */
+
 /* ################################################################### *
  * CLOCK
  * ################################################################### */
@@ -264,7 +416,7 @@ enum {                                  /* Transaction status */
 
 typedef struct r_entry {                /* Read set entry */
   stm_word_t version;                   /* Version read */
-  volatile stm_word_t *lock;            /* Pointer to lock (for fast access) */
+  volatile stm_lock_t *lock;            /* Pointer to lock (for fast access) */
 } r_entry_t;
 
 typedef struct r_set {                  /* Read set */
@@ -273,6 +425,21 @@ typedef struct r_set {                  /* Read set */
   unsigned int size;                    /* Size of array */
 } r_set_t;
 
+#ifdef REGION_SUMMARIES
+typedef struct rg_entry {               /* Region read set entry */
+  volatile stm_word_t *region;          /* Pointer to region counter */
+  stm_word_t version;                   /* Counter value when first read */
+} rg_entry_t;
+
+typedef struct rg_set {                 /* Region read set */
+  rg_entry_t entries[REGION_SET_SIZE];  /* Array of entries */
+  rg_entry_t *last;                     /* Last entry found */
+  unsigned int nb_entries;              /* Number of entries */
+  unsigned int size;                    /* Entries usable in this attempt (0: stripes only) */
+  unsigned int hot;                     /* Did a region fail validation? */
+} rg_set_t;
+#endif /* REGION_SUMMARIES */
+
 typedef struct w_entry {                /* Write set entry */
   union {                               /* For padding... */
     struct {
@@ -280,10 +447,13 @@ typedef struct w_entry {                /* Write set entry */
       stm_word_t value;                 /* New (write-back) or old (write-through) value */
       stm_word_t mask;                  /* Write mask */
       stm_word_t version;               /* Version overwritten */
-      volatile stm_word_t *lock;        /* Pointer to lock (for fast access) */
+      volatile stm_lock_t *lock;        /* Pointer to lock (for fast access) */
 #if CM == CM_MODULAR || defined(CONFLICT_TRACKING)
       struct stm_tx *tx;                /* Transaction owning the write set */
 #endif /* CM == CM_MODULAR || defined(CONFLICT_TRACKING) */
+#ifdef CALL_SITES
+      void *site;                       /* Call site of first write to the stripe */
+#endif /* CALL_SITES */
       union {
         struct w_entry *next;           /* WRITE_BACK_ETL || WRITE_THROUGH: Next address covered by same lock (if any) */
         stm_word_t no_drop;             /* WRITE_BACK_CTL: Should we drop lock upon abort? */
@@ -312,6 +482,21 @@ typedef struct cb_entry {               /* Callback entry */
   void *arg;                            /* Argument to be passed to function */
 } cb_entry_t;
 
+#ifdef RETRY_POLICIES
+typedef struct retry_policy {           /* Retry policy for one abort reason */
+  int policy;                           /* Policy (STM_RETRY_*) */
+  unsigned int arg;                     /* Policy-specific argument */
+} retry_policy_t;
+#endif /* RETRY_POLICIES */
+
+typedef struct scratch {                /* Transaction-local scratch memory */
+  uint8_t *base;                        /* Arena (allocated upon first use) */
+  size_t size;                          /* Size of arena */
+  size_t top;                           /* Bytes allocated from arena */
+  void *overflow;                       /* Blocks allocated when arena is full */
+  size_t overflow_size;                 /* Bytes allocated in overflow blocks */
+} scratch_t;
+
 typedef struct stm_tx {                 /* Transaction descriptor */
   JMP_BUF env;                          /* Environment for setjmp/longjmp */
   stm_tx_attr_t attr;                   /* Transaction attributes (user-specified) */
@@ -320,36 +505,76 @@ typedef struct stm_tx {                 /* Transaction descriptor */
   stm_word_t end;                       /* End timestamp (validity range) */
   r_set_t r_set;                        /* Read set */
   w_set_t w_set;                        /* Write set */
+#ifdef REGION_SUMMARIES
+  rg_set_t rg_set;                      /* Region read set */
+#endif /* REGION_SUMMARIES */
+  scratch_t scratch;                    /* Scratch memory */
 #ifdef IRREVOCABLE_ENABLED
   unsigned int irrevocable:4;           /* Is this execution irrevocable? */
 #endif /* IRREVOCABLE_ENABLED */
   unsigned int nesting;                 /* Nesting level */
+  unsigned int abort_reason;            /* Reason of the last abort (for callbacks) */
+#if DESIGN == MODULAR
+  unsigned int design;                  /* Design used by this thread */
+#endif /* DESIGN == MODULAR */
 #if CM == CM_MODULAR
   stm_word_t timestamp;                 /* Timestamp (not changed upon restart) */
 #endif /* CM == CM_MODULAR */
   void *data[MAX_SPECIFIC];             /* Transaction-specific data (fixed-size array for better speed) */
   struct stm_tx *next;                  /* For keeping track of all transactional threads */
+#ifdef COMPACT_LOCKS
+  unsigned int lock_id;                 /* Index in table of threads (for compact locks) */
+#endif /* COMPACT_LOCKS */
 #ifdef CONFLICT_TRACKING
   pthread_t thread_id;                  /* Thread identifier (immutable) */
 #endif /* CONFLICT_TRACKING */
-#if CM == CM_DELAY || CM == CM_MODULAR
-  volatile stm_word_t *c_lock;          /* Pointer to contented lock (cause of abort) */
-#endif /* CM == CM_DELAY || CM == CM_MODULAR */
-#if CM == CM_BACKOFF
+#ifdef CALL_SITES
+  void *site;                           /* Call site of current barrier */
+  void **r_sites;                       /* Call sites of read set entries (side buffer) */
+  int site_reads;                       /* Are call sites of reads recorded in this attempt? */
+  unsigned int site_countdown;          /* Transactions before recording call sites of reads */
+  void *conflict_site;                  /* Call site of last conflicting access */
+  void *conflict_other_site;            /* Call site of other transaction for last conflict */
+#endif /* CALL_SITES */
+#if CM == CM_DELAY || CM == CM_MODULAR || DESIGN == MODULAR || defined(RETRY_POLICIES)
+  volatile stm_lock_t *c_lock;          /* Pointer to contented lock (cause of abort) */
+#endif /* CM == CM_DELAY || CM == CM_MODULAR || DESIGN == MODULAR || defined(RETRY_POLICIES) */
+#if CM == CM_BACKOFF || DESIGN == MODULAR || defined(RETRY_POLICIES)
   unsigned long backoff;                /* Maximum backoff duration */
   unsigned long seed;                   /* RNG seed */
-#endif /* CM == CM_BACKOFF */
+#endif /* CM == CM_BACKOFF || DESIGN == MODULAR || defined(RETRY_POLICIES) */
 #if CM == CM_MODULAR
   int visible_reads;                    /* Should we use visible reads? */
 #endif /* CM == CM_MODULAR */
-#if CM == CM_MODULAR || defined(TM_STATISTICS)
+#if CM == CM_MODULAR || defined(TM_STATISTICS) || defined(RETRY_POLICIES)
   unsigned int stat_retries;            /* Number of consecutive aborts (retries) */
-#endif /* CM == CM_MODULAR || defined(TM_STATISTICS) */
+#endif /* CM == CM_MODULAR || defined(TM_STATISTICS) || defined(RETRY_POLICIES) */
+#ifdef DEADLINES
+  uint64_t deadline;                    /* Absolute deadline in microseconds (0 = none) */
+  unsigned int deadline_retries;        /* Maximal number of aborts (0 = no limit) */
+  int deadline_action;                  /* Action when deadline is exceeded (STM_DEADLINE_*) */
+  unsigned int deadline_aborts;         /* Number of aborts of current transaction */
+  volatile stm_word_t tag;              /* Tag of current transaction (incremented upon start) */
+  volatile stm_word_t cancel;           /* Tag of the transaction to cancel (requested by another thread) */
+  int no_give_up;                       /* Can the code of the transaction not be skipped? */
+#endif /* DEADLINES */
 #ifdef TM_STATISTICS
   unsigned int stat_commits;            /* Total number of commits (cumulative) */
   unsigned int stat_aborts;             /* Total number of aborts (cumulative) */
   unsigned int stat_retries_max;        /* Maximum number of consecutive aborts (retries) */
+# ifdef RETRY_POLICIES
+  unsigned int stat_retry_policy[RETRY_POLICY_NB]; /* Number of times each retry policy was applied */
+# endif /* RETRY_POLICIES */
 #endif /* TM_STATISTICS */
+#ifdef WRITE_PREDICTION
+  stm_word_t predicted[PREDICT_STRIPES]; /* Stripes prefetched by the current attempt */
+  unsigned int nb_predicted;            /* Number of stripes prefetched by the current attempt */
+  unsigned int stat_predict_prefetches; /* Number of predicted stripes prefetched (upon update commit) */
+  unsigned int stat_predict_hits;       /* Number of predicted stripes actually written */
+#endif /* WRITE_PREDICTION */
+#ifdef LOG_PRESIZE
+  unsigned int log_idle;                /* Commits since logs were last more than a quarter full */
+#endif /* LOG_PRESIZE */
 #ifdef TM_STATISTICS2
   unsigned int stat_aborts_1;           /* Total number of transactions that abort once or more (cumulative) */
   unsigned int stat_aborts_2;           /* Total number of transactions that abort twice or more (cumulative) */
@@ -363,8 +588,11 @@ typedef struct stm_tx {                 /* Transaction descriptor */
 
 /* This structure should be ordered by hot and cold variables */
 typedef struct {
-  volatile stm_word_t locks[LOCK_ARRAY_SIZE] ALIGNED;
+  volatile stm_lock_t locks[LOCK_ARRAY_SIZE] ALIGNED;
   volatile stm_word_t gclock[512 / sizeof(stm_word_t)] ALIGNED;
+#ifdef REGION_SUMMARIES
+  volatile stm_word_t regions[REGION_ARRAY_SIZE] ALIGNED;
+#endif /* REGION_SUMMARIES */
   unsigned int nb_specific;             /* Number of specific slots used (<= MAX_SPECIFIC) */
   unsigned int nb_init_cb;
   cb_entry_t init_cb[MAX_CB];           /* Init thread callbacks */
@@ -382,14 +610,46 @@ typedef struct {
 #ifdef IRREVOCABLE_ENABLED
   volatile stm_word_t irrevocable;      /* Irrevocability status */
 #endif /* IRREVOCABLE_ENABLED */
+#ifdef IRREVOCABLE_BATCH
+  volatile stm_word_t irrevocable_batch; /* Batch window (0 = closed, 1 = open, 2 = open and in use) */
+  volatile stm_word_t irrevocable_pending; /* Number of threads waiting for serial irrevocability */
+  int irrevocable_window;               /* Maximal duration of a batch window (in microseconds) */
+#endif /* IRREVOCABLE_BATCH */
   volatile stm_word_t quiesce;          /* Prevent threads from entering transactions upon quiescence */
   volatile stm_word_t threads_nb;       /* Number of active threads */
   stm_tx_t *threads;                    /* Head of linked list of threads */
+#ifdef COMPACT_LOCKS
+  stm_tx_t *threads_tab[MAX_THREADS];   /* Thread descriptors indexed by lock_id (never cleared) */
+  unsigned char threads_used[MAX_THREADS]; /* Is index in use? */
+# ifdef UNIT_TX
+  stm_tx_t unit_owner;                  /* Owner of locks held by unit transactions (empty) */
+# endif /* UNIT_TX */
+#endif /* COMPACT_LOCKS */
   pthread_mutex_t quiesce_mutex;        /* Mutex to support quiescence */
   pthread_cond_t quiesce_cond;          /* Condition variable to support quiescence */
+#if DESIGN == MODULAR
+  int design;                           /* Design selected at runtime */
+  int cm;                               /* Contention manager selected at runtime */
+#endif /* DESIGN == MODULAR */
 #if CM == CM_MODULAR
   int vr_threshold;                     /* Number of retries before to switch to visible reads. */
 #endif /* CM == CM_MODULAR */
+#ifdef RETRY_POLICIES
+  retry_policy_t retry[RETRY_SETS][RETRY_REASONS]; /* Retry policies (per set and abort reason) */
+#endif /* RETRY_POLICIES */
+#ifdef CDC
+  mod_cdc_ring_t *cdc;                  /* Change stream of committed updates (if any) */
+#endif /* CDC */
+#ifdef WRITE_PREDICTION
+  volatile stm_word_t predict[PREDICT_BLOCKS][PREDICT_STRIPES]; /* Addresses recently written by each atomic block */
+#endif /* WRITE_PREDICTION */
+#ifdef LOG_PRESIZE
+  volatile unsigned int log_hwm[LOG_BLOCKS][2]; /* Largest read/write sets used by each atomic block */
+#endif /* LOG_PRESIZE */
+#ifdef WATCH
+  volatile stm_word_t *watch;           /* Bitmap of watched lock stripes (if any) */
+  void (*watch_notify)(void *, stm_word_t, stm_word_t); /* Called for writes to watched stripes */
+#endif /* WATCH */
 #ifdef CONFLICT_TRACKING
   void (*conflict_cb)(stm_tx_t *, stm_tx_t *);
 #endif /* CONFLICT_TRACKING */
@@ -455,6 +715,14 @@ stm_quiesce_init(void)
   _tinystm.quiesce = 0;
   _tinystm.threads_nb = 0;
   _tinystm.threads = NULL;
+#ifdef COMPACT_LOCKS
+  memset(_tinystm.threads_used, 0, sizeof(_tinystm.threads_used));
+# ifdef UNIT_TX
+  /* LOCK_UNIT resolves to the reserved last index */
+  _tinystm.unit_owner.w_set.entries = NULL;
+  _tinystm.threads_tab[MAX_THREADS - 1] = &_tinystm.unit_owner;
+# endif /* UNIT_TX */
+#endif /* COMPACT_LOCKS */
 }
 
 /*
@@ -478,6 +746,17 @@ stm_quiesce_enter_thread(stm_tx_t *tx)
   PRINT_DEBUG("==> stm_quiesce_enter_thread(%p)\n", tx);
 
   pthread_mutex_lock(&_tinystm.quiesce_mutex);
+#ifdef COMPACT_LOCKS
+  /* Find free index (the last one would be confused with unit locks) */
+  for (tx->lock_id = 0; tx->lock_id < MAX_THREADS - 1 && _tinystm.threads_used[tx->lock_id]; tx->lock_id++)
+    ;
+  if (tx->lock_id == MAX_THREADS - 1) {
+    fprintf(stderr, "Too many threads for compact locks\n");
+    exit(1);
+  }
+  _tinystm.threads_used[tx->lock_id] = 1;
+  _tinystm.threads_tab[tx->lock_id] = tx;
+#endif /* COMPACT_LOCKS */
   /* Add new descriptor at head of list */
   tx->next = _tinystm.threads;
   _tinystm.threads = tx;
@@ -511,6 +790,10 @@ stm_quiesce_exit_thread(stm_tx_t *tx)
     _tinystm.threads = t->next;
   else
     p->next = t->next;
+#ifdef COMPACT_LOCKS
+  /* Keep descriptor in table as other threads may still resolve stale lock values */
+  _tinystm.threads_used[tx->lock_id] = 0;
+#endif /* COMPACT_LOCKS */
   _tinystm.threads_nb--;
   if (_tinystm.quiesce) {
     /* Wake up someone in case other threads are waiting for us */
@@ -650,6 +933,46 @@ stm_quiesce_release(stm_tx_t *tx)
   pthread_mutex_unlock(&_tinystm.quiesce_mutex);
 }
 
+#ifdef IRREVOCABLE_BATCH
+/*
+ * Let the serial-irrevocable transactions that are waiting execute in
+ * the quiescence window of the committing one (called by the owner of
+ * the window, which still holds the irrevocability lock).
+ */
+static INLINE void
+stm_irrevocable_batch(stm_tx_t *tx)
+{
+  struct timeval now, end;
+
+  if (ATOMIC_LOAD(&_tinystm.irrevocable_pending) == 0 || _tinystm.irrevocable_window <= 0)
+    return;
+
+  gettimeofday(&end, NULL);
+  end.tv_usec += _tinystm.irrevocable_window;
+  end.tv_sec += end.tv_usec / 1000000;
+  end.tv_usec %= 1000000;
+
+  /* Open the window */
+  ATOMIC_STORE_REL(&_tinystm.irrevocable_batch, 1);
+  while (1) {
+    if (ATOMIC_LOAD_ACQ(&_tinystm.irrevocable_batch) == 1) {
+      /* No transaction executing in the window: can we close it? */
+      if (ATOMIC_LOAD(&_tinystm.irrevocable_pending) == 0) {
+        if (ATOMIC_CAS_FULL(&_tinystm.irrevocable_batch, 1, 0) != 0)
+          break;
+        continue;
+      }
+      gettimeofday(&now, NULL);
+      if (timercmp(&now, &end, >=) && ATOMIC_CAS_FULL(&_tinystm.irrevocable_batch, 1, 0) != 0)
+        break;
+    }
+#ifdef WAIT_YIELD
+    sched_yield();
+#endif /* WAIT_YIELD */
+  }
+}
+#endif /* IRREVOCABLE_BATCH */
+
 /*
  * Reset clock and timestamps
  */
@@ -661,7 +984,7 @@ rollover_clock(void *arg)
   /* Reset clock */
   CLOCK = 0;
   /* Reset timestamps */
-  memset((void *)_tinystm.locks, 0, LOCK_ARRAY_SIZE * sizeof(stm_word_t));
+  memset((void *)_tinystm.locks, 0, LOCK_ARRAY_SIZE * sizeof(stm_lock_t));
 # ifdef EPOCH_GC
   /* Reset GC */
   gc_reset();
@@ -672,7 +995,7 @@ rollover_clock(void *arg)
  * Check if stripe has been read previously.
  */
 static INLINE r_entry_t *
-stm_has_read(stm_tx_t *tx, volatile stm_word_t *lock)
+stm_has_read(stm_tx_t *tx, volatile stm_lock_t *lock)
 {
   r_entry_t *r;
   int i;
@@ -694,6 +1017,81 @@ stm_has_read(stm_tx_t *tx, volatile stm_word_t *lock)
   return NULL;
 }
 
+#ifdef REGION_SUMMARIES
+/*
+ * Check if a region is in the region read set.
+ */
+static INLINE rg_entry_t *
+stm_has_region(stm_tx_t *tx, volatile stm_word_t *region)
+{
+  rg_entry_t *e;
+  int i;
+
+  /* Consecutive reads usually hit the same region */
+  e = tx->rg_set.last;
+  if (likely(e != NULL && e->region == region))
+    return e;
+  e = tx->rg_set.entries;
+  for (i = tx->rg_set.nb_entries; i > 0; i--, e++) {
+    if (e->region == region) {
+      tx->rg_set.last = e;
+      return e;
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Validate the region read set.
+ */
+static INLINE int
+stm_validate_regions(stm_tx_t *tx)
+{
+  rg_entry_t *e;
+  int i;
+
+  e = tx->rg_set.entries;
+  for (i = tx->rg_set.nb_entries; i > 0; i--, e++) {
+    if (ATOMIC_LOAD(e->region) != e->version) {
+      /* Region has been written: use stripes upon retry */
+      tx->rg_set.hot = 1;
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/*
+ * Increment the counters of the regions written by the transaction
+ * (must be done before getting the commit timestamp).
+ */
+static INLINE void
+stm_update_regions(stm_tx_t *tx)
+{
+  w_entry_t *w;
+  rg_entry_t *e;
+  volatile stm_word_t *region, *prev;
+  stm_word_t v;
+  int i;
+
+  prev = NULL;
+  w = tx->w_set.entries;
+  for (i = tx->w_set.nb_entries; i > 0; i--, w++) {
+    if (w->mask == 0)
+      continue;
+    region = GET_REGION(w->addr);
+    if (region == prev)
+      continue;
+    prev = region;
+    v = ATOMIC_FETCH_INC_FULL(region);
+    if ((e = stm_has_region(tx, region)) != NULL) {
+      /* Account for our own update (fails if another writer came first) */
+      e->version = (e->version == v ? v + 1 : v);
+    }
+  }
+}
+#endif /* REGION_SUMMARIES */
+
 /*
  * Check if address has been written previously.
  */
@@ -740,8 +1138,43 @@ stm_allocate_rs_entries(stm_tx_t *tx, int extend)
     /* Allocate read set */
     tx->r_set.entries = (r_entry_t *)xmalloc_aligned(tx->r_set.size * sizeof(r_entry_t));
   }
+#ifdef CALL_SITES
+  tx->r_sites = (void **)xrealloc(tx->r_sites, tx->r_set.size * sizeof(void *));
+#endif /* CALL_SITES */
 }
 
+#ifdef CALL_SITES
+/*
+ * Record the call site of a read set entry (if sampled).
+ */
+static INLINE void
+stm_site_read(stm_tx_t *tx, r_entry_t *r)
+{
+  if (unlikely(tx->site_reads))
+    tx->r_sites[r - tx->r_set.entries] = tx->site;
+}
+
+/*
+ * Return the call site of a read set entry (NULL if not sampled).
+ */
+static INLINE void *
+stm_site_of_read(stm_tx_t *tx, r_entry_t *r)
+{
+  return (tx->site_reads ? tx->r_sites[r - tx->r_set.entries] : NULL);
+}
+
+/*
+ * Remember the call sites of a conflict with the owner of a write set
+ * entry (for the conflict callback).
+ */
+static INLINE void
+stm_site_conflict(stm_tx_t *tx, void *site, w_entry_t *w)
+{
+  tx->conflict_site = site;
+  tx->conflict_other_site = w->site;
+}
+#endif /* CALL_SITES */
+
 /*
  * (Re)allocate write set entries.
  */
@@ -775,6 +1208,10 @@ stm_allocate_ws_entries(stm_tx_t *tx, int extend)
   }
   /* Ensure that memory is aligned. */
   assert((((stm_word_t)tx->w_set.entries) & OWNED_MASK) == 0);
+#ifdef COMPACT_LOCKS
+  /* Never extended beyond the limit (see stm_ws_overflow()) */
+  assert(tx->w_set.size <= LOCK_ENTRY_MAX);
+#endif /* COMPACT_LOCKS */
 
 #if CM == CM_MODULAR || defined(CONFLICT_TRACKING)
   /* Initialize fields */
@@ -783,6 +1220,188 @@ stm_allocate_ws_entries(stm_tx_t *tx, int extend)
 #endif /* CM == CM_MODULAR || defined(CONFLICT_TRACKING) */
 }
 
+#ifdef COMPACT_LOCKS
+/*
+ * Handle a full write set that cannot be extended (owned locks index
+ * entries with LOCK_ENTRY_BITS bits).  The transaction restarts in
+ * serial irrevocable mode, in which no other transaction executes and
+ * it cannot abort, so that further writes to stripes that it does not
+ * own can be performed in place without a write set entry.  Return 1
+ * if the write has been performed (0 if the transaction restarts).
+ */
+static NOINLINE int
+stm_ws_overflow(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t value, stm_word_t mask)
+{
+# ifdef IRREVOCABLE_ENABLED
+  if (tx->irrevocable == 0x0B) {
+    /* Serial irrevocable */
+    if (mask == ~(stm_word_t)0)
+      ATOMIC_STORE(addr, value);
+    else if (mask != 0)
+      ATOMIC_STORE(addr, (ATOMIC_LOAD(addr) & ~mask) | (value & mask));
+    return 1;
+  }
+  if ((tx->irrevocable & 0x07) != 3) {
+    /* Taken into account by int_stm_prepare() */
+    tx->irrevocable = 1 | 0x08;
+    stm_rollback(tx, STM_ABORT_EXTEND_WS);
+    return 0;
+  }
+# endif /* IRREVOCABLE_ENABLED */
+  /* Irrevocable transactions that other threads execute concurrently
+   * with cannot restart nor write in place */
+  fprintf(stderr, "Write set exceeds %d entries (maximum with compact locks)\n", LOCK_ENTRY_MAX);
+  exit(1);
+}
+#endif /* COMPACT_LOCKS */
+
+#ifdef CDC
+/*
+ * Append the write set of a committing transaction to the change stream
+ * (called after validation, while all locks are still held, so that
+ * conflicting transactions appear in commit order).
+ */
+static INLINE void
+stm_cdc_append(stm_tx_t *tx, stm_word_t t)
+{
+  mod_cdc_ring_t *ring;
+  mod_cdc_record_t *r;
+  w_entry_t *w;
+  stm_word_t pos, n;
+  int i;
+
+  ring = _tinystm.cdc;
+  if (ring == NULL)
+    return;
+
+  n = 0;
+  w = tx->w_set.entries;
+  for (i = tx->w_set.nb_entries; i > 0; i--, w++) {
+    if (w->mask != 0)
+      n++;
+  }
+  if (n == 0)
+    return;
+
+  /* Reserve records (never wait for the consumer) */
+  do {
+    pos = ATOMIC_LOAD(&ring->tail);
+    if (pos + n - ATOMIC_LOAD(&ring->head) > ring->size) {
+      ATOMIC_FETCH_INC_FULL(&ring->lost);
+      return;
+    }
+  } while (ATOMIC_CAS_FULL(&ring->tail, pos, pos + n) == 0);
+
+  w = tx->w_set.entries;
+  for (i = tx->w_set.nb_entries; i > 0; i--, w++) {
+    if (w->mask == 0)
+      continue;
+    r = &ring->records[pos & (ring->size - 1)];
+    r->ts = t;
+    r->left = --n;
+    r->offset = (stm_word_t)w->addr - ring->base;
+    r->value = w->value;
+    r->mask = w->mask;
+    /* Publish record */
+    ATOMIC_STORE_REL(&r->seq, ++pos);
+  }
+}
+#endif /* CDC */
+
+#ifdef NT_WRITE_BACK
+/*
+ * Install the new values of a large write set without polluting the
+ * caches (called with all locks held; the stores are complete upon
+ * return so that locks can be released).  Experimental (see Makefile).
+ */
+static NOINLINE void
+stm_write_back_nt(stm_tx_t *tx)
+{
+  w_entry_t *w, *end;
+
+  w = tx->w_set.entries;
+  end = w + tx->w_set.nb_entries;
+  for (; w < end; w++) {
+    if (w->mask == ~(stm_word_t)0) {
+# if defined(__SSE2__) && defined(__x86_64__)
+      /* Vector stores for runs of aligned adjacent words */
+#  ifdef __AVX__
+      if ((((stm_word_t)w->addr) & 31) == 0 && w + 3 < end &&
+          w[1].addr == w->addr + 1 && w[2].addr == w->addr + 2 && w[3].addr == w->addr + 3 &&
+          (w[1].mask & w[2].mask & w[3].mask) == ~(stm_word_t)0) {
+        _mm256_stream_si256((__m256i *)w->addr, _mm256_set_epi64x((long long)w[3].value, (long long)w[2].value, (long long)w[1].value, (long long)w->value));
+        w += 3;
+        continue;
+      }
+#  endif /* __AVX__ */
+      if ((((stm_word_t)w->addr) & 15) == 0 && w + 1 < end &&
+          w[1].addr == w->addr + 1 && w[1].mask == ~(stm_word_t)0) {
+        _mm_stream_si128((__m128i *)w->addr, _mm_set_epi64x((long long)w[1].value, (long long)w->value));
+        w++;
+        continue;
+      }
+      _mm_stream_si64((long long *)w->addr, (long long)w->value);
+# elif defined(__SSE2__)
+      _mm_stream_si32((int *)w->addr, (int)w->value);
+# else /* ! __SSE2__ */
+      ATOMIC_STORE(w->addr, w->value);
+# endif /* ! __SSE2__ */
+    } else if (w->mask != 0) {
+      ATOMIC_STORE(w->addr, (ATOMIC_LOAD(w->addr) & ~w->mask) | (w->value & w->mask));
+    }
+  }
+# ifdef __SSE2__
+  /* Non-temporal stores are weakly ordered: drain them before the locks
+   * are released */
+  _mm_sfence();
+# endif /* __SSE2__ */
+}
+#endif /* NT_WRITE_BACK */
+
+#ifdef WATCH
+/*
+ * Report the watched lock stripes written by a committed transaction
+ * (called once the new values are visible and the locks released).  Consecutive writes to the same
+ * stripe are coalesced into a single notification carrying a bitmask
+ * of the words written (the last bit also covers any further words of
+ * the stripe).
+ */
+static INLINE void
+stm_watch_notify(stm_tx_t *tx, stm_word_t t)
+{
+  volatile stm_word_t *bitmap;
+  w_entry_t *w;
+  stm_word_t idx, base, cur, bits, off;
+  int i;
+
+  bitmap = _tinystm.watch;
+  if (likely(bitmap == NULL))
+    return;
+
+  cur = bits = 0;
+  w = tx->w_set.entries;
+  for (i = tx->w_set.nb_entries; i > 0; i--, w++) {
+    if (w->mask == 0)
+      continue;
+    idx = LOCK_IDX(w->addr);
+    if (likely(((ATOMIC_LOAD(&bitmap[idx / (sizeof(stm_word_t) * 8)]) >> (idx % (sizeof(stm_word_t) * 8))) & 1) == 0))
+      continue;
+    base = (stm_word_t)w->addr & ~(((stm_word_t)1 << LOCK_SHIFT) - 1);
+    if (base != cur) {
+      if (bits != 0)
+        _tinystm.watch_notify((void *)cur, bits, t);
+      cur = base;
+      bits = 0;
+    }
+    off = ((stm_word_t)w->addr - base) / sizeof(stm_word_t);
+    if (off >= sizeof(stm_word_t) * 8)
+      off = sizeof(stm_word_t) * 8 - 1;
+    bits |= (stm_word_t)1 << off;
+  }
+  if (bits != 0)
+    _tinystm.watch_notify((void *)cur, bits, t);
+}
+#endif /* WATCH */
 
 #if DESIGN == WRITE_BACK_ETL
 # include "stm_wbetl.h"
@@ -859,10 +1478,10 @@ stm_drop(stm_tx_t *tx)
   if (i > 0) {
     w = tx->w_set.entries;
     for (; i > 0; i--, w++) {
-      l = ATOMIC_LOAD_ACQ(w->lock);
+      l = LOCK_LOAD_ACQ(w->lock);
       if (LOCK_GET_OWNED(l) && (w_entry_t *)LOCK_GET_ADDR(l) == w) {
         /* Drop using CAS */
-        ATOMIC_CAS_FULL(w->lock, l, LOCK_SET_TIMESTAMP(w->version));
+        LOCK_CAS_FULL(w->lock, l, LOCK_SET_TIMESTAMP(w->version));
         /* If CAS fail, lock has been stolen or already released in case a lock covers multiple addresses */
       }
     }
@@ -876,6 +1495,263 @@ stm_drop(stm_tx_t *tx)
 }
 #endif /* CM == CM_MODULAR */
 
+/*
+ * Allocate scratch memory (private to the transaction, released upon
+ * commit or abort).
+ */
+static NOINLINE void *
+stm_scratch_overflow(stm_tx_t *tx, size_t size)
+{
+  void **b;
+
+  PRINT_DEBUG("==> stm_scratch_overflow(%p[%lu-%lu],%lu)\n", tx, (unsigned long)tx->start, (unsigned long)tx->end, (unsigned long)size);
+
+  if (tx->scratch.base == NULL) {
+    /* First use: allocate arena */
+    tx->scratch.size = (size > SCRATCH_SIZE ? size : SCRATCH_SIZE);
+    tx->scratch.base = (uint8_t *)xmalloc_aligned(tx->scratch.size);
+    tx->scratch.top = size;
+    return tx->scratch.base;
+  }
+  /* Arena is full: chain a block that will be freed upon reset */
+  b = (void **)xmalloc(16 + size);
+  *b = tx->scratch.overflow;
+  tx->scratch.overflow = b;
+  tx->scratch.overflow_size += size;
+  return (uint8_t *)b + 16;
+}
+
+static INLINE void *
+int_stm_scratch_alloc(stm_tx_t *tx, size_t size)
+{
+  void *addr;
+
+  assert(IS_ACTIVE(tx->status));
+
+  /* Keep 16-byte alignment */
+  size = (size + 15) & ~(size_t)15;
+  if (unlikely(tx->scratch.size - tx->scratch.top < size))
+    return stm_scratch_overflow(tx, size);
+  addr = tx->scratch.base + tx->scratch.top;
+  tx->scratch.top += size;
+  return addr;
+}
+
+/*
+ * Release all scratch memory of the transaction.
+ */
+static INLINE void
+stm_scratch_reset(stm_tx_t *tx)
+{
+  void **b;
+  size_t size;
+
+  tx->scratch.top = 0;
+  if (unlikely(tx->scratch.overflow != NULL)) {
+    do {
+      b = (void **)tx->scratch.overflow;
+      tx->scratch.overflow = *b;
+      xfree(b);
+    } while (tx->scratch.overflow != NULL);
+    /* Grow arena so that the next transaction fits in */
+    size = tx->scratch.size + tx->scratch.overflow_size;
+    while (tx->scratch.size < size)
+      tx->scratch.size *= 2;
+    tx->scratch.overflow_size = 0;
+    xfree(tx->scratch.base);
+    tx->scratch.base = (uint8_t *)xmalloc_aligned(tx->scratch.size);
+  }
+}
+
+/*
+ * Check if an address belongs to scratch memory of the transaction.
+ * Only the arena is considered; overflow blocks use regular barriers.
+ */
+static INLINE int
+stm_scratch_contains(stm_tx_t *tx, const volatile void *addr)
+{
+  return (uintptr_t)addr - (uintptr_t)tx->scratch.base < tx->scratch.top;
+}
+
+#ifdef WRITE_PREDICTION
+/*
+ * Prefetch the locks and data of the stripes that the atomic block has
+ * written in its last execution.
+ */
+static INLINE void
+stm_predict_prefetch(stm_tx_t *tx)
+{
+  volatile stm_word_t *p;
+  stm_word_t a;
+  int i;
+# if DESIGN == WRITE_BACK_CTL
+  int j;
+# endif /* DESIGN == WRITE_BACK_CTL */
+
+  p = _tinystm.predict[tx->attr.id & (PREDICT_BLOCKS - 1)];
+  for (i = 0; i < PREDICT_STRIPES && (a = p[i]) != 0; i++) {
+    PREFETCHW(GET_LOCK(a));
+    PREFETCHW(a);
+    tx->predicted[i] = a;
+# if DESIGN == WRITE_BACK_CTL
+    /* Pre-validate: let a committing transaction finish writing back the
+     * stripe instead of reading a version that is about to change */
+    for (j = PREDICT_WAIT; j > 0 && LOCK_GET_OWNED(LOCK_LOAD(GET_LOCK(a))); j--)
+      ;
+# endif /* DESIGN == WRITE_BACK_CTL */
+  }
+  tx->nb_predicted = i;
+}
+
+/*
+ * Remember the first stripes written by a committed transaction and
+ * count how many of the stripes prefetched by its last attempt were
+ * written (prefetches and hits are both counted here, so that retries
+ * and read-only transactions do not skew the hit rate).
+ */
+static INLINE void
+stm_predict_learn(stm_tx_t *tx)
+{
+  volatile stm_word_t *p;
+  stm_word_t s[PREDICT_STRIPES];
+  w_entry_t *w;
+  int i, j, n;
+
+  /* One address per stripe */
+  n = 0;
+  w = tx->w_set.entries;
+  for (i = tx->w_set.nb_entries; i > 0 && n < PREDICT_STRIPES; i--, w++) {
+    if (w->mask == 0)
+      continue;
+    for (j = 0; j < n && LOCK_IDX(s[j]) != LOCK_IDX(w->addr); j++)
+      ;
+    if (j == n)
+      s[n++] = (stm_word_t)w->addr;
+  }
+
+  tx->stat_predict_prefetches += tx->nb_predicted;
+  for (i = 0; i < (int)tx->nb_predicted; i++) {
+    for (j = 0; j < n && LOCK_IDX(s[j]) != LOCK_IDX(tx->predicted[i]); j++)
+      ;
+    if (j < n)
+      tx->stat_predict_hits++;
+  }
+
+  /* Only write the shared entries if the prediction changed (same
+   * stripes, in any order) */
+  p = _tinystm.predict[tx->attr.id & (PREDICT_BLOCKS - 1)];
+  for (i = 0; i < PREDICT_STRIPES && p[i] != 0; i++) {
+    for (j = 0; j < n && LOCK_IDX(s[j]) != LOCK_IDX(p[i]); j++)
+      ;
+    if (j == n)
+      break;
+  }
+  if (i == n && (i == PREDICT_STRIPES || p[i] == 0))
+    return;
+  for (i = 0; i < PREDICT_STRIPES; i++) {
+    if (p[i] != (i < n ? s[i] : 0))
+      p[i] = (i < n ? s[i] : 0);
+  }
+}
+#endif /* WRITE_PREDICTION */
+
+#ifdef LOG_PRESIZE
+/*
+ * Remember the size of the read/write sets used by the atomic block
+ * (upon commit or abort).  Peaks are shared by all threads (races are
+ * benign, they are only hints).
+ */
+static INLINE void
+stm_log_record(stm_tx_t *tx)
+{
+  volatile unsigned int *h;
+
+  h = _tinystm.log_hwm[tx->attr.id & (LOG_BLOCKS - 1)];
+  if (h[0] < tx->r_set.nb_entries)
+    h[0] = tx->r_set.nb_entries;
+  if (h[1] < tx->w_set.nb_entries)
+    h[1] = tx->w_set.nb_entries;
+}
+
+/*
+ * Touch the pages of fresh log memory (contents are left unchanged).
+ */
+static INLINE void
+stm_log_prefault(void *base, size_t size)
+{
+  volatile char *p;
+
+  for (p = (volatile char *)base; p < (volatile char *)base + size; p += LOG_PAGE_SIZE)
+    *p = *p;
+}
+
+/*
+ * Reallocate the read/write sets (transaction must be inactive).
+ */
+static NOINLINE void
+stm_log_resize(stm_tx_t *tx, volatile unsigned int *h)
+{
+  unsigned int r, w, hr, hw;
+
+  r = tx->r_set.size;
+  w = tx->w_set.size;
+  if (tx->log_idle >= LOG_SHRINK_PERIOD) {
+    /* Logs have been mostly empty for a long time: shrink them (peaks
+     * are kept, the logs grow again before a large block executes) */
+    tx->log_idle = 0;
+    if (r > RW_SET_SIZE)
+      r /= 2;
+    if (w > RW_SET_SIZE)
+      w /= 2;
+  }
+  /* Make room for the largest execution of the atomic block */
+  hr = h[0];
+  hw = h[1];
+  while (r <= hr)
+    r *= 2;
+  while (w <= hw)
+    w *= 2;
+#ifdef COMPACT_LOCKS
+  while (w > LOCK_ENTRY_MAX)
+    w /= 2;
+#endif /* COMPACT_LOCKS */
+
+  PRINT_DEBUG("==> stm_log_resize(%p,%u->%u,%u->%u)\n", tx, tx->r_set.size, r, tx->w_set.size, w);
+
+  if (r != tx->r_set.size) {
+    xfree(tx->r_set.entries);
+    tx->r_set.size = r;
+    stm_allocate_rs_entries(tx, 0);
+    stm_log_prefault(tx->r_set.entries, hr * sizeof(r_entry_t));
+  }
+  if (w != tx->w_set.size) {
+#ifdef EPOCH_GC
+    /* Other threads may still access entries through stale lock values */
+    gc_free(tx->w_set.entries, GET_CLOCK);
+#else /* ! EPOCH_GC */
+    xfree(tx->w_set.entries);
+#endif /* ! EPOCH_GC */
+    tx->w_set.size = w;
+    stm_allocate_ws_entries(tx, 0);
+    stm_log_prefault(tx->w_set.entries, hw * sizeof(w_entry_t));
+  }
+}
+
+/*
+ * Size the read/write sets before the first execution of an atomic
+ * block.
+ */
+static INLINE void
+stm_log_presize(stm_tx_t *tx)
+{
+  volatile unsigned int *h;
+
+  h = _tinystm.log_hwm[tx->attr.id & (LOG_BLOCKS - 1)];
+  if (unlikely(h[0] >= tx->r_set.size || h[1] >= tx->w_set.size || tx->log_idle >= LOG_SHRINK_PERIOD))
+    stm_log_resize(tx, h);
+}
+#endif /* LOG_PRESIZE */
+
 /*
  * Initialize the transaction descriptor before start or restart.
  */
@@ -899,6 +1775,16 @@ int_stm_prepare(stm_tx_t *tx)
 #endif /* USE_BLOOM_FILTER */
   tx->w_set.nb_entries = 0;
   tx->r_set.nb_entries = 0;
+#ifdef REGION_SUMMARIES
+  /* Fall back to stripes after a region failed validation */
+  tx->rg_set.nb_entries = 0;
+  tx->rg_set.size = (tx->rg_set.hot ? 0 : REGION_SET_SIZE);
+  tx->rg_set.last = NULL;
+#endif /* REGION_SUMMARIES */
+
+#ifdef WRITE_PREDICTION
+  stm_predict_prefetch(tx);
+#endif /* WRITE_PREDICTION */
 
  start:
   /* Start timestamp */
@@ -932,16 +1818,129 @@ int_stm_prepare(stm_tx_t *tx)
   stm_check_quiesce(tx);
 }
 
+#ifdef DEADLINES
+/*
+ * Check if the deadline of the transaction has been exceeded.
+ */
+static INLINE int
+stm_deadline_exceeded(stm_tx_t *tx)
+{
+  struct timeval now;
+
+  if (tx->deadline_retries != 0 && tx->deadline_aborts >= tx->deadline_retries)
+    return 1;
+  if (tx->deadline == 0)
+    return 0;
+  gettimeofday(&now, NULL);
+  return (uint64_t)now.tv_sec * 1000000 + now.tv_usec >= tx->deadline;
+}
+
+/*
+ * Check if cancellation has been requested (irrevocable transactions
+ * cannot be cancelled).
+ */
+static INLINE int
+stm_cancelled(stm_tx_t *tx)
+{
+# ifdef IRREVOCABLE_ENABLED
+  return tx->cancel == tx->tag && (tx->irrevocable & 0x07) != 3;
+# else /* ! IRREVOCABLE_ENABLED */
+  return tx->cancel == tx->tag;
+# endif /* ! IRREVOCABLE_ENABLED */
+}
+#endif /* DEADLINES */
+
+#if CM == CM_BACKOFF || DESIGN == MODULAR || defined(RETRY_POLICIES)
+/*
+ * Randomized exponential backoff (the range doubles up to max).
+ */
+static INLINE void
+stm_backoff(stm_tx_t *tx, unsigned long max)
+{
+  unsigned long wait;
+  volatile int j;
+
+  /* Simple RNG (good enough for backoff) */
+  tx->seed ^= (tx->seed << 17);
+  tx->seed ^= (tx->seed >> 13);
+  tx->seed ^= (tx->seed << 5);
+  wait = tx->seed % tx->backoff;
+  for (j = 0; j < wait; j++) {
+    /* Do nothing */
+  }
+  if (tx->backoff < max)
+    tx->backoff <<= 1;
+}
+#endif /* CM == CM_BACKOFF || DESIGN == MODULAR || defined(RETRY_POLICIES) */
+
+#ifdef RETRY_POLICIES
+/*
+ * Apply the retry policy registered for the abort reason (in the set
+ * selected by the transaction attributes).  Return 0 if the default
+ * contention management should be used instead.
+ */
+static INLINE int
+stm_retry_policy(stm_tx_t *tx, unsigned int reason)
+{
+  retry_policy_t *rp;
+
+  rp = &_tinystm.retry[tx->attr.retry_policy][RETRY_REASON(reason)];
+  switch (rp->policy) {
+    case STM_RETRY_IMMEDIATE:
+      break;
+    case STM_RETRY_WAIT_LOCK:
+      /* Wait until contented lock is free (if known) */
+      if (tx->c_lock != NULL) {
+        while (LOCK_GET_OWNED(LOCK_LOAD(tx->c_lock))) {
+# ifdef DEADLINES
+          if (tx->deadline != 0 && stm_deadline_exceeded(tx))
+            break;
+# endif /* DEADLINES */
+# ifdef WAIT_YIELD
+          sched_yield();
+# endif /* WAIT_YIELD */
+        }
+      }
+      break;
+    case STM_RETRY_BACKOFF:
+      /* Randomized exponential backoff (argument is the maximum, if any) */
+      stm_backoff(tx, (rp->arg != 0 && rp->arg < MAX_BACKOFF ? rp->arg : MAX_BACKOFF));
+      break;
+# if CM == CM_MODULAR
+    case STM_RETRY_VISIBLE_READS:
+      /* Taken into account by int_stm_prepare() */
+      tx->attr.visible_reads = 1;
+      break;
+# endif /* CM == CM_MODULAR */
+# ifdef IRREVOCABLE_ENABLED
+    case STM_RETRY_IRREVOCABLE:
+      /* Argument is the number of attempts before becoming irrevocable */
+      if (tx->stat_retries < rp->arg || tx->attr.no_retry || (reason & STM_ABORT_NO_RETRY) == STM_ABORT_NO_RETRY)
+        return 0;
+      /* Taken into account by int_stm_prepare() (keep serial requests) */
+      tx->irrevocable = 1 | (tx->irrevocable & 0x08);
+      break;
+# endif /* IRREVOCABLE_ENABLED */
+    default:
+      return 0;
+  }
+  tx->c_lock = NULL;
+# ifdef TM_STATISTICS
+  tx->stat_retry_policy[rp->policy]++;
+# endif /* TM_STATISTICS */
+  return 1;
+}
+#endif /* RETRY_POLICIES */
+
 /*
  * Rollback transaction.
  */
 static NOINLINE void
 stm_rollback(stm_tx_t *tx, unsigned int reason)
 {
-#if CM == CM_BACKOFF
-  unsigned long wait;
-  volatile int j;
-#endif /* CM == CM_BACKOFF */
+#ifdef DEADLINES
+  int deadline = 0;
+#endif /* DEADLINES */
 #if CM == CM_MODULAR
   stm_word_t t;
 #endif /* CM == CM_MODULAR */
@@ -974,9 +1973,9 @@ stm_rollback(stm_tx_t *tx, unsigned int reason)
 #elif DESIGN == WRITE_THROUGH
   stm_wt_rollback(tx);
 #elif DESIGN == MODULAR
-  if (tx->attr.id == WRITE_BACK_CTL)
+  if (tx->design == WRITE_BACK_CTL)
     stm_wbctl_rollback(tx);
-  else if (tx->attr.id == WRITE_THROUGH)
+  else if (tx->design == WRITE_THROUGH)
     stm_wt_rollback(tx);
   else
     stm_wbetl_rollback(tx);
@@ -986,9 +1985,9 @@ stm_rollback(stm_tx_t *tx, unsigned int reason)
  dropped:
 #endif /* CM == CM_MODULAR */
 
-#if CM == CM_MODULAR || defined(TM_STATISTICS)
+#if CM == CM_MODULAR || defined(TM_STATISTICS) || defined(RETRY_POLICIES)
   tx->stat_retries++;
-#endif /* CM == CM_MODULAR || defined(TM_STATISTICS) */
+#endif /* CM == CM_MODULAR || defined(TM_STATISTICS) || defined(RETRY_POLICIES) */
 #ifdef TM_STATISTICS
   tx->stat_aborts++;
   if (tx->stat_retries_max < tx->stat_retries)
@@ -1003,56 +2002,125 @@ stm_rollback(stm_tx_t *tx, unsigned int reason)
     tx->stat_aborts_2++;
 #endif /* TM_STATISTICS2 */
 
+#ifdef LOG_PRESIZE
+  stm_log_record(tx);
+#endif /* LOG_PRESIZE */
+
   /* Set status to ABORTED */
   SET_STATUS(tx->status, TX_ABORTED);
 
   /* Abort for extending the write set */
+#ifdef COMPACT_LOCKS
+  if (unlikely(reason == STM_ABORT_EXTEND_WS) && WS_EXTENSIBLE(tx)) {
+#else /* ! COMPACT_LOCKS */
   if (unlikely(reason == STM_ABORT_EXTEND_WS)) {
+#endif /* ! COMPACT_LOCKS */
     stm_allocate_ws_entries(tx, 1);
   }
 
   /* Reset nesting level */
   tx->nesting = 1;
 
+#ifdef DEADLINES
+  /* Give up or become irrevocable if cancelled or deadline exceeded */
+  tx->deadline_aborts++;
+  if (unlikely(reason == STM_ABORT_CANCELLED)) {
+    tx->cancel = 0;
+    deadline = 1;
+  } else if (unlikely(stm_deadline_exceeded(tx)) && (reason & STM_ABORT_NO_RETRY) != STM_ABORT_NO_RETRY) {
+    if (tx->deadline_action == STM_DEADLINE_IRREVOCABLE) {
+      deadline = 2;
+    } else {
+      reason = STM_ABORT_DEADLINE;
+      deadline = 1;
+    }
+  }
+  if (unlikely(deadline == 1 && tx->no_give_up)) {
+    /* Code cannot be skipped (e.g., compiled without cancellation support) */
+    deadline = 2;
+  }
+  if (unlikely(deadline == 2)) {
+# ifdef IRREVOCABLE_ENABLED
+    /* Taken into account by int_stm_prepare() (keep serial requests) */
+    tx->irrevocable = 1 | (tx->irrevocable & 0x08);
+# else /* ! IRREVOCABLE_ENABLED */
+    /* Retry as usual */
+    deadline = 0;
+# endif /* ! IRREVOCABLE_ENABLED */
+  }
+#endif /* DEADLINES */
+
   /* Callbacks */
+  tx->abort_reason = reason;
   if (likely(_tinystm.nb_abort_cb != 0)) {
     unsigned int cb;
     for (cb = 0; cb < _tinystm.nb_abort_cb; cb++)
       _tinystm.abort_cb[cb].f(_tinystm.abort_cb[cb].arg);
   }
 
-#if CM == CM_BACKOFF
-  /* Simple RNG (good enough for backoff) */
-  tx->seed ^= (tx->seed << 17);
-  tx->seed ^= (tx->seed >> 13);
-  tx->seed ^= (tx->seed << 5);
-  wait = tx->seed % tx->backoff;
-  for (j = 0; j < wait; j++) {
-    /* Do nothing */
+  /* Release scratch memory */
+  stm_scratch_reset(tx);
+
+#ifdef CALL_SITES
+  /* Record call sites of reads upon retry */
+  tx->site_reads = 1;
+#endif /* CALL_SITES */
+
+#ifdef DEADLINES
+  if (unlikely(deadline != 0)) {
+# if CM == CM_DELAY || CM == CM_MODULAR || DESIGN == MODULAR || defined(RETRY_POLICIES)
+    tx->c_lock = NULL;
+# endif /* CM == CM_DELAY || CM == CM_MODULAR || DESIGN == MODULAR || defined(RETRY_POLICIES) */
+    goto retry;
   }
-  if (tx->backoff < MAX_BACKOFF)
-    tx->backoff <<= 1;
-#endif /* CM == CM_BACKOFF */
+#endif /* DEADLINES */
 
-#if CM == CM_DELAY || CM == CM_MODULAR
+#ifdef RETRY_POLICIES
+  if (stm_retry_policy(tx, reason))
+    goto retry;
+#endif /* RETRY_POLICIES */
+
+#if CM == CM_BACKOFF || DESIGN == MODULAR || defined(RETRY_POLICIES)
+  if (CM_ACTIVE(CM_BACKOFF))
+    stm_backoff(tx, MAX_BACKOFF);
+#endif /* CM == CM_BACKOFF || DESIGN == MODULAR || defined(RETRY_POLICIES) */
+
+#if CM == CM_DELAY || CM == CM_MODULAR || DESIGN == MODULAR || defined(RETRY_POLICIES)
   /* Wait until contented lock is free */
   if (tx->c_lock != NULL) {
-    /* Busy waiting (yielding is expensive) */
-    while (LOCK_GET_OWNED(ATOMIC_LOAD(tx->c_lock))) {
+    if (CM_ACTIVE(CM_DELAY) || CM_ACTIVE(CM_MODULAR)) {
+      /* Busy waiting (yielding is expensive) */
+      while (LOCK_GET_OWNED(LOCK_LOAD(tx->c_lock))) {
+# ifdef DEADLINES
+        if (tx->deadline != 0 && stm_deadline_exceeded(tx))
+          break;
+# endif /* DEADLINES */
 # ifdef WAIT_YIELD
-      sched_yield();
+        sched_yield();
 # endif /* WAIT_YIELD */
+      }
     }
     tx->c_lock = NULL;
   }
-#endif /* CM == CM_DELAY || CM == CM_MODULAR */
+#endif /* CM == CM_DELAY || CM == CM_MODULAR || DESIGN == MODULAR || defined(RETRY_POLICIES) */
 
+#if defined(RETRY_POLICIES) || defined(DEADLINES)
+ retry:
+#endif /* defined(RETRY_POLICIES) || defined(DEADLINES) */
   /* Don't prepare a new transaction if no retry. */
   if (tx->attr.no_retry || (reason & STM_ABORT_NO_RETRY) == STM_ABORT_NO_RETRY) {
     tx->nesting = 0;
     return;
   }
 
+#ifdef DEADLINES
+  if (unlikely(deadline == 1)) {
+    /* Jump back to transaction start without execution path (give up) */
+    tx->nesting = 0;
+    LONGJMP(tx->env, reason | GIVE_UP_PATH);
+  }
+#endif /* DEADLINES */
+
   /* Reset field to restart transaction */
   int_stm_prepare(tx);
 
@@ -1089,6 +2157,13 @@ stm_write(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t value, stm_word_t
   assert(IS_ACTIVE(tx->status));
 #endif /* CM != CM_MODULAR */
 
+#ifdef DEADLINES
+  if (unlikely(stm_cancelled(tx))) {
+    stm_rollback(tx, STM_ABORT_CANCELLED);
+    return NULL;
+  }
+#endif /* DEADLINES */
+
 #ifdef DEBUG
   /* Check consistency with read_only attribute. */
   assert(!tx->attr.read_only);
@@ -1101,9 +2176,9 @@ stm_write(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t value, stm_word_t
 #elif DESIGN == WRITE_THROUGH
   w = stm_wt_write(tx, addr, value, mask);
 #elif DESIGN == MODULAR
-  if (tx->attr.id == WRITE_BACK_CTL)
+  if (tx->design == WRITE_BACK_CTL)
     w = stm_wbctl_write(tx, addr, value, mask);
-  else if (tx->attr.id == WRITE_THROUGH)
+  else if (tx->design == WRITE_THROUGH)
     w = stm_wt_write(tx, addr, value, mask);
   else
     w = stm_wbetl_write(tx, addr, value, mask);
@@ -1112,17 +2187,35 @@ stm_write(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t value, stm_word_t
   return w;
 }
 
+/*
+ * Specialized accesses, used when the compiler knows that the address has
+ * already been read (RaR, WaR) or written (RaW, WaW) by the transaction,
+ * or that it will be written (RfW).
+ */
 static INLINE stm_word_t
 int_stm_RaR(stm_tx_t *tx, volatile stm_word_t *addr)
 {
   stm_word_t value;
+#ifdef DEADLINES
+  if (unlikely(stm_cancelled(tx))) {
+    stm_rollback(tx, STM_ABORT_CANCELLED);
+    return 0;
+  }
+#endif /* DEADLINES */
 #if DESIGN == WRITE_BACK_ETL
   value = stm_wbetl_RaR(tx, addr);
 #elif DESIGN == WRITE_BACK_CTL
   value = stm_wbctl_RaR(tx, addr);
 #elif DESIGN == WRITE_THROUGH
   value = stm_wt_RaR(tx, addr);
-#endif /* DESIGN == WRITE_THROUGH */
+#elif DESIGN == MODULAR
+  if (tx->design == WRITE_BACK_CTL)
+    value = stm_wbctl_RaR(tx, addr);
+  else if (tx->design == WRITE_THROUGH)
+    value = stm_wt_RaR(tx, addr);
+  else
+    value = stm_wbetl_RaR(tx, addr);
+#endif /* DESIGN == MODULAR */
   return value;
 }
 
@@ -1130,13 +2223,26 @@ static INLINE stm_word_t
 int_stm_RaW(stm_tx_t *tx, volatile stm_word_t *addr)
 {
   stm_word_t value;
+#ifdef DEADLINES
+  if (unlikely(stm_cancelled(tx))) {
+    stm_rollback(tx, STM_ABORT_CANCELLED);
+    return 0;
+  }
+#endif /* DEADLINES */
 #if DESIGN == WRITE_BACK_ETL
   value = stm_wbetl_RaW(tx, addr);
 #elif DESIGN == WRITE_BACK_CTL
   value = stm_wbctl_RaW(tx, addr);
 #elif DESIGN == WRITE_THROUGH
   value = stm_wt_RaW(tx, addr);
-#endif /* DESIGN == WRITE_THROUGH */
+#elif DESIGN == MODULAR
+  if (tx->design == WRITE_BACK_CTL)
+    value = stm_wbctl_RaW(tx, addr);
+  else if (tx->design == WRITE_THROUGH)
+    value = stm_wt_RaW(tx, addr);
+  else
+    value = stm_wbetl_RaW(tx, addr);
+#endif /* DESIGN == MODULAR */
   return value;
 }
 
@@ -1144,38 +2250,95 @@ static INLINE stm_word_t
 int_stm_RfW(stm_tx_t *tx, volatile stm_word_t *addr)
 {
   stm_word_t value;
+#if CM == CM_MODULAR
+  if (GET_STATUS(tx->status) == TX_KILLED) {
+    stm_rollback(tx, STM_ABORT_KILLED);
+    return 0;
+  }
+#endif /* CM == CM_MODULAR */
+#ifdef DEADLINES
+  if (unlikely(stm_cancelled(tx))) {
+    stm_rollback(tx, STM_ABORT_CANCELLED);
+    return 0;
+  }
+#endif /* DEADLINES */
 #if DESIGN == WRITE_BACK_ETL
   value = stm_wbetl_RfW(tx, addr);
 #elif DESIGN == WRITE_BACK_CTL
   value = stm_wbctl_RfW(tx, addr);
 #elif DESIGN == WRITE_THROUGH
   value = stm_wt_RfW(tx, addr);
-#endif /* DESIGN == WRITE_THROUGH */
+#elif DESIGN == MODULAR
+  if (tx->design == WRITE_BACK_CTL)
+    value = stm_wbctl_RfW(tx, addr);
+  else if (tx->design == WRITE_THROUGH)
+    value = stm_wt_RfW(tx, addr);
+  else
+    value = stm_wbetl_RfW(tx, addr);
+#endif /* DESIGN == MODULAR */
   return value;
 }
 
 static INLINE void
 int_stm_WaR(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t value, stm_word_t mask)
 {
+#if CM == CM_MODULAR
+  if (GET_STATUS(tx->status) == TX_KILLED) {
+    stm_rollback(tx, STM_ABORT_KILLED);
+    return;
+  }
+#endif /* CM == CM_MODULAR */
+#ifdef DEADLINES
+  if (unlikely(stm_cancelled(tx))) {
+    stm_rollback(tx, STM_ABORT_CANCELLED);
+    return;
+  }
+#endif /* DEADLINES */
 #if DESIGN == WRITE_BACK_ETL
   stm_wbetl_WaR(tx, addr, value, mask);
 #elif DESIGN == WRITE_BACK_CTL
   stm_wbctl_WaR(tx, addr, value, mask);
 #elif DESIGN == WRITE_THROUGH
   stm_wt_WaR(tx, addr, value, mask);
-#endif /* DESIGN == WRITE_THROUGH */
+#elif DESIGN == MODULAR
+  if (tx->design == WRITE_BACK_CTL)
+    stm_wbctl_WaR(tx, addr, value, mask);
+  else if (tx->design == WRITE_THROUGH)
+    stm_wt_WaR(tx, addr, value, mask);
+  else
+    stm_wbetl_WaR(tx, addr, value, mask);
+#endif /* DESIGN == MODULAR */
 }
 
 static INLINE void
 int_stm_WaW(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t value, stm_word_t mask)
 {
+#if CM == CM_MODULAR
+  if (GET_STATUS(tx->status) == TX_KILLED) {
+    stm_rollback(tx, STM_ABORT_KILLED);
+    return;
+  }
+#endif /* CM == CM_MODULAR */
+#ifdef DEADLINES
+  if (unlikely(stm_cancelled(tx))) {
+    stm_rollback(tx, STM_ABORT_CANCELLED);
+    return;
+  }
+#endif /* DEADLINES */
 #if DESIGN == WRITE_BACK_ETL
   stm_wbetl_WaW(tx, addr, value, mask);
 #elif DESIGN == WRITE_BACK_CTL
   stm_wbctl_WaW(tx, addr, value, mask);
 #elif DESIGN == WRITE_THROUGH
   stm_wt_WaW(tx, addr, value, mask);
-#endif /* DESIGN == WRITE_THROUGH */
+#elif DESIGN == MODULAR
+  if (tx->design == WRITE_BACK_CTL)
+    stm_wbctl_WaW(tx, addr, value, mask);
+  else if (tx->design == WRITE_THROUGH)
+    stm_wt_WaW(tx, addr, value, mask);
+  else
+    stm_wbetl_WaW(tx, addr, value, mask);
+#endif /* DESIGN == MODULAR */
 }
 
 static INLINE stm_tx_t *
@@ -1202,6 +2365,9 @@ int_stm_init_thread(void)
   /* Read set */
   tx->r_set.nb_entries = 0;
   tx->r_set.size = RW_SET_SIZE;
+#ifdef CALL_SITES
+  tx->r_sites = NULL;
+#endif /* CALL_SITES */
   stm_allocate_rs_entries(tx, 0);
   /* Write set */
   tx->w_set.nb_entries = 0;
@@ -1213,36 +2379,78 @@ int_stm_init_thread(void)
   tx->w_set.bloom = 0;
 #endif /* USE_BLOOM_FILTER */
   stm_allocate_ws_entries(tx, 0);
+#ifdef REGION_SUMMARIES
+  /* Region read set */
+  tx->rg_set.last = NULL;
+  tx->rg_set.nb_entries = 0;
+  tx->rg_set.size = REGION_SET_SIZE;
+  tx->rg_set.hot = 0;
+#endif /* REGION_SUMMARIES */
+  /* Scratch memory */
+  tx->scratch.base = NULL;
+  tx->scratch.size = tx->scratch.top = tx->scratch.overflow_size = 0;
+  tx->scratch.overflow = NULL;
   /* Nesting level */
   tx->nesting = 0;
+  tx->abort_reason = 0;
   /* Transaction-specific data */
   memset(tx->data, 0, MAX_SPECIFIC * sizeof(void *));
 #ifdef CONFLICT_TRACKING
   /* Thread identifier */
   tx->thread_id = pthread_self();
 #endif /* CONFLICT_TRACKING */
-#if CM == CM_DELAY || CM == CM_MODULAR
+#ifdef CALL_SITES
+  /* Call sites */
+  tx->site = tx->conflict_site = tx->conflict_other_site = NULL;
+  tx->site_reads = 0;
+  tx->site_countdown = CALL_SITES_SAMPLE;
+#endif /* CALL_SITES */
+#if DESIGN == MODULAR
+  /* Design */
+  tx->design = _tinystm.design;
+#endif /* DESIGN == MODULAR */
+#if CM == CM_DELAY || CM == CM_MODULAR || DESIGN == MODULAR || defined(RETRY_POLICIES)
   /* Contented lock */
   tx->c_lock = NULL;
-#endif /* CM == CM_DELAY || CM == CM_MODULAR */
-#if CM == CM_BACKOFF
+#endif /* CM == CM_DELAY || CM == CM_MODULAR || DESIGN == MODULAR || defined(RETRY_POLICIES) */
+#if CM == CM_BACKOFF || DESIGN == MODULAR || defined(RETRY_POLICIES)
   /* Backoff */
   tx->backoff = MIN_BACKOFF;
   tx->seed = 123456789UL;
-#endif /* CM == CM_BACKOFF */
+#endif /* CM == CM_BACKOFF || DESIGN == MODULAR || defined(RETRY_POLICIES) */
 #if CM == CM_MODULAR
   tx->visible_reads = 0;
   tx->timestamp = 0;
 #endif /* CM == CM_MODULAR */
-#if CM == CM_MODULAR || defined(TM_STATISTICS)
+#if CM == CM_MODULAR || defined(TM_STATISTICS) || defined(RETRY_POLICIES)
   tx->stat_retries = 0;
-#endif /* CM == CM_MODULAR || defined(TM_STATISTICS) */
+#endif /* CM == CM_MODULAR || defined(TM_STATISTICS) || defined(RETRY_POLICIES) */
+#ifdef DEADLINES
+  /* Deadline */
+  tx->deadline = 0;
+  tx->deadline_retries = 0;
+  tx->deadline_action = STM_DEADLINE_ABORT;
+  tx->deadline_aborts = 0;
+  tx->cancel = 0;
+  tx->no_give_up = 0;
+#endif /* DEADLINES */
 #ifdef TM_STATISTICS
   /* Statistics */
   tx->stat_commits = 0;
   tx->stat_aborts = 0;
   tx->stat_retries_max = 0;
+# ifdef RETRY_POLICIES
+  memset(tx->stat_retry_policy, 0, sizeof(tx->stat_retry_policy));
+# endif /* RETRY_POLICIES */
 #endif /* TM_STATISTICS */
+#ifdef WRITE_PREDICTION
+  tx->nb_predicted = 0;
+  tx->stat_predict_prefetches = 0;
+  tx->stat_predict_hits = 0;
+#endif /* WRITE_PREDICTION */
+#ifdef LOG_PRESIZE
+  tx->log_idle = 0;
+#endif /* LOG_PRESIZE */
 #ifdef TM_STATISTICS2
   tx->stat_aborts_1 = 0;
   tx->stat_aborts_2 = 0;
@@ -1298,18 +2506,29 @@ int_stm_exit_thread(stm_tx_t *tx)
     printf("Thread %p | commits:%12u avg_aborts:%12.2f max_retries:%12u\n", (void *)pthread_self(), tx->stat_commits, avg_aborts, tx->stat_retries_max);
   }
 #endif /* TM_STATISTICS */
+#ifdef WRITE_PREDICTION
+  if (getenv("TM_STATISTICS") != NULL && tx->stat_predict_prefetches != 0) {
+    printf("Thread %p | prefetches:%12u hits:%12u hit_rate:%11.2f%%\n", (void *)pthread_self(), tx->stat_predict_prefetches, tx->stat_predict_hits, 100.0 * tx->stat_predict_hits / tx->stat_predict_prefetches);
+  }
+#endif /* WRITE_PREDICTION */
 
   stm_quiesce_exit_thread(tx);
 
 #ifdef EPOCH_GC
   t = GET_CLOCK;
   gc_free(tx->r_set.entries, t);
+# ifdef CALL_SITES
+  gc_free(tx->r_sites, t);
+# endif /* CALL_SITES */
   gc_free(tx->w_set.entries, t);
+  if (tx->scratch.base != NULL)
+    gc_free(tx->scratch.base, t);
   gc_free(tx, t);
   gc_exit_thread();
 #else /* ! EPOCH_GC */
   xfree(tx->r_set.entries);
   xfree(tx->w_set.entries);
+  xfree(tx->scratch.base);
   xfree(tx);
 #endif /* ! EPOCH_GC */
 
@@ -1331,6 +2550,27 @@ int_stm_start(stm_tx_t *tx, stm_tx_attr_t attr)
   /* Attributes */
   tx->attr = attr;
 
+#ifdef CALL_SITES
+  /* Record call sites of reads in a sample of transactions */
+  if (unlikely(--tx->site_countdown == 0)) {
+    tx->site_countdown = CALL_SITES_SAMPLE;
+    tx->site_reads = 1;
+  } else
+    tx->site_reads = 0;
+#endif /* CALL_SITES */
+
+#ifdef DEADLINES
+  tx->deadline_aborts = 0;
+  /* Requests for previous transactions no longer match (0 is never used) */
+  if (unlikely(++tx->tag == 0))
+    tx->tag = 1;
+  tx->no_give_up = 0;
+#endif /* DEADLINES */
+
+#ifdef LOG_PRESIZE
+  stm_log_presize(tx);
+#endif /* LOG_PRESIZE */
+
   /* Initialize transaction descriptor */
   int_stm_prepare(tx);
 
@@ -1366,6 +2606,13 @@ int_stm_commit(stm_tx_t *tx)
 
   assert(IS_ACTIVE(tx->status));
 
+#ifdef DEADLINES
+  if (unlikely(stm_cancelled(tx))) {
+    stm_rollback(tx, STM_ABORT_CANCELLED);
+    return 0;
+  }
+#endif /* DEADLINES */
+
 #if CM == CM_MODULAR
   /* Set status to COMMITTING */
   t = tx->status;
@@ -1389,26 +2636,42 @@ int_stm_commit(stm_tx_t *tx)
 #elif DESIGN == WRITE_THROUGH
   stm_wt_commit(tx);
 #elif DESIGN == MODULAR
-  if (tx->attr.id == WRITE_BACK_CTL)
+  if (tx->design == WRITE_BACK_CTL)
     stm_wbctl_commit(tx);
-  else if (tx->attr.id == WRITE_THROUGH)
+  else if (tx->design == WRITE_THROUGH)
     stm_wt_commit(tx);
   else
     stm_wbetl_commit(tx);
 #endif /* DESIGN == MODULAR */
 
+#ifdef WRITE_PREDICTION
+  stm_predict_learn(tx);
+#endif /* WRITE_PREDICTION */
+
  end:
+#ifdef LOG_PRESIZE
+  stm_log_record(tx);
+  if (tx->r_set.nb_entries * 4 > tx->r_set.size || tx->w_set.nb_entries * 4 > tx->w_set.size ||
+      (tx->r_set.size == RW_SET_SIZE && tx->w_set.size == RW_SET_SIZE))
+    tx->log_idle = 0;
+  else
+    tx->log_idle++;
+#endif /* LOG_PRESIZE */
 #ifdef TM_STATISTICS
   tx->stat_commits++;
 #endif /* TM_STATISTICS */
-#if CM == CM_MODULAR || defined(TM_STATISTICS)
+#if CM == CM_MODULAR || defined(TM_STATISTICS) || defined(RETRY_POLICIES)
   tx->stat_retries = 0;
-#endif /* CM == CM_MODULAR || defined(TM_STATISTICS) */
+#endif /* CM == CM_MODULAR || defined(TM_STATISTICS) || defined(RETRY_POLICIES) */
 
-#if CM == CM_BACKOFF
+#if CM == CM_BACKOFF || DESIGN == MODULAR || defined(RETRY_POLICIES)
   /* Reset backoff */
   tx->backoff = MIN_BACKOFF;
-#endif /* CM == CM_BACKOFF */
+#endif /* CM == CM_BACKOFF || DESIGN == MODULAR || defined(RETRY_POLICIES) */
+
+#ifdef REGION_SUMMARIES
+  tx->rg_set.hot = 0;
+#endif /* REGION_SUMMARIES */
 
 #if CM == CM_MODULAR
   tx->visible_reads = 0;
@@ -1416,10 +2679,22 @@ int_stm_commit(stm_tx_t *tx)
 
 #ifdef IRREVOCABLE_ENABLED
   if (unlikely(tx->irrevocable)) {
+# ifdef IRREVOCABLE_BATCH
+    if ((tx->irrevocable & 0x08) != 0 && ATOMIC_LOAD(&_tinystm.irrevocable_batch) == 2) {
+      /* Executed in the window of another transaction: give it back */
+      ATOMIC_STORE_REL(&_tinystm.irrevocable_batch, 1);
+      tx->irrevocable = 0;
+    } else {
+      if ((tx->irrevocable & 0x08) != 0)
+        stm_irrevocable_batch(tx);
+# endif /* IRREVOCABLE_BATCH */
     ATOMIC_STORE(&_tinystm.irrevocable, 0);
     if ((tx->irrevocable & 0x08) != 0)
       stm_quiesce_release(tx);
     tx->irrevocable = 0;
+# ifdef IRREVOCABLE_BATCH
+    }
+# endif /* IRREVOCABLE_BATCH */
   }
 #endif /* IRREVOCABLE_ENABLED */
 
@@ -1433,12 +2708,21 @@ int_stm_commit(stm_tx_t *tx)
       _tinystm.commit_cb[cb].f(_tinystm.commit_cb[cb].arg);
   }
 
+  /* Release scratch memory */
+  stm_scratch_reset(tx);
+
   return 1;
 }
 
 static INLINE stm_word_t
 int_stm_load(stm_tx_t *tx, volatile stm_word_t *addr)
 {
+#ifdef DEADLINES
+  if (unlikely(stm_cancelled(tx))) {
+    stm_rollback(tx, STM_ABORT_CANCELLED);
+    return 0;
+  }
+#endif /* DEADLINES */
 #if DESIGN == WRITE_BACK_ETL
   return stm_wbetl_read(tx, addr);
 #elif DESIGN == WRITE_BACK_CTL
@@ -1446,15 +2730,71 @@ int_stm_load(stm_tx_t *tx, volatile stm_word_t *addr)
 #elif DESIGN == WRITE_THROUGH
   return stm_wt_read(tx, addr);
 #elif DESIGN == MODULAR
-  if (tx->attr.id == WRITE_BACK_CTL)
+  if (tx->design == WRITE_BACK_CTL)
     return stm_wbctl_read(tx, addr);
-  else if (tx->attr.id == WRITE_THROUGH)
+  else if (tx->design == WRITE_THROUGH)
     return stm_wt_read(tx, addr);
   else
     return stm_wbetl_read(tx, addr);
 #endif /* DESIGN == MODULAR */
 }
 
+/*
+ * Load consecutive words, checking the lock of each stripe only once.
+ */
+static INLINE void
+int_stm_load_range(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t *buf, size_t nb)
+{
+#if CM != CM_MODULAR
+  volatile stm_lock_t *lock;
+  stm_word_t l;
+#endif /* CM != CM_MODULAR */
+  size_t i, n;
+  int done;
+#if CM != CM_MODULAR
+  int copy;
+
+  /* With commit-time locking, our writes are not visible in the locks */
+# if DESIGN == WRITE_BACK_CTL
+  copy = (tx->w_set.nb_entries == 0);
+# elif DESIGN == MODULAR
+  copy = (tx->design != WRITE_BACK_CTL || tx->w_set.nb_entries == 0);
+# else /* DESIGN != WRITE_BACK_CTL && DESIGN != MODULAR */
+  copy = 1;
+# endif /* DESIGN != WRITE_BACK_CTL && DESIGN != MODULAR */
+#endif /* CM != CM_MODULAR */
+
+  while (nb > 0) {
+    /* Words up to the end of the stripe */
+    n = (1 << LOCK_SHIFT_EXTRA) - (((stm_word_t)addr >> (LOCK_SHIFT - LOCK_SHIFT_EXTRA)) & ((1 << LOCK_SHIFT_EXTRA) - 1));
+    if (n > nb)
+      n = nb;
+    /* The first word handles conflicts, extension and the read set entry */
+    buf[0] = int_stm_load(tx, addr);
+    done = (n == 1);
+#if CM != CM_MODULAR
+    if (!done && copy) {
+      /* Copy the rest of the stripe if its version is still valid and unchanged */
+      lock = GET_LOCK(addr);
+      l = LOCK_LOAD_ACQ(lock);
+      if (likely(!LOCK_GET_WRITE(l) && LOCK_GET_TIMESTAMP(l) <= tx->end)) {
+        for (i = 1; i < n; i++)
+          buf[i] = ATOMIC_LOAD_ACQ(addr + i);
+        done = (LOCK_LOAD_ACQ(lock) == l);
+      }
+    }
+#endif /* CM != CM_MODULAR */
+    if (!done) {
+      /* Locked (possibly by us) or concurrently updated: one word at a time */
+      for (i = 1; i < n; i++)
+        buf[i] = int_stm_load(tx, addr + i);
+    }
+    addr += n;
+    buf += n;
+    nb -= n;
+  }
+}
+
 static INLINE void
 int_stm_store(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t value)
 {
@@ -1532,6 +2872,29 @@ int_stm_get_stats(stm_tx_t *tx, const char *name, void *val)
     *(unsigned int *)val = tx->attr.read_only;
     return 1;
   }
+  if (strcmp("abort_reason", name) == 0) {
+    *(unsigned int *)val = tx->abort_reason;
+    return 1;
+  }
+  if (strcmp("start_timestamp", name) == 0) {
+    *(stm_word_t *)val = tx->start;
+    return 1;
+  }
+  if (strcmp("commit_timestamp", name) == 0) {
+    /* Valid after commit (end of validity range for read-only transactions) */
+    *(stm_word_t *)val = tx->end;
+    return 1;
+  }
+#ifdef WRITE_PREDICTION
+  if (strcmp("nb_predict_prefetches", name) == 0) {
+    *(unsigned int *)val = tx->stat_predict_prefetches;
+    return 1;
+  }
+  if (strcmp("nb_predict_hits", name) == 0) {
+    *(unsigned int *)val = tx->stat_predict_hits;
+    return 1;
+  }
+#endif /* WRITE_PREDICTION */
 #ifdef TM_STATISTICS
   if (strcmp("nb_commits", name) == 0) {
     *(unsigned int *)val = tx->stat_commits;
@@ -1549,6 +2912,28 @@ int_stm_get_stats(stm_tx_t *tx, const char *name, void *val)
     *(unsigned int *)val = tx->stat_retries_max;
     return 1;
   }
+# ifdef RETRY_POLICIES
+  if (strcmp("nb_retry_immediate", name) == 0) {
+    *(unsigned int *)val = tx->stat_retry_policy[STM_RETRY_IMMEDIATE];
+    return 1;
+  }
+  if (strcmp("nb_retry_wait_lock", name) == 0) {
+    *(unsigned int *)val = tx->stat_retry_policy[STM_RETRY_WAIT_LOCK];
+    return 1;
+  }
+  if (strcmp("nb_retry_backoff", name) == 0) {
+    *(unsigned int *)val = tx->stat_retry_policy[STM_RETRY_BACKOFF];
+    return 1;
+  }
+  if (strcmp("nb_retry_visible_reads", name) == 0) {
+    *(unsigned int *)val = tx->stat_retry_policy[STM_RETRY_VISIBLE_READS];
+    return 1;
+  }
+  if (strcmp("nb_retry_irrevocable", name) == 0) {
+    *(unsigned int *)val = tx->stat_retry_policy[STM_RETRY_IRREVOCABLE];
+    return 1;
+  }
+# endif /* RETRY_POLICIES */
 #endif /* TM_STATISTICS */
 #ifdef TM_STATISTICS2
   if (strcmp("nb_aborts_1", name) == 0) {
@@ -1587,6 +2972,22 @@ int_stm_get_stats(stm_tx_t *tx, const char *name, void *val)
     *(unsigned int *)val = tx->stat_aborts_r[STM_ABORT_SIGNAL >> 8];
     return 1;
   }
+  if (strcmp("nb_aborts_rr_conflict", name) == 0) {
+    *(unsigned int *)val = tx->stat_aborts_r[STM_ABORT_RR_CONFLICT >> 8];
+    return 1;
+  }
+  if (strcmp("nb_aborts_rw_conflict", name) == 0) {
+    *(unsigned int *)val = tx->stat_aborts_r[STM_ABORT_RW_CONFLICT >> 8];
+    return 1;
+  }
+  if (strcmp("nb_aborts_irrevocable", name) == 0) {
+    *(unsigned int *)val = tx->stat_aborts_r[STM_ABORT_IRREVOCABLE >> 8];
+    return 1;
+  }
+  if (strcmp("nb_aborts_extend_ws", name) == 0) {
+    *(unsigned int *)val = tx->stat_aborts_r[STM_ABORT_EXTEND_WS >> 8];
+    return 1;
+  }
 # ifdef READ_LOCKED_DATA
   if (strcmp("locked_reads_ok", name) == 0) {
     *(unsigned int *)val = tx->stat_locked_reads_ok;
@@ -1615,5 +3016,44 @@ int_stm_get_specific(stm_tx_t *tx, int key)
   return (void *)ATOMIC_LOAD(&tx->data[key]);
 }
 
+static INLINE int
+int_stm_set_deadline(stm_tx_t *tx, uint64_t deadline, unsigned int max_retries, int action)
+{
+#ifdef DEADLINES
+  assert (tx != NULL);
+  switch (action) {
+    case STM_DEADLINE_ABORT:
+# ifdef IRREVOCABLE_ENABLED
+    case STM_DEADLINE_IRREVOCABLE:
+# endif /* IRREVOCABLE_ENABLED */
+      break;
+    default:
+      return 0;
+  }
+  tx->deadline = deadline;
+  tx->deadline_retries = max_retries;
+  tx->deadline_action = action;
+  return 1;
+#else /* ! DEADLINES */
+  return 0;
+#endif /* ! DEADLINES */
+}
+
+static INLINE void
+int_stm_cancel(stm_tx_t *tx)
+{
+#ifdef DEADLINES
+  stm_word_t tag;
+
+  assert (tx != NULL);
+  /* Read the tag before the status: the tag is updated before the
+   * transaction becomes active, so a request tagged with a transaction
+   * that has completed in the meantime is ignored by the next ones */
+  tag = ATOMIC_LOAD_ACQ(&tx->tag);
+  if (IS_ACTIVE(tx->status))
+    ATOMIC_STORE(&tx->cancel, tag);
+#endif /* DEADLINES */
+}
+
 #endif /* _STM_INTERNAL_H_ */
 
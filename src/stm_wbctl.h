@@ -39,7 +39,7 @@ stm_wbctl_validate(stm_tx_t *tx)
   r = tx->r_set.entries;
   for (i = tx->r_set.nb_entries; i > 0; i--, r++) {
     /* Read lock */
-    l = ATOMIC_LOAD(r->lock);
+    l = LOCK_LOAD(r->lock);
     /* Unlocked and still the same version? */
     if (LOCK_GET_OWNED(l)) {
       /* Do we own the lock? */
@@ -55,6 +55,9 @@ stm_wbctl_validate(stm_tx_t *tx)
 # endif /* UNIT_TX */
             /* Call conflict callback */
             stm_tx_t *other = ((w_entry_t *)LOCK_GET_ADDR(l))->tx;
+# ifdef CALL_SITES
+            stm_site_conflict(tx, stm_site_of_read(tx, r), (w_entry_t *)LOCK_GET_ADDR(l));
+# endif /* CALL_SITES */
             _tinystm.conflict_cb(tx, other);
 # ifdef UNIT_TX
           }
@@ -124,9 +127,9 @@ stm_wbctl_rollback(stm_tx_t *tx)
       if (!w->no_drop) {
         if (--tx->w_set.nb_acquired == 0) {
           /* Make sure that all lock releases become visible to other threads */
-          ATOMIC_STORE_REL(w->lock, LOCK_SET_TIMESTAMP(w->version));
+          LOCK_STORE_REL(w->lock, LOCK_SET_TIMESTAMP(w->version));
         } else {
-          ATOMIC_STORE(w->lock, LOCK_SET_TIMESTAMP(w->version));
+          LOCK_STORE(w->lock, LOCK_SET_TIMESTAMP(w->version));
         }
       }
     } while (tx->w_set.nb_acquired > 0);
@@ -136,7 +139,7 @@ stm_wbctl_rollback(stm_tx_t *tx)
 static INLINE stm_word_t
 stm_wbctl_read(stm_tx_t *tx, volatile stm_word_t *addr)
 {
-  volatile stm_word_t *lock;
+  volatile stm_lock_t *lock;
   stm_word_t l, l2, value, version;
   r_entry_t *r;
   w_entry_t *written = NULL;
@@ -163,7 +166,7 @@ stm_wbctl_read(stm_tx_t *tx, volatile stm_word_t *addr)
 
   /* Read lock, value, lock */
  restart:
-  l = ATOMIC_LOAD_ACQ(lock);
+  l = LOCK_LOAD_ACQ(lock);
  restart_no_load:
   if (LOCK_GET_WRITE(l)) {
     /* Locked */
@@ -173,7 +176,7 @@ stm_wbctl_read(stm_tx_t *tx, volatile stm_word_t *addr)
   } else {
     /* Not locked */
     value = ATOMIC_LOAD_ACQ(addr);
-    l2 = ATOMIC_LOAD_ACQ(lock);
+    l2 = LOCK_LOAD_ACQ(lock);
     if (l != l2) {
       l = l2;
       goto restart_no_load;
@@ -196,7 +199,7 @@ stm_wbctl_read(stm_tx_t *tx, volatile stm_word_t *addr)
       /* Verify that version has not been overwritten (read value has not
        * yet been added to read set and may have not been checked during
        * extend) */
-      l = ATOMIC_LOAD_ACQ(lock);
+      l = LOCK_LOAD_ACQ(lock);
       if (l != l2) {
         l = l2;
         goto restart_no_load;
@@ -225,6 +228,9 @@ stm_wbctl_read(stm_tx_t *tx, volatile stm_word_t *addr)
     r = &tx->r_set.entries[tx->r_set.nb_entries++];
     r->version = version;
     r->lock = lock;
+#ifdef CALL_SITES
+    stm_site_read(tx, r);
+#endif /* CALL_SITES */
   }
  return_value:
   return value;
@@ -233,7 +239,7 @@ stm_wbctl_read(stm_tx_t *tx, volatile stm_word_t *addr)
 static INLINE w_entry_t *
 stm_wbctl_write(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t value, stm_word_t mask)
 {
-  volatile stm_word_t *lock;
+  volatile stm_lock_t *lock;
   stm_word_t l, version;
   w_entry_t *w;
 
@@ -245,7 +251,7 @@ stm_wbctl_write(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t value, stm_w
 
   /* Try to acquire lock */
  restart:
-  l = ATOMIC_LOAD_ACQ(lock);
+  l = LOCK_LOAD_ACQ(lock);
  restart_no_load:
   if (LOCK_GET_OWNED(l)) {
     /* Locked */
@@ -289,12 +295,19 @@ stm_wbctl_write(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t value, stm_w
   /* We own the lock here (ETL) */
 do_write:
   /* Add address to write set */
+#ifdef COMPACT_LOCKS
+  if (unlikely(tx->w_set.nb_entries == tx->w_set.size && !WS_EXTENSIBLE(tx)) && stm_ws_overflow(tx, addr, value, mask))
+    return NULL;
+#endif /* COMPACT_LOCKS */
   if (tx->w_set.nb_entries == tx->w_set.size)
     stm_allocate_ws_entries(tx, 1);
   w = &tx->w_set.entries[tx->w_set.nb_entries++];
   w->addr = addr;
   w->mask = mask;
   w->lock = lock;
+#ifdef CALL_SITES
+  w->site = tx->site;
+#endif /* CALL_SITES */
   if (mask == 0) {
     /* Do not write anything */
 #ifndef NDEBUG
@@ -318,14 +331,56 @@ do_write:
 static INLINE stm_word_t
 stm_wbctl_RaR(stm_tx_t *tx, volatile stm_word_t *addr)
 {
-  /* Possible optimization: avoid adding to read set. */
+  volatile stm_lock_t *lock;
+  stm_word_t l, l2, value;
+
+  PRINT_DEBUG2("==> stm_wbctl_RaR(t=%p[%lu-%lu],a=%p)\n", tx, (unsigned long)tx->start, (unsigned long)tx->end, addr);
+
+  assert(IS_ACTIVE(tx->status));
+
+  /* Writes may have happened since the previous read (through an alias) */
+  if (likely(stm_has_written(tx, addr) == NULL)) {
+    /* Get reference to lock */
+    lock = GET_LOCK(addr);
+    /* Read lock, value, lock */
+    l = LOCK_LOAD_ACQ(lock);
+    if (likely(!LOCK_GET_OWNED(l))) {
+      value = ATOMIC_LOAD_ACQ(addr);
+      l2 = LOCK_LOAD_ACQ(lock);
+      /* Same version as recorded by the previous read: no need to add to
+       * read set again (any later update would have a timestamp higher
+       * than tx->end) */
+      if (likely(l == l2 && LOCK_GET_TIMESTAMP(l) <= tx->end))
+        return value;
+    }
+  }
+  /* Written, locked, concurrently updated or too recent: use regular read */
   return stm_wbctl_read(tx, addr);
 }
 
 static INLINE stm_word_t
 stm_wbctl_RaW(stm_tx_t *tx, volatile stm_word_t *addr)
 {
-  /* Cannot be much better than regular due to mask == 0 case. */
+  w_entry_t *w;
+  int i;
+
+  PRINT_DEBUG2("==> stm_wbctl_RaW(t=%p[%lu-%lu],a=%p)\n", tx, (unsigned long)tx->start, (unsigned long)tx->end, addr);
+
+  assert(IS_ACTIVE(tx->status));
+
+  /* Look for write, most recent entries first (no need to check the bloom
+   * filter, the address is known to be in the write set) */
+  w = tx->w_set.entries + tx->w_set.nb_entries;
+  for (i = tx->w_set.nb_entries; i > 0; i--) {
+    w--;
+    if (w->addr == addr) {
+      /* Get value from write set if it covers the whole word */
+      if (likely(w->mask == ~(stm_word_t)0))
+        return w->value;
+      break;
+    }
+  }
+  /* Partial write (must be merged with memory) or wrong hint: use regular read */
   return stm_wbctl_read(tx, addr);
 }
 
@@ -339,7 +394,8 @@ stm_wbctl_RfW(stm_tx_t *tx, volatile stm_word_t *addr)
 static INLINE void
 stm_wbctl_WaR(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t value, stm_word_t mask)
 {
-  /* Probably no optimization can be done here. */
+  /* The read set is only looked up when the lock version is too recent,
+   * in which case we abort anyway: nothing to gain here. */
   stm_wbctl_write(tx, addr, value, mask);
 }
 
@@ -347,12 +403,24 @@ static INLINE void
 stm_wbctl_WaW(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t value, stm_word_t mask)
 {
   w_entry_t *w;
-  /* Get the write set entry. */
-  w = stm_has_written(tx, addr);
-  assert(w != NULL);
-  /* Update directly into the write set. */
-  w->value = (w->value & ~mask) | (value & mask);
-  w->mask |= mask;
+  int i;
+
+  PRINT_DEBUG2("==> stm_wbctl_WaW(t=%p[%lu-%lu],a=%p,d=%p-%lu,m=0x%lx)\n",
+               tx, (unsigned long)tx->start, (unsigned long)tx->end, addr, (void *)value, (unsigned long)value, (unsigned long)mask);
+
+  /* Get the write set entry (most recent entries first). */
+  w = tx->w_set.entries + tx->w_set.nb_entries;
+  for (i = tx->w_set.nb_entries; i > 0; i--) {
+    w--;
+    if (w->addr == addr) {
+      /* Update directly into the write set. */
+      w->value = (w->value & ~mask) | (value & mask);
+      w->mask |= mask;
+      return;
+    }
+  }
+  /* Wrong hint: use regular write */
+  stm_wbctl_write(tx, addr, value, mask);
 }
 
 static INLINE int
@@ -371,7 +439,7 @@ stm_wbctl_commit(stm_tx_t *tx)
     w--;
     /* Try to acquire lock */
  restart:
-    l = ATOMIC_LOAD(w->lock);
+    l = LOCK_LOAD(w->lock);
     if (LOCK_GET_OWNED(l)) {
       /* Do we already own the lock? */
       if (tx->w_set.entries <= (w_entry_t *)LOCK_GET_ADDR(l) && (w_entry_t *)LOCK_GET_ADDR(l) < tx->w_set.entries + tx->w_set.nb_entries) {
@@ -379,9 +447,9 @@ stm_wbctl_commit(stm_tx_t *tx)
         continue;
       }
       /* Conflict: CM kicks in */
-# if CM == CM_DELAY
+# if CM == CM_DELAY || DESIGN == MODULAR || defined(RETRY_POLICIES)
       tx->c_lock = w->lock;
-# endif /* CM == CM_DELAY */
+# endif /* CM == CM_DELAY || DESIGN == MODULAR || defined(RETRY_POLICIES) */
 
 #ifdef IRREVOCABLE_ENABLED
       if (tx->irrevocable) {
@@ -398,7 +466,7 @@ stm_wbctl_commit(stm_tx_t *tx)
       stm_rollback(tx, STM_ABORT_WW_CONFLICT);
       return 0;
     }
-    if (ATOMIC_CAS_FULL(w->lock, l, LOCK_SET_ADDR_WRITE((stm_word_t)w)) == 0)
+    if (LOCK_CAS_FULL(w->lock, l, LOCK_SET_ADDR_WRITE(LOCK_ENTRY(tx, w))) == 0)
       goto restart;
     /* We own the lock here */
     w->no_drop = 0;
@@ -448,6 +516,23 @@ stm_wbctl_commit(stm_tx_t *tx)
   release_locks:
 #endif /* IRREVOCABLE_ENABLED */
 
+#ifdef CDC
+  stm_cdc_append(tx, t);
+#endif /* CDC */
+
+#ifdef NT_WRITE_BACK
+  if (unlikely(tx->w_set.nb_entries >= NT_THRESHOLD)) {
+    /* Bulk update: stream new versions to memory, then drop locks */
+    stm_write_back_nt(tx);
+    w = tx->w_set.entries;
+    for (i = tx->w_set.nb_entries; i > 0; i--, w++) {
+      if (!w->no_drop)
+        LOCK_STORE_REL(w->lock, LOCK_SET_TIMESTAMP(t));
+    }
+    goto installed;
+  }
+#endif /* NT_WRITE_BACK */
+
   /* Install new versions, drop locks and set new timestamp */
   w = tx->w_set.entries;
   for (i = tx->w_set.nb_entries; i > 0; i--, w++) {
@@ -459,9 +544,19 @@ stm_wbctl_commit(stm_tx_t *tx)
     }
     /* Only drop lock for last covered address in write set (cannot be "no drop") */
     if (!w->no_drop)
-      ATOMIC_STORE_REL(w->lock, LOCK_SET_TIMESTAMP(t));
+      LOCK_STORE_REL(w->lock, LOCK_SET_TIMESTAMP(t));
   }
 
+#ifdef NT_WRITE_BACK
+ installed:
+#endif /* NT_WRITE_BACK */
+  /* Remember commit timestamp */
+  tx->end = t;
+
+#ifdef WATCH
+  stm_watch_notify(tx, t);
+#endif /* WATCH */
+
  end:
   return 1;
 }
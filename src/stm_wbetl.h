@@ -44,11 +44,17 @@ stm_wbetl_validate(stm_tx_t *tx)
 
   PRINT_DEBUG("==> stm_wbetl_validate(%p[%lu-%lu])\n", tx, (unsigned long)tx->start, (unsigned long)tx->end);
 
+#ifdef REGION_SUMMARIES
+  /* Validate regions */
+  if (!stm_validate_regions(tx))
+    return 0;
+#endif /* REGION_SUMMARIES */
+
   /* Validate reads */
   r = tx->r_set.entries;
   for (i = tx->r_set.nb_entries; i > 0; i--, r++) {
     /* Read lock */
-    l = ATOMIC_LOAD(r->lock);
+    l = LOCK_LOAD(r->lock);
     /* Unlocked and still the same version? */
     if (LOCK_GET_OWNED(l)) {
       /* Do we own the lock? */
@@ -64,6 +70,9 @@ stm_wbetl_validate(stm_tx_t *tx)
 # endif /* UNIT_TX */
             /* Call conflict callback */
             stm_tx_t *other = ((w_entry_t *)LOCK_GET_ADDR(l))->tx;
+# ifdef CALL_SITES
+            stm_site_conflict(tx, stm_site_of_read(tx, r), (w_entry_t *)LOCK_GET_ADDR(l));
+# endif /* CALL_SITES */
             _tinystm.conflict_cb(tx, other);
 # ifdef UNIT_TX
           }
@@ -148,7 +157,7 @@ stm_wbetl_rollback(stm_tx_t *tx)
     for (; i > 0; i--, w++) {
       if (w->next == NULL) {
         /* Only drop lock for last covered address in write set */
-        ATOMIC_STORE(w->lock, LOCK_SET_TIMESTAMP(w->version));
+        LOCK_STORE(w->lock, LOCK_SET_TIMESTAMP(w->version));
       }
     }
     /* Make sure that all lock releases become visible */
@@ -162,7 +171,7 @@ stm_wbetl_rollback(stm_tx_t *tx)
 static INLINE stm_word_t
 stm_wbetl_read_invisible(stm_tx_t *tx, volatile stm_word_t *addr)
 {
-  volatile stm_word_t *lock;
+  volatile stm_lock_t *lock;
   stm_word_t l, l2, value, version;
   r_entry_t *r;
   w_entry_t *w;
@@ -170,6 +179,11 @@ stm_wbetl_read_invisible(stm_tx_t *tx, volatile stm_word_t *addr)
   stm_word_t t;
   int decision;
 #endif /* CM == CM_MODULAR */
+#ifdef REGION_SUMMARIES
+  volatile stm_word_t *region = NULL;
+  stm_word_t rv = 0;
+  int rg_new = 0;
+#endif /* REGION_SUMMARIES */
 
   PRINT_DEBUG2("==> stm_wbetl_read_invisible(t=%p[%lu-%lu],a=%p)\n", tx, (unsigned long)tx->start, (unsigned long)tx->end, addr);
 
@@ -180,11 +194,28 @@ stm_wbetl_read_invisible(stm_tx_t *tx, volatile stm_word_t *addr)
   /* Get reference to lock */
   lock = GET_LOCK(addr);
 
+#ifdef REGION_SUMMARIES
+  if (!tx->attr.read_only && tx->rg_set.size > 0) {
+    region = GET_REGION(addr);
+    if (stm_has_region(tx, region) != NULL) {
+      /* Region already covers this read */
+    } else if (tx->rg_set.nb_entries < tx->rg_set.size) {
+      /* Record counter before reading data */
+      rv = ATOMIC_LOAD_ACQ(region);
+      rg_new = 1;
+    } else {
+      /* Region set full (scattered reads): use stripes from now on */
+      tx->rg_set.size = 0;
+      region = NULL;
+    }
+  }
+#endif /* REGION_SUMMARIES */
+
   /* Note: we could check for duplicate reads and get value from read set */
 
   /* Read lock, value, lock */
  restart:
-  l = ATOMIC_LOAD_ACQ(lock);
+  l = LOCK_LOAD_ACQ(lock);
  restart_no_load:
   if (unlikely(LOCK_GET_WRITE(l))) {
     /* Locked */
@@ -236,7 +267,7 @@ stm_wbetl_read_invisible(stm_tx_t *tx, volatile stm_word_t *addr)
 # endif /* CM != CM_MODULAR && defined(IRREVOCABLE_ENABLED) */
 # if CM == CM_MODULAR
     t = w->tx->status;
-    l2 = ATOMIC_LOAD_ACQ(lock);
+    l2 = LOCK_LOAD_ACQ(lock);
     if (l != l2) {
       l = l2;
       goto restart_no_load;
@@ -287,6 +318,9 @@ stm_wbetl_read_invisible(stm_tx_t *tx, volatile stm_word_t *addr)
         (_tinystm.contention_manager != NULL ? _tinystm.contention_manager(tx, w->tx, WR_CONFLICT) : KILL_SELF);
       if (decision == KILL_OTHER) {
         /* Kill other */
+#  ifdef CALL_SITES
+        stm_site_conflict(tx, tx->site, w);
+#  endif /* CALL_SITES */
         if (!stm_kill(tx, w->tx, t)) {
           /* Transaction may have committed or aborted: retry */
           goto restart;
@@ -296,7 +330,7 @@ stm_wbetl_read_invisible(stm_tx_t *tx, volatile stm_word_t *addr)
     if (decision == KILL_OTHER) {
       /* Steal lock */
       l2 = LOCK_SET_TIMESTAMP(w->version);
-      if (ATOMIC_CAS_FULL(lock, l, l2) == 0)
+      if (LOCK_CAS_FULL(lock, l, l2) == 0)
         goto restart;
       l = l2;
       goto restart_no_load;
@@ -304,9 +338,9 @@ stm_wbetl_read_invisible(stm_tx_t *tx, volatile stm_word_t *addr)
     /* Kill self */
     if ((decision & DELAY_RESTART) != 0)
       tx->c_lock = lock;
-# elif CM == CM_DELAY
+# elif CM == CM_DELAY || DESIGN == MODULAR || defined(RETRY_POLICIES)
     tx->c_lock = lock;
-# endif /* CM == CM_DELAY */
+# endif /* CM == CM_DELAY || DESIGN == MODULAR || defined(RETRY_POLICIES) */
     /* Abort */
 # ifdef CONFLICT_TRACKING
     if (_tinystm.conflict_cb != NULL) {
@@ -315,6 +349,9 @@ stm_wbetl_read_invisible(stm_tx_t *tx, volatile stm_word_t *addr)
 #  endif /* UNIT_TX */
         /* Call conflict callback */
         stm_tx_t *other = ((w_entry_t *)LOCK_GET_ADDR(l))->tx;
+#  ifdef CALL_SITES
+        stm_site_conflict(tx, tx->site, (w_entry_t *)LOCK_GET_ADDR(l));
+#  endif /* CALL_SITES */
         _tinystm.conflict_cb(tx, other);
 #  ifdef UNIT_TX
       }
@@ -326,7 +363,7 @@ stm_wbetl_read_invisible(stm_tx_t *tx, volatile stm_word_t *addr)
   } else {
     /* Not locked */
     value = ATOMIC_LOAD_ACQ(addr);
-    l2 = ATOMIC_LOAD_ACQ(lock);
+    l2 = LOCK_LOAD_ACQ(lock);
     if (unlikely(l != l2)) {
       l = l2;
       goto restart_no_load;
@@ -360,7 +397,7 @@ stm_wbetl_read_invisible(stm_tx_t *tx, volatile stm_word_t *addr)
       /* Verify that version has not been overwritten (read value has not
        * yet been added to read set and may have not been checked during
        * extend) */
-      l2 = ATOMIC_LOAD_ACQ(lock);
+      l2 = LOCK_LOAD_ACQ(lock);
       if (l != l2) {
         l = l2;
         goto restart_no_load;
@@ -381,6 +418,17 @@ stm_wbetl_read_invisible(stm_tx_t *tx, volatile stm_word_t *addr)
  add_to_read_set:
 #endif /* READ_LOCKED_DATA */
   if (!tx->attr.read_only) {
+#ifdef REGION_SUMMARIES
+    if (region != NULL) {
+      if (rg_new) {
+        /* One entry for the whole region */
+        tx->rg_set.last = &tx->rg_set.entries[tx->rg_set.nb_entries++];
+        tx->rg_set.last->region = region;
+        tx->rg_set.last->version = rv;
+      }
+      goto return_value;
+    }
+#endif /* REGION_SUMMARIES */
 #ifdef NO_DUPLICATES_IN_RW_SETS
     if (stm_has_read(tx, lock) != NULL)
       goto return_value;
@@ -391,6 +439,9 @@ stm_wbetl_read_invisible(stm_tx_t *tx, volatile stm_word_t *addr)
     r = &tx->r_set.entries[tx->r_set.nb_entries++];
     r->version = version;
     r->lock = lock;
+#ifdef CALL_SITES
+    stm_site_read(tx, r);
+#endif /* CALL_SITES */
   }
  return_value:
   return value;
@@ -403,7 +454,7 @@ stm_wbetl_read_invisible(stm_tx_t *tx, volatile stm_word_t *addr)
 static INLINE stm_word_t
 stm_wbetl_read_visible(stm_tx_t *tx, volatile stm_word_t *addr)
 {
-  volatile stm_word_t *lock;
+  volatile stm_lock_t *lock;
   stm_word_t l, l2, t, value, version;
   w_entry_t *w;
   int decision;
@@ -420,7 +471,7 @@ stm_wbetl_read_visible(stm_tx_t *tx, volatile stm_word_t *addr)
 
   /* Try to acquire lock */
  restart:
-  l = ATOMIC_LOAD_ACQ(lock);
+  l = LOCK_LOAD_ACQ(lock);
  restart_no_load:
   if (LOCK_GET_OWNED(l)) {
     /* Locked */
@@ -467,7 +518,7 @@ stm_wbetl_read_visible(stm_tx_t *tx, volatile stm_word_t *addr)
       ATOMIC_STORE(&_tinystm.irrevocable, 2);
 # endif /* defined(IRREVOCABLE_ENABLED) && defined(IRREVOCABLE_IMPROVED) */
     t = w->tx->status;
-    l2 = ATOMIC_LOAD_ACQ(lock);
+    l2 = LOCK_LOAD_ACQ(lock);
     if (l != l2) {
       l = l2;
       goto restart_no_load;
@@ -489,6 +540,9 @@ stm_wbetl_read_visible(stm_tx_t *tx, volatile stm_word_t *addr)
         (_tinystm.contention_manager != NULL ? _tinystm.contention_manager(tx, w->tx, (LOCK_GET_WRITE(l) ? WR_CONFLICT : RR_CONFLICT)) : KILL_SELF);
       if (decision == KILL_OTHER) {
         /* Kill other */
+# ifdef CALL_SITES
+        stm_site_conflict(tx, tx->site, w);
+# endif /* CALL_SITES */
         if (!stm_kill(tx, w->tx, t)) {
           /* Transaction may have committed or aborted: retry */
           goto restart;
@@ -510,6 +564,9 @@ stm_wbetl_read_visible(stm_tx_t *tx, volatile stm_word_t *addr)
 #  endif /* UNIT_TX */
         /* Call conflict callback */
         stm_tx_t *other = ((w_entry_t *)LOCK_GET_ADDR(l))->tx;
+#  ifdef CALL_SITES
+        stm_site_conflict(tx, tx->site, (w_entry_t *)LOCK_GET_ADDR(l));
+#  endif /* CALL_SITES */
         _tinystm.conflict_cb(tx, other);
 #  ifdef UNIT_TX
       }
@@ -523,16 +580,23 @@ stm_wbetl_read_visible(stm_tx_t *tx, volatile stm_word_t *addr)
   version = LOCK_GET_TIMESTAMP(l);
  acquire:
   /* Acquire lock (ETL) */
+# ifdef COMPACT_LOCKS
+  if (unlikely(tx->w_set.nb_entries == tx->w_set.size && !WS_EXTENSIBLE(tx)) && stm_ws_overflow(tx, addr, 0, 0))
+    return ATOMIC_LOAD(addr);
+# endif /* COMPACT_LOCKS */
   if (tx->w_set.nb_entries == tx->w_set.size)
     stm_rollback(tx, STM_ABORT_EXTEND_WS);
   w = &tx->w_set.entries[tx->w_set.nb_entries];
   w->version = version;
   value = ATOMIC_LOAD(addr);
-  if (ATOMIC_CAS_FULL(lock, l, LOCK_SET_ADDR_READ((stm_word_t)w)) == 0)
+  if (LOCK_CAS_FULL(lock, l, LOCK_SET_ADDR_READ(LOCK_ENTRY(tx, w))) == 0)
     goto restart;
   /* Add entry to write set */
   w->addr = addr;
   w->mask = 0;
+# ifdef CALL_SITES
+  w->site = tx->site;
+# endif /* CALL_SITES */
   w->lock = lock;
   w->value = value;
   w->next = NULL;
@@ -556,7 +620,7 @@ stm_wbetl_read(stm_tx_t *tx, volatile stm_word_t *addr)
 static INLINE w_entry_t *
 stm_wbetl_write(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t value, stm_word_t mask)
 {
-  volatile stm_word_t *lock;
+  volatile stm_lock_t *lock;
   stm_word_t l, version;
   w_entry_t *w;
   w_entry_t *prev = NULL;
@@ -573,7 +637,7 @@ stm_wbetl_write(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t value, stm_w
 
   /* Try to acquire lock */
  restart:
-  l = ATOMIC_LOAD_ACQ(lock);
+  l = LOCK_LOAD_ACQ(lock);
  restart_no_load:
   if (unlikely(LOCK_GET_OWNED(l))) {
     /* Locked */
@@ -593,7 +657,7 @@ stm_wbetl_write(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t value, stm_w
 #if CM == CM_MODULAR
       /* If read-locked: upgrade lock */
       if (!LOCK_GET_WRITE(l)) {
-        if (ATOMIC_CAS_FULL(lock, l, LOCK_UPGRADE(l)) == 0) {
+        if (LOCK_CAS_FULL(lock, l, LOCK_UPGRADE(l)) == 0) {
           /* Lock must have been stolen: abort */
           stm_rollback(tx, STM_ABORT_KILLED);
           return NULL;
@@ -628,6 +692,10 @@ stm_wbetl_write(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t value, stm_w
       /* Get version from previous write set entry (all entries in linked list have same version) */
       version = prev->version;
       /* Must add to write set */
+#ifdef COMPACT_LOCKS
+      if (unlikely(tx->w_set.nb_entries == tx->w_set.size && !WS_EXTENSIBLE(tx)) && stm_ws_overflow(tx, addr, value, mask))
+        return NULL;
+#endif /* COMPACT_LOCKS */
       if (tx->w_set.nb_entries == tx->w_set.size)
         stm_rollback(tx, STM_ABORT_EXTEND_WS);
       w = &tx->w_set.entries[tx->w_set.nb_entries];
@@ -649,7 +717,7 @@ stm_wbetl_write(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t value, stm_w
 #endif /* CM != CM_MODULAR && defined(IRREVOCABLE_ENABLED) */
 #if CM == CM_MODULAR
     t = w->tx->status;
-    l2 = ATOMIC_LOAD_ACQ(lock);
+    l2 = LOCK_LOAD_ACQ(lock);
     if (l != l2) {
       l = l2;
       goto restart_no_load;
@@ -671,6 +739,9 @@ stm_wbetl_write(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t value, stm_w
         (_tinystm.contention_manager != NULL ? _tinystm.contention_manager(tx, w->tx, WW_CONFLICT) : KILL_SELF);
       if (decision == KILL_OTHER) {
         /* Kill other */
+# ifdef CALL_SITES
+        stm_site_conflict(tx, tx->site, w);
+# endif /* CALL_SITES */
         if (!stm_kill(tx, w->tx, t)) {
           /* Transaction may have committed or aborted: retry */
           goto restart;
@@ -685,9 +756,9 @@ stm_wbetl_write(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t value, stm_w
     /* Kill self */
     if ((decision & DELAY_RESTART) != 0)
       tx->c_lock = lock;
-#elif CM == CM_DELAY
+#elif CM == CM_DELAY || DESIGN == MODULAR || defined(RETRY_POLICIES)
     tx->c_lock = lock;
-#endif /* CM == CM_DELAY */
+#endif /* CM == CM_DELAY || DESIGN == MODULAR || defined(RETRY_POLICIES) */
     /* Abort */
 #ifdef CONFLICT_TRACKING
     if (_tinystm.conflict_cb != NULL) {
@@ -696,6 +767,9 @@ stm_wbetl_write(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t value, stm_w
 # endif /* UNIT_TX */
         /* Call conflict callback */
         stm_tx_t *other = ((w_entry_t *)LOCK_GET_ADDR(l))->tx;
+# ifdef CALL_SITES
+        stm_site_conflict(tx, tx->site, (w_entry_t *)LOCK_GET_ADDR(l));
+# endif /* CALL_SITES */
         _tinystm.conflict_cb(tx, other);
 # ifdef UNIT_TX
       }
@@ -737,13 +811,17 @@ stm_wbetl_write(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t value, stm_w
 #ifdef IRREVOCABLE_ENABLED
  acquire_no_check:
 #endif /* IRREVOCABLE_ENABLED */
+#ifdef COMPACT_LOCKS
+  if (unlikely(tx->w_set.nb_entries == tx->w_set.size && !WS_EXTENSIBLE(tx)) && stm_ws_overflow(tx, addr, value, mask))
+    return NULL;
+#endif /* COMPACT_LOCKS */
   if (unlikely(tx->w_set.nb_entries == tx->w_set.size))
     stm_rollback(tx, STM_ABORT_EXTEND_WS);
   w = &tx->w_set.entries[tx->w_set.nb_entries];
 #if CM == CM_MODULAR
   w->version = version;
 #endif /* if CM == CM_MODULAR */
-  if (unlikely(ATOMIC_CAS_FULL(lock, l, LOCK_SET_ADDR_WRITE((stm_word_t)w)) == 0))
+  if (unlikely(LOCK_CAS_FULL(lock, l, LOCK_SET_ADDR_WRITE(LOCK_ENTRY(tx, w))) == 0))
     goto restart;
   /* We own the lock here (ETL) */
 do_write:
@@ -751,6 +829,9 @@ do_write:
   w->addr = addr;
   w->mask = mask;
   w->lock = lock;
+#ifdef CALL_SITES
+  w->site = tx->site;
+#endif /* CALL_SITES */
   if (unlikely(mask == 0)) {
     /* Do not write anything */
 #ifndef NDEBUG
@@ -779,7 +860,32 @@ do_write:
 static INLINE stm_word_t
 stm_wbetl_RaR(stm_tx_t *tx, volatile stm_word_t *addr)
 {
-  /* Possible optimization: avoid adding to read set again */
+  volatile stm_lock_t *lock;
+  stm_word_t l, l2, value;
+
+  PRINT_DEBUG2("==> stm_wbetl_RaR(t=%p[%lu-%lu],a=%p)\n", tx, (unsigned long)tx->start, (unsigned long)tx->end, addr);
+
+#if CM == CM_MODULAR
+  if (unlikely(tx->attr.visible_reads || GET_STATUS(tx->status) == TX_KILLED))
+    return stm_wbetl_read(tx, addr);
+#endif /* CM == CM_MODULAR */
+
+  /* Get reference to lock */
+  lock = GET_LOCK(addr);
+
+  /* Read lock, value, lock */
+  l = LOCK_LOAD_ACQ(lock);
+  if (likely(!LOCK_GET_OWNED(l))) {
+    value = ATOMIC_LOAD_ACQ(addr);
+    l2 = LOCK_LOAD_ACQ(lock);
+    /* The previous read of this address has already added the lock to the
+     * read set.  If the version is still within our snapshot, it must be
+     * the one recorded in the read set (any later update would get a
+     * timestamp higher than tx->end), so there is no need to log it again. */
+    if (likely(l == l2 && LOCK_GET_TIMESTAMP(l) <= tx->end))
+      return value;
+  }
+  /* Locked, concurrently updated or too recent: use regular read */
   return stm_wbetl_read(tx, addr);
 }
 
@@ -789,15 +895,28 @@ stm_wbetl_RaW(stm_tx_t *tx, volatile stm_word_t *addr)
   stm_word_t l;
   w_entry_t *w;
 
-  l = ATOMIC_LOAD_ACQ(GET_LOCK(addr));
-  /* Does the lock owned? */
-  assert(LOCK_GET_WRITE(l));
-  /* Do we own the lock? */
-  w = (w_entry_t *)LOCK_GET_ADDR(l);
-  assert(tx->w_set.entries <= w && w < tx->w_set.entries + tx->w_set.nb_entries);
+  PRINT_DEBUG2("==> stm_wbetl_RaW(t=%p[%lu-%lu],a=%p)\n", tx, (unsigned long)tx->start, (unsigned long)tx->end, addr);
 
-  /* Read directly from write set entry. */
-  return w->value;
+  l = LOCK_LOAD_ACQ(GET_LOCK(addr));
+  /* Is the lock owned (for writing)? */
+  if (likely(LOCK_GET_WRITE(l))) {
+    /* Do we own the lock? */
+    w = (w_entry_t *)LOCK_GET_ADDR(l);
+    if (likely(tx->w_set.entries <= w && w < tx->w_set.entries + tx->w_set.nb_entries)) {
+      /* Read directly from write set entry (all entries covered by the lock are chained) */
+      do {
+        if (addr == w->addr) {
+          /* Partial writes are merged with memory at write time */
+          return (w->mask == 0 ? ATOMIC_LOAD(addr) : w->value);
+        }
+        w = w->next;
+      } while (w != NULL);
+      /* Not written (other address covered by the same lock): memory is stable */
+      return ATOMIC_LOAD(addr);
+    }
+  }
+  /* Lock has been stolen or the hint was wrong: use regular read */
+  return stm_wbetl_read(tx, addr);
 }
 
 static INLINE stm_word_t
@@ -805,15 +924,15 @@ stm_wbetl_RfW(stm_tx_t *tx, volatile stm_word_t *addr)
 {
   /* Acquire lock as write. */
   stm_wbetl_write(tx, addr, 0, 0);
-  /* Now the lock is owned, read directly from memory is safe. */
-  /* TODO Unsafe with CM_MODULAR */
-  return *addr;
+  /* Now the lock is owned: the value is either in the write set or in memory. */
+  return stm_wbetl_RaW(tx, addr);
 }
 
 static INLINE void
 stm_wbetl_WaR(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t value, stm_word_t mask)
 {
-  /* Probably no optimization can be done here. */
+  /* The read set is only looked up when the lock version is too recent,
+   * in which case we abort anyway: nothing to gain here. */
   stm_wbetl_write(tx, addr, value, mask);
 }
 
@@ -823,30 +942,35 @@ stm_wbetl_WaW(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t value, stm_wor
   stm_word_t l;
   w_entry_t *w;
 
-  l = ATOMIC_LOAD_ACQ(GET_LOCK(addr));
-  /* Does the lock owned? */
-  assert(LOCK_GET_WRITE(l));
-  /* Do we own the lock? */
-  w = (w_entry_t *)LOCK_GET_ADDR(l);
-  assert(tx->w_set.entries <= w && w < tx->w_set.entries + tx->w_set.nb_entries);
+  PRINT_DEBUG2("==> stm_wbetl_WaW(t=%p[%lu-%lu],a=%p,d=%p-%lu,m=0x%lx)\n",
+               tx, (unsigned long)tx->start, (unsigned long)tx->end, addr, (void *)value, (unsigned long)value, (unsigned long)mask);
+
   /* in WaW, mask can never be 0 */
   assert(mask != 0);
-  while (1) {
-    if (addr == w->addr) {
-      /* No need to add to write set */
-      if (mask != ~(stm_word_t)0) {
-        if (w->mask == 0)
-          w->value = ATOMIC_LOAD(addr);
-        value = (w->value & ~mask) | (value & mask);
-      }
-      w->value = value;
-      w->mask |= mask;
-      return;
+  l = LOCK_LOAD_ACQ(GET_LOCK(addr));
+  /* Is the lock owned (for writing)? */
+  if (likely(LOCK_GET_WRITE(l))) {
+    /* Do we own the lock? */
+    w = (w_entry_t *)LOCK_GET_ADDR(l);
+    if (likely(tx->w_set.entries <= w && w < tx->w_set.entries + tx->w_set.nb_entries)) {
+      do {
+        if (addr == w->addr) {
+          /* No need to add to write set */
+          if (mask != ~(stm_word_t)0) {
+            if (w->mask == 0)
+              w->value = ATOMIC_LOAD(addr);
+            value = (w->value & ~mask) | (value & mask);
+          }
+          w->value = value;
+          w->mask |= mask;
+          return;
+        }
+        w = w->next;
+      } while (w != NULL);
     }
-    /* The entry must exist */
-    assert (w->next != NULL);
-    w = w->next;
   }
+  /* Lock has been stolen or the hint was wrong: use regular write */
+  stm_wbetl_write(tx, addr, value, mask);
 }
 
 static INLINE int
@@ -855,6 +979,9 @@ stm_wbetl_commit(stm_tx_t *tx)
   w_entry_t *w;
   stm_word_t t;
   int i;
+#ifdef NT_WRITE_BACK
+  int nt;
+#endif /* NT_WRITE_BACK */
 
   PRINT_DEBUG("==> stm_wbetl_commit(%p[%lu-%lu])\n", tx, (unsigned long)tx->start, (unsigned long)tx->end);
 
@@ -866,7 +993,7 @@ stm_wbetl_commit(stm_tx_t *tx)
     for (i = tx->w_set.nb_entries; i > 0; i--, w++) {
       /* Only drop lock for last covered address in write set */
       if (w->next == NULL)
-        ATOMIC_STORE_REL(w->lock, LOCK_SET_TIMESTAMP(w->version));
+        LOCK_STORE_REL(w->lock, LOCK_SET_TIMESTAMP(w->version));
     }
     /* Update clock so that future transactions get higher timestamp (liveness of timestamp CM) */
     FETCH_INC_CLOCK;
@@ -897,6 +1024,11 @@ stm_wbetl_commit(stm_tx_t *tx)
 # endif /* ! IRREVOCABLE_IMPROVED */
 #endif /* IRREVOCABLE_ENABLED */
 
+#ifdef REGION_SUMMARIES
+  /* Publish updated regions before getting the commit timestamp */
+  stm_update_regions(tx);
+#endif /* REGION_SUMMARIES */
+
   /* Get commit timestamp (may exceed VERSION_MAX by up to MAX_THREADS) */
   t = FETCH_INC_CLOCK + 1;
 #ifdef IRREVOCABLE_ENABLED
@@ -919,23 +1051,45 @@ stm_wbetl_commit(stm_tx_t *tx)
   release_locks:
 #endif /* IRREVOCABLE_ENABLED */
 
+#ifdef CDC
+  stm_cdc_append(tx, t);
+#endif /* CDC */
+
+#ifdef NT_WRITE_BACK
+  /* Bulk update: stream new versions to memory before dropping locks */
+  nt = (tx->w_set.nb_entries >= NT_THRESHOLD);
+  if (unlikely(nt))
+    stm_write_back_nt(tx);
+#endif /* NT_WRITE_BACK */
+
   /* Install new versions, drop locks and set new timestamp */
   w = tx->w_set.entries;
   for (i = tx->w_set.nb_entries; i > 0; i--, w++) {
+#ifdef NT_WRITE_BACK
+    if (w->mask != 0 && !nt)
+#else /* ! NT_WRITE_BACK */
     if (w->mask != 0)
+#endif /* ! NT_WRITE_BACK */
       ATOMIC_STORE(w->addr, w->value);
     /* Only drop lock for last covered address in write set */
     if (w->next == NULL) {
 # if CM == CM_MODULAR
       /* In case of visible read, reset lock to its previous timestamp */
       if (w->mask == 0)
-        ATOMIC_STORE_REL(w->lock, LOCK_SET_TIMESTAMP(w->version));
+        LOCK_STORE_REL(w->lock, LOCK_SET_TIMESTAMP(w->version));
       else
 # endif /* CM == CM_MODULAR */
-        ATOMIC_STORE_REL(w->lock, LOCK_SET_TIMESTAMP(t));
+        LOCK_STORE_REL(w->lock, LOCK_SET_TIMESTAMP(t));
     }
   }
 
+  /* Remember commit timestamp */
+  tx->end = t;
+
+#ifdef WATCH
+  stm_watch_notify(tx, t);
+#endif /* WATCH */
+
  end:
   return 1;
 }
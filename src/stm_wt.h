@@ -39,7 +39,7 @@ stm_wt_validate(stm_tx_t *tx)
   r = tx->r_set.entries;
   for (i = tx->r_set.nb_entries; i > 0; i--, r++) {
     /* Read lock */
-    l = ATOMIC_LOAD(r->lock);
+    l = LOCK_LOAD(r->lock);
     /* Unlocked and still the same version? */
     if (LOCK_GET_OWNED(l)) {
       /* Do we own the lock? */
@@ -55,6 +55,9 @@ stm_wt_validate(stm_tx_t *tx)
 # endif /* UNIT_TX */
             /* Call conflict callback */
             stm_tx_t *other = ((w_entry_t *)LOCK_GET_ADDR(l))->tx;
+# ifdef CALL_SITES
+            stm_site_conflict(tx, stm_site_of_read(tx, r), (w_entry_t *)LOCK_GET_ADDR(l));
+# endif /* CALL_SITES */
             _tinystm.conflict_cb(tx, other);
 # ifdef UNIT_TX
           }
@@ -133,10 +136,10 @@ stm_wt_rollback(stm_tx_t *tx)
         /* Get new version (may exceed VERSION_MAX by up to MAX_THREADS) */
         t = FETCH_INC_CLOCK + 1;
       }
-      ATOMIC_STORE_REL(w->lock, LOCK_SET_TIMESTAMP(t));
+      LOCK_STORE_REL(w->lock, LOCK_SET_TIMESTAMP(t));
     } else {
       /* Use new incarnation number */
-      ATOMIC_STORE_REL(w->lock, LOCK_UPD_INCARNATION(w->version, j));
+      LOCK_STORE_REL(w->lock, LOCK_UPD_INCARNATION(w->version, j));
     }
   }
   /* Make sure that all lock releases become visible */
@@ -144,7 +147,7 @@ stm_wt_rollback(stm_tx_t *tx)
 }
 
 static INLINE void
-stm_wt_add_to_rs(stm_tx_t *tx, stm_word_t version, volatile stm_word_t *lock)
+stm_wt_add_to_rs(stm_tx_t *tx, stm_word_t version, volatile stm_lock_t *lock)
 {
   r_entry_t *r;
 
@@ -154,7 +157,7 @@ stm_wt_add_to_rs(stm_tx_t *tx, stm_word_t version, volatile stm_word_t *lock)
 
 #ifdef NO_DUPLICATES_IN_RW_SETS
   if (stm_has_read(tx, lock) != NULL)
-    return value;
+    return;
 #endif /* NO_DUPLICATES_IN_RW_SETS */
 
   /* Add address and version to read set */
@@ -163,12 +166,15 @@ stm_wt_add_to_rs(stm_tx_t *tx, stm_word_t version, volatile stm_word_t *lock)
   r = &tx->r_set.entries[tx->r_set.nb_entries++];
   r->version = version;
   r->lock = lock;
+#ifdef CALL_SITES
+  stm_site_read(tx, r);
+#endif /* CALL_SITES */
 }
 
 static INLINE stm_word_t
 stm_wt_read(stm_tx_t *tx, volatile stm_word_t *addr)
 {
-  volatile stm_word_t *lock;
+  volatile stm_lock_t *lock;
   stm_word_t l, l2, value, version;
   w_entry_t *w;
 
@@ -183,12 +189,12 @@ stm_wt_read(stm_tx_t *tx, volatile stm_word_t *addr)
 
   /* Read lock, value, lock */
  restart:
-  l = ATOMIC_LOAD_ACQ(lock);
+  l = LOCK_LOAD_ACQ(lock);
  restart_no_load:
   if (likely(!LOCK_GET_WRITE(l))) {
     /* Not locked */
     value = ATOMIC_LOAD_ACQ(addr);
-    l2 = ATOMIC_LOAD_ACQ(lock);
+    l2 = LOCK_LOAD_ACQ(lock);
     if (l != l2) {
       l = l2;
       goto restart_no_load;
@@ -253,9 +259,9 @@ stm_wt_read(stm_tx_t *tx, volatile stm_word_t *addr)
       goto restart;
     }
 # endif /* defined(IRREVOCABLE_ENABLED) */
-# if CM == CM_DELAY
+# if CM == CM_DELAY || DESIGN == MODULAR || defined(RETRY_POLICIES)
     tx->c_lock = lock;
-# endif /* CM == CM_DELAY */
+# endif /* CM == CM_DELAY || DESIGN == MODULAR || defined(RETRY_POLICIES) */
 
     /* Abort */
 # ifdef CONFLICT_TRACKING
@@ -265,6 +271,9 @@ stm_wt_read(stm_tx_t *tx, volatile stm_word_t *addr)
 #  endif /* UNIT_TX */
         /* Call conflict callback */
         stm_tx_t *other = ((w_entry_t *)LOCK_GET_ADDR(l))->tx;
+#  ifdef CALL_SITES
+        stm_site_conflict(tx, tx->site, (w_entry_t *)LOCK_GET_ADDR(l));
+#  endif /* CALL_SITES */
         _tinystm.conflict_cb(tx, other);
 #  ifdef UNIT_TX
       }
@@ -280,7 +289,7 @@ stm_wt_read(stm_tx_t *tx, volatile stm_word_t *addr)
 static INLINE w_entry_t *
 stm_wt_write(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t value, stm_word_t mask)
 {
-  volatile stm_word_t *lock;
+  volatile stm_lock_t *lock;
   stm_word_t l, version;
   w_entry_t *w;
   w_entry_t *prev = NULL;
@@ -293,7 +302,7 @@ stm_wt_write(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t value, stm_word
 
   /* Try to acquire lock */
  restart:
-  l = ATOMIC_LOAD_ACQ(lock);
+  l = LOCK_LOAD_ACQ(lock);
  restart_no_load:
   if (LOCK_GET_OWNED(l)) {
     /* Locked */
@@ -335,6 +344,10 @@ stm_wt_write(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t value, stm_word
         prev = prev->next;
       }
       /* Must add to write set */
+#ifdef COMPACT_LOCKS
+      if (unlikely(tx->w_set.nb_entries == tx->w_set.size && !WS_EXTENSIBLE(tx)) && stm_ws_overflow(tx, addr, value, mask))
+        return NULL;
+#endif /* COMPACT_LOCKS */
       if (tx->w_set.nb_entries == tx->w_set.size)
         stm_rollback(tx, STM_ABORT_EXTEND_WS);
       w = &tx->w_set.entries[tx->w_set.nb_entries];
@@ -353,9 +366,9 @@ stm_wt_write(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t value, stm_word
       goto restart;
     }
 # endif /* defined(IRREVOCABLE_ENABLED) */
-# if CM == CM_DELAY
+# if CM == CM_DELAY || DESIGN == MODULAR || defined(RETRY_POLICIES)
     tx->c_lock = lock;
-# endif /* CM == CM_DELAY */
+# endif /* CM == CM_DELAY || DESIGN == MODULAR || defined(RETRY_POLICIES) */
 
     /* Abort */
 # ifdef CONFLICT_TRACKING
@@ -365,6 +378,9 @@ stm_wt_write(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t value, stm_word
 #  endif /* UNIT_TX */
         /* Call conflict callback */
         stm_tx_t *other = ((w_entry_t *)LOCK_GET_ADDR(l))->tx;
+#  ifdef CALL_SITES
+        stm_site_conflict(tx, tx->site, (w_entry_t *)LOCK_GET_ADDR(l));
+#  endif /* CALL_SITES */
         _tinystm.conflict_cb(tx, other);
 #  ifdef UNIT_TX
       }
@@ -403,10 +419,14 @@ stm_wt_write(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t value, stm_word
 #ifdef IRREVOCABLE_ENABLED
  acquire_no_check:
 #endif /* IRREVOCABLE_ENABLED */
+#ifdef COMPACT_LOCKS
+  if (unlikely(tx->w_set.nb_entries == tx->w_set.size && !WS_EXTENSIBLE(tx)) && stm_ws_overflow(tx, addr, value, mask))
+    return NULL;
+#endif /* COMPACT_LOCKS */
   if (tx->w_set.nb_entries == tx->w_set.size)
     stm_rollback(tx, STM_ABORT_EXTEND_WS);
   w = &tx->w_set.entries[tx->w_set.nb_entries];
-  if (ATOMIC_CAS_FULL(lock, l, LOCK_SET_ADDR_WRITE((stm_word_t)w)) == 0)
+  if (LOCK_CAS_FULL(lock, l, LOCK_SET_ADDR_WRITE(LOCK_ENTRY(tx, w))) == 0)
     goto restart;
   /* We store the old value of the lock (timestamp and incarnation) */
   w->version = l;
@@ -416,6 +436,9 @@ do_write:
   w->addr = addr;
   w->mask = mask;
   w->lock = lock;
+#ifdef CALL_SITES
+  w->site = tx->site;
+#endif /* CALL_SITES */
   if (mask == 0) {
     /* Do not write anything */
 #ifndef NDEBUG
@@ -443,26 +466,49 @@ do_write:
 static INLINE stm_word_t
 stm_wt_RaR(stm_tx_t *tx, volatile stm_word_t *addr)
 {
-  /* TODO same as fast read but no need to add into the RS */
+  volatile stm_lock_t *lock;
+  stm_word_t l, l2, value;
+
+  PRINT_DEBUG2("==> stm_wt_RaR(t=%p[%lu-%lu],a=%p)\n", tx, (unsigned long)tx->start, (unsigned long)tx->end, addr);
+
+  assert(IS_ACTIVE(tx->status));
+
+  /* Get reference to lock */
+  lock = GET_LOCK(addr);
+
+  /* Read lock, value, lock */
+  l = LOCK_LOAD_ACQ(lock);
+  if (likely(!LOCK_GET_WRITE(l))) {
+    value = ATOMIC_LOAD_ACQ(addr);
+    l2 = LOCK_LOAD_ACQ(lock);
+    /* Same version as recorded by the previous read: no need to add to
+     * read set again (any later update would have a timestamp higher
+     * than tx->end) */
+    if (likely(l == l2 && LOCK_GET_TIMESTAMP(l) <= tx->end))
+      return value;
+  }
+  /* Locked, concurrently updated or too recent: use regular read */
   return stm_wt_read(tx, addr);
 }
 
 static INLINE stm_word_t
 stm_wt_RaW(stm_tx_t *tx, volatile stm_word_t *addr)
 {
-#ifndef NDEBUG
   stm_word_t l;
   w_entry_t *w;
-  l = ATOMIC_LOAD_ACQ(GET_LOCK(addr));
-  /* Does the lock owned? */
-  assert(LOCK_GET_WRITE(l));
-  /* Do we own the lock? */
-  w = (w_entry_t *)LOCK_GET_ADDR(l);
-  assert(tx->w_set.entries <= w && w < tx->w_set.entries + tx->w_set.nb_entries);
-#endif /* ! NDEBUG */
 
-  /* Read directly from memory. */
-  return *addr;
+  l = LOCK_LOAD_ACQ(GET_LOCK(addr));
+  /* Is the lock owned? */
+  if (likely(LOCK_GET_WRITE(l))) {
+    /* Do we own the lock? */
+    w = (w_entry_t *)LOCK_GET_ADDR(l);
+    if (likely(tx->w_set.entries <= w && w < tx->w_set.entries + tx->w_set.nb_entries)) {
+      /* Read directly from memory. */
+      return ATOMIC_LOAD(addr);
+    }
+  }
+  /* Wrong hint: use regular read */
+  return stm_wt_read(tx, addr);
 }
 
 static INLINE stm_word_t
@@ -477,29 +523,35 @@ stm_wt_RfW(stm_tx_t *tx, volatile stm_word_t *addr)
 static INLINE void
 stm_wt_WaR(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t value, stm_word_t mask)
 {
-  /* Probably no optimization can be done here. */
+  /* The read set is only looked up when the lock version is too recent,
+   * in which case we abort anyway: nothing to gain here. */
   stm_wt_write(tx, addr, value, mask);
 }
 
 static INLINE void
 stm_wt_WaW(stm_tx_t *tx, volatile stm_word_t *addr, stm_word_t value, stm_word_t mask)
 {
-#ifndef NDEBUG
   stm_word_t l;
   w_entry_t *w;
-  l = ATOMIC_LOAD_ACQ(GET_LOCK(addr));
-  /* Does the lock owned? */
-  assert(LOCK_GET_WRITE(l));
-  /* Do we own the lock? */
-  w = (w_entry_t *)LOCK_GET_ADDR(l);
-  assert(tx->w_set.entries <= w && w < tx->w_set.entries + tx->w_set.nb_entries);
+
   /* in WaW, mask can never be 0 */
   assert(mask != 0);
-#endif /* ! NDEBUG */
-  if (mask != ~(stm_word_t)0) {
-    value = (ATOMIC_LOAD(addr) & ~mask) | (value & mask);
+  l = LOCK_LOAD_ACQ(GET_LOCK(addr));
+  /* Is the lock owned? */
+  if (likely(LOCK_GET_WRITE(l))) {
+    /* Do we own the lock? */
+    w = (w_entry_t *)LOCK_GET_ADDR(l);
+    if (likely(tx->w_set.entries <= w && w < tx->w_set.entries + tx->w_set.nb_entries)) {
+      /* Old value is already in the undo log: write directly to memory. */
+      if (mask != ~(stm_word_t)0) {
+        value = (ATOMIC_LOAD(addr) & ~mask) | (value & mask);
+      }
+      ATOMIC_STORE(addr, value);
+      return;
+    }
   }
-  ATOMIC_STORE(addr, value);
+  /* Wrong hint: use regular write */
+  stm_wt_write(tx, addr, value, mask);
 }
 
 static INLINE int
@@ -560,12 +612,20 @@ stm_wt_commit(stm_tx_t *tx)
   for (i = tx->w_set.nb_entries; i > 0; i--, w++) {
     if (w->next == NULL) {
       /* No need for CAS (can only be modified by owner transaction) */
-      ATOMIC_STORE(w->lock, LOCK_SET_TIMESTAMP(t));
+      LOCK_STORE(w->lock, LOCK_SET_TIMESTAMP(t));
     }
   }
   /* Make sure that all lock releases become visible */
   /* TODO: is ATOMIC_MB_WRITE required? */
   ATOMIC_MB_WRITE;
+
+  /* Remember commit timestamp */
+  tx->end = t;
+
+#ifdef WATCH
+  stm_watch_notify(tx, t);
+#endif /* WATCH */
+
 end:
   return 1;
 }
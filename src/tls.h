@@ -112,8 +112,14 @@ tls_set_gc(long gc)
 
 
 #elif defined(TLS_COMPILER)
-extern __thread struct stm_tx * thread_tx;
-extern __thread long thread_gc;
+# ifdef TLS_INITIAL_EXEC
+/* Avoid __tls_get_addr() calls when built as a shared library */
+#  define TLS_MODEL                     __attribute__((tls_model("initial-exec")))
+# else /* ! TLS_INITIAL_EXEC */
+#  define TLS_MODEL
+# endif /* ! TLS_INITIAL_EXEC */
+extern __thread struct stm_tx * thread_tx TLS_MODEL;
+extern __thread long thread_gc TLS_MODEL;
 
 static INLINE void
 tls_init(void)
@@ -66,6 +66,7 @@
 # define unlikely(x)                    __builtin_expect(!!(x), 0)
 # define INLINE                         inline __attribute__((always_inline))
 # define NOINLINE                       __attribute__((noinline))
+# define PREFETCHW(a)                   __builtin_prefetch((const void *)(a), 1, 3)
 # if defined(__INTEL_COMPILER)
 #  define ALIGNED                       /* Unknown */
 # else /* ! __INTEL_COMPILER */
@@ -76,6 +77,7 @@
 # define unlikely(x)                    (x)
 # define INLINE                         inline
 # define NOINLINE                       /* None in the C standard */
+# define PREFETCHW(a)                   /* None in the C standard */
 # define ALIGNED                        /* None in the C standard */
 #endif /* ! (defined(__GNUC__) || defined(__INTEL_COMPILER)) */
 
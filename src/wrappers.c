@@ -31,9 +31,10 @@
 
 #define ALLOW_MISALIGNED_ACCESSES
 
-#define TM_LOAD(addr)                stm_load(addr)
-#define TM_STORE(addr, val)          stm_store(addr, val)
-#define TM_STORE2(addr, val, mask)   stm_store2(addr, val, mask)
+/* The descriptor is fetched once by the public wrappers and passed along */
+#define TM_LOAD(addr)                stm_load_tx(tx, addr)
+#define TM_STORE(addr, val)          stm_store_tx(tx, addr, val)
+#define TM_STORE2(addr, val, mask)   stm_store2_tx(tx, addr, val, mask)
 
 typedef union convert_64 {
   uint64_t u64;
@@ -85,7 +86,7 @@ static void sanity_checks(void)
  * ################################################################### */
 
 static INLINE
-uint8_t int_stm_load_u8(volatile uint8_t *addr)
+uint8_t int_stm_load_u8(stm_tx_t *tx, volatile uint8_t *addr)
 {
   if (sizeof(stm_word_t) == 4) {
     convert_32_t val;
@@ -99,11 +100,11 @@ uint8_t int_stm_load_u8(volatile uint8_t *addr)
 }
 
 static INLINE
-uint16_t int_stm_load_u16(volatile uint16_t *addr)
+uint16_t int_stm_load_u16(stm_tx_t *tx, volatile uint16_t *addr)
 {
   if (unlikely(((uintptr_t)addr & 0x01) != 0)) {
     uint16_t val;
-    stm_load_bytes((volatile uint8_t *)addr, (uint8_t *)&val, sizeof(uint16_t));
+    stm_load_bytes_tx(tx, (volatile uint8_t *)addr, (uint8_t *)&val, sizeof(uint16_t));
     return val;
   } else if (sizeof(stm_word_t) == 4) {
     convert_32_t val;
@@ -117,11 +118,11 @@ uint16_t int_stm_load_u16(volatile uint16_t *addr)
 }
 
 static INLINE
-uint32_t int_stm_load_u32(volatile uint32_t *addr)
+uint32_t int_stm_load_u32(stm_tx_t *tx, volatile uint32_t *addr)
 {
   if (unlikely(((uintptr_t)addr & 0x03) != 0)) {
     uint32_t val;
-    stm_load_bytes((volatile uint8_t *)addr, (uint8_t *)&val, sizeof(uint32_t));
+    stm_load_bytes_tx(tx, (volatile uint8_t *)addr, (uint8_t *)&val, sizeof(uint32_t));
     return val;
   } else if (sizeof(stm_word_t) == 4) {
     return (uint32_t)TM_LOAD((volatile stm_word_t *)addr);
@@ -133,11 +134,11 @@ uint32_t int_stm_load_u32(volatile uint32_t *addr)
 }
 
 static INLINE
-uint64_t int_stm_load_u64(volatile uint64_t *addr)
+uint64_t int_stm_load_u64(stm_tx_t *tx, volatile uint64_t *addr)
 {
   if (unlikely(((uintptr_t)addr & 0x07) != 0)) {
     uint64_t val;
-    stm_load_bytes((volatile uint8_t *)addr, (uint8_t *)&val, sizeof(uint64_t));
+    stm_load_bytes_tx(tx, (volatile uint8_t *)addr, (uint8_t *)&val, sizeof(uint64_t));
     return val;
   } else if (sizeof(stm_word_t) == 4) {
     convert_64_t val;
@@ -155,97 +156,187 @@ uint64_t int_stm_load_u64(volatile uint64_t *addr)
 
 _CALLCONV uint8_t stm_load_u8(volatile uint8_t *addr)
 {
-  return int_stm_load_u8(addr);
+  TX_GET;
+  return stm_load_u8_tx(tx, addr);
+}
+
+_CALLCONV uint8_t stm_load_u8_tx(stm_tx_t *tx, volatile uint8_t *addr)
+{
+  return int_stm_load_u8(tx, addr);
 }
 
 _CALLCONV uint16_t stm_load_u16(volatile uint16_t *addr)
 {
-  return int_stm_load_u16(addr);
+  TX_GET;
+  return stm_load_u16_tx(tx, addr);
+}
+
+_CALLCONV uint16_t stm_load_u16_tx(stm_tx_t *tx, volatile uint16_t *addr)
+{
+  return int_stm_load_u16(tx, addr);
 }
 
 _CALLCONV uint32_t stm_load_u32(volatile uint32_t *addr)
 {
-  return int_stm_load_u32(addr);
+  TX_GET;
+  return stm_load_u32_tx(tx, addr);
+}
+
+_CALLCONV uint32_t stm_load_u32_tx(stm_tx_t *tx, volatile uint32_t *addr)
+{
+  return int_stm_load_u32(tx, addr);
 }
 
 _CALLCONV uint64_t stm_load_u64(volatile uint64_t *addr)
 {
-  return int_stm_load_u64(addr);
+  TX_GET;
+  return stm_load_u64_tx(tx, addr);
+}
+
+_CALLCONV uint64_t stm_load_u64_tx(stm_tx_t *tx, volatile uint64_t *addr)
+{
+  return int_stm_load_u64(tx, addr);
 }
 
 _CALLCONV char stm_load_char(volatile char *addr)
+{
+  TX_GET;
+  return stm_load_char_tx(tx, addr);
+}
+
+_CALLCONV char stm_load_char_tx(stm_tx_t *tx, volatile char *addr)
 {
   convert_8_t val;
-  val.u8 = int_stm_load_u8((volatile uint8_t *)addr);
+  val.u8 = int_stm_load_u8(tx, (volatile uint8_t *)addr);
   return val.s8;
 }
 
 _CALLCONV unsigned char stm_load_uchar(volatile unsigned char *addr)
 {
-  return (unsigned char)int_stm_load_u8((volatile uint8_t *)addr);
+  TX_GET;
+  return stm_load_uchar_tx(tx, addr);
+}
+
+_CALLCONV unsigned char stm_load_uchar_tx(stm_tx_t *tx, volatile unsigned char *addr)
+{
+  return (unsigned char)int_stm_load_u8(tx, (volatile uint8_t *)addr);
 }
 
 _CALLCONV short stm_load_short(volatile short *addr)
+{
+  TX_GET;
+  return stm_load_short_tx(tx, addr);
+}
+
+_CALLCONV short stm_load_short_tx(stm_tx_t *tx, volatile short *addr)
 {
   convert_16_t val;
-  val.u16 = int_stm_load_u16((volatile uint16_t *)addr);
+  val.u16 = int_stm_load_u16(tx, (volatile uint16_t *)addr);
   return val.s16;
 }
 
 _CALLCONV unsigned short stm_load_ushort(volatile unsigned short *addr)
 {
-  return (unsigned short)int_stm_load_u16((volatile uint16_t *)addr);
+  TX_GET;
+  return stm_load_ushort_tx(tx, addr);
+}
+
+_CALLCONV unsigned short stm_load_ushort_tx(stm_tx_t *tx, volatile unsigned short *addr)
+{
+  return (unsigned short)int_stm_load_u16(tx, (volatile uint16_t *)addr);
 }
 
 _CALLCONV int stm_load_int(volatile int *addr)
+{
+  TX_GET;
+  return stm_load_int_tx(tx, addr);
+}
+
+_CALLCONV int stm_load_int_tx(stm_tx_t *tx, volatile int *addr)
 {
   convert_32_t val;
-  val.u32 = int_stm_load_u32((volatile uint32_t *)addr);
+  val.u32 = int_stm_load_u32(tx, (volatile uint32_t *)addr);
   return val.s32;
 }
 
 _CALLCONV unsigned int stm_load_uint(volatile unsigned int *addr)
 {
-  return (unsigned int)int_stm_load_u32((volatile uint32_t *)addr);
+  TX_GET;
+  return stm_load_uint_tx(tx, addr);
+}
+
+_CALLCONV unsigned int stm_load_uint_tx(stm_tx_t *tx, volatile unsigned int *addr)
+{
+  return (unsigned int)int_stm_load_u32(tx, (volatile uint32_t *)addr);
 }
 
 _CALLCONV long stm_load_long(volatile long *addr)
+{
+  TX_GET;
+  return stm_load_long_tx(tx, addr);
+}
+
+_CALLCONV long stm_load_long_tx(stm_tx_t *tx, volatile long *addr)
 {
   if (sizeof(long) == 4) {
     convert_32_t val;
-    val.u32 = int_stm_load_u32((volatile uint32_t *)addr);
+    val.u32 = int_stm_load_u32(tx, (volatile uint32_t *)addr);
     return val.s32;
   } else {
     convert_64_t val;
-    val.u64 = int_stm_load_u64((volatile uint64_t *)addr);
+    val.u64 = int_stm_load_u64(tx, (volatile uint64_t *)addr);
     return val.s64;
   }
 }
 
 _CALLCONV unsigned long stm_load_ulong(volatile unsigned long *addr)
+{
+  TX_GET;
+  return stm_load_ulong_tx(tx, addr);
+}
+
+_CALLCONV unsigned long stm_load_ulong_tx(stm_tx_t *tx, volatile unsigned long *addr)
 {
   if (sizeof(long) == 4) {
-    return (unsigned long)int_stm_load_u32((volatile uint32_t *)addr);
+    return (unsigned long)int_stm_load_u32(tx, (volatile uint32_t *)addr);
   } else {
-    return (unsigned long)int_stm_load_u64((volatile uint64_t *)addr);
+    return (unsigned long)int_stm_load_u64(tx, (volatile uint64_t *)addr);
   }
 }
 
 _CALLCONV float stm_load_float(volatile float *addr)
+{
+  TX_GET;
+  return stm_load_float_tx(tx, addr);
+}
+
+_CALLCONV float stm_load_float_tx(stm_tx_t *tx, volatile float *addr)
 {
   convert_32_t val;
-  val.u32 = int_stm_load_u32((volatile uint32_t *)addr);
+  val.u32 = int_stm_load_u32(tx, (volatile uint32_t *)addr);
   return val.f;
 }
 
 _CALLCONV double stm_load_double(volatile double *addr)
+{
+  TX_GET;
+  return stm_load_double_tx(tx, addr);
+}
+
+_CALLCONV double stm_load_double_tx(stm_tx_t *tx, volatile double *addr)
 {
   convert_64_t val;
-  val.u64 = int_stm_load_u64((volatile uint64_t *)addr);
+  val.u64 = int_stm_load_u64(tx, (volatile uint64_t *)addr);
   return val.d;
 }
 
 _CALLCONV void *stm_load_ptr(volatile void **addr)
+{
+  TX_GET;
+  return stm_load_ptr_tx(tx, addr);
+}
+
+_CALLCONV void *stm_load_ptr_tx(stm_tx_t *tx, volatile void **addr)
 {
   union { stm_word_t w; void *v; } convert;
   convert.w = TM_LOAD((stm_word_t *)addr);
@@ -253,6 +344,12 @@ _CALLCONV void *stm_load_ptr(volatile void **addr)
 }
 
 _CALLCONV void stm_load_bytes(volatile uint8_t *addr, uint8_t *buf, size_t size)
+{
+  TX_GET;
+  stm_load_bytes_tx(tx, addr, buf, size);
+}
+
+_CALLCONV void stm_load_bytes_tx(stm_tx_t *tx, volatile uint8_t *addr, uint8_t *buf, size_t size)
 {
   convert_t val;
   unsigned int i;
@@ -295,7 +392,7 @@ _CALLCONV void stm_load_bytes(volatile uint8_t *addr, uint8_t *buf, size_t size)
  * ################################################################### */
 
 static INLINE
-void int_stm_store_u8(volatile uint8_t *addr, uint8_t value)
+void int_stm_store_u8(stm_tx_t *tx, volatile uint8_t *addr, uint8_t value)
 {
   if (sizeof(stm_word_t) == 4) {
     convert_32_t val, mask;
@@ -313,10 +410,10 @@ void int_stm_store_u8(volatile uint8_t *addr, uint8_t value)
 }
 
 static INLINE
-void int_stm_store_u16(volatile uint16_t *addr, uint16_t value)
+void int_stm_store_u16(stm_tx_t *tx, volatile uint16_t *addr, uint16_t value)
 {
   if (unlikely(((uintptr_t)addr & 0x01) != 0)) {
-    stm_store_bytes((volatile uint8_t *)addr, (uint8_t *)&value, sizeof(uint16_t));
+    stm_store_bytes_tx(tx, (volatile uint8_t *)addr, (uint8_t *)&value, sizeof(uint16_t));
   } else if (sizeof(stm_word_t) == 4) {
     convert_32_t val, mask;
     val.u16[((uintptr_t)addr & 0x03) >> 1] = value;
@@ -333,10 +430,10 @@ void int_stm_store_u16(volatile uint16_t *addr, uint16_t value)
 }
 
 static INLINE
-void int_stm_store_u32(volatile uint32_t *addr, uint32_t value)
+void int_stm_store_u32(stm_tx_t *tx, volatile uint32_t *addr, uint32_t value)
 {
   if (unlikely(((uintptr_t)addr & 0x03) != 0)) {
-    stm_store_bytes((volatile uint8_t *)addr, (uint8_t *)&value, sizeof(uint32_t));
+    stm_store_bytes_tx(tx, (volatile uint8_t *)addr, (uint8_t *)&value, sizeof(uint32_t));
   } else if (sizeof(stm_word_t) == 4) {
     TM_STORE((volatile stm_word_t *)addr, (stm_word_t)value);
   } else {
@@ -349,10 +446,10 @@ void int_stm_store_u32(volatile uint32_t *addr, uint32_t value)
 }
 
 static INLINE
-void int_stm_store_u64(volatile uint64_t *addr, uint64_t value)
+void int_stm_store_u64(stm_tx_t *tx, volatile uint64_t *addr, uint64_t value)
 {
   if (unlikely(((uintptr_t)addr & 0x07) != 0)) {
-    stm_store_bytes((volatile uint8_t *)addr, (uint8_t *)&value, sizeof(uint64_t));
+    stm_store_bytes_tx(tx, (volatile uint8_t *)addr, (uint8_t *)&value, sizeof(uint64_t));
   } else if (sizeof(stm_word_t) == 4) {
     convert_64_t val;
     val.u64 = value;
@@ -369,97 +466,187 @@ void int_stm_store_u64(volatile uint64_t *addr, uint64_t value)
 
 _CALLCONV void stm_store_u8(volatile uint8_t *addr, uint8_t value)
 {
-  int_stm_store_u8(addr, value);
+  TX_GET;
+  stm_store_u8_tx(tx, addr, value);
+}
+
+_CALLCONV void stm_store_u8_tx(stm_tx_t *tx, volatile uint8_t *addr, uint8_t value)
+{
+  int_stm_store_u8(tx, addr, value);
 }
 
 _CALLCONV void stm_store_u16(volatile uint16_t *addr, uint16_t value)
 {
-  int_stm_store_u16(addr, value);
+  TX_GET;
+  stm_store_u16_tx(tx, addr, value);
+}
+
+_CALLCONV void stm_store_u16_tx(stm_tx_t *tx, volatile uint16_t *addr, uint16_t value)
+{
+  int_stm_store_u16(tx, addr, value);
 }
 
 _CALLCONV void stm_store_u32(volatile uint32_t *addr, uint32_t value)
 {
-  int_stm_store_u32(addr, value);
+  TX_GET;
+  stm_store_u32_tx(tx, addr, value);
+}
+
+_CALLCONV void stm_store_u32_tx(stm_tx_t *tx, volatile uint32_t *addr, uint32_t value)
+{
+  int_stm_store_u32(tx, addr, value);
 }
 
 _CALLCONV void stm_store_u64(volatile uint64_t *addr, uint64_t value)
 {
-  int_stm_store_u64(addr, value);
+  TX_GET;
+  stm_store_u64_tx(tx, addr, value);
+}
+
+_CALLCONV void stm_store_u64_tx(stm_tx_t *tx, volatile uint64_t *addr, uint64_t value)
+{
+  int_stm_store_u64(tx, addr, value);
 }
 
 _CALLCONV void stm_store_char(volatile char *addr, char value)
+{
+  TX_GET;
+  stm_store_char_tx(tx, addr, value);
+}
+
+_CALLCONV void stm_store_char_tx(stm_tx_t *tx, volatile char *addr, char value)
 {
   convert_8_t val;
   val.s8 = value;
-  int_stm_store_u8((volatile uint8_t *)addr, val.u8);
+  int_stm_store_u8(tx, (volatile uint8_t *)addr, val.u8);
 }
 
 _CALLCONV void stm_store_uchar(volatile unsigned char *addr, unsigned char value)
 {
-  int_stm_store_u8((volatile uint8_t *)addr, (uint8_t)value);
+  TX_GET;
+  stm_store_uchar_tx(tx, addr, value);
+}
+
+_CALLCONV void stm_store_uchar_tx(stm_tx_t *tx, volatile unsigned char *addr, unsigned char value)
+{
+  int_stm_store_u8(tx, (volatile uint8_t *)addr, (uint8_t)value);
 }
 
 _CALLCONV void stm_store_short(volatile short *addr, short value)
+{
+  TX_GET;
+  stm_store_short_tx(tx, addr, value);
+}
+
+_CALLCONV void stm_store_short_tx(stm_tx_t *tx, volatile short *addr, short value)
 {
   convert_16_t val;
   val.s16 = value;
-  int_stm_store_u16((volatile uint16_t *)addr, val.u16);
+  int_stm_store_u16(tx, (volatile uint16_t *)addr, val.u16);
 }
 
 _CALLCONV void stm_store_ushort(volatile unsigned short *addr, unsigned short value)
 {
-  int_stm_store_u16((volatile uint16_t *)addr, (uint16_t)value);
+  TX_GET;
+  stm_store_ushort_tx(tx, addr, value);
+}
+
+_CALLCONV void stm_store_ushort_tx(stm_tx_t *tx, volatile unsigned short *addr, unsigned short value)
+{
+  int_stm_store_u16(tx, (volatile uint16_t *)addr, (uint16_t)value);
 }
 
 _CALLCONV void stm_store_int(volatile int *addr, int value)
+{
+  TX_GET;
+  stm_store_int_tx(tx, addr, value);
+}
+
+_CALLCONV void stm_store_int_tx(stm_tx_t *tx, volatile int *addr, int value)
 {
   convert_32_t val;
   val.s32 = value;
-  int_stm_store_u32((volatile uint32_t *)addr, val.u32);
+  int_stm_store_u32(tx, (volatile uint32_t *)addr, val.u32);
 }
 
 _CALLCONV void stm_store_uint(volatile unsigned int *addr, unsigned int value)
 {
-  int_stm_store_u32((volatile uint32_t *)addr, (uint32_t)value);
+  TX_GET;
+  stm_store_uint_tx(tx, addr, value);
+}
+
+_CALLCONV void stm_store_uint_tx(stm_tx_t *tx, volatile unsigned int *addr, unsigned int value)
+{
+  int_stm_store_u32(tx, (volatile uint32_t *)addr, (uint32_t)value);
 }
 
 _CALLCONV void stm_store_long(volatile long *addr, long value)
+{
+  TX_GET;
+  stm_store_long_tx(tx, addr, value);
+}
+
+_CALLCONV void stm_store_long_tx(stm_tx_t *tx, volatile long *addr, long value)
 {
   if (sizeof(long) == 4) {
     convert_32_t val;
     val.s32 = value;
-    int_stm_store_u32((volatile uint32_t *)addr, val.u32);
+    int_stm_store_u32(tx, (volatile uint32_t *)addr, val.u32);
   } else {
     convert_64_t val;
     val.s64 = value;
-    int_stm_store_u64((volatile uint64_t *)addr, val.u64);
+    int_stm_store_u64(tx, (volatile uint64_t *)addr, val.u64);
   }
 }
 
 _CALLCONV void stm_store_ulong(volatile unsigned long *addr, unsigned long value)
+{
+  TX_GET;
+  stm_store_ulong_tx(tx, addr, value);
+}
+
+_CALLCONV void stm_store_ulong_tx(stm_tx_t *tx, volatile unsigned long *addr, unsigned long value)
 {
   if (sizeof(long) == 4) {
-    int_stm_store_u32((volatile uint32_t *)addr, (uint32_t)value);
+    int_stm_store_u32(tx, (volatile uint32_t *)addr, (uint32_t)value);
   } else {
-    int_stm_store_u64((volatile uint64_t *)addr, (uint64_t)value);
+    int_stm_store_u64(tx, (volatile uint64_t *)addr, (uint64_t)value);
   }
 }
 
 _CALLCONV void stm_store_float(volatile float *addr, float value)
+{
+  TX_GET;
+  stm_store_float_tx(tx, addr, value);
+}
+
+_CALLCONV void stm_store_float_tx(stm_tx_t *tx, volatile float *addr, float value)
 {
   convert_32_t val;
   val.f = value;
-  int_stm_store_u32((volatile uint32_t *)addr, val.u32);
+  int_stm_store_u32(tx, (volatile uint32_t *)addr, val.u32);
 }
 
 _CALLCONV void stm_store_double(volatile double *addr, double value)
+{
+  TX_GET;
+  stm_store_double_tx(tx, addr, value);
+}
+
+_CALLCONV void stm_store_double_tx(stm_tx_t *tx, volatile double *addr, double value)
 {
   convert_64_t val;
   val.d = value;
-  int_stm_store_u64((volatile uint64_t *)addr, val.u64);
+  int_stm_store_u64(tx, (volatile uint64_t *)addr, val.u64);
 }
 
 _CALLCONV void stm_store_ptr(volatile void **addr, void *value)
+{
+  TX_GET;
+  stm_store_ptr_tx(tx, addr, value);
+}
+
+_CALLCONV void stm_store_ptr_tx(stm_tx_t *tx, volatile void **addr, void *value)
 {
   union { stm_word_t w; void *v; } convert;
   convert.v = value;
@@ -467,6 +654,12 @@ _CALLCONV void stm_store_ptr(volatile void **addr, void *value)
 }
 
 _CALLCONV void stm_store_bytes(volatile uint8_t *addr, uint8_t *buf, size_t size)
+{
+  TX_GET;
+  stm_store_bytes_tx(tx, addr, buf, size);
+}
+
+_CALLCONV void stm_store_bytes_tx(stm_tx_t *tx, volatile uint8_t *addr, uint8_t *buf, size_t size)
 {
   convert_t val, mask;
   unsigned int i;
@@ -510,6 +703,12 @@ _CALLCONV void stm_store_bytes(volatile uint8_t *addr, uint8_t *buf, size_t size
 }
 
 _CALLCONV void stm_set_bytes(volatile uint8_t *addr, uint8_t byte, size_t count)
+{
+  TX_GET;
+  stm_set_bytes_tx(tx, addr, byte, count);
+}
+
+_CALLCONV void stm_set_bytes_tx(stm_tx_t *tx, volatile uint8_t *addr, uint8_t byte, size_t count)
 {
   convert_t val, mask;
   unsigned int i;
@@ -26,6 +26,7 @@
 #include <assert.h>
 #include <getopt.h>
 #include <limits.h>
+#include <math.h>
 #include <pthread.h>
 #include <signal.h>
 #include <stdlib.h>
@@ -33,6 +34,8 @@
 #include <sys/time.h>
 #include <time.h>
 
+#include "mod_topo.h"
+
 #ifdef DEBUG
 # define IO_FLUSH                       fflush(NULL)
 /* Note: stdio is thread-safe */
@@ -49,9 +52,13 @@
 # include "../../abi/intel/tm_macros.h"
 #elif defined(TM_ABI)
 # include "../../abi/tm_macros.h"
-#endif /* defined(TM_ABI) */
+#elif defined(TM_MUTEX) || defined(TM_RWLOCK) || defined(TM_FINE_LOCKS)
+# include "../lock/tm_macros.h"
+#elif defined(TM_LOCK_FREE)
+# error "No lock-free version of the bank benchmark"
+#endif /* defined(TM_LOCK_FREE) */
 
-#if defined(TM_GCC) || defined(TM_DTMC) || defined(TM_INTEL) || defined(TM_ABI)
+#if defined(TM_GCC) || defined(TM_DTMC) || defined(TM_INTEL) || defined(TM_ABI) || defined(TM_LOCK)
 # define TM_COMPILER
 /* Add some attributes to library function */
 TM_PURE 
@@ -90,6 +97,12 @@ void perror(const char *s);
 #define DEFAULT_READ_THREADS            0
 #define DEFAULT_WRITE_THREADS           0
 #define DEFAULT_DISJOINT                0
+#define DEFAULT_BALANCE                 0
+#define DEFAULT_TX_ACCOUNTS             2
+#define DEFAULT_ZIPF                    0
+#define DEFAULT_HOT_ACCOUNTS            0
+#define DEFAULT_HOT_RATE                0
+#define DEFAULT_CROSS_RATE              0
 
 #define XSTR(s)                         STR(s)
 #define STR(s)                          #s
@@ -107,6 +120,9 @@ static volatile int stop;
 typedef struct account {
   long number;
   long balance;
+#ifdef TM_FINE_LOCKS
+  pthread_mutex_t lock;
+#endif /* TM_FINE_LOCKS */
 } account_t;
 
 typedef struct bank {
@@ -114,23 +130,130 @@ typedef struct bank {
   long size;
 } bank_t;
 
-static int transfer(account_t *src, account_t *dst, int amount)
+#ifdef TM_FINE_LOCKS
+/* Lock accounts in increasing address order to avoid deadlocks */
+static void lock_accounts(account_t **accounts, int nb)
+{
+  account_t *last, *next;
+  int i, j;
+
+  last = NULL;
+  for (i = 0; i < nb; i++) {
+    next = NULL;
+    for (j = 0; j < nb; j++) {
+      if (accounts[j] > last && (next == NULL || accounts[j] < next))
+        next = accounts[j];
+    }
+    pthread_mutex_lock(&next->lock);
+    last = next;
+  }
+}
+
+static void unlock_accounts(account_t **accounts, int nb)
+{
+  int i;
+
+  for (i = 0; i < nb; i++)
+    pthread_mutex_unlock(&accounts[i]->lock);
+}
+
+static int transfer(account_t **accounts, int nb, int amount)
+{
+  int j;
+
+  /* The first account pays the others (allow overdrafts) */
+  lock_accounts(accounts, nb);
+  accounts[0]->balance -= amount * (nb - 1);
+  for (j = 1; j < nb; j++)
+    accounts[j]->balance += amount;
+  unlock_accounts(accounts, nb);
+
+  return amount;
+}
+
+static long balance(account_t **accounts, int nb)
+{
+  long total;
+  int j;
+
+  lock_accounts(accounts, nb);
+  total = 0;
+  for (j = 0; j < nb; j++)
+    total += accounts[j]->balance;
+  unlock_accounts(accounts, nb);
+
+  return total;
+}
+
+static int total(bank_t *bank, int transactional)
+{
+  long i, total;
+
+  /* Accounts are stored in increasing address order */
+  if (transactional) {
+    for (i = 0; i < bank->size; i++)
+      pthread_mutex_lock(&bank->accounts[i].lock);
+  }
+  total = 0;
+  for (i = 0; i < bank->size; i++) {
+    total += bank->accounts[i].balance;
+  }
+  if (transactional) {
+    for (i = 0; i < bank->size; i++)
+      pthread_mutex_unlock(&bank->accounts[i].lock);
+  }
+
+  return total;
+}
+
+static void reset(bank_t *bank)
 {
   long i;
 
-  /* Allow overdrafts */
+  for (i = 0; i < bank->size; i++)
+    pthread_mutex_lock(&bank->accounts[i].lock);
+  for (i = 0; i < bank->size; i++) {
+    bank->accounts[i].balance = 0;
+  }
+  for (i = 0; i < bank->size; i++)
+    pthread_mutex_unlock(&bank->accounts[i].lock);
+}
+#else /* ! TM_FINE_LOCKS */
+static int transfer(account_t **accounts, int nb, int amount)
+{
+  long i;
+  int j;
+
+  /* The first account pays the others (allow overdrafts) */
   TM_START(0, RW);
-  i = TM_LOAD(&src->balance);
-  i -= amount;
-  TM_STORE(&src->balance, i);
-  i = TM_LOAD(&dst->balance);
-  i += amount;
-  TM_STORE(&dst->balance, i);
+  i = TM_LOAD(&accounts[0]->balance);
+  i -= amount * (nb - 1);
+  TM_STORE(&accounts[0]->balance, i);
+  for (j = 1; j < nb; j++) {
+    i = TM_LOAD(&accounts[j]->balance);
+    i += amount;
+    TM_STORE(&accounts[j]->balance, i);
+  }
   TM_COMMIT;
 
   return amount;
 }
 
+static long balance(account_t **accounts, int nb)
+{
+  long total;
+  int j;
+
+  TM_START(3, RO);
+  total = 0;
+  for (j = 0; j < nb; j++) {
+    total += TM_LOAD(&accounts[j]->balance);
+  }
+  TM_COMMIT;
+
+  return total;
+}
+
 static int total(bank_t *bank, int transactional)
 {
   long i, total;
@@ -162,6 +285,7 @@ static void reset(bank_t *bank)
   }
   TM_COMMIT;
 }
+#endif /* ! TM_FINE_LOCKS */
 
 /* ################################################################### *
  * BARRIER
@@ -205,7 +329,9 @@ static void barrier_cross(barrier_t *b)
 typedef struct thread_data {
   bank_t *bank;
   barrier_t *barrier;
+  double *zipf_cdf;
   unsigned long nb_transfer;
+  unsigned long nb_balance;
   unsigned long nb_read_all;
   unsigned long nb_write_all;
 #ifndef TM_COMPILER
@@ -219,27 +345,89 @@ typedef struct thread_data {
   unsigned long nb_aborts_validate_commit;
   unsigned long nb_aborts_invalid_memory;
   unsigned long nb_aborts_killed;
+  unsigned long nb_aborts_rr_conflict;
+  unsigned long nb_aborts_rw_conflict;
+  unsigned long nb_aborts_irrevocable;
+  unsigned long nb_aborts_extend_ws;
   unsigned long locked_reads_ok;
   unsigned long locked_reads_failed;
   unsigned long max_retries;
 #endif /* ! TM_COMPILER */
   unsigned int seed;
   int id;
+  int pinning;
   int read_all;
   int read_threads;
   int write_all;
   int write_threads;
   int disjoint;
   int nb_threads;
+  int balance;
+  int tx_accounts;
+  int hot_accounts;
+  int hot_rate;
+  int cross_rate;
   char padding[64];
 } thread_data_t;
 
+/* Pick an account index in [0, range) */
+static int choose_account(thread_data_t *d, unsigned short *seed, int range)
+{
+  double u;
+  int lo, hi, mid;
+
+  if (d->zipf_cdf != NULL) {
+    /* Zipfian distribution: binary search in the cumulative distribution */
+    u = erand48(seed);
+    lo = 0;
+    hi = range - 1;
+    while (lo < hi) {
+      mid = (lo + hi) / 2;
+      if (d->zipf_cdf[mid] < u)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    return lo;
+  }
+  if (d->hot_accounts > 0 && (int)(erand48(seed) * 100) < d->hot_rate) {
+    /* Hotspot: first accounts of the range */
+    return (int)(erand48(seed) * d->hot_accounts);
+  }
+  return (int)(erand48(seed) * range);
+}
+
+/* Pick tx_accounts distinct accounts in [rand_min, rand_min + rand_max) */
+static void choose_accounts(thread_data_t *d, unsigned short *seed, account_t **accounts, int rand_min, int rand_max)
+{
+  account_t *a;
+  int i, j, n, min;
+
+  for (i = 0; i < d->tx_accounts; i++) {
+    min = rand_min;
+    if (d->disjoint && d->cross_rate > 0 && (int)(erand48(seed) * 100) < d->cross_rate) {
+      /* Access the partition of another thread */
+      min = ((rand_min / rand_max + 1 + (int)(erand48(seed) * (d->nb_threads - 1))) % d->nb_threads) * rand_max;
+    }
+    n = choose_account(d, seed, rand_max);
+    /* Skip accounts already chosen */
+    do {
+      a = &d->bank->accounts[n + min];
+      for (j = 0; j < i && accounts[j] != a; j++)
+        ;
+      n = (n + 1) % rand_max;
+    } while (j < i);
+    accounts[i] = a;
+  }
+}
+
 static void *test(void *data)
 {
-  int src, dst, nb;
+  int nb;
   int rand_max, rand_min;
   thread_data_t *d = (thread_data_t *)data;
   unsigned short seed[3];
+  account_t **accounts;
 
   /* Initialize seed (use rand48 as rand is poor) */
   seed[0] = (unsigned short)rand_r(&d->seed);
@@ -250,7 +438,7 @@ static void *test(void *data)
   if (d->disjoint) {
     rand_max = d->bank->size / d->nb_threads;
     rand_min = rand_max * d->id;
-    if (rand_max <= 2) {
+    if (rand_max <= 2 || rand_max < d->tx_accounts) {
       fprintf(stderr, "can't have disjoint account accesses");
       return NULL;
     }
@@ -258,7 +446,14 @@ static void *test(void *data)
     rand_max = d->bank->size;
     rand_min = 0;
   }
+  if ((accounts = (account_t **)malloc(d->tx_accounts * sizeof(account_t *))) == NULL) {
+    perror("malloc");
+    exit(1);
+  }
 
+  /* Pin thread before allocating its transaction descriptor */
+  if (d->pinning != MOD_TOPO_NONE)
+    mod_topo_pin(d->pinning, d->id);
   /* Create transaction */
   TM_INIT_THREAD;
   /* Wait on barrier */
@@ -283,13 +478,15 @@ static void *test(void *data)
         /* Write all */
         reset(d->bank);
         d->nb_write_all++;
+      } else if (nb < d->read_all + d->write_all + d->balance) {
+        /* Read balance of random accounts */
+        choose_accounts(d, seed, accounts, rand_min, rand_max);
+        balance(accounts, d->tx_accounts);
+        d->nb_balance++;
       } else {
         /* Choose random accounts */
-        src = (int)(erand48(seed) * rand_max) + rand_min;
-        dst = (int)(erand48(seed) * rand_max) + rand_min;
-        if (dst == src)
-          dst = ((src + 1) % rand_max) + rand_min;
-        transfer(&d->bank->accounts[src], &d->bank->accounts[dst], 1);
+        choose_accounts(d, seed, accounts, rand_min, rand_max);
+        transfer(accounts, d->tx_accounts, 1);
         d->nb_transfer++;
       }
     }
@@ -305,6 +502,10 @@ static void *test(void *data)
   stm_get_stats("nb_aborts_validate_commit", &d->nb_aborts_validate_commit);
   stm_get_stats("nb_aborts_invalid_memory", &d->nb_aborts_invalid_memory);
   stm_get_stats("nb_aborts_killed", &d->nb_aborts_killed);
+  stm_get_stats("nb_aborts_rr_conflict", &d->nb_aborts_rr_conflict);
+  stm_get_stats("nb_aborts_rw_conflict", &d->nb_aborts_rw_conflict);
+  stm_get_stats("nb_aborts_irrevocable", &d->nb_aborts_irrevocable);
+  stm_get_stats("nb_aborts_extend_ws", &d->nb_aborts_extend_ws);
   stm_get_stats("locked_reads_ok", &d->locked_reads_ok);
   stm_get_stats("locked_reads_failed", &d->locked_reads_failed);
   stm_get_stats("max_retries", &d->max_retries);
@@ -312,6 +513,8 @@ static void *test(void *data)
   /* Free transaction */
   TM_EXIT_THREAD;
 
+  free(accounts);
+
   return NULL;
 }
 
@@ -332,24 +535,33 @@ int main(int argc, char **argv)
     {"contention-manager",        required_argument, NULL, 'c'},
     {"duration",                  required_argument, NULL, 'd'},
     {"num-threads",               required_argument, NULL, 'n'},
+    {"pinning",                   required_argument, NULL, 'p'},
     {"read-all-rate",             required_argument, NULL, 'r'},
     {"read-threads",              required_argument, NULL, 'R'},
     {"seed",                      required_argument, NULL, 's'},
     {"write-all-rate",            required_argument, NULL, 'w'},
     {"write-threads",             required_argument, NULL, 'W'},
     {"disjoint",                  no_argument,       NULL, 'j'},
+    {"balance-rate",              required_argument, NULL, 'b'},
+    {"tx-accounts",               required_argument, NULL, 'k'},
+    {"zipf",                      required_argument, NULL, 'z'},
+    {"hot-accounts",              required_argument, NULL, 'o'},
+    {"hot-rate",                  required_argument, NULL, 'O'},
+    {"cross-rate",                required_argument, NULL, 'x'},
     {NULL, 0, NULL, 0}
   };
 
   bank_t *bank;
-  int i, c, ret;
-  unsigned long reads, writes, updates;
+  int i, c, ret, range;
+  unsigned long reads, writes, updates, balances;
 #ifndef TM_COMPILER
   char *s;
   unsigned long aborts, aborts_1, aborts_2,
     aborts_locked_read, aborts_locked_write,
     aborts_validate_read, aborts_validate_write, aborts_validate_commit,
     aborts_invalid_memory, aborts_killed,
+    aborts_rr_conflict, aborts_rw_conflict,
+    aborts_irrevocable, aborts_extend_ws,
     locked_reads_ok, locked_reads_failed, max_retries;
   stm_ab_stats_t ab_stats;
   char *cm = NULL;
@@ -369,11 +581,20 @@ int main(int argc, char **argv)
   int write_all = DEFAULT_WRITE_ALL;
   int write_threads = DEFAULT_WRITE_THREADS;
   int disjoint = DEFAULT_DISJOINT;
+  int balance_rate = DEFAULT_BALANCE;
+  int tx_accounts = DEFAULT_TX_ACCOUNTS;
+  double zipf = DEFAULT_ZIPF;
+  int hot_accounts = DEFAULT_HOT_ACCOUNTS;
+  int hot_rate = DEFAULT_HOT_RATE;
+  int cross_rate = DEFAULT_CROSS_RATE;
+  int pinning = MOD_TOPO_NONE;
+  char *pin = NULL;
+  double *zipf_cdf = NULL;
   sigset_t block_set;
 
   while(1) {
     i = 0;
-    c = getopt_long(argc, argv, "ha:c:d:n:r:R:s:w:W:j", long_options, &i);
+    c = getopt_long(argc, argv, "ha:b:c:d:jk:n:o:O:p:r:R:s:w:W:x:z:", long_options, &i);
 
     if(c == -1)
       break;
@@ -396,14 +617,26 @@ int main(int argc, char **argv)
               "        Print this message\n"
               "  -a, --accounts <int>\n"
               "        Number of accounts in the bank (default=" XSTR(DEFAULT_NB_ACCOUNTS) ")\n"
+              "  -b, --balance-rate <int>\n"
+              "        Percentage of read-only balance queries (default=" XSTR(DEFAULT_BALANCE) ")\n"
 #ifndef TM_COMPILER
               "  -c, --contention-manager <string>\n"
               "        Contention manager for resolving conflicts (default=suicide)\n"
 #endif /* ! TM_COMPILER */
               "  -d, --duration <int>\n"
               "        Test duration in milliseconds (0=infinite, default=" XSTR(DEFAULT_DURATION) ")\n"
+              "  -j, --disjoint\n"
+              "        Each thread accesses its own partition of the accounts\n"
+              "  -k, --tx-accounts <int>\n"
+              "        Number of accounts accessed by transfers and balance queries (default=" XSTR(DEFAULT_TX_ACCOUNTS) ")\n"
               "  -n, --num-threads <int>\n"
               "        Number of threads (default=" XSTR(DEFAULT_NB_THREADS) ")\n"
+              "  -o, --hot-accounts <int>\n"
+              "        Number of hot accounts (default=" XSTR(DEFAULT_HOT_ACCOUNTS) ")\n"
+              "  -O, --hot-rate <int>\n"
+              "        Percentage of accesses to hot accounts (default=" XSTR(DEFAULT_HOT_RATE) ")\n"
+              "  -p, --pinning <string>\n"
+              "        Thread placement (none, compact, scatter or numa, default=none)\n"
               "  -r, --read-all-rate <int>\n"
               "        Percentage of read-all transactions (default=" XSTR(DEFAULT_READ_ALL) ")\n"
               "  -R, --read-threads <int>\n"
@@ -414,11 +647,18 @@ int main(int argc, char **argv)
               "        Percentage of write-all transactions (default=" XSTR(DEFAULT_WRITE_ALL) ")\n"
               "  -W, --write-threads <int>\n"
               "        Number of threads issuing only write-all transactions (default=" XSTR(DEFAULT_WRITE_THREADS) ")\n"
+              "  -x, --cross-rate <int>\n"
+              "        Percentage of accesses to other partitions with --disjoint (default=" XSTR(DEFAULT_CROSS_RATE) ")\n"
+              "  -z, --zipf <double>\n"
+              "        Zipf parameter of account selection (0=uniform, default=" XSTR(DEFAULT_ZIPF) ")\n"
          );
        exit(0);
      case 'a':
        nb_accounts = atoi(optarg);
        break;
+     case 'b':
+       balance_rate = atoi(optarg);
+       break;
 #ifndef TM_COMPILER
      case 'c':
        cm = optarg;
@@ -448,6 +688,28 @@ int main(int argc, char **argv)
      case 'j':
        disjoint = 1;
        break;
+     case 'k':
+       tx_accounts = atoi(optarg);
+       break;
+     case 'o':
+       hot_accounts = atoi(optarg);
+       break;
+     case 'O':
+       hot_rate = atoi(optarg);
+       break;
+     case 'p':
+       pin = optarg;
+       if ((pinning = mod_topo_policy(optarg)) < 0) {
+         printf("Unknown pinning policy \"%s\"\n", optarg);
+         exit(1);
+       }
+       break;
+     case 'x':
+       cross_rate = atoi(optarg);
+       break;
+     case 'z':
+       zipf = atof(optarg);
+       break;
      case '?':
        printf("Use -h or --help for help\n");
        exit(0);
@@ -459,20 +721,48 @@ int main(int argc, char **argv)
   assert(duration >= 0);
   assert(nb_accounts >= 2);
   assert(nb_threads > 0);
-  assert(read_all >= 0 && write_all >= 0 && read_all + write_all <= 100);
+  assert(read_all >= 0 && write_all >= 0 && balance_rate >= 0 && read_all + write_all + balance_rate <= 100);
   assert(read_threads + write_threads <= nb_threads);
+  assert(tx_accounts >= 2 && tx_accounts <= nb_accounts);
+  assert(zipf >= 0);
+  assert(hot_accounts >= 0 && hot_rate >= 0 && hot_rate <= 100);
+  assert(cross_rate >= 0 && cross_rate <= 100);
+
+  /* Accounts are chosen within the partition of the thread */
+  range = (disjoint ? nb_accounts / nb_threads : nb_accounts);
+  if (hot_accounts > range)
+    hot_accounts = range;
 
   printf("Nb accounts    : %d\n", nb_accounts);
+#if defined(TM_MUTEX)
+  printf("Sync           : global mutex\n");
+#elif defined(TM_RWLOCK)
+  printf("Sync           : global reader-writer lock\n");
+#elif defined(TM_FINE_LOCKS)
+  printf("Sync           : fine-grained locks\n");
+#endif /* defined(TM_FINE_LOCKS) */
 #ifndef TM_COMPILER
   printf("CM             : %s\n", (cm == NULL ? "DEFAULT" : cm));
 #endif /* ! TM_COMPILER */
   printf("Duration       : %d\n", duration);
   printf("Nb threads     : %d\n", nb_threads);
+  printf("Pinning        : %s\n", (pin == NULL ? "none" : pin));
+  if (pinning != MOD_TOPO_NONE) {
+    i = mod_topo_init();
+    printf("Topology       : %d CPUs, %d nodes\n", i, mod_topo_nb_nodes());
+  }
   printf("Read-all rate  : %d\n", read_all);
   printf("Read threads   : %d\n", read_threads);
   printf("Seed           : %d\n", seed);
   printf("Write-all rate : %d\n", write_all);
   printf("Write threads  : %d\n", write_threads);
+  printf("Balance rate   : %d\n", balance_rate);
+  printf("Tx accounts    : %d\n", tx_accounts);
+  printf("Disjoint       : %d\n", disjoint);
+  printf("Cross rate     : %d\n", cross_rate);
+  printf("Zipf           : %f\n", zipf);
+  printf("Hot accounts   : %d\n", hot_accounts);
+  printf("Hot rate       : %d\n", hot_rate);
   printf("Type sizes     : int=%d/long=%d/ptr=%d/word=%d\n",
          (int)sizeof(int),
          (int)sizeof(long),
@@ -502,6 +792,22 @@ int main(int argc, char **argv)
   for (i = 0; i < bank->size; i++) {
     bank->accounts[i].number = i;
     bank->accounts[i].balance = 0;
+#ifdef TM_FINE_LOCKS
+    pthread_mutex_init(&bank->accounts[i].lock, NULL);
+#endif /* TM_FINE_LOCKS */
+  }
+
+  if (zipf > 0 && range > 0) {
+    /* Cumulative distribution of account ranks */
+    if ((zipf_cdf = (double *)malloc(range * sizeof(double))) == NULL) {
+      perror("malloc");
+      exit(1);
+    }
+    zipf_cdf[0] = 1.0;
+    for (i = 1; i < range; i++)
+      zipf_cdf[i] = zipf_cdf[i - 1] + 1.0 / pow(i + 1, zipf);
+    for (i = 0; i < range; i++)
+      zipf_cdf[i] /= zipf_cdf[range - 1];
   }
 
   stop = 0;
@@ -527,13 +833,21 @@ int main(int argc, char **argv)
   for (i = 0; i < nb_threads; i++) {
     printf("Creating thread %d\n", i);
     data[i].id = i;
+    data[i].pinning = pinning;
     data[i].read_all = read_all;
     data[i].read_threads = read_threads;
     data[i].write_all = write_all;
     data[i].write_threads = write_threads;
     data[i].disjoint = disjoint;
     data[i].nb_threads = nb_threads;
+    data[i].balance = balance_rate;
+    data[i].tx_accounts = tx_accounts;
+    data[i].hot_accounts = hot_accounts;
+    data[i].hot_rate = hot_rate;
+    data[i].cross_rate = cross_rate;
+    data[i].zipf_cdf = zipf_cdf;
     data[i].nb_transfer = 0;
+    data[i].nb_balance = 0;
     data[i].nb_read_all = 0;
     data[i].nb_write_all = 0;
 #ifndef TM_COMPILER
@@ -547,6 +861,10 @@ int main(int argc, char **argv)
     data[i].nb_aborts_validate_commit = 0;
     data[i].nb_aborts_invalid_memory = 0;
     data[i].nb_aborts_killed = 0;
+    data[i].nb_aborts_rr_conflict = 0;
+    data[i].nb_aborts_rw_conflict = 0;
+    data[i].nb_aborts_irrevocable = 0;
+    data[i].nb_aborts_extend_ws = 0;
     data[i].locked_reads_ok = 0;
     data[i].locked_reads_failed = 0;
     data[i].max_retries = 0;
@@ -604,6 +922,10 @@ int main(int argc, char **argv)
   aborts_validate_commit = 0;
   aborts_invalid_memory = 0;
   aborts_killed = 0;
+  aborts_rr_conflict = 0;
+  aborts_rw_conflict = 0;
+  aborts_irrevocable = 0;
+  aborts_extend_ws = 0;
   locked_reads_ok = 0;
   locked_reads_failed = 0;
   max_retries = 0;
@@ -611,9 +933,11 @@ int main(int argc, char **argv)
   reads = 0;
   writes = 0;
   updates = 0;
+  balances = 0;
   for (i = 0; i < nb_threads; i++) {
     printf("Thread %d\n", i);
     printf("  #transfer   : %lu\n", data[i].nb_transfer);
+    printf("  #balance    : %lu\n", data[i].nb_balance);
     printf("  #read-all   : %lu\n", data[i].nb_read_all);
     printf("  #write-all  : %lu\n", data[i].nb_write_all);
 #ifndef TM_COMPILER
@@ -625,6 +949,10 @@ int main(int argc, char **argv)
     printf("    #val-c    : %lu\n", data[i].nb_aborts_validate_commit);
     printf("    #inv-mem  : %lu\n", data[i].nb_aborts_invalid_memory);
     printf("    #killed   : %lu\n", data[i].nb_aborts_killed);
+    printf("    #rr-conf  : %lu\n", data[i].nb_aborts_rr_conflict);
+    printf("    #rw-conf  : %lu\n", data[i].nb_aborts_rw_conflict);
+    printf("    #irrevoc  : %lu\n", data[i].nb_aborts_irrevocable);
+    printf("    #ext-ws   : %lu\n", data[i].nb_aborts_extend_ws);
     printf("  #aborts>=1  : %lu\n", data[i].nb_aborts_1);
     printf("  #aborts>=2  : %lu\n", data[i].nb_aborts_2);
     printf("  #lr-ok      : %lu\n", data[i].locked_reads_ok);
@@ -640,6 +968,10 @@ int main(int argc, char **argv)
     aborts_validate_commit += data[i].nb_aborts_validate_commit;
     aborts_invalid_memory += data[i].nb_aborts_invalid_memory;
     aborts_killed += data[i].nb_aborts_killed;
+    aborts_rr_conflict += data[i].nb_aborts_rr_conflict;
+    aborts_rw_conflict += data[i].nb_aborts_rw_conflict;
+    aborts_irrevocable += data[i].nb_aborts_irrevocable;
+    aborts_extend_ws += data[i].nb_aborts_extend_ws;
     locked_reads_ok += data[i].locked_reads_ok;
     locked_reads_failed += data[i].locked_reads_failed;
     if (max_retries < data[i].max_retries)
@@ -648,15 +980,17 @@ int main(int argc, char **argv)
     updates += data[i].nb_transfer;
     reads += data[i].nb_read_all;
     writes += data[i].nb_write_all;
+    balances += data[i].nb_balance;
   }
   /* Sanity check */
   ret = total(bank, 0);
   printf("Bank total    : %d (expected: 0)\n", ret);
   printf("Duration      : %d (ms)\n", duration);
-  printf("#txs          : %lu (%f / s)\n", reads + writes + updates, (reads + writes + updates) * 1000.0 / duration);
+  printf("#txs          : %lu (%f / s)\n", reads + writes + updates + balances, (reads + writes + updates + balances) * 1000.0 / duration);
   printf("#read txs     : %lu (%f / s)\n", reads, reads * 1000.0 / duration);
   printf("#write txs    : %lu (%f / s)\n", writes, writes * 1000.0 / duration);
   printf("#update txs   : %lu (%f / s)\n", updates, updates * 1000.0 / duration);
+  printf("#balance txs  : %lu (%f / s)\n", balances, balances * 1000.0 / duration);
 #ifndef TM_COMPILER
   printf("#aborts       : %lu (%f / s)\n", aborts, aborts * 1000.0 / duration);
   printf("  #lock-r     : %lu (%f / s)\n", aborts_locked_read, aborts_locked_read * 1000.0 / duration);
@@ -666,6 +1000,10 @@ int main(int argc, char **argv)
   printf("  #val-c      : %lu (%f / s)\n", aborts_validate_commit, aborts_validate_commit * 1000.0 / duration);
   printf("  #inv-mem    : %lu (%f / s)\n", aborts_invalid_memory, aborts_invalid_memory * 1000.0 / duration);
   printf("  #killed     : %lu (%f / s)\n", aborts_killed, aborts_killed * 1000.0 / duration);
+  printf("  #rr-conf    : %lu (%f / s)\n", aborts_rr_conflict, aborts_rr_conflict * 1000.0 / duration);
+  printf("  #rw-conf    : %lu (%f / s)\n", aborts_rw_conflict, aborts_rw_conflict * 1000.0 / duration);
+  printf("  #irrevoc    : %lu (%f / s)\n", aborts_irrevocable, aborts_irrevocable * 1000.0 / duration);
+  printf("  #ext-ws     : %lu (%f / s)\n", aborts_extend_ws, aborts_extend_ws * 1000.0 / duration);
   printf("#aborts>=1    : %lu (%f / s)\n", aborts_1, aborts_1 * 1000.0 / duration);
   printf("#aborts>=2    : %lu (%f / s)\n", aborts_2, aborts_2 * 1000.0 / duration);
   printf("#lr-ok        : %lu (%f / s)\n", locked_reads_ok, locked_reads_ok * 1000.0 / duration);
@@ -686,8 +1024,13 @@ int main(int argc, char **argv)
 #endif /* ! TM_COMPILER */
 
   /* Delete bank and accounts */
+#ifdef TM_FINE_LOCKS
+  for (i = 0; i < bank->size; i++)
+    pthread_mutex_destroy(&bank->accounts[i].lock);
+#endif /* TM_FINE_LOCKS */
   free(bank->accounts);
   free(bank);
+  free(zipf_cdf);
 
   /* Cleanup STM */
   TM_EXIT;
@@ -0,0 +1,764 @@
+/*
+ * File:
+ *   eigen.c
+ * Author(s):
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *   Patrick Marlier <patrick.marlier@unine.ch>
+ * Description:
+ *   Parametric microbenchmark (in the spirit of EigenBench).
+ *
+ * Copyright (c) 2007-2014.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * This program has a dual license and can also be distributed
+ * under the terms of the MIT license.
+ */
+
+/*
+ * Each thread repeatedly executes transactions that access three kinds
+ * of arrays, so that the characteristics of the workload can be varied
+ * independently of each other:
+ *   - the hot array is shared by all threads and accessed transactionally
+ *     (contention);
+ *   - the mild array is partitioned between threads and accessed
+ *     transactionally (working-set size and transactional overhead
+ *     without conflicts);
+ *   - the cold arrays are private to each thread and accessed without
+ *     instrumentation, inside or outside transactions (predominance of
+ *     transactional code).
+ * The number of reads and writes of each kind sets the transaction
+ * length and pollution (write ratio), the locality parameter sets the
+ * probability of reaccessing a recently used element (temporal
+ * locality), and the number of threads sets the concurrency.
+ */
+
+#include <assert.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "mod_topo.h"
+#include "stm.h"
+
+#define TM_START(tid, ro)               { stm_tx_attr_t _a = {{.id = tid, .read_only = ro}}; sigjmp_buf *_e = stm_start(_a); if (_e != NULL) sigsetjmp(*_e, 0)
+#define TM_LOAD(addr)                   stm_load((stm_word_t *)addr)
+#define TM_STORE(addr, value)           stm_store((stm_word_t *)addr, (stm_word_t)value)
+#define TM_COMMIT                       stm_commit(); }
+
+#define TM_INIT                         stm_init()
+#define TM_EXIT                         stm_exit()
+#define TM_INIT_THREAD                  stm_init_thread()
+#define TM_EXIT_THREAD                  stm_exit_thread()
+
+#define DEFAULT_DURATION                10000
+#define DEFAULT_NB_THREADS              1
+#define DEFAULT_SEED                    0
+#define DEFAULT_HOT_SIZE                1024
+#define DEFAULT_MILD_SIZE               65536
+#define DEFAULT_COLD_SIZE               16384
+#define DEFAULT_HOT_READS               4
+#define DEFAULT_HOT_WRITES              1
+#define DEFAULT_MILD_READS              8
+#define DEFAULT_MILD_WRITES             2
+#define DEFAULT_COLD_READS_IN           0
+#define DEFAULT_COLD_WRITES_IN          0
+#define DEFAULT_COLD_READS_OUT          0
+#define DEFAULT_COLD_WRITES_OUT         0
+#define DEFAULT_NOPS_IN                 0
+#define DEFAULT_NOPS_OUT                0
+#define DEFAULT_LOCALITY                0
+#define DEFAULT_HISTORY                 16
+
+#define XSTR(s)                         STR(s)
+#define STR(s)                          #s
+
+/* ################################################################### *
+ * GLOBALS
+ * ################################################################### */
+
+static volatile int stop;
+
+/* Operation types */
+enum {
+  HOT_READ,
+  HOT_WRITE,
+  MILD_READ,
+  MILD_WRITE,
+  COLD_READ,
+  COLD_WRITE,
+  NB_OPS
+};
+
+typedef struct op {
+  int type;
+  long index;
+} op_t;
+
+/* ################################################################### *
+ * TIMING
+ * ################################################################### */
+
+static inline uint64_t get_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  uint32_t a, d;
+  __asm__ __volatile__("rdtsc" : "=a" (a), "=d" (d));
+  return (((uint64_t)d) << 32) | (((uint64_t)a) & 0xffffffff);
+#else /* ! (defined(__x86_64__) || defined(__i386__)) */
+  /* Nanoseconds */
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif /* ! (defined(__x86_64__) || defined(__i386__)) */
+}
+
+/* ################################################################### *
+ * BARRIER
+ * ################################################################### */
+
+typedef struct barrier {
+  pthread_cond_t complete;
+  pthread_mutex_t mutex;
+  int count;
+  int crossing;
+} barrier_t;
+
+static void barrier_init(barrier_t *b, int n)
+{
+  pthread_cond_init(&b->complete, NULL);
+  pthread_mutex_init(&b->mutex, NULL);
+  b->count = n;
+  b->crossing = 0;
+}
+
+static void barrier_cross(barrier_t *b)
+{
+  pthread_mutex_lock(&b->mutex);
+  /* One more thread through */
+  b->crossing++;
+  /* If not all here, wait */
+  if (b->crossing < b->count) {
+    pthread_cond_wait(&b->complete, &b->mutex);
+  } else {
+    pthread_cond_broadcast(&b->complete);
+    /* Reset for next time */
+    b->crossing = 0;
+  }
+  pthread_mutex_unlock(&b->mutex);
+}
+
+/* ################################################################### *
+ * STRESS TEST
+ * ################################################################### */
+
+typedef struct thread_data {
+  barrier_t *barrier;
+  long *hot;
+  long *mild;
+  long *cold;
+  long hot_size;
+  long mild_size;                       /* Size of the partition of the thread */
+  long cold_size;
+  int nb[NB_OPS];                       /* Accesses per transaction (per type) */
+  int cold_reads_out;
+  int cold_writes_out;
+  int nops_in;
+  int nops_out;
+  int locality;
+  int history;
+  long *hist[3];                        /* Recently accessed elements (hot, mild, cold) */
+  int hist_pos[3];
+  int id;
+  int pinning;
+  unsigned long nb_txs;
+  unsigned long nb_accesses_in;
+  unsigned long nb_accesses_out;
+  uint64_t ticks_in;
+  uint64_t ticks_out;
+  unsigned long nb_aborts;
+  unsigned long nb_aborts_locked_read;
+  unsigned long nb_aborts_locked_write;
+  unsigned long nb_aborts_validate_read;
+  unsigned long nb_aborts_validate_write;
+  unsigned long nb_aborts_validate_commit;
+  unsigned long nb_aborts_killed;
+  unsigned long max_retries;
+  unsigned short seed[3];
+  char padding[64];
+} thread_data_t;
+
+/* Pick an element in [0, size), possibly among recently accessed ones */
+static long choose(thread_data_t *d, int array, long size)
+{
+  long i;
+
+  if (d->locality > 0 && (int)(erand48(d->seed) * 100) < d->locality) {
+    /* Temporal locality: reuse a recent element (if any) */
+    i = d->hist[array][(int)(erand48(d->seed) * d->history)];
+    if (i >= 0)
+      return i;
+  }
+  i = (long)(erand48(d->seed) * size);
+  d->hist[array][d->hist_pos[array]] = i;
+  d->hist_pos[array] = (d->hist_pos[array] + 1) % d->history;
+  return i;
+}
+
+/* Draw the accesses of the next transaction in random order */
+static int prepare(thread_data_t *d, op_t *ops)
+{
+  int left[NB_OPS];
+  int i, j, n, r;
+
+  n = 0;
+  for (i = 0; i < NB_OPS; i++) {
+    left[i] = d->nb[i];
+    n += left[i];
+  }
+  for (j = 0; j < n; j++) {
+    r = (int)(erand48(d->seed) * (n - j));
+    for (i = 0; r >= left[i]; i++)
+      r -= left[i];
+    left[i]--;
+    ops[j].type = i;
+    switch (i) {
+      case HOT_READ:
+      case HOT_WRITE:
+        ops[j].index = choose(d, 0, d->hot_size);
+        break;
+      case MILD_READ:
+      case MILD_WRITE:
+        ops[j].index = choose(d, 1, d->mild_size);
+        break;
+      default:
+        ops[j].index = choose(d, 2, d->cold_size);
+        break;
+    }
+  }
+  return n;
+}
+
+static void nops(int n)
+{
+  volatile int i;
+
+  for (i = 0; i < n; i++)
+    ;
+}
+
+static void *test(void *data)
+{
+  thread_data_t *d = (thread_data_t *)data;
+  op_t *ops;
+  uint64_t t;
+  long v;
+  int i, j, n;
+
+  if ((ops = (op_t *)malloc((d->nb[HOT_READ] + d->nb[HOT_WRITE] + d->nb[MILD_READ] + d->nb[MILD_WRITE] + d->nb[COLD_READ] + d->nb[COLD_WRITE] + 1) * sizeof(op_t))) == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+
+  /* Pin thread before allocating its transaction descriptor */
+  if (d->pinning != MOD_TOPO_NONE)
+    mod_topo_pin(d->pinning, d->id);
+  /* Create transaction */
+  TM_INIT_THREAD;
+  /* Wait on barrier */
+  barrier_cross(d->barrier);
+
+  while (stop == 0) {
+    n = prepare(d, ops);
+    v = 0;
+    t = get_ticks();
+    TM_START(0, (d->nb[HOT_WRITE] + d->nb[MILD_WRITE] == 0));
+    for (i = 0; i < n; i++) {
+      switch (ops[i].type) {
+        case HOT_READ:
+          v += (long)TM_LOAD(&d->hot[ops[i].index]);
+          break;
+        case HOT_WRITE:
+          TM_STORE(&d->hot[ops[i].index], (long)TM_LOAD(&d->hot[ops[i].index]) + 1);
+          break;
+        case MILD_READ:
+          v += (long)TM_LOAD(&d->mild[ops[i].index]);
+          break;
+        case MILD_WRITE:
+          TM_STORE(&d->mild[ops[i].index], (long)TM_LOAD(&d->mild[ops[i].index]) + 1);
+          break;
+        case COLD_READ:
+          v += d->cold[ops[i].index];
+          break;
+        case COLD_WRITE:
+          d->cold[ops[i].index]++;
+          break;
+      }
+      nops(d->nops_in);
+    }
+    TM_COMMIT;
+    d->ticks_in += get_ticks() - t;
+    d->nb_accesses_in += n;
+    d->nb_txs++;
+
+    /* Non-transactional work between transactions */
+    t = get_ticks();
+    for (j = 0; j < d->cold_reads_out; j++)
+      v += d->cold[choose(d, 2, d->cold_size)];
+    for (j = 0; j < d->cold_writes_out; j++)
+      d->cold[choose(d, 2, d->cold_size)] += v;
+    nops(d->nops_out);
+    d->ticks_out += get_ticks() - t;
+    d->nb_accesses_out += d->cold_reads_out + d->cold_writes_out;
+  }
+  stm_get_stats("nb_aborts", &d->nb_aborts);
+  stm_get_stats("nb_aborts_locked_read", &d->nb_aborts_locked_read);
+  stm_get_stats("nb_aborts_locked_write", &d->nb_aborts_locked_write);
+  stm_get_stats("nb_aborts_validate_read", &d->nb_aborts_validate_read);
+  stm_get_stats("nb_aborts_validate_write", &d->nb_aborts_validate_write);
+  stm_get_stats("nb_aborts_validate_commit", &d->nb_aborts_validate_commit);
+  stm_get_stats("nb_aborts_killed", &d->nb_aborts_killed);
+  stm_get_stats("max_retries", &d->max_retries);
+  /* Free transaction */
+  TM_EXIT_THREAD;
+
+  free(ops);
+
+  return NULL;
+}
+
+static void catcher(int sig)
+{
+  static int nb = 0;
+  printf("CAUGHT SIGNAL %d\n", sig);
+  if (++nb >= 3)
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+  struct option long_options[] = {
+    // These options don't set a flag
+    {"help",                      no_argument,       NULL, 'h'},
+    {"contention-manager",        required_argument, NULL, 'c'},
+    {"duration",                  required_argument, NULL, 'd'},
+    {"num-threads",               required_argument, NULL, 'n'},
+    {"pinning",                   required_argument, NULL, 'p'},
+    {"seed",                      required_argument, NULL, 's'},
+    {"hot-size",                  required_argument, NULL, 'A'},
+    {"mild-size",                 required_argument, NULL, 'B'},
+    {"cold-size",                 required_argument, NULL, 'C'},
+    {"hot-reads",                 required_argument, NULL, 'r'},
+    {"hot-writes",                required_argument, NULL, 'w'},
+    {"mild-reads",                required_argument, NULL, 'R'},
+    {"mild-writes",               required_argument, NULL, 'W'},
+    {"cold-reads-in",             required_argument, NULL, 'i'},
+    {"cold-writes-in",            required_argument, NULL, 'I'},
+    {"cold-reads-out",            required_argument, NULL, 'o'},
+    {"cold-writes-out",           required_argument, NULL, 'O'},
+    {"nops-in",                   required_argument, NULL, 'x'},
+    {"nops-out",                  required_argument, NULL, 'X'},
+    {"locality",                  required_argument, NULL, 'k'},
+    {"history",                   required_argument, NULL, 'l'},
+    {NULL, 0, NULL, 0}
+  };
+
+  thread_data_t *data;
+  pthread_t *threads;
+  pthread_attr_t attr;
+  barrier_t barrier;
+  struct timeval start, end;
+  struct timespec timeout;
+  long *hot, *mild;
+  unsigned long txs, accesses_in, accesses_out, aborts, aborts_locked_read, aborts_locked_write,
+    aborts_validate_read, aborts_validate_write, aborts_validate_commit, aborts_killed, max_retries;
+  uint64_t ticks_in, ticks_out;
+  int i, j, c;
+  char *s;
+  char *cm = NULL;
+  int duration = DEFAULT_DURATION;
+  int nb_threads = DEFAULT_NB_THREADS;
+  int seed = DEFAULT_SEED;
+  long hot_size = DEFAULT_HOT_SIZE;
+  long mild_size = DEFAULT_MILD_SIZE;
+  long cold_size = DEFAULT_COLD_SIZE;
+  int hot_reads = DEFAULT_HOT_READS;
+  int hot_writes = DEFAULT_HOT_WRITES;
+  int mild_reads = DEFAULT_MILD_READS;
+  int mild_writes = DEFAULT_MILD_WRITES;
+  int cold_reads_in = DEFAULT_COLD_READS_IN;
+  int cold_writes_in = DEFAULT_COLD_WRITES_IN;
+  int cold_reads_out = DEFAULT_COLD_READS_OUT;
+  int cold_writes_out = DEFAULT_COLD_WRITES_OUT;
+  int nops_in = DEFAULT_NOPS_IN;
+  int nops_out = DEFAULT_NOPS_OUT;
+  int locality = DEFAULT_LOCALITY;
+  int history = DEFAULT_HISTORY;
+  int pinning = MOD_TOPO_NONE;
+  char *pin = NULL;
+  sigset_t block_set;
+
+  while(1) {
+    i = 0;
+    c = getopt_long(argc, argv, "hc:d:n:p:s:A:B:C:r:w:R:W:i:I:o:O:x:X:k:l:", long_options, &i);
+
+    if(c == -1)
+      break;
+
+    if(c == 0 && long_options[i].flag == 0)
+      c = long_options[i].val;
+
+    switch(c) {
+     case 0:
+       /* Flag is automatically set */
+       break;
+     case 'h':
+       printf("eigen -- parametric STM microbenchmark\n"
+              "\n"
+              "Usage:\n"
+              "  eigen [options...]\n"
+              "\n"
+              "Options:\n"
+              "  -h, --help\n"
+              "        Print this message\n"
+              "  -c, --contention-manager <string>\n"
+              "        Contention manager for resolving conflicts (default=suicide)\n"
+              "  -d, --duration <int>\n"
+              "        Test duration in milliseconds (0=infinite, default=" XSTR(DEFAULT_DURATION) ")\n"
+              "  -n, --num-threads <int>\n"
+              "        Number of threads (default=" XSTR(DEFAULT_NB_THREADS) ")\n"
+              "  -p, --pinning <string>\n"
+              "        Thread placement (none, compact, scatter or numa, default=none)\n"
+              "  -s, --seed <int>\n"
+              "        RNG seed (0=time-based, default=" XSTR(DEFAULT_SEED) ")\n"
+              "  -A, --hot-size <int>\n"
+              "        Number of elements of the shared hot array (default=" XSTR(DEFAULT_HOT_SIZE) ")\n"
+              "  -B, --mild-size <int>\n"
+              "        Number of elements of the mild array, split between threads (default=" XSTR(DEFAULT_MILD_SIZE) ")\n"
+              "  -C, --cold-size <int>\n"
+              "        Number of elements of the private cold array of each thread (default=" XSTR(DEFAULT_COLD_SIZE) ")\n"
+              "  -r, --hot-reads <int>\n"
+              "        Reads of the hot array per transaction (default=" XSTR(DEFAULT_HOT_READS) ")\n"
+              "  -w, --hot-writes <int>\n"
+              "        Writes of the hot array per transaction (default=" XSTR(DEFAULT_HOT_WRITES) ")\n"
+              "  -R, --mild-reads <int>\n"
+              "        Reads of the mild array per transaction (default=" XSTR(DEFAULT_MILD_READS) ")\n"
+              "  -W, --mild-writes <int>\n"
+              "        Writes of the mild array per transaction (default=" XSTR(DEFAULT_MILD_WRITES) ")\n"
+              "  -i, --cold-reads-in <int>\n"
+              "        Uninstrumented reads of the cold array per transaction (default=" XSTR(DEFAULT_COLD_READS_IN) ")\n"
+              "  -I, --cold-writes-in <int>\n"
+              "        Uninstrumented writes of the cold array per transaction (default=" XSTR(DEFAULT_COLD_WRITES_IN) ")\n"
+              "  -o, --cold-reads-out <int>\n"
+              "        Reads of the cold array between transactions (default=" XSTR(DEFAULT_COLD_READS_OUT) ")\n"
+              "  -O, --cold-writes-out <int>\n"
+              "        Writes of the cold array between transactions (default=" XSTR(DEFAULT_COLD_WRITES_OUT) ")\n"
+              "  -x, --nops-in <int>\n"
+              "        Empty loop iterations after each access in transactions (default=" XSTR(DEFAULT_NOPS_IN) ")\n"
+              "  -X, --nops-out <int>\n"
+              "        Empty loop iterations between transactions (default=" XSTR(DEFAULT_NOPS_OUT) ")\n"
+              "  -k, --locality <int>\n"
+              "        Percentage of accesses to recently accessed elements (default=" XSTR(DEFAULT_LOCALITY) ")\n"
+              "  -l, --history <int>\n"
+              "        Number of recently accessed elements remembered per array (default=" XSTR(DEFAULT_HISTORY) ")\n"
+         );
+       exit(0);
+     case 'c':
+       cm = optarg;
+       break;
+     case 'd':
+       duration = atoi(optarg);
+       break;
+     case 'n':
+       nb_threads = atoi(optarg);
+       break;
+     case 'p':
+       pin = optarg;
+       if ((pinning = mod_topo_policy(optarg)) < 0) {
+         printf("Unknown pinning policy \"%s\"\n", optarg);
+         exit(1);
+       }
+       break;
+     case 's':
+       seed = atoi(optarg);
+       break;
+     case 'A':
+       hot_size = atol(optarg);
+       break;
+     case 'B':
+       mild_size = atol(optarg);
+       break;
+     case 'C':
+       cold_size = atol(optarg);
+       break;
+     case 'r':
+       hot_reads = atoi(optarg);
+       break;
+     case 'w':
+       hot_writes = atoi(optarg);
+       break;
+     case 'R':
+       mild_reads = atoi(optarg);
+       break;
+     case 'W':
+       mild_writes = atoi(optarg);
+       break;
+     case 'i':
+       cold_reads_in = atoi(optarg);
+       break;
+     case 'I':
+       cold_writes_in = atoi(optarg);
+       break;
+     case 'o':
+       cold_reads_out = atoi(optarg);
+       break;
+     case 'O':
+       cold_writes_out = atoi(optarg);
+       break;
+     case 'x':
+       nops_in = atoi(optarg);
+       break;
+     case 'X':
+       nops_out = atoi(optarg);
+       break;
+     case 'k':
+       locality = atoi(optarg);
+       break;
+     case 'l':
+       history = atoi(optarg);
+       break;
+     case '?':
+       printf("Use -h or --help for help\n");
+       exit(0);
+     default:
+       exit(1);
+    }
+  }
+
+  assert(duration >= 0);
+  assert(nb_threads > 0);
+  assert(hot_size > 0 && cold_size > 0 && mild_size >= nb_threads);
+  assert(hot_reads >= 0 && hot_writes >= 0 && mild_reads >= 0 && mild_writes >= 0);
+  assert(cold_reads_in >= 0 && cold_writes_in >= 0 && cold_reads_out >= 0 && cold_writes_out >= 0);
+  assert(nops_in >= 0 && nops_out >= 0);
+  assert(locality >= 0 && locality <= 100 && history > 0);
+
+  printf("CM             : %s\n", (cm == NULL ? "DEFAULT" : cm));
+  printf("Duration       : %d\n", duration);
+  printf("Nb threads     : %d\n", nb_threads);
+  printf("Pinning        : %s\n", (pin == NULL ? "none" : pin));
+  if (pinning != MOD_TOPO_NONE) {
+    i = mod_topo_init();
+    printf("Topology       : %d CPUs, %d nodes\n", i, mod_topo_nb_nodes());
+  }
+  printf("Seed           : %d\n", seed);
+  printf("Hot size       : %ld\n", hot_size);
+  printf("Mild size      : %ld\n", mild_size);
+  printf("Cold size      : %ld\n", cold_size);
+  printf("Hot r/w        : %d/%d\n", hot_reads, hot_writes);
+  printf("Mild r/w       : %d/%d\n", mild_reads, mild_writes);
+  printf("Cold r/w in    : %d/%d\n", cold_reads_in, cold_writes_in);
+  printf("Cold r/w out   : %d/%d\n", cold_reads_out, cold_writes_out);
+  printf("Nops in/out    : %d/%d\n", nops_in, nops_out);
+  printf("Locality       : %d (history=%d)\n", locality, history);
+
+  timeout.tv_sec = duration / 1000;
+  timeout.tv_nsec = (duration % 1000) * 1000000;
+
+  if ((data = (thread_data_t *)malloc(nb_threads * sizeof(thread_data_t))) == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  if ((threads = (pthread_t *)malloc(nb_threads * sizeof(pthread_t))) == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  if ((hot = (long *)calloc(hot_size, sizeof(long))) == NULL ||
+      (mild = (long *)calloc(mild_size, sizeof(long))) == NULL) {
+    perror("calloc");
+    exit(1);
+  }
+
+  if (seed == 0)
+    srand((int)time(NULL));
+  else
+    srand(seed);
+
+  stop = 0;
+
+  /* Init STM */
+  printf("Initializing STM\n");
+  TM_INIT;
+
+  if (stm_get_parameter("compile_flags", &s))
+    printf("STM flags      : %s\n", s);
+
+  if (cm != NULL) {
+    if (stm_set_parameter("cm_policy", cm) == 0)
+      printf("WARNING: cannot set contention manager \"%s\"\n", cm);
+  }
+
+  /* Access set from all threads */
+  barrier_init(&barrier, nb_threads + 1);
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+  for (i = 0; i < nb_threads; i++) {
+    printf("Creating thread %d\n", i);
+    data[i].barrier = &barrier;
+    data[i].hot = hot;
+    data[i].hot_size = hot_size;
+    data[i].mild_size = mild_size / nb_threads;
+    data[i].mild = mild + i * data[i].mild_size;
+    data[i].cold_size = cold_size;
+    if ((data[i].cold = (long *)calloc(cold_size, sizeof(long))) == NULL) {
+      perror("calloc");
+      exit(1);
+    }
+    data[i].nb[HOT_READ] = hot_reads;
+    data[i].nb[HOT_WRITE] = hot_writes;
+    data[i].nb[MILD_READ] = mild_reads;
+    data[i].nb[MILD_WRITE] = mild_writes;
+    data[i].nb[COLD_READ] = cold_reads_in;
+    data[i].nb[COLD_WRITE] = cold_writes_in;
+    data[i].cold_reads_out = cold_reads_out;
+    data[i].cold_writes_out = cold_writes_out;
+    data[i].nops_in = nops_in;
+    data[i].nops_out = nops_out;
+    data[i].locality = locality;
+    data[i].history = history;
+    for (j = 0; j < 3; j++) {
+      if ((data[i].hist[j] = (long *)malloc(history * sizeof(long))) == NULL) {
+        perror("malloc");
+        exit(1);
+      }
+      for (c = 0; c < history; c++)
+        data[i].hist[j][c] = -1;
+      data[i].hist_pos[j] = 0;
+    }
+    data[i].id = i;
+    data[i].pinning = pinning;
+    data[i].nb_txs = 0;
+    data[i].nb_accesses_in = 0;
+    data[i].nb_accesses_out = 0;
+    data[i].ticks_in = 0;
+    data[i].ticks_out = 0;
+    data[i].nb_aborts = 0;
+    data[i].nb_aborts_locked_read = 0;
+    data[i].nb_aborts_locked_write = 0;
+    data[i].nb_aborts_validate_read = 0;
+    data[i].nb_aborts_validate_write = 0;
+    data[i].nb_aborts_validate_commit = 0;
+    data[i].nb_aborts_killed = 0;
+    data[i].max_retries = 0;
+    data[i].seed[0] = (unsigned short)rand();
+    data[i].seed[1] = (unsigned short)rand();
+    data[i].seed[2] = (unsigned short)rand();
+    if (pthread_create(&threads[i], &attr, test, (void *)(&data[i])) != 0) {
+      fprintf(stderr, "Error creating thread\n");
+      exit(1);
+    }
+  }
+  pthread_attr_destroy(&attr);
+
+  /* Catch some signals */
+  if (signal(SIGHUP, catcher) == SIG_ERR ||
+      signal(SIGINT, catcher) == SIG_ERR ||
+      signal(SIGTERM, catcher) == SIG_ERR) {
+    perror("signal");
+    exit(1);
+  }
+
+  /* Start threads */
+  barrier_cross(&barrier);
+
+  printf("STARTING...\n");
+  gettimeofday(&start, NULL);
+  if (duration > 0) {
+    nanosleep(&timeout, NULL);
+  } else {
+    sigemptyset(&block_set);
+    sigsuspend(&block_set);
+  }
+  stop = 1;
+  gettimeofday(&end, NULL);
+  printf("STOPPING...\n");
+
+  /* Wait for thread completion */
+  for (i = 0; i < nb_threads; i++) {
+    if (pthread_join(threads[i], NULL) != 0) {
+      fprintf(stderr, "Error waiting for thread completion\n");
+      exit(1);
+    }
+  }
+
+  duration = (end.tv_sec * 1000 + end.tv_usec / 1000) - (start.tv_sec * 1000 + start.tv_usec / 1000);
+  txs = accesses_in = accesses_out = 0;
+  aborts = aborts_locked_read = aborts_locked_write = 0;
+  aborts_validate_read = aborts_validate_write = aborts_validate_commit = aborts_killed = 0;
+  max_retries = 0;
+  ticks_in = ticks_out = 0;
+  for (i = 0; i < nb_threads; i++) {
+    printf("Thread %d\n", i);
+    printf("  #txs        : %lu\n", data[i].nb_txs);
+    printf("  #aborts     : %lu\n", data[i].nb_aborts);
+    printf("  Ticks/access: %f (in) %f (out)\n",
+           data[i].nb_accesses_in ? (double)data[i].ticks_in / data[i].nb_accesses_in : 0.0,
+           data[i].nb_accesses_out ? (double)data[i].ticks_out / data[i].nb_accesses_out : 0.0);
+    txs += data[i].nb_txs;
+    accesses_in += data[i].nb_accesses_in;
+    accesses_out += data[i].nb_accesses_out;
+    ticks_in += data[i].ticks_in;
+    ticks_out += data[i].ticks_out;
+    aborts += data[i].nb_aborts;
+    aborts_locked_read += data[i].nb_aborts_locked_read;
+    aborts_locked_write += data[i].nb_aborts_locked_write;
+    aborts_validate_read += data[i].nb_aborts_validate_read;
+    aborts_validate_write += data[i].nb_aborts_validate_write;
+    aborts_validate_commit += data[i].nb_aborts_validate_commit;
+    aborts_killed += data[i].nb_aborts_killed;
+    if (max_retries < data[i].max_retries)
+      max_retries = data[i].max_retries;
+    free(data[i].cold);
+    for (j = 0; j < 3; j++)
+      free(data[i].hist[j]);
+  }
+  printf("Duration      : %d (ms)\n", duration);
+  printf("#txs          : %lu (%f / s)\n", txs, txs * 1000.0 / duration);
+  printf("#accesses     : %lu (%f / s)\n", accesses_in + accesses_out, (accesses_in + accesses_out) * 1000.0 / duration);
+  printf("#aborts       : %lu (%f / s)\n", aborts, aborts * 1000.0 / duration);
+  printf("  #lock-r     : %lu (%f / s)\n", aborts_locked_read, aborts_locked_read * 1000.0 / duration);
+  printf("  #lock-w     : %lu (%f / s)\n", aborts_locked_write, aborts_locked_write * 1000.0 / duration);
+  printf("  #val-r      : %lu (%f / s)\n", aborts_validate_read, aborts_validate_read * 1000.0 / duration);
+  printf("  #val-w      : %lu (%f / s)\n", aborts_validate_write, aborts_validate_write * 1000.0 / duration);
+  printf("  #val-c      : %lu (%f / s)\n", aborts_validate_commit, aborts_validate_commit * 1000.0 / duration);
+  printf("  #killed     : %lu (%f / s)\n", aborts_killed, aborts_killed * 1000.0 / duration);
+  printf("Abort rate    : %f\n", txs ? (double)aborts / (txs + aborts) : 0.0);
+  printf("Max retries   : %lu\n", max_retries);
+  /* Ticks are cycles on x86 and nanoseconds elsewhere */
+  printf("Ticks/access  : %f (in tx) %f (out of tx)\n",
+         accesses_in ? (double)ticks_in / accesses_in : 0.0,
+         accesses_out ? (double)ticks_out / accesses_out : 0.0);
+
+  /* Cleanup STM */
+  TM_EXIT;
+
+  free(hot);
+  free(mild);
+  free(threads);
+  free(data);
+
+  return 0;
+}
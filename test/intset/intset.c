@@ -31,9 +31,12 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 #include <sys/time.h>
 #include <time.h>
 
+#include "mod_topo.h"
+
 #define RO                              1
 #define RW                              0
 
@@ -47,9 +50,11 @@ static double tanger_wrapperpure_erand48(unsigned short int __xsubi[3]) __attrib
 # include "../../abi/intel/tm_macros.h"
 #elif defined(TM_ABI)
 # include "../../abi/tm_macros.h"
-#endif /* defined(TM_ABI) */
+#elif defined(TM_MUTEX) || defined(TM_RWLOCK) || defined(TM_FINE_LOCKS) || defined(TM_LOCK_FREE)
+# include "../lock/tm_macros.h"
+#endif /* defined(TM_MUTEX) || defined(TM_RWLOCK) || defined(TM_FINE_LOCKS) || defined(TM_LOCK_FREE) */
 
-#if defined(TM_GCC) || defined(TM_DTMC) || defined(TM_INTEL) || defined(TM_ABI)
+#if defined(TM_GCC) || defined(TM_DTMC) || defined(TM_INTEL) || defined(TM_ABI) || defined(TM_LOCK)
 # define TM_COMPILER
 /* Add some attributes to library function */
 TM_PURE 
@@ -61,6 +66,7 @@ void perror(const char *s);
 # include "stm.h"
 # include "mod_mem.h"
 # include "mod_ab.h"
+# include "mod_replay.h"
 
 /*
  * Useful macros to work with transactions. Note that, to use nested
@@ -81,6 +87,8 @@ void perror(const char *s);
 # define TM_MALLOC(size)                    stm_malloc(size)
 # define TM_FREE(addr)                      stm_free(addr, sizeof(*addr))
 # define TM_FREE2(addr, size)               stm_free(addr, size)
+# define TM_LOAD_RANGE(addr, buf, nb)       stm_load_range((stm_word_t *)addr, (stm_word_t *)buf, nb)
+# define TM_MALLOC_ALIGNED(size)            stm_malloc_aligned(size)
 
 # define TM_INIT                            stm_init(); mod_mem_init(0); mod_ab_init(0, NULL)
 # define TM_EXIT                            stm_exit()
@@ -98,9 +106,9 @@ void perror(const char *s);
 /* Note: stdio is thread-safe */
 #endif
 
-#if !(defined(USE_LINKEDLIST) || defined(USE_RBTREE) || defined(USE_SKIPLIST) || defined(USE_HASHSET))
-# error "Must define USE_LINKEDLIST or USE_RBTREE or USE_SKIPLIST or USE_HASHSET"
-#endif /* !(defined(USE_LINKEDLIST) || defined(USE_RBTREE) || defined(USE_SKIPLIST) || defined(USE_HASHSET)) */
+#if !(defined(USE_LINKEDLIST) || defined(USE_RBTREE) || defined(USE_SKIPLIST) || defined(USE_HASHSET) || defined(USE_SFTREE) || defined(USE_BPTREE))
+# error "Must define USE_LINKEDLIST or USE_RBTREE or USE_SKIPLIST or USE_HASHSET or USE_SFTREE or USE_BPTREE"
+#endif /* !(defined(USE_LINKEDLIST) || defined(USE_RBTREE) || defined(USE_SKIPLIST) || defined(USE_HASHSET) || defined(USE_SFTREE) || defined(USE_BPTREE)) */
 
 
 #define DEFAULT_DURATION                10000
@@ -109,10 +117,24 @@ void perror(const char *s);
 #define DEFAULT_RANGE                   (DEFAULT_INITIAL * 2)
 #define DEFAULT_SEED                    0
 #define DEFAULT_UPDATE                  20
+#define DEFAULT_SCAN                    0
+#define DEFAULT_SCAN_LENGTH             32
 
 #define XSTR(s)                         STR(s)
 #define STR(s)                          #s
 
+/* Operations as recorded in replay logs (tag = value << 2 | operation) */
+#define OP_CONTAINS                     0
+#define OP_ADD                          1
+#define OP_REMOVE                       2
+#define OP_SCAN                         3
+
+#ifndef TM_COMPILER
+# define REPLAY_TAG(op, val)            mod_replay_tag(((stm_word_t)(val) << 2) | (op))
+#else /* TM_COMPILER */
+# define REPLAY_TAG(op, val)
+#endif /* TM_COMPILER */
+
 /* ################################################################### *
  * GLOBALS
  * ################################################################### */
@@ -141,6 +163,8 @@ typedef struct thread_data {
   unsigned long nb_remove;
   unsigned long nb_contains;
   unsigned long nb_found;
+  unsigned long nb_scan;
+  unsigned long nb_scanned;
 #ifndef TM_COMPILER
   unsigned long nb_aborts;
   unsigned long nb_aborts_1;
@@ -155,11 +179,16 @@ typedef struct thread_data {
   unsigned long locked_reads_ok;
   unsigned long locked_reads_failed;
   unsigned long max_retries;
+  int replay;
 #endif /* ! TM_COMPILER */
   unsigned short seed[3];
+  int id;
+  int pinning;
   int diff;
   int range;
   int update;
+  int scan;
+  int scan_length;
   int alternate;
 #ifdef USE_LINKEDLIST
   int unit_tx;
@@ -167,7 +196,15 @@ typedef struct thread_data {
   char padding[64];
 } thread_data_t;
 
-#if defined(USE_LINKEDLIST)
+#if defined(TM_FINE_LOCKS) || defined(TM_LOCK_FREE)
+
+/* ################################################################### *
+ * FINE-GRAINED LOCKS / LOCK-FREE
+ * ################################################################### */
+
+# include "lockset.c"
+
+#elif defined(USE_LINKEDLIST)
 
 /* ################################################################### *
  * LINKEDLIST
@@ -255,7 +292,7 @@ static int set_size(intset_t *set)
 
 static int set_contains(intset_t *set, val_t val, thread_data_t *td)
 {
-  int result;
+  int result = 0;
   node_t *prev, *next;
   val_t v;
 
@@ -326,7 +363,7 @@ static int set_contains(intset_t *set, val_t val, thread_data_t *td)
 
 static int set_add(intset_t *set, val_t val, thread_data_t *td)
 {
-  int result;
+  int result = 0;
   node_t *prev, *next;
   val_t v;
 
@@ -411,7 +448,7 @@ static int set_add(intset_t *set, val_t val, thread_data_t *td)
 
 static int set_remove(intset_t *set, val_t val, thread_data_t *td)
 {
-  int result;
+  int result = 0;
   node_t *prev, *next;
   val_t v;
   node_t *n;
@@ -619,6 +656,52 @@ static int set_remove(intset_t *set, val_t val, thread_data_t *td)
   return result;
 }
 
+# define HAS_SCAN
+
+static int set_scan(intset_t *set, val_t val, int length, thread_data_t *td)
+{
+  int result = 0;
+  node_t *p, *n = NULL;
+
+# ifdef DEBUG
+  printf("++> set_scan(%d, %d)\n", val, length);
+  IO_FLUSH;
+# endif
+
+  if (!td) {
+    /* Find smallest element not smaller than val */
+    p = LDNODE((rbtree_t *)set, root);
+    while (p != NULL) {
+      if ((val_t)LDF(p, k) >= val) {
+        n = p;
+        p = LDNODE(p, l);
+      } else {
+        p = LDNODE(p, r);
+      }
+    }
+    for (; n != NULL && (val_t)LDF(n, k) < val + length; n = successor(n))
+      result++;
+  } else {
+    TM_START(3, RO);
+    result = 0;
+    n = NULL;
+    p = TX_LDNODE((rbtree_t *)set, root);
+    while (p != NULL) {
+      if ((val_t)TX_LDF_P(p, k) >= val) {
+        n = p;
+        p = TX_LDNODE(p, l);
+      } else {
+        p = TX_LDNODE(p, r);
+      }
+    }
+    for (; n != NULL && (val_t)TX_LDF_P(n, k) < val + length; n = TX_SUCCESSOR(n))
+      result++;
+    TM_COMMIT;
+  }
+
+  return result;
+}
+
 #elif defined(USE_SKIPLIST)
 
 /* ################################################################### *
@@ -932,6 +1015,56 @@ static int set_remove(intset_t *set, val_t val, thread_data_t *td)
   return result;
 }
 
+# define HAS_SCAN
+
+static int set_scan(intset_t *set, val_t val, int length, thread_data_t *td)
+{
+  int result = 0, i;
+  node_t *node, *next;
+  val_t v;
+
+# ifdef DEBUG
+  printf("++> set_scan(%d, %d)\n", val, length);
+  IO_FLUSH;
+# endif
+
+  if (!td) {
+    node = set->head;
+    for (i = set->level; i >= 0; i--) {
+      next = node->forward[i];
+      while (next->val < val) {
+        node = next;
+        next = node->forward[i];
+      }
+    }
+    for (node = node->forward[0]; node->val < val + length; node = node->forward[0])
+      result++;
+  } else {
+    TM_START(3, RO);
+    result = 0;
+    node = set->head;
+    for (i = TM_LOAD(&set->level); i >= 0; i--) {
+      next = (node_t *)TM_LOAD(&node->forward[i]);
+      while (1) {
+        v = TM_LOAD(&next->val);
+        if (v >= val)
+          break;
+        node = next;
+        next = (node_t *)TM_LOAD(&node->forward[i]);
+      }
+    }
+    /* Walk the bottom level */
+    node = (node_t *)TM_LOAD(&node->forward[0]);
+    while (TM_LOAD(&node->val) < val + length) {
+      result++;
+      node = (node_t *)TM_LOAD(&node->forward[0]);
+    }
+    TM_COMMIT;
+  }
+
+  return result;
+}
+
 #elif defined(USE_HASHSET)
 
 /* ################################################################### *
@@ -1178,154 +1311,992 @@ static int set_remove(intset_t *set, val_t val, thread_data_t *td)
   return result;
 }
 
-#endif /* defined(USE_HASHSET) */
+#elif defined(USE_SFTREE)
 
 /* ################################################################### *
- * BARRIER
+ * SPECULATION-FRIENDLY TREE
  * ################################################################### */
 
-typedef struct barrier {
-  pthread_cond_t complete;
-  pthread_mutex_t mutex;
-  int count;
-  int crossing;
-} barrier_t;
+/*
+ * Binary search tree in the style of the speculation-friendly tree of
+ * Crain, Gramoli and Raynal (PPoPP 2012).  Update transactions only
+ * insert leaves or flip the deleted flag of a node (logical deletion),
+ * so they never write near the root.  A background maintenance thread
+ * physically removes deleted nodes that have at most one child and
+ * rebalances the tree using local height information, each step being
+ * a separate small transaction.  Heights are only accessed by the
+ * maintenance thread and are therefore not transactional.
+ */
 
-static void barrier_init(barrier_t *b, int n)
-{
-  pthread_cond_init(&b->complete, NULL);
-  pthread_mutex_init(&b->mutex, NULL);
-  b->count = n;
-  b->crossing = 0;
-}
+# include <sched.h>
 
-static void barrier_cross(barrier_t *b)
+# define INIT_SET_PARAMETERS            /* Nothing */
+
+typedef intptr_t val_t;
+# define VAL_MAX                        INT_MAX
+
+typedef struct node {
+  val_t val;
+  struct node *left;
+  struct node *right;
+  intptr_t deleted;                     /* Logically deleted? */
+  int left_h;                           /* Heights (maintenance only) */
+  int right_h;
+  int local_h;
+} node_t;
+
+typedef struct intset {
+  node_t *root;                         /* Sentinel (tree is its left subtree) */
+  pthread_t maintenance;
+  volatile int stop;
+  unsigned long nb_removals;
+  unsigned long nb_rotations;
+} intset_t;
+
+TM_SAFE
+static node_t *new_node(val_t val, int transactional)
 {
-  pthread_mutex_lock(&b->mutex);
-  /* One more thread through */
-  b->crossing++;
-  /* If not all here, wait */
-  if (b->crossing < b->count) {
-    pthread_cond_wait(&b->complete, &b->mutex);
+  node_t *node;
+
+  if (!transactional) {
+    node = (node_t *)malloc(sizeof(node_t));
   } else {
-    pthread_cond_broadcast(&b->complete);
-    /* Reset for next time */
-    b->crossing = 0;
+    node = (node_t *)TM_MALLOC(sizeof(node_t));
   }
-  pthread_mutex_unlock(&b->mutex);
+  if (node == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+
+  node->val = val;
+  node->left = NULL;
+  node->right = NULL;
+  node->deleted = 0;
+  node->left_h = 0;
+  node->right_h = 0;
+  node->local_h = 1;
+
+  return node;
 }
 
-/* ################################################################### *
- * STRESS TEST
- * ################################################################### */
+static intset_t *set_new()
+{
+  intset_t *set;
 
-static void *test(void *data)
+  if ((set = (intset_t *)malloc(sizeof(intset_t))) == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  set->root = new_node(VAL_MAX, 0);
+  set->stop = 1;
+  set->nb_removals = 0;
+  set->nb_rotations = 0;
+
+  return set;
+}
+
+static void node_delete(node_t *node)
 {
-  int op, val, last = -1;
-  thread_data_t *d = (thread_data_t *)data;
+  if (node != NULL) {
+    node_delete(node->left);
+    node_delete(node->right);
+    free(node);
+  }
+}
 
-  /* Create transaction */
-  TM_INIT_THREAD;
-  /* Wait on barrier */
-  barrier_cross(d->barrier);
+static void set_delete(intset_t *set)
+{
+  node_delete(set->root);
+  free(set);
+}
 
-  while (stop == 0) {
-    op = rand_range(100, d->seed);
-    if (op < d->update) {
-      if (d->alternate) {
-        /* Alternate insertions and removals */
-        if (last < 0) {
-          /* Add random value */
-          val = rand_range(d->range, d->seed) + 1;
-          if (set_add(d->set, val, d)) {
-            d->diff++;
-            last = val;
-          }
-          d->nb_add++;
-        } else {
-          /* Remove last value */
-          if (set_remove(d->set, last, d))
-            d->diff--;
-          d->nb_remove++;
-          last = -1;
-        }
-      } else {
-        /* Randomly perform insertions and removals */
-        val = rand_range(d->range, d->seed) + 1;
-        if ((op & 0x01) == 0) {
-          /* Add random value */
-          if (set_add(d->set, val, d))
-            d->diff++;
-          d->nb_add++;
-        } else {
-          /* Remove random value */
-          if (set_remove(d->set, val, d))
-            d->diff--;
-          d->nb_remove++;
-        }
-      }
-    } else {
-      /* Look for random value */
-      val = rand_range(d->range, d->seed) + 1;
-      if (set_contains(d->set, val, d))
-        d->nb_found++;
-      d->nb_contains++;
-    }
+static int node_size(node_t *node, val_t min, val_t max)
+{
+  if (node == NULL)
+    return 0;
+  if (node->val <= min || node->val >= max) {
+    printf("Validation failed!\n");
+    exit(1);
   }
-#ifndef TM_COMPILER
-  stm_get_stats("nb_aborts", &d->nb_aborts);
-  stm_get_stats("nb_aborts_1", &d->nb_aborts_1);
-  stm_get_stats("nb_aborts_2", &d->nb_aborts_2);
-  stm_get_stats("nb_aborts_locked_read", &d->nb_aborts_locked_read);
-  stm_get_stats("nb_aborts_locked_write", &d->nb_aborts_locked_write);
-  stm_get_stats("nb_aborts_validate_read", &d->nb_aborts_validate_read);
-  stm_get_stats("nb_aborts_validate_write", &d->nb_aborts_validate_write);
-  stm_get_stats("nb_aborts_validate_commit", &d->nb_aborts_validate_commit);
-  stm_get_stats("nb_aborts_invalid_memory", &d->nb_aborts_invalid_memory);
-  stm_get_stats("nb_aborts_killed", &d->nb_aborts_killed);
-  stm_get_stats("locked_reads_ok", &d->locked_reads_ok);
-  stm_get_stats("locked_reads_failed", &d->locked_reads_failed);
-  stm_get_stats("max_retries", &d->max_retries);
-#endif /* ! TM_COMPILER */
-  /* Free transaction */
-  TM_EXIT_THREAD;
+  return (node->deleted ? 0 : 1) + node_size(node->left, min, node->val) + node_size(node->right, node->val, max);
+}
 
-  return NULL;
+static int set_size(intset_t *set)
+{
+  return node_size(set->root->left, INT_MIN, VAL_MAX);
 }
 
-int main(int argc, char **argv)
+static int set_contains(intset_t *set, val_t val, thread_data_t *td)
 {
-  struct option long_options[] = {
-    // These options don't set a flag
-    {"help",                      no_argument,       NULL, 'h'},
-    {"do-not-alternate",          no_argument,       NULL, 'a'},
-#ifndef TM_COMPILER
-    {"contention-manager",        required_argument, NULL, 'c'},
-#endif /* ! TM_COMPILER */
-    {"duration",                  required_argument, NULL, 'd'},
-    {"initial-size",              required_argument, NULL, 'i'},
-    {"num-threads",               required_argument, NULL, 'n'},
-    {"range",                     required_argument, NULL, 'r'},
-    {"seed",                      required_argument, NULL, 's'},
-    {"update-rate",               required_argument, NULL, 'u'},
-#ifdef USE_LINKEDLIST
-    {"unit-tx",                   no_argument,       NULL, 'x'},
-#endif /* LINKEDLIST */
-    {NULL, 0, NULL, 0}
-  };
+  int result;
+  node_t *node;
+  val_t v = 0;
 
-  intset_t *set;
-  int i, c, val, size, ret;
-  unsigned long reads, updates;
-#ifndef TM_COMPILER
-  char *s;
-  unsigned long aborts, aborts_1, aborts_2,
-    aborts_locked_read, aborts_locked_write,
-    aborts_validate_read, aborts_validate_write, aborts_validate_commit,
-    aborts_invalid_memory, aborts_killed,
-    locked_reads_ok, locked_reads_failed, max_retries;
-  stm_ab_stats_t ab_stats;
-#endif /* ! TM_COMPILER */
+# ifdef DEBUG
+  printf("++> set_contains(%d)\n", val);
+  IO_FLUSH;
+# endif
+
+  if (!td) {
+    node = set->root->left;
+    while (node != NULL && (v = node->val) != val)
+      node = (val < v ? node->left : node->right);
+    result = (node != NULL && !node->deleted);
+  } else {
+    TM_START(0, RO);
+    node = (node_t *)TM_LOAD(&set->root->left);
+    while (node != NULL && (v = TM_LOAD(&node->val)) != val)
+      node = (node_t *)(val < v ? TM_LOAD(&node->left) : TM_LOAD(&node->right));
+    result = (node != NULL && !TM_LOAD(&node->deleted));
+    TM_COMMIT;
+  }
+
+  return result;
+}
+
+static int set_add(intset_t *set, val_t val, thread_data_t *td)
+{
+  int result;
+  node_t *prev, *node;
+  val_t v = 0;
+
+# ifdef DEBUG
+  printf("++> set_add(%d)\n", val);
+  IO_FLUSH;
+# endif
+
+  if (!td) {
+    prev = set->root;
+    node = prev->left;
+    while (node != NULL && (v = node->val) != val) {
+      prev = node;
+      node = (val < v ? node->left : node->right);
+    }
+    if (node != NULL) {
+      result = (node->deleted != 0);
+      node->deleted = 0;
+    } else {
+      result = 1;
+      if (val < prev->val)
+        prev->left = new_node(val, 0);
+      else
+        prev->right = new_node(val, 0);
+    }
+  } else {
+    TM_START(1, RW);
+    prev = set->root;
+    node = (node_t *)TM_LOAD(&prev->left);
+    while (node != NULL && (v = TM_LOAD(&node->val)) != val) {
+      prev = node;
+      node = (node_t *)(val < v ? TM_LOAD(&node->left) : TM_LOAD(&node->right));
+    }
+    if (node != NULL) {
+      /* Revive logically deleted node */
+      result = (TM_LOAD(&node->deleted) != 0);
+      if (result)
+        TM_STORE(&node->deleted, 0);
+    } else {
+      /* Insert leaf */
+      result = 1;
+      if (prev == set->root || val < v)
+        TM_STORE(&prev->left, new_node(val, 1));
+      else
+        TM_STORE(&prev->right, new_node(val, 1));
+    }
+    TM_COMMIT;
+  }
+
+  return result;
+}
+
+static int set_remove(intset_t *set, val_t val, thread_data_t *td)
+{
+  int result;
+  node_t *node;
+  val_t v = 0;
+
+# ifdef DEBUG
+  printf("++> set_remove(%d)\n", val);
+  IO_FLUSH;
+# endif
+
+  if (!td) {
+    node = set->root->left;
+    while (node != NULL && (v = node->val) != val)
+      node = (val < v ? node->left : node->right);
+    result = (node != NULL && !node->deleted);
+    if (result)
+      node->deleted = 1;
+  } else {
+    TM_START(2, RW);
+    node = (node_t *)TM_LOAD(&set->root->left);
+    while (node != NULL && (v = TM_LOAD(&node->val)) != val)
+      node = (node_t *)(val < v ? TM_LOAD(&node->left) : TM_LOAD(&node->right));
+    /* Logical deletion (physical removal by maintenance thread) */
+    result = (node != NULL && !TM_LOAD(&node->deleted));
+    if (result)
+      TM_STORE(&node->deleted, 1);
+    TM_COMMIT;
+  }
+
+  return result;
+}
+
+/*
+ * Physically remove a deleted node with at most one child.
+ */
+static int maintenance_remove(intset_t *set, node_t *parent, int left, node_t *node)
+{
+  int result;
+  node_t **link, *l, *r;
+
+  link = (left ? &parent->left : &parent->right);
+  TM_START(4, RW);
+  result = 0;
+  if ((node_t *)TM_LOAD(link) == node && TM_LOAD(&node->deleted)) {
+    l = (node_t *)TM_LOAD(&node->left);
+    r = (node_t *)TM_LOAD(&node->right);
+    if (l == NULL || r == NULL) {
+      TM_STORE(link, (l != NULL ? l : r));
+      TM_FREE2(node, sizeof(node_t));
+      result = 1;
+    }
+  }
+  TM_COMMIT;
+
+  if (result)
+    set->nb_removals++;
+  return result;
+}
+
+static void maintenance_heights(node_t *node)
+{
+  node->local_h = (node->left_h > node->right_h ? node->left_h : node->right_h) + 1;
+}
+
+/*
+ * Rotate the child of a node to the right (its left child moves up) or
+ * to the left.  Returns the node that replaced it, or NULL.
+ */
+static node_t *maintenance_rotate(intset_t *set, node_t *parent, int left, int right_rotation)
+{
+  node_t **link, *node, *child, *moved;
+
+  link = (left ? &parent->left : &parent->right);
+  TM_START(5, RW);
+  node = (node_t *)TM_LOAD(link);
+  child = NULL;
+  if (node != NULL) {
+    child = (node_t *)(right_rotation ? TM_LOAD(&node->left) : TM_LOAD(&node->right));
+    if (child != NULL) {
+      if (right_rotation) {
+        moved = (node_t *)TM_LOAD(&child->right);
+        TM_STORE(&node->left, moved);
+        TM_STORE(&child->right, node);
+      } else {
+        moved = (node_t *)TM_LOAD(&child->left);
+        TM_STORE(&node->right, moved);
+        TM_STORE(&child->left, node);
+      }
+      TM_STORE(link, child);
+    }
+  }
+  TM_COMMIT;
+
+  if (child == NULL)
+    return NULL;
+  /* Only the maintenance thread updates heights */
+  if (right_rotation) {
+    node->left_h = child->right_h;
+    maintenance_heights(node);
+    child->right_h = node->local_h;
+  } else {
+    node->right_h = child->left_h;
+    maintenance_heights(node);
+    child->left_h = node->local_h;
+  }
+  maintenance_heights(child);
+  set->nb_rotations++;
+
+  return child;
+}
+
+/*
+ * Depth-first pass over the subtree rooted at a child of parent.
+ */
+static void maintenance_visit(intset_t *set, node_t *parent, int left)
+{
+  node_t *node, *l, *r;
+
+  TM_START(3, RO);
+  node = (node_t *)(left ? TM_LOAD(&parent->left) : TM_LOAD(&parent->right));
+  TM_COMMIT;
+  if (node == NULL)
+    return;
+
+  maintenance_visit(set, node, 1);
+  maintenance_visit(set, node, 0);
+
+  if (maintenance_remove(set, parent, left, node))
+    return;
+
+  TM_START(3, RO);
+  l = (node_t *)TM_LOAD(&node->left);
+  r = (node_t *)TM_LOAD(&node->right);
+  TM_COMMIT;
+  node->left_h = (l != NULL ? l->local_h : 0);
+  node->right_h = (r != NULL ? r->local_h : 0);
+  maintenance_heights(node);
+
+  if (node->left_h > node->right_h + 1) {
+    /* Left-right case: first rotate left child to the left */
+    if (l->right_h > l->left_h && maintenance_rotate(set, node, 1, 0) != NULL)
+      node->left_h = node->left->local_h;
+    maintenance_rotate(set, parent, left, 1);
+  } else if (node->right_h > node->left_h + 1) {
+    /* Right-left case: first rotate right child to the right */
+    if (r->left_h > r->right_h && maintenance_rotate(set, node, 0, 1) != NULL)
+      node->right_h = node->right->local_h;
+    maintenance_rotate(set, parent, left, 0);
+  }
+}
+
+static void *maintenance(void *data)
+{
+  intset_t *set = (intset_t *)data;
+
+  TM_INIT_THREAD;
+  while (set->stop == 0) {
+    maintenance_visit(set, set->root, 1);
+    /* Let application threads run if CPUs are scarce */
+    sched_yield();
+  }
+  TM_EXIT_THREAD;
+
+  return NULL;
+}
+
+static void set_start_maintenance(intset_t *set)
+{
+  set->stop = 0;
+  if (pthread_create(&set->maintenance, NULL, maintenance, set) != 0) {
+    fprintf(stderr, "Error creating maintenance thread\n");
+    exit(1);
+  }
+}
+
+static void set_stop_maintenance(intset_t *set)
+{
+  set->stop = 1;
+  if (pthread_join(set->maintenance, NULL) != 0) {
+    fprintf(stderr, "Error waiting for maintenance thread\n");
+    exit(1);
+  }
+  printf("Removals      : %lu\n", set->nb_removals);
+  printf("Rotations     : %lu\n", set->nb_rotations);
+}
+
+#elif defined(USE_BPTREE)
+
+/* ################################################################### *
+ * B+-TREE
+ * ################################################################### */
+
+/*
+ * B+-tree whose nodes follow the lock stripes: the header (number of
+ * keys, leaf flag and next leaf) fills whole stripes, keys fill whole
+ * stripes, and nodes are allocated on cache line boundaries.  Headers
+ * and keys are read with TM_LOAD_RANGE, i.e., with one lock check and
+ * one read set entry per stripe, and range scans follow the chain of
+ * leaves.  Full nodes are split on the way down so that insertions
+ * only write the nodes they traverse.  Removals do not merge nodes
+ * (leaves may become empty).
+ */
+
+# define HAS_SCAN
+
+# ifndef LOCK_SHIFT_EXTRA
+#  define LOCK_SHIFT_EXTRA              2       /* Same default as the library */
+# endif /* ! LOCK_SHIFT_EXTRA */
+# define BP_STRIPE                      (1 << LOCK_SHIFT_EXTRA)
+# define BP_HEADER                      (BP_STRIPE < 4 ? 4 : BP_STRIPE)
+# define BP_ORDER                       (4 * BP_HEADER)
+# define BP_LEAF_SIZE                   ((BP_HEADER + BP_ORDER) * sizeof(intptr_t))
+# define BP_NODE_SIZE                   ((BP_HEADER + BP_ORDER + BP_ORDER + BP_HEADER) * sizeof(intptr_t))
+
+# ifndef TM_LOAD_RANGE
+#  define TM_LOAD_RANGE(addr, buf, nb)  { int _i; for (_i = 0; _i < (nb); _i++) (buf)[_i] = TM_LOAD(&(addr)[_i]); }
+#  define TM_MALLOC_ALIGNED(size)       TM_MALLOC(size)
+# endif /* ! TM_LOAD_RANGE */
+
+/* Accessors for transactional (td != NULL) and sequential code */
+# define BP_LOAD(addr)                  (td != NULL ? (intptr_t)TM_LOAD(addr) : (intptr_t)*(addr))
+# define BP_STORE(addr, val)            if (td != NULL) { TM_STORE(addr, val); } else { *(addr) = (val); }
+# define BP_LOAD_RANGE(addr, buf, nb)   if (td != NULL) { TM_LOAD_RANGE(addr, buf, nb); } else { memcpy(buf, (void *)(addr), (nb) * sizeof(intptr_t)); }
+
+# define INIT_SET_PARAMETERS            /* Nothing */
+
+typedef intptr_t val_t;
+
+typedef struct node {
+  intptr_t nb;                          /* Number of keys */
+  intptr_t leaf;                        /* Leaf node? */
+  struct node *next;                    /* Next leaf */
+  intptr_t pad[BP_HEADER - 3];
+  val_t keys[BP_ORDER];                 /* Sorted keys */
+  struct node *children[BP_ORDER + BP_HEADER]; /* Children (inner nodes only) */
+} node_t;
+
+typedef struct intset {
+  node_t *root;
+} intset_t;
+
+TM_SAFE
+static node_t *new_node(int leaf, thread_data_t *td)
+{
+  node_t *node;
+  size_t size = (leaf ? BP_LEAF_SIZE : BP_NODE_SIZE);
+
+  if (td == NULL) {
+    if (posix_memalign((void **)&node, 64, size) != 0)
+      node = NULL;
+  } else {
+    node = (node_t *)TM_MALLOC_ALIGNED(size);
+  }
+  if (node == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+
+  /* Not yet visible to other threads */
+  node->nb = 0;
+  node->leaf = leaf;
+  node->next = NULL;
+
+  return node;
+}
+
+static intset_t *set_new()
+{
+  intset_t *set;
+
+  if ((set = (intset_t *)malloc(sizeof(intset_t))) == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  set->root = new_node(1, NULL);
+
+  return set;
+}
+
+static void node_delete(node_t *node)
+{
+  int i;
+
+  if (!node->leaf) {
+    for (i = 0; i <= node->nb; i++)
+      node_delete(node->children[i]);
+  }
+  free(node);
+}
+
+static void set_delete(intset_t *set)
+{
+  node_delete(set->root);
+  free(set);
+}
+
+static int set_size(intset_t *set)
+{
+  int size = 0, i;
+  node_t *node;
+  val_t last = INT_MIN;
+
+  node = set->root;
+  while (!node->leaf)
+    node = node->children[0];
+  for (; node != NULL; node = node->next) {
+    for (i = 0; i < node->nb; i++) {
+      if (node->keys[i] <= last) {
+        printf("Validation failed!\n");
+        exit(1);
+      }
+      last = node->keys[i];
+    }
+    size += node->nb;
+  }
+
+  return size;
+}
+
+/*
+ * Number of keys smaller than or equal to val (index of child).
+ */
+static inline int bp_upper(val_t *keys, int nb, val_t val)
+{
+  int i;
+
+  for (i = 0; i < nb && keys[i] <= val; i++)
+    ;
+  return i;
+}
+
+/*
+ * Number of keys smaller than val (position in leaf).
+ */
+static inline int bp_lower(val_t *keys, int nb, val_t val)
+{
+  int i;
+
+  for (i = 0; i < nb && keys[i] < val; i++)
+    ;
+  return i;
+}
+
+/*
+ * Find the leaf that may contain val and read its keys.
+ */
+TM_SAFE
+static node_t *bp_leaf(intset_t *set, val_t val, val_t *keys, int *nb, thread_data_t *td)
+{
+  node_t *node;
+  intptr_t header[3];
+
+  node = (node_t *)BP_LOAD(&set->root);
+  while (1) {
+    BP_LOAD_RANGE(&node->nb, header, 3);
+    BP_LOAD_RANGE(node->keys, keys, header[0]);
+    if (header[1])
+      break;
+    node = (node_t *)BP_LOAD(&node->children[bp_upper(keys, header[0], val)]);
+  }
+  *nb = header[0];
+
+  return node;
+}
+
+/*
+ * Split the full i-th child of a node that is not full.
+ */
+TM_SAFE
+static void bp_split(node_t *parent, int i, node_t *child, thread_data_t *td)
+{
+  node_t *node;
+  val_t keys[BP_ORDER], sep;
+  int j, nb, half = BP_ORDER / 2;
+
+  BP_LOAD_RANGE(child->keys, keys, BP_ORDER);
+  sep = keys[half];
+  if (BP_LOAD(&child->leaf)) {
+    /* Separator is the first key of the new leaf */
+    node = new_node(1, td);
+    for (j = half; j < BP_ORDER; j++)
+      node->keys[j - half] = keys[j];
+    node->nb = BP_ORDER - half;
+    node->next = (node_t *)BP_LOAD(&child->next);
+    BP_STORE(&child->next, node);
+  } else {
+    /* Separator moves up */
+    node = new_node(0, td);
+    for (j = half + 1; j < BP_ORDER; j++)
+      node->keys[j - half - 1] = keys[j];
+    for (j = half + 1; j <= BP_ORDER; j++)
+      node->children[j - half - 1] = (node_t *)BP_LOAD(&child->children[j]);
+    node->nb = BP_ORDER - half - 1;
+  }
+  BP_STORE(&child->nb, half);
+
+  /* Insert separator in parent */
+  nb = BP_LOAD(&parent->nb);
+  for (j = nb; j > i; j--) {
+    BP_STORE(&parent->keys[j], BP_LOAD(&parent->keys[j - 1]));
+    BP_STORE(&parent->children[j + 1], (node_t *)BP_LOAD(&parent->children[j]));
+  }
+  BP_STORE(&parent->keys[i], sep);
+  BP_STORE(&parent->children[i + 1], node);
+  BP_STORE(&parent->nb, nb + 1);
+}
+
+TM_SAFE
+static int bp_insert(intset_t *set, val_t val, thread_data_t *td)
+{
+  node_t *node, *child;
+  val_t keys[BP_ORDER];
+  intptr_t header[3];
+  int i, nb;
+
+  node = (node_t *)BP_LOAD(&set->root);
+  if (BP_LOAD(&node->nb) == BP_ORDER) {
+    /* Grow tree */
+    child = node;
+    node = new_node(0, td);
+    node->children[0] = child;
+    bp_split(node, 0, child, td);
+    BP_STORE(&set->root, node);
+  }
+  while (1) {
+    BP_LOAD_RANGE(&node->nb, header, 3);
+    nb = header[0];
+    BP_LOAD_RANGE(node->keys, keys, nb);
+    if (header[1])
+      break;
+    i = bp_upper(keys, nb, val);
+    child = (node_t *)BP_LOAD(&node->children[i]);
+    if (BP_LOAD(&child->nb) == BP_ORDER) {
+      /* Split on the way down (parent is not full) */
+      bp_split(node, i, child, td);
+      if (val >= BP_LOAD(&node->keys[i]))
+        child = (node_t *)BP_LOAD(&node->children[i + 1]);
+    }
+    node = child;
+  }
+
+  i = bp_lower(keys, nb, val);
+  if (i < nb && keys[i] == val)
+    return 0;
+  for (; nb > i; nb--) {
+    BP_STORE(&node->keys[nb], keys[nb - 1]);
+  }
+  BP_STORE(&node->keys[i], val);
+  BP_STORE(&node->nb, header[0] + 1);
+
+  return 1;
+}
+
+TM_SAFE
+static int bp_remove(intset_t *set, val_t val, thread_data_t *td)
+{
+  node_t *node;
+  val_t keys[BP_ORDER];
+  int i, nb;
+
+  node = bp_leaf(set, val, keys, &nb, td);
+  i = bp_lower(keys, nb, val);
+  if (i == nb || keys[i] != val)
+    return 0;
+  for (; i < nb - 1; i++) {
+    BP_STORE(&node->keys[i], keys[i + 1]);
+  }
+  BP_STORE(&node->nb, nb - 1);
+
+  return 1;
+}
+
+TM_SAFE
+static int bp_scan(intset_t *set, val_t val, int length, thread_data_t *td)
+{
+  node_t *node;
+  val_t keys[BP_ORDER];
+  intptr_t header[3];
+  int i, nb, result = 0;
+
+  node = bp_leaf(set, val, keys, &nb, td);
+  while (1) {
+    for (i = bp_lower(keys, nb, val); i < nb; i++) {
+      if (keys[i] >= val + length)
+        return result;
+      result++;
+    }
+    /* Follow leaf chain */
+    node = (node_t *)BP_LOAD(&node->next);
+    if (node == NULL)
+      return result;
+    BP_LOAD_RANGE(&node->nb, header, 3);
+    nb = header[0];
+    BP_LOAD_RANGE(node->keys, keys, nb);
+  }
+}
+
+static int set_contains(intset_t *set, val_t val, thread_data_t *td)
+{
+  int result, i, nb;
+  val_t keys[BP_ORDER];
+
+# ifdef DEBUG
+  printf("++> set_contains(%d)\n", val);
+  IO_FLUSH;
+# endif
+
+  if (!td) {
+    bp_leaf(set, val, keys, &nb, NULL);
+    i = bp_lower(keys, nb, val);
+    result = (i < nb && keys[i] == val);
+  } else {
+    TM_START(0, RO);
+    bp_leaf(set, val, keys, &nb, td);
+    i = bp_lower(keys, nb, val);
+    result = (i < nb && keys[i] == val);
+    TM_COMMIT;
+  }
+
+  return result;
+}
+
+static int set_add(intset_t *set, val_t val, thread_data_t *td)
+{
+  int result;
+
+# ifdef DEBUG
+  printf("++> set_add(%d)\n", val);
+  IO_FLUSH;
+# endif
+
+  if (!td) {
+    result = bp_insert(set, val, NULL);
+  } else {
+    TM_START(1, RW);
+    result = bp_insert(set, val, td);
+    TM_COMMIT;
+  }
+
+  return result;
+}
+
+static int set_remove(intset_t *set, val_t val, thread_data_t *td)
+{
+  int result;
+
+# ifdef DEBUG
+  printf("++> set_remove(%d)\n", val);
+  IO_FLUSH;
+# endif
+
+  if (!td) {
+    result = bp_remove(set, val, NULL);
+  } else {
+    TM_START(2, RW);
+    result = bp_remove(set, val, td);
+    TM_COMMIT;
+  }
+
+  return result;
+}
+
+static int set_scan(intset_t *set, val_t val, int length, thread_data_t *td)
+{
+  int result;
+
+# ifdef DEBUG
+  printf("++> set_scan(%d, %d)\n", val, length);
+  IO_FLUSH;
+# endif
+
+  if (!td) {
+    result = bp_scan(set, val, length, NULL);
+  } else {
+    TM_START(3, RO);
+    result = bp_scan(set, val, length, td);
+    TM_COMMIT;
+  }
+
+  return result;
+}
+
+#endif /* defined(USE_BPTREE) */
+
+/* ################################################################### *
+ * BARRIER
+ * ################################################################### */
+
+typedef struct barrier {
+  pthread_cond_t complete;
+  pthread_mutex_t mutex;
+  int count;
+  int crossing;
+} barrier_t;
+
+static void barrier_init(barrier_t *b, int n)
+{
+  pthread_cond_init(&b->complete, NULL);
+  pthread_mutex_init(&b->mutex, NULL);
+  b->count = n;
+  b->crossing = 0;
+}
+
+static void barrier_cross(barrier_t *b)
+{
+  pthread_mutex_lock(&b->mutex);
+  /* One more thread through */
+  b->crossing++;
+  /* If not all here, wait */
+  if (b->crossing < b->count) {
+    pthread_cond_wait(&b->complete, &b->mutex);
+  } else {
+    pthread_cond_broadcast(&b->complete);
+    /* Reset for next time */
+    b->crossing = 0;
+  }
+  pthread_mutex_unlock(&b->mutex);
+}
+
+/* ################################################################### *
+ * STRESS TEST
+ * ################################################################### */
+
+static void *test(void *data)
+{
+  int op, val, last = -1;
+#ifndef TM_COMPILER
+  stm_word_t tag;
+#endif /* ! TM_COMPILER */
+  thread_data_t *d = (thread_data_t *)data;
+
+  /* Pin thread before allocating its transaction descriptor */
+  if (d->pinning != MOD_TOPO_NONE)
+    mod_topo_pin(d->pinning, d->id);
+  /* Create transaction */
+  TM_INIT_THREAD;
+  /* Wait on barrier */
+  barrier_cross(d->barrier);
+
+#ifndef TM_COMPILER
+  if (d->replay) {
+    /* Execute the recorded operations in the recorded begin order */
+    while (mod_replay_next(&tag) >= 0) {
+      val = (int)(tag >> 2);
+      switch (tag & 0x03) {
+        case OP_ADD:
+          if (set_add(d->set, val, d))
+            d->diff++;
+          d->nb_add++;
+          break;
+        case OP_REMOVE:
+          if (set_remove(d->set, val, d))
+            d->diff--;
+          d->nb_remove++;
+          break;
+#ifdef HAS_SCAN
+        case OP_SCAN:
+          d->nb_scanned += set_scan(d->set, val, d->scan_length, d);
+          d->nb_scan++;
+          break;
+#endif /* HAS_SCAN */
+        default:
+          if (set_contains(d->set, val, d))
+            d->nb_found++;
+          d->nb_contains++;
+      }
+    }
+  } else
+#endif /* ! TM_COMPILER */
+  while (stop == 0) {
+    op = rand_range(100, d->seed);
+    if (op < d->update) {
+      if (d->alternate) {
+        /* Alternate insertions and removals */
+        if (last < 0) {
+          /* Add random value */
+          val = rand_range(d->range, d->seed) + 1;
+          REPLAY_TAG(OP_ADD, val);
+          if (set_add(d->set, val, d)) {
+            d->diff++;
+            last = val;
+          }
+          d->nb_add++;
+        } else {
+          /* Remove last value */
+          REPLAY_TAG(OP_REMOVE, last);
+          if (set_remove(d->set, last, d))
+            d->diff--;
+          d->nb_remove++;
+          last = -1;
+        }
+      } else {
+        /* Randomly perform insertions and removals */
+        val = rand_range(d->range, d->seed) + 1;
+        if ((op & 0x01) == 0) {
+          /* Add random value */
+          REPLAY_TAG(OP_ADD, val);
+          if (set_add(d->set, val, d))
+            d->diff++;
+          d->nb_add++;
+        } else {
+          /* Remove random value */
+          REPLAY_TAG(OP_REMOVE, val);
+          if (set_remove(d->set, val, d))
+            d->diff--;
+          d->nb_remove++;
+        }
+      }
+#ifdef HAS_SCAN
+    } else if (op < d->update + d->scan) {
+      /* Count values in random range */
+      val = rand_range(d->range, d->seed) + 1;
+      REPLAY_TAG(OP_SCAN, val);
+      d->nb_scanned += set_scan(d->set, val, d->scan_length, d);
+      d->nb_scan++;
+#endif /* HAS_SCAN */
+    } else {
+      /* Look for random value */
+      val = rand_range(d->range, d->seed) + 1;
+      REPLAY_TAG(OP_CONTAINS, val);
+      if (set_contains(d->set, val, d))
+        d->nb_found++;
+      d->nb_contains++;
+    }
+  }
+#ifndef TM_COMPILER
+  stm_get_stats("nb_aborts", &d->nb_aborts);
+  stm_get_stats("nb_aborts_1", &d->nb_aborts_1);
+  stm_get_stats("nb_aborts_2", &d->nb_aborts_2);
+  stm_get_stats("nb_aborts_locked_read", &d->nb_aborts_locked_read);
+  stm_get_stats("nb_aborts_locked_write", &d->nb_aborts_locked_write);
+  stm_get_stats("nb_aborts_validate_read", &d->nb_aborts_validate_read);
+  stm_get_stats("nb_aborts_validate_write", &d->nb_aborts_validate_write);
+  stm_get_stats("nb_aborts_validate_commit", &d->nb_aborts_validate_commit);
+  stm_get_stats("nb_aborts_invalid_memory", &d->nb_aborts_invalid_memory);
+  stm_get_stats("nb_aborts_killed", &d->nb_aborts_killed);
+  stm_get_stats("locked_reads_ok", &d->locked_reads_ok);
+  stm_get_stats("locked_reads_failed", &d->locked_reads_failed);
+  stm_get_stats("max_retries", &d->max_retries);
+#endif /* ! TM_COMPILER */
+  /* Free transaction */
+  TM_EXIT_THREAD;
+
+  return NULL;
+}
+
+int main(int argc, char **argv)
+{
+  struct option long_options[] = {
+    // These options don't set a flag
+    {"help",                      no_argument,       NULL, 'h'},
+    {"do-not-alternate",          no_argument,       NULL, 'a'},
+#ifndef TM_COMPILER
+    {"contention-manager",        required_argument, NULL, 'c'},
+    {"record",                    required_argument, NULL, 'R'},
+    {"replay",                    required_argument, NULL, 'P'},
+#endif /* ! TM_COMPILER */
+    {"duration",                  required_argument, NULL, 'd'},
+    {"initial-size",              required_argument, NULL, 'i'},
+    {"num-threads",               required_argument, NULL, 'n'},
+    {"pinning",                   required_argument, NULL, 'p'},
+    {"range",                     required_argument, NULL, 'r'},
+    {"seed",                      required_argument, NULL, 's'},
+    {"update-rate",               required_argument, NULL, 'u'},
+#ifdef HAS_SCAN
+    {"scan-rate",                 required_argument, NULL, 'S'},
+    {"scan-length",               required_argument, NULL, 'L'},
+#endif /* HAS_SCAN */
+#ifdef USE_LINKEDLIST
+    {"unit-tx",                   no_argument,       NULL, 'x'},
+#endif /* LINKEDLIST */
+    {NULL, 0, NULL, 0}
+  };
+
+  intset_t *set;
+  int i, c, val, size, ret;
+  unsigned long reads, updates;
+#ifndef TM_COMPILER
+  char *s;
+  unsigned long aborts, aborts_1, aborts_2,
+    aborts_locked_read, aborts_locked_write,
+    aborts_validate_read, aborts_validate_write, aborts_validate_commit,
+    aborts_invalid_memory, aborts_killed,
+    locked_reads_ok, locked_reads_failed, max_retries;
+  stm_ab_stats_t ab_stats;
+  mod_replay_stats_t replay_stats;
+#endif /* ! TM_COMPILER */
   thread_data_t *data;
   pthread_t *threads;
   pthread_attr_t attr;
@@ -1338,9 +2309,15 @@ int main(int argc, char **argv)
   int range = DEFAULT_RANGE;
   int seed = DEFAULT_SEED;
   int update = DEFAULT_UPDATE;
+  int scan = DEFAULT_SCAN;
+  int scan_length = DEFAULT_SCAN_LENGTH;
   int alternate = 1;
+  int pinning = MOD_TOPO_NONE;
+  char *pin = NULL;
 #ifndef TM_COMPILER
   char *cm = NULL;
+  char *record = NULL;
+  char *replay = NULL;
 #endif /* ! TM_COMPILER */
 #ifdef USE_LINKEDLIST
   int unit_tx = 0;
@@ -1351,9 +2328,12 @@ int main(int argc, char **argv)
     i = 0;
     c = getopt_long(argc, argv, "ha"
 #ifndef TM_COMPILER
-                    "c:"
+                    "c:R:P:"
 #endif /* ! TM_COMPILER */
-                    "d:i:n:r:s:u:"
+                    "d:i:n:p:r:s:u:"
+#ifdef HAS_SCAN
+                    "S:L:"
+#endif /* HAS_SCAN */
 #ifdef USE_LINKEDLIST
                     "x"
 #endif /* LINKEDLIST */
@@ -1379,7 +2359,11 @@ int main(int argc, char **argv)
               "(skip list)\n"
 #elif defined(USE_HASHSET)
               "(hash set)\n"
-#endif /* defined(USE_HASHSET) */
+#elif defined(USE_SFTREE)
+              "(speculation-friendly tree)\n"
+#elif defined(USE_BPTREE)
+              "(B+-tree)\n"
+#endif /* defined(USE_BPTREE) */
               "\n"
               "Usage:\n"
               "  intset [options...]\n"
@@ -1392,6 +2376,11 @@ int main(int argc, char **argv)
 #ifndef TM_COMPILER
 	      "  -c, --contention-manager <string>\n"
               "        Contention manager for resolving conflicts (default=suicide)\n"
+              "  -R, --record <file>\n"
+              "        Record the transactions of all threads into a log\n"
+              "  -P, --replay <file>\n"
+              "        Replay the operations and begin order of a log (use the same -i, -r\n"
+              "        and -s options as for recording, with -s != 0)\n"
 #endif /* ! TM_COMPILER */
 	      "  -d, --duration <int>\n"
               "        Test duration in milliseconds (0=infinite, default=" XSTR(DEFAULT_DURATION) ")\n"
@@ -1399,12 +2388,20 @@ int main(int argc, char **argv)
               "        Number of elements to insert before test (default=" XSTR(DEFAULT_INITIAL) ")\n"
               "  -n, --num-threads <int>\n"
               "        Number of threads (default=" XSTR(DEFAULT_NB_THREADS) ")\n"
+              "  -p, --pinning <string>\n"
+              "        Thread placement (none, compact, scatter or numa, default=none)\n"
               "  -r, --range <int>\n"
               "        Range of integer values inserted in set (default=" XSTR(DEFAULT_RANGE) ")\n"
               "  -s, --seed <int>\n"
               "        RNG seed (0=time-based, default=" XSTR(DEFAULT_SEED) ")\n"
               "  -u, --update-rate <int>\n"
               "        Percentage of update transactions (default=" XSTR(DEFAULT_UPDATE) ")\n"
+#ifdef HAS_SCAN
+              "  -S, --scan-rate <int>\n"
+              "        Percentage of range scan transactions (default=" XSTR(DEFAULT_SCAN) ")\n"
+              "  -L, --scan-length <int>\n"
+              "        Range of values covered by a scan (default=" XSTR(DEFAULT_SCAN_LENGTH) ")\n"
+#endif /* HAS_SCAN */
 #ifdef USE_LINKEDLIST
               "  -x, --unit-tx\n"
               "        Use unit transactions\n"
@@ -1418,6 +2415,12 @@ int main(int argc, char **argv)
      case 'c':
        cm = optarg;
        break;
+     case 'R':
+       record = optarg;
+       break;
+     case 'P':
+       replay = optarg;
+       break;
 #endif /* ! TM_COMPILER */
      case 'd':
        duration = atoi(optarg);
@@ -1428,6 +2431,13 @@ int main(int argc, char **argv)
      case 'n':
        nb_threads = atoi(optarg);
        break;
+     case 'p':
+       pin = optarg;
+       if ((pinning = mod_topo_policy(optarg)) < 0) {
+         printf("Unknown pinning policy \"%s\"\n", optarg);
+         exit(1);
+       }
+       break;
      case 'r':
        range = atoi(optarg);
        break;
@@ -1437,6 +2447,14 @@ int main(int argc, char **argv)
      case 'u':
        update = atoi(optarg);
        break;
+#ifdef HAS_SCAN
+     case 'S':
+       scan = atoi(optarg);
+       break;
+     case 'L':
+       scan_length = atoi(optarg);
+       break;
+#endif /* HAS_SCAN */
 #ifdef USE_LINKEDLIST
      case 'x':
        unit_tx++;
@@ -1455,6 +2473,15 @@ int main(int argc, char **argv)
   assert(nb_threads > 0);
   assert(range > 0 && range >= initial);
   assert(update >= 0 && update <= 100);
+  assert(scan >= 0 && update + scan <= 100);
+  assert(scan_length > 0);
+#ifndef TM_COMPILER
+# ifdef USE_LINKEDLIST
+  /* Unit transactions are not seen by the replay module */
+  assert(unit_tx == 0 || (record == NULL && replay == NULL));
+# endif /* LINKEDLIST */
+  assert(record == NULL || replay == NULL);
+#endif /* ! TM_COMPILER */
 
 #if defined(USE_LINKEDLIST)
   printf("Set type     : linked list\n");
@@ -1464,16 +2491,42 @@ int main(int argc, char **argv)
   printf("Set type     : skip list\n");
 #elif defined(USE_HASHSET)
   printf("Set type     : hash set\n");
-#endif /* defined(USE_HASHSET) */
+#elif defined(USE_SFTREE)
+  printf("Set type     : speculation-friendly tree\n");
+#elif defined(USE_BPTREE)
+  printf("Set type     : B+-tree (%d keys per node)\n", BP_ORDER);
+#endif /* defined(USE_BPTREE) */
+#if defined(TM_MUTEX)
+  printf("Sync         : global mutex\n");
+#elif defined(TM_RWLOCK)
+  printf("Sync         : global reader-writer lock\n");
+#elif defined(TM_FINE_LOCKS)
+  printf("Sync         : fine-grained locks\n");
+#elif defined(TM_LOCK_FREE)
+  printf("Sync         : lock-free\n");
+#endif /* defined(TM_LOCK_FREE) */
 #ifndef TM_COMPILER
   printf("CM           : %s\n", (cm == NULL ? "DEFAULT" : cm));
+  if (record != NULL)
+    printf("Record       : %s\n", record);
+  if (replay != NULL)
+    printf("Replay       : %s\n", replay);
 #endif /* ! TM_COMPILER */
   printf("Duration     : %d\n", duration);
   printf("Initial size : %d\n", initial);
   printf("Nb threads   : %d\n", nb_threads);
+  printf("Pinning      : %s\n", (pin == NULL ? "none" : pin));
+  if (pinning != MOD_TOPO_NONE) {
+    i = mod_topo_init();
+    printf("Topology     : %d CPUs, %d nodes\n", i, mod_topo_nb_nodes());
+  }
   printf("Value range  : %d\n", range);
   printf("Seed         : %d\n", seed);
   printf("Update rate  : %d\n", update);
+#ifdef HAS_SCAN
+  printf("Scan rate    : %d\n", scan);
+  printf("Scan length  : %d\n", scan_length);
+#endif /* HAS_SCAN */
   printf("Alternate    : %d\n", alternate);
 #ifdef USE_LINKEDLIST
   printf("Unit tx      : %d\n", unit_tx);
@@ -1487,15 +2540,6 @@ int main(int argc, char **argv)
   timeout.tv_sec = duration / 1000;
   timeout.tv_nsec = (duration % 1000) * 1000000;
 
-  if ((data = (thread_data_t *)malloc(nb_threads * sizeof(thread_data_t))) == NULL) {
-    perror("malloc");
-    exit(1);
-  }
-  if ((threads = (pthread_t *)malloc(nb_threads * sizeof(pthread_t))) == NULL) {
-    perror("malloc");
-    exit(1);
-  }
-
   if (seed == 0)
     srand((int)time(NULL));
   else
@@ -1535,14 +2579,44 @@ int main(int argc, char **argv)
   size = set_size(set);
   printf("Set size     : %d\n", size);
 
+#ifdef USE_SFTREE
+  /* Rebalance in the background while the test runs */
+  set_start_maintenance(set);
+#endif /* USE_SFTREE */
+
+#ifndef TM_COMPILER
+  if (record != NULL)
+    mod_replay_record(record);
+  if (replay != NULL) {
+    if (seed == 0)
+      printf("WARNING: initial set differs from recorded one (time-based seed)\n");
+    /* One thread per recorded stream */
+    nb_threads = mod_replay_load(replay);
+    printf("Replay       : %d threads\n", nb_threads);
+  }
+#endif /* ! TM_COMPILER */
+
+  if ((data = (thread_data_t *)malloc(nb_threads * sizeof(thread_data_t))) == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  if ((threads = (pthread_t *)malloc(nb_threads * sizeof(pthread_t))) == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+
   /* Access set from all threads */
   barrier_init(&barrier, nb_threads + 1);
   pthread_attr_init(&attr);
   pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
   for (i = 0; i < nb_threads; i++) {
     printf("Creating thread %d\n", i);
+    data[i].id = i;
+    data[i].pinning = pinning;
     data[i].range = range;
     data[i].update = update;
+    data[i].scan = scan;
+    data[i].scan_length = scan_length;
     data[i].alternate = alternate;
 #ifdef USE_LINKEDLIST
     data[i].unit_tx = unit_tx;
@@ -1551,6 +2625,8 @@ int main(int argc, char **argv)
     data[i].nb_remove = 0;
     data[i].nb_contains = 0;
     data[i].nb_found = 0;
+    data[i].nb_scan = 0;
+    data[i].nb_scanned = 0;
 #ifndef TM_COMPILER
     data[i].nb_aborts = 0;
     data[i].nb_aborts_1 = 0;
@@ -1565,6 +2641,7 @@ int main(int argc, char **argv)
     data[i].locked_reads_ok = 0;
     data[i].locked_reads_failed = 0;
     data[i].max_retries = 0;
+    data[i].replay = (replay != NULL);
 #endif /* ! TM_COMPILER */
     data[i].diff = 0;
     rand_init(data[i].seed);
@@ -1582,6 +2659,11 @@ int main(int argc, char **argv)
 
   printf("STARTING...\n");
   gettimeofday(&start, NULL);
+#ifndef TM_COMPILER
+  if (replay != NULL) {
+    /* Threads stop at the end of their stream */
+  } else
+#endif /* ! TM_COMPILER */
   if (duration > 0) {
     nanosleep(&timeout, NULL);
   } else {
@@ -1589,6 +2671,9 @@ int main(int argc, char **argv)
     sigsuspend(&block_set);
   }
   stop = 1;
+#ifndef TM_COMPILER
+  if (replay == NULL)
+#endif /* ! TM_COMPILER */
   gettimeofday(&end, NULL);
   printf("STOPPING...\n");
 
@@ -1599,6 +2684,13 @@ int main(int argc, char **argv)
       exit(1);
     }
   }
+#ifdef USE_SFTREE
+  set_stop_maintenance(set);
+#endif /* USE_SFTREE */
+#ifndef TM_COMPILER
+  if (replay != NULL)
+    gettimeofday(&end, NULL);
+#endif /* ! TM_COMPILER */
 
   duration = (end.tv_sec * 1000 + end.tv_usec / 1000) - (start.tv_sec * 1000 + start.tv_usec / 1000);
 #ifndef TM_COMPILER
@@ -1624,6 +2716,10 @@ int main(int argc, char **argv)
     printf("  #remove     : %lu\n", data[i].nb_remove);
     printf("  #contains   : %lu\n", data[i].nb_contains);
     printf("  #found      : %lu\n", data[i].nb_found);
+#ifdef HAS_SCAN
+    printf("  #scan       : %lu\n", data[i].nb_scan);
+    printf("  #scanned    : %lu\n", data[i].nb_scanned);
+#endif /* HAS_SCAN */
 #ifndef TM_COMPILER
     printf("  #aborts     : %lu\n", data[i].nb_aborts);
     printf("    #lock-r   : %lu\n", data[i].nb_aborts_locked_read);
@@ -1653,7 +2749,7 @@ int main(int argc, char **argv)
     if (max_retries < data[i].max_retries)
       max_retries = data[i].max_retries;
 #endif /* ! TM_COMPILER */
-    reads += data[i].nb_contains;
+    reads += data[i].nb_contains + data[i].nb_scan;
     updates += (data[i].nb_add + data[i].nb_remove);
     size += data[i].diff;
   }
@@ -1689,6 +2785,18 @@ int main(int argc, char **argv)
     printf("  90th perc.  : %f\n", ab_stats.percentile_90);
     printf("  95th perc.  : %f\n", ab_stats.percentile_95);
   }
+
+  if (mod_replay_get_stats(&replay_stats)) {
+    printf("Replay        : recorded / replayed\n");
+    printf("  #commits    : %lu / %lu\n", replay_stats.recorded_commits, replay_stats.commits);
+    printf("  #aborts     : %lu / %lu\n", replay_stats.recorded_aborts, replay_stats.aborts);
+    printf("    #lock-r   : %lu / %lu\n", replay_stats.recorded_aborts_r[STM_ABORT_WR_CONFLICT >> 8], replay_stats.aborts_r[STM_ABORT_WR_CONFLICT >> 8]);
+    printf("    #lock-w   : %lu / %lu\n", replay_stats.recorded_aborts_r[STM_ABORT_WW_CONFLICT >> 8], replay_stats.aborts_r[STM_ABORT_WW_CONFLICT >> 8]);
+    printf("    #val-r    : %lu / %lu\n", replay_stats.recorded_aborts_r[STM_ABORT_VAL_READ >> 8], replay_stats.aborts_r[STM_ABORT_VAL_READ >> 8]);
+    printf("    #val-w    : %lu / %lu\n", replay_stats.recorded_aborts_r[STM_ABORT_VAL_WRITE >> 8], replay_stats.aborts_r[STM_ABORT_VAL_WRITE >> 8]);
+    printf("    #val-c    : %lu / %lu\n", replay_stats.recorded_aborts_r[STM_ABORT_VALIDATE >> 8], replay_stats.aborts_r[STM_ABORT_VALIDATE >> 8]);
+    printf("    #killed   : %lu / %lu\n", replay_stats.recorded_aborts_r[STM_ABORT_KILLED >> 8], replay_stats.aborts_r[STM_ABORT_KILLED >> 8]);
+  }
 #endif /* ! TM_COMPILER */
 
   /* Delete set */
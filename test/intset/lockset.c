@@ -0,0 +1,594 @@
+/*
+ * File:
+ *   lockset.c
+ * Author(s):
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *   Patrick Marlier <patrick.marlier@unine.ch>
+ * Description:
+ *   Fine-grained lock-based and lock-free integer sets used as
+ *   baselines for the transactional versions (included by intset.c).
+ *
+ * Copyright (c) 2007-2014.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * This program has a dual license and can also be distributed
+ * under the terms of the MIT license.
+ */
+
+/*
+ * TM_FINE_LOCKS:
+ *   - linked list: lazy list (optimistic traversal, lock predecessor and
+ *     current node, then validate) [Heller et al., OPODIS 2005].
+ *   - hash set: one lock per bucket.
+ * TM_LOCK_FREE:
+ *   - linked list and hash set buckets: lock-free list with marked
+ *     pointers [Harris, DISC 2001; Michael, SPAA 2002].
+ *
+ * Concurrent traversals may still access removed nodes, which are thus
+ * never freed (there is no safe memory reclamation scheme here).
+ */
+
+#include "atomic.h"
+
+# define INIT_SET_PARAMETERS            /* Nothing */
+
+typedef intptr_t val_t;
+# define VAL_MIN                        INT_MIN
+# define VAL_MAX                        INT_MAX
+
+#if defined(TM_LOCK_FREE)
+
+/* ################################################################### *
+ * LOCK-FREE LIST
+ * ################################################################### */
+
+typedef struct node {
+  val_t val;
+  struct node *next;                    /* Low bit set if node removed */
+} node_t;
+
+# define IS_MARKED(p)                   (((uintptr_t)(p) & 0x01) != 0)
+# define MARK(p)                        ((node_t *)((uintptr_t)(p) | 0x01))
+# define UNMARK(p)                      ((node_t *)((uintptr_t)(p) & ~(uintptr_t)0x01))
+
+static node_t *new_node(val_t val, node_t *next)
+{
+  node_t *node;
+
+  if ((node = (node_t *)malloc(sizeof(node_t))) == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  node->val = val;
+  node->next = next;
+
+  return node;
+}
+
+/* Return first node with value >= val (or NULL) and its predecessor */
+static node_t *list_search(node_t *head, val_t val, node_t **left)
+{
+  node_t *prev, *curr, *next;
+
+ retry:
+  /* Head node is never removed */
+  prev = head;
+  curr = (node_t *)ATOMIC_LOAD(&prev->next);
+  while (curr != NULL) {
+    next = (node_t *)ATOMIC_LOAD(&curr->next);
+    if (IS_MARKED(next)) {
+      /* Unlink removed node */
+      if (!ATOMIC_CAS_FULL(&prev->next, curr, UNMARK(next)))
+        goto retry;
+      curr = UNMARK(next);
+      continue;
+    }
+    if (curr->val >= val)
+      break;
+    prev = curr;
+    curr = next;
+  }
+  *left = prev;
+
+  return curr;
+}
+
+static int list_contains(node_t *head, val_t val)
+{
+  node_t *curr;
+
+  curr = UNMARK(ATOMIC_LOAD(&head->next));
+  while (curr != NULL && curr->val < val)
+    curr = UNMARK(ATOMIC_LOAD(&curr->next));
+
+  return (curr != NULL && curr->val == val && !IS_MARKED(ATOMIC_LOAD(&curr->next)));
+}
+
+static int list_add(node_t *head, val_t val)
+{
+  node_t *prev, *curr, *n;
+
+  n = new_node(val, NULL);
+  while (1) {
+    curr = list_search(head, val, &prev);
+    if (curr != NULL && curr->val == val) {
+      free(n);
+      return 0;
+    }
+    n->next = curr;
+    if (ATOMIC_CAS_FULL(&prev->next, curr, n))
+      return 1;
+  }
+}
+
+static int list_remove(node_t *head, val_t val)
+{
+  node_t *prev, *curr, *next;
+
+  while (1) {
+    curr = list_search(head, val, &prev);
+    if (curr == NULL || curr->val != val)
+      return 0;
+    next = (node_t *)ATOMIC_LOAD(&curr->next);
+    if (IS_MARKED(next))
+      continue;
+    /* Logical removal (linearization point) */
+    if (ATOMIC_CAS_FULL(&curr->next, next, MARK(next)))
+      break;
+  }
+  /* Physical removal (otherwise done by later traversals) */
+  ATOMIC_CAS_FULL(&prev->next, curr, next);
+
+  return 1;
+}
+
+static int list_size(node_t *head)
+{
+  int size = 0;
+  node_t *node;
+
+  node = UNMARK(head->next);
+  while (node != NULL) {
+    if (!IS_MARKED(node->next))
+      size++;
+    node = UNMARK(node->next);
+  }
+
+  return size;
+}
+
+static void list_delete(node_t *head)
+{
+  node_t *node, *next;
+
+  node = UNMARK(head->next);
+  while (node != NULL) {
+    next = UNMARK(node->next);
+    free(node);
+    node = next;
+  }
+}
+
+#elif defined(TM_FINE_LOCKS) && defined(USE_LINKEDLIST)
+
+/* ################################################################### *
+ * LAZY LIST
+ * ################################################################### */
+
+typedef struct node {
+  val_t val;
+  struct node *next;
+  volatile int marked;                  /* Set once node is removed */
+  pthread_mutex_t lock;
+} node_t;
+
+static node_t *new_node(val_t val, node_t *next)
+{
+  node_t *node;
+
+  if ((node = (node_t *)malloc(sizeof(node_t))) == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  node->val = val;
+  node->next = next;
+  node->marked = 0;
+  pthread_mutex_init(&node->lock, NULL);
+
+  return node;
+}
+
+/* Return first node with value >= val (or NULL) and its predecessor */
+static node_t *list_search(node_t *head, val_t val, node_t **left)
+{
+  node_t *prev, *curr;
+
+  prev = head;
+  curr = (node_t *)ATOMIC_LOAD(&prev->next);
+  while (curr != NULL && curr->val < val) {
+    prev = curr;
+    curr = (node_t *)ATOMIC_LOAD(&prev->next);
+  }
+  *left = prev;
+
+  return curr;
+}
+
+static void list_lock(node_t *prev, node_t *curr)
+{
+  pthread_mutex_lock(&prev->lock);
+  if (curr != NULL)
+    pthread_mutex_lock(&curr->lock);
+}
+
+static void list_unlock(node_t *prev, node_t *curr)
+{
+  if (curr != NULL)
+    pthread_mutex_unlock(&curr->lock);
+  pthread_mutex_unlock(&prev->lock);
+}
+
+/* Both nodes are still in the list and adjacent (called with locks held) */
+static int list_validate(node_t *prev, node_t *curr)
+{
+  return (!prev->marked && (curr == NULL || !curr->marked) && prev->next == curr);
+}
+
+static int list_contains(node_t *head, val_t val)
+{
+  node_t *prev, *curr;
+
+  curr = list_search(head, val, &prev);
+
+  return (curr != NULL && curr->val == val && !curr->marked);
+}
+
+static int list_add(node_t *head, val_t val)
+{
+  int result;
+  node_t *prev, *curr;
+
+  while (1) {
+    curr = list_search(head, val, &prev);
+    list_lock(prev, curr);
+    if (list_validate(prev, curr)) {
+      result = (curr == NULL || curr->val != val);
+      if (result)
+        ATOMIC_STORE(&prev->next, new_node(val, curr));
+      list_unlock(prev, curr);
+      return result;
+    }
+    list_unlock(prev, curr);
+  }
+}
+
+static int list_remove(node_t *head, val_t val)
+{
+  int result;
+  node_t *prev, *curr;
+
+  while (1) {
+    curr = list_search(head, val, &prev);
+    list_lock(prev, curr);
+    if (list_validate(prev, curr)) {
+      result = (curr != NULL && curr->val == val);
+      if (result) {
+        /* Logical then physical removal */
+        curr->marked = 1;
+        ATOMIC_STORE(&prev->next, curr->next);
+      }
+      list_unlock(prev, curr);
+      return result;
+    }
+    list_unlock(prev, curr);
+  }
+}
+
+static int list_size(node_t *head)
+{
+  int size = 0;
+  node_t *node;
+
+  node = head->next;
+  while (node != NULL) {
+    size++;
+    node = node->next;
+  }
+
+  return size;
+}
+
+static void list_delete(node_t *head)
+{
+  node_t *node, *next;
+
+  node = head->next;
+  while (node != NULL) {
+    next = node->next;
+    pthread_mutex_destroy(&node->lock);
+    free(node);
+    node = next;
+  }
+}
+
+#endif /* defined(TM_FINE_LOCKS) && defined(USE_LINKEDLIST) */
+
+#if defined(USE_LINKEDLIST)
+
+/* ################################################################### *
+ * LINKEDLIST
+ * ################################################################### */
+
+typedef struct intset {
+  node_t *head;
+} intset_t;
+
+static intset_t *set_new()
+{
+  intset_t *set;
+
+  if ((set = (intset_t *)malloc(sizeof(intset_t))) == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  set->head = new_node(VAL_MIN, NULL);
+
+  return set;
+}
+
+static void set_delete(intset_t *set)
+{
+  list_delete(set->head);
+  free(set->head);
+  free(set);
+}
+
+static int set_size(intset_t *set)
+{
+  return list_size(set->head);
+}
+
+static int set_contains(intset_t *set, val_t val, thread_data_t *td)
+{
+  return list_contains(set->head, val);
+}
+
+static int set_add(intset_t *set, val_t val, thread_data_t *td)
+{
+  return list_add(set->head, val);
+}
+
+static int set_remove(intset_t *set, val_t val, thread_data_t *td)
+{
+  return list_remove(set->head, val);
+}
+
+#elif defined(USE_HASHSET)
+
+/* ################################################################### *
+ * HASHSET
+ * ################################################################### */
+
+# define NB_BUCKETS                     (1UL << 17)
+
+# define HASH(a)                        (hash((uint32_t)a) & (NB_BUCKETS - 1))
+
+static uint32_t hash(uint32_t a)
+{
+  /* Knuth's multiplicative hash function */
+  a *= 2654435761UL;
+  return a;
+}
+
+# if defined(TM_LOCK_FREE)
+
+typedef struct intset {
+  node_t *buckets;                      /* Head node of each bucket */
+} intset_t;
+
+static intset_t *set_new()
+{
+  intset_t *set;
+
+  if ((set = (intset_t *)malloc(sizeof(intset_t))) == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  if ((set->buckets = (node_t *)calloc(NB_BUCKETS, sizeof(node_t))) == NULL) {
+    perror("calloc");
+    exit(1);
+  }
+
+  return set;
+}
+
+static void set_delete(intset_t *set)
+{
+  unsigned int i;
+
+  for (i = 0; i < NB_BUCKETS; i++)
+    list_delete(&set->buckets[i]);
+  free(set->buckets);
+  free(set);
+}
+
+static int set_size(intset_t *set)
+{
+  int size = 0;
+  unsigned int i;
+
+  for (i = 0; i < NB_BUCKETS; i++)
+    size += list_size(&set->buckets[i]);
+
+  return size;
+}
+
+static int set_contains(intset_t *set, val_t val, thread_data_t *td)
+{
+  return list_contains(&set->buckets[HASH(val)], val);
+}
+
+static int set_add(intset_t *set, val_t val, thread_data_t *td)
+{
+  return list_add(&set->buckets[HASH(val)], val);
+}
+
+static int set_remove(intset_t *set, val_t val, thread_data_t *td)
+{
+  return list_remove(&set->buckets[HASH(val)], val);
+}
+
+# else /* TM_FINE_LOCKS */
+
+typedef struct bucket {
+  val_t val;
+  struct bucket *next;
+} bucket_t;
+
+typedef struct intset {
+  bucket_t **buckets;
+  pthread_mutex_t *locks;               /* One lock per bucket */
+} intset_t;
+
+static bucket_t *new_entry(val_t val, bucket_t *next)
+{
+  bucket_t *b;
+
+  if ((b = (bucket_t *)malloc(sizeof(bucket_t))) == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  b->val = val;
+  b->next = next;
+
+  return b;
+}
+
+static intset_t *set_new()
+{
+  intset_t *set;
+  unsigned int i;
+
+  if ((set = (intset_t *)malloc(sizeof(intset_t))) == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  if ((set->buckets = (bucket_t **)calloc(NB_BUCKETS, sizeof(bucket_t *))) == NULL) {
+    perror("calloc");
+    exit(1);
+  }
+  if ((set->locks = (pthread_mutex_t *)malloc(NB_BUCKETS * sizeof(pthread_mutex_t))) == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  for (i = 0; i < NB_BUCKETS; i++)
+    pthread_mutex_init(&set->locks[i], NULL);
+
+  return set;
+}
+
+static void set_delete(intset_t *set)
+{
+  unsigned int i;
+  bucket_t *b, *next;
+
+  for (i = 0; i < NB_BUCKETS; i++) {
+    b = set->buckets[i];
+    while (b != NULL) {
+      next = b->next;
+      free(b);
+      b = next;
+    }
+    pthread_mutex_destroy(&set->locks[i]);
+  }
+  free(set->locks);
+  free(set->buckets);
+  free(set);
+}
+
+static int set_size(intset_t *set)
+{
+  int size = 0;
+  unsigned int i;
+  bucket_t *b;
+
+  for (i = 0; i < NB_BUCKETS; i++) {
+    b = set->buckets[i];
+    while (b != NULL) {
+      size++;
+      b = b->next;
+    }
+  }
+
+  return size;
+}
+
+static int set_contains(intset_t *set, val_t val, thread_data_t *td)
+{
+  int result, i;
+  bucket_t *b;
+
+  i = HASH(val);
+  pthread_mutex_lock(&set->locks[i]);
+  b = set->buckets[i];
+  while (b != NULL && b->val != val)
+    b = b->next;
+  result = (b != NULL);
+  pthread_mutex_unlock(&set->locks[i]);
+
+  return result;
+}
+
+static int set_add(intset_t *set, val_t val, thread_data_t *td)
+{
+  int result, i;
+  bucket_t *b;
+
+  i = HASH(val);
+  pthread_mutex_lock(&set->locks[i]);
+  b = set->buckets[i];
+  while (b != NULL && b->val != val)
+    b = b->next;
+  result = (b == NULL);
+  if (result)
+    set->buckets[i] = new_entry(val, set->buckets[i]);
+  pthread_mutex_unlock(&set->locks[i]);
+
+  return result;
+}
+
+static int set_remove(intset_t *set, val_t val, thread_data_t *td)
+{
+  int result, i;
+  bucket_t *b, **prev;
+
+  i = HASH(val);
+  pthread_mutex_lock(&set->locks[i]);
+  prev = &set->buckets[i];
+  while ((b = *prev) != NULL && b->val != val)
+    prev = &b->next;
+  result = (b != NULL);
+  if (result) {
+    *prev = b->next;
+    /* No concurrent access to the bucket: free immediately */
+    free(b);
+  }
+  pthread_mutex_unlock(&set->locks[i]);
+
+  return result;
+}
+
+# endif /* TM_FINE_LOCKS */
+
+#else /* !(defined(USE_LINKEDLIST) || defined(USE_HASHSET)) */
+# error "Fine-grained locking and lock-free versions only available for linked list and hash set"
+#endif /* !(defined(USE_LINKEDLIST) || defined(USE_HASHSET)) */
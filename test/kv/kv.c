@@ -0,0 +1,1165 @@
+/*
+ * File:
+ *   kv.c
+ * Author(s):
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *   Patrick Marlier <patrick.marlier@unine.ch>
+ * Description:
+ *   Transactional key-value store benchmark (memcached-like).
+ *
+ * Copyright (c) 2007-2014.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * This program has a dual license and can also be distributed
+ * under the terms of the MIT license.
+ */
+
+/*
+ * The store is a chained hash table of items with variable-size values.
+ * Items and values are allocated and freed in transactions with the
+ * memory module.  Items are kept in a global LRU list (moved to the
+ * front when read, at most once per bump interval) and the least
+ * recently used ones are evicted when the memory capacity is exceeded.
+ * Items may have a time-to-live, in which case they are removed by the
+ * first access after expiry.  The hash table doubles in size when the
+ * load factor is exceeded; the resize rehashes all items in a single
+ * (large) transaction, which becomes irrevocable after a few failed
+ * attempts.  Worker threads act as local clients issuing GET, SET and
+ * DELETE requests on zipf-distributed keys.
+ *
+ * When the library is compiled with EPOCH_GC, freed blocks are recycled
+ * only after concurrent transactions have completed, so values and old
+ * bucket arrays are freed without being overwritten.  Otherwise, values
+ * are overwritten (so that concurrent readers fail validation before
+ * they can observe reused memory) and old bucket arrays are kept until
+ * the end of the run.
+ */
+
+#include <assert.h>
+#include <getopt.h>
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "atomic.h"
+#include "mod_mem.h"
+#include "mod_topo.h"
+#include "stm.h"
+
+#define TM_START(tid, ro)               { stm_tx_attr_t _a = {{.id = tid, .read_only = ro}}; sigjmp_buf *_e = stm_start(_a); if (_e != NULL) sigsetjmp(*_e, 0)
+#define TM_LOAD(addr)                   stm_load((stm_word_t *)addr)
+#define TM_STORE(addr, value)           stm_store((stm_word_t *)addr, (stm_word_t)value)
+#define TM_COMMIT                       stm_commit(); }
+#define TM_MALLOC(size)                 stm_malloc(size)
+#define TM_CALLOC(nm, size)             stm_calloc(nm, size)
+#define TM_FREE2(addr, size)            stm_free(addr, size)
+
+#define TM_INIT                         stm_init(); mod_mem_init(1)
+#define TM_EXIT                         stm_exit()
+#define TM_INIT_THREAD                  stm_init_thread()
+#define TM_EXIT_THREAD                  stm_exit_thread()
+
+#define DEFAULT_DURATION                10000
+#define DEFAULT_NB_THREADS              1
+#define DEFAULT_SEED                    0
+#define DEFAULT_RANGE                   65536
+#define DEFAULT_INITIAL                 (DEFAULT_RANGE / 2)
+#define DEFAULT_BUCKETS                 1024
+#define DEFAULT_CAPACITY                16384
+#define DEFAULT_MIN_VALUE               32
+#define DEFAULT_MAX_VALUE               1024
+#define DEFAULT_GET                     90
+#define DEFAULT_SET                     8
+#define DEFAULT_TTL                     5000
+#define DEFAULT_BUMP                    10
+#define DEFAULT_ZIPF                    0.99
+
+#define LOAD_FACTOR                     2
+#define RESIZE_RETRIES                  8
+#define MAX_VALUE                       65536   /* Stay below mmap() threshold of malloc() */
+#define MAX_RETIRED                     64
+
+#define LAT_SUB                         8       /* Sub-buckets per power of 2 */
+#define LAT_BUCKETS                     (2 * LAT_SUB + 60 * LAT_SUB)
+
+#define XSTR(s)                         STR(s)
+#define STR(s)                          #s
+
+/* ################################################################### *
+ * GLOBALS
+ * ################################################################### */
+
+static volatile int stop;
+
+/* Requests (also used as transaction identifiers) */
+enum {
+  KV_GET,
+  KV_SET,
+  KV_DELETE,
+  KV_RESIZE,
+  NB_REQUESTS = KV_RESIZE
+};
+
+static const char *request_names[] = { "GET", "SET", "DELETE" };
+
+/* ################################################################### *
+ * BARRIER
+ * ################################################################### */
+
+typedef struct barrier {
+  pthread_cond_t complete;
+  pthread_mutex_t mutex;
+  int count;
+  int crossing;
+} barrier_t;
+
+static void barrier_init(barrier_t *b, int n)
+{
+  pthread_cond_init(&b->complete, NULL);
+  pthread_mutex_init(&b->mutex, NULL);
+  b->count = n;
+  b->crossing = 0;
+}
+
+static void barrier_cross(barrier_t *b)
+{
+  pthread_mutex_lock(&b->mutex);
+  /* One more thread through */
+  b->crossing++;
+  /* If not all here, wait */
+  if (b->crossing < b->count) {
+    pthread_cond_wait(&b->complete, &b->mutex);
+  } else {
+    pthread_cond_broadcast(&b->complete);
+    /* Reset for next time */
+    b->crossing = 0;
+  }
+  pthread_mutex_unlock(&b->mutex);
+}
+
+/* ################################################################### *
+ * STORE
+ * ################################################################### */
+
+typedef struct item {
+  long key;
+  long size;                            /* Size of value in bytes */
+  long *value;
+  long expire;                          /* Expiry time in ms (0 = never) */
+  long atime;                           /* Time of last LRU bump in ms */
+  struct item *next;                    /* Hash chain */
+  struct item *lru_prev;
+  struct item *lru_next;
+} item_t;
+
+typedef struct table {
+  long size;                            /* Power of 2 */
+  item_t **buckets;
+} table_t;
+
+static struct {
+  table_t *table;
+  char padding1[64];
+  item_t lru;                           /* Sentinel (next = most recent, prev = least recent) */
+  char padding2[64];
+  long nb_items;
+  long bytes;
+  char padding3[64];
+  long capacity;                        /* In bytes (read-only) */
+  int gc;                               /* Freed memory is recycled by epoch-based GC */
+  int irrevocable;                      /* Library supports irrevocability */
+  volatile stm_word_t resizing;
+  table_t *retired[MAX_RETIRED];        /* Old tables (without GC) */
+  int nb_retired;
+  struct timespec start;
+} store;
+
+#define VALUE_WORDS(size)               (((size) + sizeof(long) - 1) / sizeof(long))
+#define ITEM_BYTES(size)                ((long)(sizeof(item_t) + VALUE_WORDS(size) * sizeof(long)))
+
+/* Accounting of memory allocated and freed by a transaction */
+typedef struct acct {
+  unsigned long nb_malloc;
+  unsigned long nb_free;
+  unsigned long bytes_malloc;
+  unsigned long bytes_free;
+  unsigned long nb_evicted;
+  unsigned long nb_expired;
+} acct_t;
+
+static inline unsigned long kv_hash(long key)
+{
+  unsigned long h = (unsigned long)key * 2654435761UL;
+  return h ^ (h >> 16);
+}
+
+static inline long now_ms(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  /* Never 0 (means no expiry) */
+  return (ts.tv_sec - store.start.tv_sec) * 1000 + (ts.tv_nsec - store.start.tv_nsec) / 1000000 + 1;
+}
+
+static inline uint64_t now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Find item and the link pointing to it (or to where it would be) */
+static item_t *kv_find(table_t *t, long key, item_t ***link)
+{
+  item_t **p, **b, *it;
+  long size;
+
+  size = (long)TM_LOAD(&t->size);
+  b = (item_t **)TM_LOAD(&t->buckets);
+  p = &b[kv_hash(key) & (size - 1)];
+  while ((it = (item_t *)TM_LOAD(p)) != NULL) {
+    if ((long)TM_LOAD(&it->key) == key)
+      break;
+    p = &it->next;
+  }
+  *link = p;
+  return it;
+}
+
+/* Remove item from hash table and LRU list, and free it */
+static void kv_unlink(item_t **link, item_t *it, acct_t *a)
+{
+  item_t *prev, *next;
+  long size;
+
+  TM_STORE(link, TM_LOAD(&it->next));
+  prev = (item_t *)TM_LOAD(&it->lru_prev);
+  next = (item_t *)TM_LOAD(&it->lru_next);
+  TM_STORE(&prev->lru_next, next);
+  TM_STORE(&next->lru_prev, prev);
+  size = (long)TM_LOAD(&it->size);
+  TM_STORE(&store.nb_items, (long)TM_LOAD(&store.nb_items) - 1);
+  TM_STORE(&store.bytes, (long)TM_LOAD(&store.bytes) - ITEM_BYTES(size));
+  TM_FREE2((void *)TM_LOAD(&it->value), store.gc ? 0 : VALUE_WORDS(size) * sizeof(long));
+  /* Always overwrite header (readers must notice removal) */
+  TM_FREE2(it, sizeof(item_t));
+  a->nb_free += 2;
+  a->bytes_free += ITEM_BYTES(size);
+}
+
+/* Move item to the front of the LRU list */
+static void kv_bump(item_t *it)
+{
+  item_t *prev, *next, *first;
+
+  first = (item_t *)TM_LOAD(&store.lru.lru_next);
+  if (first == it)
+    return;
+  prev = (item_t *)TM_LOAD(&it->lru_prev);
+  next = (item_t *)TM_LOAD(&it->lru_next);
+  TM_STORE(&prev->lru_next, next);
+  TM_STORE(&next->lru_prev, prev);
+  TM_STORE(&it->lru_prev, &store.lru);
+  TM_STORE(&it->lru_next, first);
+  TM_STORE(&first->lru_prev, it);
+  TM_STORE(&store.lru.lru_next, it);
+}
+
+/* ################################################################### *
+ * REQUESTS
+ * ################################################################### */
+
+typedef struct thread_data {
+  barrier_t *barrier;
+  double *zipf_cdf;
+  long *buffer;
+  long range;
+  long min_value;
+  long max_value;
+  long ttl;
+  long bump;
+  int get;
+  int set;
+  int id;
+  int pinning;
+  unsigned long nb_requests[NB_REQUESTS];
+  unsigned long nb_hits;
+  unsigned long nb_misses;
+  unsigned long nb_errors;
+  unsigned long nb_resizes;
+  unsigned long max_resize_items;
+  unsigned long nb_malloc_tries;
+  acct_t acct;
+  unsigned long lat[NB_REQUESTS][LAT_BUCKETS];
+  unsigned long nb_aborts;
+  unsigned long nb_aborts_locked_read;
+  unsigned long nb_aborts_locked_write;
+  unsigned long nb_aborts_validate_read;
+  unsigned long nb_aborts_validate_write;
+  unsigned long nb_aborts_validate_commit;
+  unsigned long nb_aborts_killed;
+  unsigned long nb_aborts_rw_conflict;
+  unsigned long nb_aborts_irrevocable;
+  unsigned long max_retries;
+  unsigned short seed[3];
+  char padding[64];
+} thread_data_t;
+
+static void kv_account(thread_data_t *d, acct_t *a)
+{
+  d->acct.nb_malloc += a->nb_malloc;
+  d->acct.nb_free += a->nb_free;
+  d->acct.bytes_malloc += a->bytes_malloc;
+  d->acct.bytes_free += a->bytes_free;
+  d->acct.nb_evicted += a->nb_evicted;
+  d->acct.nb_expired += a->nb_expired;
+}
+
+static int kv_get(thread_data_t *d, long key, long now)
+{
+  table_t *t;
+  item_t *it, **link;
+  long *v;
+  long i, n, size, expire;
+  acct_t a;
+  int hit;
+
+  TM_START(KV_GET, 0);
+  memset(&a, 0, sizeof(a));
+  hit = 0;
+  size = 0;
+  t = (table_t *)TM_LOAD(&store.table);
+  it = kv_find(t, key, &link);
+  if (it != NULL) {
+    expire = (long)TM_LOAD(&it->expire);
+    if (expire != 0 && expire <= now) {
+      /* Lazy expiry */
+      kv_unlink(link, it, &a);
+      a.nb_expired++;
+    } else {
+      size = (long)TM_LOAD(&it->size);
+      v = (long *)TM_LOAD(&it->value);
+      for (i = 0, n = VALUE_WORDS(size); i < n; i++)
+        d->buffer[i] = (long)TM_LOAD(&v[i]);
+      if (now - (long)TM_LOAD(&it->atime) >= d->bump) {
+        kv_bump(it);
+        TM_STORE(&it->atime, now);
+      }
+      hit = 1;
+    }
+  }
+  TM_COMMIT;
+
+  kv_account(d, &a);
+  if (hit) {
+    /* Values are filled with their key */
+    n = VALUE_WORDS(size);
+    if (d->buffer[0] != key || d->buffer[n - 1] != key)
+      d->nb_errors++;
+  }
+  return hit;
+}
+
+static int kv_set(thread_data_t *d, long key, long size, long now)
+{
+  table_t *t;
+  item_t *it, *victim, *first, **link, **b;
+  long *v;
+  long i, n, need, nb_items, buckets;
+  acct_t a;
+
+  n = VALUE_WORDS(size);
+  need = ITEM_BYTES(size);
+
+  TM_START(KV_SET, 0);
+  memset(&a, 0, sizeof(a));
+  t = (table_t *)TM_LOAD(&store.table);
+  if ((it = kv_find(t, key, &link)) != NULL)
+    kv_unlink(link, it, &a);
+  /* Make room */
+  while ((long)TM_LOAD(&store.bytes) + need > store.capacity) {
+    victim = (item_t *)TM_LOAD(&store.lru.lru_prev);
+    if (victim == &store.lru)
+      break;
+    it = kv_find(t, (long)TM_LOAD(&victim->key), &link);
+    assert(it == victim);
+    kv_unlink(link, victim, &a);
+    a.nb_evicted++;
+  }
+  /* Fresh memory is private until the transaction commits */
+  it = (item_t *)TM_MALLOC(sizeof(item_t));
+  v = (long *)TM_MALLOC(n * sizeof(long));
+  d->nb_malloc_tries += 2;
+  a.nb_malloc += 2;
+  a.bytes_malloc += need;
+  for (i = 0; i < n; i++)
+    v[i] = key;
+  it->key = key;
+  it->size = size;
+  it->value = v;
+  it->expire = (d->ttl > 0 ? now + d->ttl : 0);
+  it->atime = now;
+  /* Insert in hash table */
+  buckets = (long)TM_LOAD(&t->size);
+  b = (item_t **)TM_LOAD(&t->buckets);
+  it->next = (item_t *)TM_LOAD(&b[kv_hash(key) & (buckets - 1)]);
+  TM_STORE(&b[kv_hash(key) & (buckets - 1)], it);
+  /* Insert at the front of the LRU list */
+  first = (item_t *)TM_LOAD(&store.lru.lru_next);
+  it->lru_prev = &store.lru;
+  it->lru_next = first;
+  TM_STORE(&first->lru_prev, it);
+  TM_STORE(&store.lru.lru_next, it);
+  nb_items = (long)TM_LOAD(&store.nb_items) + 1;
+  TM_STORE(&store.nb_items, nb_items);
+  TM_STORE(&store.bytes, (long)TM_LOAD(&store.bytes) + need);
+  TM_COMMIT;
+
+  kv_account(d, &a);
+  /* Does the table need to grow? */
+  return (nb_items > buckets * LOAD_FACTOR);
+}
+
+static int kv_delete(thread_data_t *d, long key)
+{
+  table_t *t;
+  item_t *it, **link;
+  acct_t a;
+
+  TM_START(KV_DELETE, 0);
+  memset(&a, 0, sizeof(a));
+  t = (table_t *)TM_LOAD(&store.table);
+  if ((it = kv_find(t, key, &link)) != NULL)
+    kv_unlink(link, it, &a);
+  TM_COMMIT;
+
+  kv_account(d, &a);
+  return (it != NULL);
+}
+
+/* Double the size of the hash table (large transaction) */
+static void kv_resize(thread_data_t *d)
+{
+  table_t *t, *nt;
+  item_t *it, *next, **b, **nb;
+  long i, h, size, moved;
+  volatile int attempts = 0;
+
+  /* One resize at a time */
+  if (store.resizing != 0 || ATOMIC_CAS_FULL(&store.resizing, 0, 1) == 0)
+    return;
+
+  TM_START(KV_RESIZE, 0);
+  /* Don't starve (resizing conflicts with all updates) */
+  if (attempts++ >= RESIZE_RETRIES && store.irrevocable)
+    stm_set_irrevocable(0);
+  moved = 0;
+  nt = NULL;
+  t = (table_t *)TM_LOAD(&store.table);
+  size = (long)TM_LOAD(&t->size);
+  if ((long)TM_LOAD(&store.nb_items) > size * LOAD_FACTOR) {
+    b = (item_t **)TM_LOAD(&t->buckets);
+    nt = (table_t *)TM_MALLOC(sizeof(table_t));
+    nb = (item_t **)TM_CALLOC(size * 2, sizeof(item_t *));
+    for (i = 0; i < size; i++) {
+      for (it = (item_t *)TM_LOAD(&b[i]); it != NULL; it = next) {
+        next = (item_t *)TM_LOAD(&it->next);
+        h = kv_hash((long)TM_LOAD(&it->key)) & (size * 2 - 1);
+        TM_STORE(&it->next, nb[h]);
+        nb[h] = it;
+        moved++;
+      }
+    }
+    nt->size = size * 2;
+    nt->buckets = nb;
+    TM_STORE(&store.table, nt);
+    if (store.gc) {
+      TM_FREE2(b, 0);
+      TM_FREE2(t, sizeof(table_t));
+    }
+  }
+  TM_COMMIT;
+
+  if (nt != NULL) {
+    if (!store.gc) {
+      /* Concurrent readers may still access the old buckets */
+      assert(store.nb_retired < MAX_RETIRED);
+      store.retired[store.nb_retired++] = t;
+    }
+    d->nb_resizes++;
+    if (d->max_resize_items < moved)
+      d->max_resize_items = moved;
+  }
+  ATOMIC_STORE_REL(&store.resizing, 0);
+}
+
+/* ################################################################### *
+ * LATENCY HISTOGRAMS
+ * ################################################################### */
+
+/* Log-linear buckets: LAT_SUB buckets per power of 2 */
+static inline int lat_bucket(uint64_t v)
+{
+  int p;
+
+  if (v < 2 * LAT_SUB)
+    return (int)v;
+  p = 63 - __builtin_clzll(v);
+  return 2 * LAT_SUB + (p - 4) * LAT_SUB + (int)((v >> (p - 3)) & (LAT_SUB - 1));
+}
+
+static inline uint64_t lat_value(int b)
+{
+  int p;
+
+  if (b < 2 * LAT_SUB)
+    return (uint64_t)b;
+  p = (b - 2 * LAT_SUB) / LAT_SUB + 4;
+  return (uint64_t)(LAT_SUB + (b - 2 * LAT_SUB) % LAT_SUB) << (p - 3);
+}
+
+/* Smallest value such that a fraction q of samples are not larger */
+static uint64_t lat_percentile(unsigned long *lat, unsigned long n, double q)
+{
+  unsigned long c, target;
+  int b;
+
+  target = (unsigned long)ceil(q * n);
+  if (target == 0)
+    target = 1;
+  for (b = 0, c = 0; b < LAT_BUCKETS; b++) {
+    c += lat[b];
+    if (c >= target)
+      return lat_value(b);
+  }
+  return lat_value(LAT_BUCKETS - 1);
+}
+
+static void lat_print(const char *name, unsigned long *lat)
+{
+  unsigned long n;
+  int b, max;
+
+  for (b = 0, n = 0, max = 0; b < LAT_BUCKETS; b++) {
+    n += lat[b];
+    if (lat[b] > 0)
+      max = b;
+  }
+  if (n == 0)
+    return;
+  printf("  %-8s    : p50=%lu p90=%lu p99=%lu p99.9=%lu max=%lu\n", name,
+         (unsigned long)lat_percentile(lat, n, 0.50),
+         (unsigned long)lat_percentile(lat, n, 0.90),
+         (unsigned long)lat_percentile(lat, n, 0.99),
+         (unsigned long)lat_percentile(lat, n, 0.999),
+         (unsigned long)lat_value(max));
+}
+
+/* ################################################################### *
+ * LOAD GENERATOR
+ * ################################################################### */
+
+/* Pick a key in [0, range) */
+static long choose_key(thread_data_t *d)
+{
+  double u;
+  long lo, hi, mid;
+
+  if (d->zipf_cdf != NULL) {
+    /* Zipfian distribution: binary search in the cumulative distribution */
+    u = erand48(d->seed);
+    lo = 0;
+    hi = d->range - 1;
+    while (lo < hi) {
+      mid = (lo + hi) / 2;
+      if (d->zipf_cdf[mid] < u)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    return lo;
+  }
+  return (long)(erand48(d->seed) * d->range);
+}
+
+static long choose_size(thread_data_t *d)
+{
+  return d->min_value + (long)(erand48(d->seed) * (d->max_value - d->min_value + 1));
+}
+
+static void *test(void *data)
+{
+  thread_data_t *d = (thread_data_t *)data;
+  uint64_t t;
+  long key;
+  int r, op, grow;
+
+  /* Pin thread before allocating its transaction descriptor */
+  if (d->pinning != MOD_TOPO_NONE)
+    mod_topo_pin(d->pinning, d->id);
+  /* Create transaction */
+  TM_INIT_THREAD;
+  /* Wait on barrier */
+  barrier_cross(d->barrier);
+
+  while (stop == 0) {
+    r = (int)(erand48(d->seed) * 100);
+    op = (r < d->get ? KV_GET : (r < d->get + d->set ? KV_SET : KV_DELETE));
+    key = choose_key(d);
+    grow = 0;
+    t = now_ns();
+    switch (op) {
+      case KV_GET:
+        if (kv_get(d, key, now_ms()))
+          d->nb_hits++;
+        else
+          d->nb_misses++;
+        break;
+      case KV_SET:
+        grow = kv_set(d, key, choose_size(d), now_ms());
+        break;
+      case KV_DELETE:
+        kv_delete(d, key);
+        break;
+    }
+    t = now_ns() - t;
+    d->lat[op][lat_bucket(t)]++;
+    d->nb_requests[op]++;
+    if (grow)
+      kv_resize(d);
+  }
+  stm_get_stats("nb_aborts", &d->nb_aborts);
+  stm_get_stats("nb_aborts_locked_read", &d->nb_aborts_locked_read);
+  stm_get_stats("nb_aborts_locked_write", &d->nb_aborts_locked_write);
+  stm_get_stats("nb_aborts_validate_read", &d->nb_aborts_validate_read);
+  stm_get_stats("nb_aborts_validate_write", &d->nb_aborts_validate_write);
+  stm_get_stats("nb_aborts_validate_commit", &d->nb_aborts_validate_commit);
+  stm_get_stats("nb_aborts_killed", &d->nb_aborts_killed);
+  stm_get_stats("nb_aborts_rw_conflict", &d->nb_aborts_rw_conflict);
+  stm_get_stats("nb_aborts_irrevocable", &d->nb_aborts_irrevocable);
+  stm_get_stats("max_retries", &d->max_retries);
+  /* Free transaction */
+  TM_EXIT_THREAD;
+
+  return NULL;
+}
+
+/* Check store invariants and free all memory (no concurrency) */
+static int check_and_free(long *nb_items, long *bytes, long *lru_items)
+{
+  item_t *it, *next;
+  long i, n;
+  int ok = 1;
+
+  *nb_items = *bytes = *lru_items = 0;
+  for (it = store.lru.lru_next; it != &store.lru; it = it->lru_next) {
+    if (it->lru_next->lru_prev != it)
+      ok = 0;
+    (*lru_items)++;
+  }
+  for (i = 0; i < store.table->size; i++) {
+    for (it = store.table->buckets[i]; it != NULL; it = next) {
+      next = it->next;
+      if ((long)(kv_hash(it->key) & (store.table->size - 1)) != i)
+        ok = 0;
+      for (n = 0; n < (long)VALUE_WORDS(it->size); n++) {
+        if (it->value[n] != it->key)
+          ok = 0;
+      }
+      (*nb_items)++;
+      *bytes += ITEM_BYTES(it->size);
+      free(it->value);
+      free(it);
+    }
+  }
+  if (*nb_items != store.nb_items || *bytes != store.bytes || *lru_items != store.nb_items)
+    ok = 0;
+  free(store.table->buckets);
+  free(store.table);
+  for (i = 0; i < store.nb_retired; i++) {
+    free(store.retired[i]->buckets);
+    free(store.retired[i]);
+  }
+  return ok;
+}
+
+static void catcher(int sig)
+{
+  static int nb = 0;
+  printf("CAUGHT SIGNAL %d\n", sig);
+  if (++nb >= 3)
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+  struct option long_options[] = {
+    // These options don't set a flag
+    {"help",                      no_argument,       NULL, 'h'},
+    {"bump",                      required_argument, NULL, 'b'},
+    {"contention-manager",        required_argument, NULL, 'c'},
+    {"duration",                  required_argument, NULL, 'd'},
+    {"get-rate",                  required_argument, NULL, 'g'},
+    {"initial-size",              required_argument, NULL, 'i'},
+    {"buckets",                   required_argument, NULL, 'k'},
+    {"capacity",                  required_argument, NULL, 'm'},
+    {"num-threads",               required_argument, NULL, 'n'},
+    {"pinning",                   required_argument, NULL, 'p'},
+    {"range",                     required_argument, NULL, 'r'},
+    {"seed",                      required_argument, NULL, 's'},
+    {"ttl",                       required_argument, NULL, 't'},
+    {"set-rate",                  required_argument, NULL, 'u'},
+    {"min-value",                 required_argument, NULL, 'v'},
+    {"max-value",                 required_argument, NULL, 'V'},
+    {"zipf",                      required_argument, NULL, 'z'},
+    {NULL, 0, NULL, 0}
+  };
+
+  thread_data_t *data;
+  pthread_t *threads;
+  pthread_attr_t attr;
+  barrier_t barrier;
+  struct timeval start, end;
+  struct timespec timeout;
+  unsigned long requests, hits, misses, errors, resizes, max_resize_items, malloc_tries,
+    aborts, aborts_locked_read, aborts_locked_write, aborts_validate_read, aborts_validate_write,
+    aborts_validate_commit, aborts_killed, aborts_rw_conflict, aborts_irrevocable, max_retries;
+  unsigned long nb_requests[NB_REQUESTS];
+  unsigned long (*lat)[LAT_BUCKETS];
+  double *zipf_cdf = NULL;
+  acct_t acct;
+  thread_data_t init;
+  long nb_items, bytes, lru_items;
+  long i;
+  int j, c, ok;
+  char *s;
+  char *cm = NULL;
+  int duration = DEFAULT_DURATION;
+  int nb_threads = DEFAULT_NB_THREADS;
+  int seed = DEFAULT_SEED;
+  long range = DEFAULT_RANGE;
+  long initial = -1;
+  long buckets = DEFAULT_BUCKETS;
+  long capacity = DEFAULT_CAPACITY;
+  long min_value = DEFAULT_MIN_VALUE;
+  long max_value = DEFAULT_MAX_VALUE;
+  long ttl = DEFAULT_TTL;
+  long bump = DEFAULT_BUMP;
+  int get = DEFAULT_GET;
+  int set = DEFAULT_SET;
+  double zipf = DEFAULT_ZIPF;
+  int pinning = MOD_TOPO_NONE;
+  char *pin = NULL;
+  sigset_t block_set;
+
+  while(1) {
+    j = 0;
+    c = getopt_long(argc, argv, "hb:c:d:g:i:k:m:n:p:r:s:t:u:v:V:z:", long_options, &j);
+
+    if(c == -1)
+      break;
+
+    if(c == 0 && long_options[j].flag == 0)
+      c = long_options[j].val;
+
+    switch(c) {
+     case 0:
+       /* Flag is automatically set */
+       break;
+     case 'h':
+       printf("kv -- transactional key-value store benchmark\n"
+              "\n"
+              "Usage:\n"
+              "  kv [options...]\n"
+              "\n"
+              "Options:\n"
+              "  -h, --help\n"
+              "        Print this message\n"
+              "  -b, --bump <int>\n"
+              "        Minimum interval between LRU bumps of an item in ms (default=" XSTR(DEFAULT_BUMP) ")\n"
+              "  -c, --contention-manager <string>\n"
+              "        Contention manager for resolving conflicts (default=suicide)\n"
+              "  -d, --duration <int>\n"
+              "        Test duration in milliseconds (0=infinite, default=" XSTR(DEFAULT_DURATION) ")\n"
+              "  -g, --get-rate <int>\n"
+              "        Percentage of GET requests (default=" XSTR(DEFAULT_GET) ")\n"
+              "  -i, --initial-size <int>\n"
+              "        Number of items initially stored (default=range/2)\n"
+              "  -k, --buckets <int>\n"
+              "        Initial number of hash buckets (default=" XSTR(DEFAULT_BUCKETS) ")\n"
+              "  -m, --capacity <int>\n"
+              "        Memory capacity in KB before eviction (default=" XSTR(DEFAULT_CAPACITY) ")\n"
+              "  -n, --num-threads <int>\n"
+              "        Number of threads (default=" XSTR(DEFAULT_NB_THREADS) ")\n"
+              "  -p, --pinning <string>\n"
+              "        Thread placement (none, compact, scatter or numa, default=none)\n"
+              "  -r, --range <int>\n"
+              "        Range of keys (default=" XSTR(DEFAULT_RANGE) ")\n"
+              "  -s, --seed <int>\n"
+              "        RNG seed (0=time-based, default=" XSTR(DEFAULT_SEED) ")\n"
+              "  -t, --ttl <int>\n"
+              "        Time-to-live of items in ms (0=infinite, default=" XSTR(DEFAULT_TTL) ")\n"
+              "  -u, --set-rate <int>\n"
+              "        Percentage of SET requests, the rest are DELETE (default=" XSTR(DEFAULT_SET) ")\n"
+              "  -v, --min-value <int>\n"
+              "        Minimum value size in bytes (default=" XSTR(DEFAULT_MIN_VALUE) ")\n"
+              "  -V, --max-value <int>\n"
+              "        Maximum value size in bytes (default=" XSTR(DEFAULT_MAX_VALUE) ", at most " XSTR(MAX_VALUE) ")\n"
+              "  -z, --zipf <double>\n"
+              "        Zipf parameter of key popularity (0=uniform, default=" XSTR(DEFAULT_ZIPF) ")\n"
+         );
+       exit(0);
+     case 'b':
+       bump = atol(optarg);
+       break;
+     case 'c':
+       cm = optarg;
+       break;
+     case 'd':
+       duration = atoi(optarg);
+       break;
+     case 'g':
+       get = atoi(optarg);
+       break;
+     case 'i':
+       initial = atol(optarg);
+       break;
+     case 'k':
+       buckets = atol(optarg);
+       break;
+     case 'm':
+       capacity = atol(optarg);
+       break;
+     case 'n':
+       nb_threads = atoi(optarg);
+       break;
+     case 'p':
+       pin = optarg;
+       if ((pinning = mod_topo_policy(optarg)) < 0) {
+         printf("Unknown pinning policy \"%s\"\n", optarg);
+         exit(1);
+       }
+       break;
+     case 'r':
+       range = atol(optarg);
+       break;
+     case 's':
+       seed = atoi(optarg);
+       break;
+     case 't':
+       ttl = atol(optarg);
+       break;
+     case 'u':
+       set = atoi(optarg);
+       break;
+     case 'v':
+       min_value = atol(optarg);
+       break;
+     case 'V':
+       max_value = atol(optarg);
+       break;
+     case 'z':
+       zipf = atof(optarg);
+       break;
+     case '?':
+       printf("Use -h or --help for help\n");
+       exit(0);
+     default:
+       exit(1);
+    }
+  }
+
+  if (initial < 0)
+    initial = range / 2;
+  /* Round up to a power of 2 */
+  for (i = 1; i < buckets; i <<= 1)
+    ;
+  buckets = i;
+
+  assert(duration >= 0);
+  assert(nb_threads > 0);
+  assert(range > 0 && initial <= range);
+  assert(capacity > 0);
+  assert(min_value > 0 && min_value <= max_value && max_value <= MAX_VALUE);
+  assert(ttl >= 0 && bump >= 0);
+  assert(get >= 0 && set >= 0 && get + set <= 100);
+  assert(zipf >= 0);
+
+  printf("CM             : %s\n", (cm == NULL ? "DEFAULT" : cm));
+  printf("Duration       : %d\n", duration);
+  printf("Nb threads     : %d\n", nb_threads);
+  printf("Pinning        : %s\n", (pin == NULL ? "none" : pin));
+  if (pinning != MOD_TOPO_NONE) {
+    j = mod_topo_init();
+    printf("Topology       : %d CPUs, %d nodes\n", j, mod_topo_nb_nodes());
+  }
+  printf("Seed           : %d\n", seed);
+  printf("Range          : %ld\n", range);
+  printf("Initial size   : %ld\n", initial);
+  printf("Buckets        : %ld\n", buckets);
+  printf("Capacity       : %ld KB\n", capacity);
+  printf("Value size     : %ld-%ld\n", min_value, max_value);
+  printf("TTL            : %ld\n", ttl);
+  printf("LRU bump       : %ld\n", bump);
+  printf("GET/SET/DELETE : %d/%d/%d\n", get, set, 100 - get - set);
+  printf("Zipf           : %f\n", zipf);
+  printf("Type sizes     : int=%d/long=%d/ptr=%d/word=%d\n",
+         (int)sizeof(int),
+         (int)sizeof(long),
+         (int)sizeof(void *),
+         (int)sizeof(stm_word_t));
+
+  timeout.tv_sec = duration / 1000;
+  timeout.tv_nsec = (duration % 1000) * 1000000;
+
+  if ((data = (thread_data_t *)malloc(nb_threads * sizeof(thread_data_t))) == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  if ((threads = (pthread_t *)malloc(nb_threads * sizeof(pthread_t))) == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  if ((lat = calloc(NB_REQUESTS, sizeof(*lat))) == NULL) {
+    perror("calloc");
+    exit(1);
+  }
+
+  if (seed == 0)
+    srand((int)time(NULL));
+  else
+    srand(seed);
+
+  if (zipf > 0) {
+    /* Precompute cumulative distribution (key 0 is the most popular) */
+    if ((zipf_cdf = (double *)malloc(range * sizeof(double))) == NULL) {
+      perror("malloc");
+      exit(1);
+    }
+    zipf_cdf[0] = 1.0;
+    for (i = 1; i < range; i++)
+      zipf_cdf[i] = zipf_cdf[i - 1] + 1.0 / pow(i + 1, zipf);
+    for (i = 0; i < range; i++)
+      zipf_cdf[i] /= zipf_cdf[range - 1];
+  }
+
+  stop = 0;
+
+  /* Init STM */
+  printf("Initializing STM\n");
+  TM_INIT;
+
+  if (stm_get_parameter("compile_flags", &s)) {
+    printf("STM flags      : %s\n", s);
+    store.gc = (strstr(s, "-DEPOCH_GC") != NULL);
+    store.irrevocable = (strstr(s, "-DIRREVOCABLE_ENABLED") != NULL);
+  }
+
+  if (cm != NULL) {
+    if (stm_set_parameter("cm_policy", cm) == 0)
+      printf("WARNING: cannot set contention manager \"%s\"\n", cm);
+  }
+
+  /* Create store */
+  clock_gettime(CLOCK_MONOTONIC, &store.start);
+  if ((store.table = (table_t *)malloc(sizeof(table_t))) == NULL ||
+      (store.table->buckets = (item_t **)calloc(buckets, sizeof(item_t *))) == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  store.table->size = buckets;
+  store.lru.lru_next = store.lru.lru_prev = &store.lru;
+  store.nb_items = store.bytes = 0;
+  store.capacity = capacity * 1024;
+  store.resizing = 0;
+  store.nb_retired = 0;
+
+  /* Populate store (from the main thread, with transactions) */
+  printf("Adding %ld items\n", initial);
+  TM_INIT_THREAD;
+  memset(&init, 0, sizeof(init));
+  init.range = range;
+  init.min_value = min_value;
+  init.max_value = max_value;
+  init.ttl = 0;
+  init.seed[0] = (unsigned short)rand();
+  init.seed[1] = (unsigned short)rand();
+  init.seed[2] = (unsigned short)rand();
+  while (store.nb_items < initial) {
+    if (kv_set(&init, (long)(erand48(init.seed) * range), choose_size(&init), now_ms()))
+      kv_resize(&init);
+    if (init.acct.nb_evicted > 0) {
+      printf("WARNING: capacity reached after %ld items\n", store.nb_items);
+      break;
+    }
+  }
+  TM_EXIT_THREAD;
+  printf("Store size     : %ld items, %ld bytes, %ld buckets\n", store.nb_items, store.bytes, store.table->size);
+
+  /* Access set from all threads */
+  barrier_init(&barrier, nb_threads + 1);
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+  for (i = 0; i < nb_threads; i++) {
+    printf("Creating thread %ld\n", i);
+    memset(&data[i], 0, sizeof(thread_data_t));
+    data[i].barrier = &barrier;
+    data[i].zipf_cdf = zipf_cdf;
+    if ((data[i].buffer = (long *)malloc(VALUE_WORDS(max_value) * sizeof(long))) == NULL) {
+      perror("malloc");
+      exit(1);
+    }
+    data[i].range = range;
+    data[i].min_value = min_value;
+    data[i].max_value = max_value;
+    data[i].ttl = ttl;
+    data[i].bump = bump;
+    data[i].get = get;
+    data[i].set = set;
+    data[i].id = i;
+    data[i].pinning = pinning;
+    data[i].seed[0] = (unsigned short)rand();
+    data[i].seed[1] = (unsigned short)rand();
+    data[i].seed[2] = (unsigned short)rand();
+    if (pthread_create(&threads[i], &attr, test, (void *)(&data[i])) != 0) {
+      fprintf(stderr, "Error creating thread\n");
+      exit(1);
+    }
+  }
+  pthread_attr_destroy(&attr);
+
+  /* Catch some signals */
+  if (signal(SIGHUP, catcher) == SIG_ERR ||
+      signal(SIGINT, catcher) == SIG_ERR ||
+      signal(SIGTERM, catcher) == SIG_ERR) {
+    perror("signal");
+    exit(1);
+  }
+
+  /* Start threads */
+  barrier_cross(&barrier);
+
+  printf("STARTING...\n");
+  gettimeofday(&start, NULL);
+  if (duration > 0) {
+    nanosleep(&timeout, NULL);
+  } else {
+    sigemptyset(&block_set);
+    sigsuspend(&block_set);
+  }
+  stop = 1;
+  gettimeofday(&end, NULL);
+  printf("STOPPING...\n");
+
+  /* Wait for thread completion */
+  for (i = 0; i < nb_threads; i++) {
+    if (pthread_join(threads[i], NULL) != 0) {
+      fprintf(stderr, "Error waiting for thread completion\n");
+      exit(1);
+    }
+  }
+
+  duration = (end.tv_sec * 1000 + end.tv_usec / 1000) - (start.tv_sec * 1000 + start.tv_usec / 1000);
+  memset(nb_requests, 0, sizeof(nb_requests));
+  memset(&acct, 0, sizeof(acct));
+  requests = hits = misses = errors = resizes = max_resize_items = malloc_tries = 0;
+  aborts = aborts_locked_read = aborts_locked_write = aborts_validate_read = aborts_validate_write = 0;
+  aborts_validate_commit = aborts_killed = aborts_rw_conflict = aborts_irrevocable = max_retries = 0;
+  for (i = 0; i < nb_threads; i++) {
+    printf("Thread %ld\n", i);
+    for (j = 0; j < NB_REQUESTS; j++) {
+      printf("  #%-10s: %lu\n", request_names[j], data[i].nb_requests[j]);
+      nb_requests[j] += data[i].nb_requests[j];
+      requests += data[i].nb_requests[j];
+      for (c = 0; c < LAT_BUCKETS; c++)
+        lat[j][c] += data[i].lat[j][c];
+    }
+    printf("  #resizes    : %lu\n", data[i].nb_resizes);
+    printf("  #aborts     : %lu\n", data[i].nb_aborts);
+    hits += data[i].nb_hits;
+    misses += data[i].nb_misses;
+    errors += data[i].nb_errors;
+    resizes += data[i].nb_resizes;
+    if (max_resize_items < data[i].max_resize_items)
+      max_resize_items = data[i].max_resize_items;
+    malloc_tries += data[i].nb_malloc_tries;
+    acct.nb_malloc += data[i].acct.nb_malloc;
+    acct.nb_free += data[i].acct.nb_free;
+    acct.bytes_malloc += data[i].acct.bytes_malloc;
+    acct.bytes_free += data[i].acct.bytes_free;
+    acct.nb_evicted += data[i].acct.nb_evicted;
+    acct.nb_expired += data[i].acct.nb_expired;
+    aborts += data[i].nb_aborts;
+    aborts_locked_read += data[i].nb_aborts_locked_read;
+    aborts_locked_write += data[i].nb_aborts_locked_write;
+    aborts_validate_read += data[i].nb_aborts_validate_read;
+    aborts_validate_write += data[i].nb_aborts_validate_write;
+    aborts_validate_commit += data[i].nb_aborts_validate_commit;
+    aborts_killed += data[i].nb_aborts_killed;
+    aborts_rw_conflict += data[i].nb_aborts_rw_conflict;
+    aborts_irrevocable += data[i].nb_aborts_irrevocable;
+    if (max_retries < data[i].max_retries)
+      max_retries = data[i].max_retries;
+    free(data[i].buffer);
+  }
+  printf("Duration      : %d (ms)\n", duration);
+  printf("#requests     : %lu (%f / s)\n", requests, requests * 1000.0 / duration);
+  for (j = 0; j < NB_REQUESTS; j++)
+    printf("  #%-10s: %lu (%f / s)\n", request_names[j], nb_requests[j], nb_requests[j] * 1000.0 / duration);
+  printf("Hit rate      : %f (%lu hits, %lu misses)\n", hits + misses ? (double)hits / (hits + misses) : 0.0, hits, misses);
+  printf("Latency (ns)\n");
+  for (j = 0; j < NB_REQUESTS; j++)
+    lat_print(request_names[j], lat[j]);
+  for (c = 0; c < LAT_BUCKETS; c++)
+    lat[0][c] += lat[1][c] + lat[2][c];
+  lat_print("ALL", lat[0]);
+  printf("#aborts       : %lu (%f / s)\n", aborts, aborts * 1000.0 / duration);
+  printf("  #lock-r     : %lu (%f / s)\n", aborts_locked_read, aborts_locked_read * 1000.0 / duration);
+  printf("  #lock-w     : %lu (%f / s)\n", aborts_locked_write, aborts_locked_write * 1000.0 / duration);
+  printf("  #val-r      : %lu (%f / s)\n", aborts_validate_read, aborts_validate_read * 1000.0 / duration);
+  printf("  #val-w      : %lu (%f / s)\n", aborts_validate_write, aborts_validate_write * 1000.0 / duration);
+  printf("  #val-c      : %lu (%f / s)\n", aborts_validate_commit, aborts_validate_commit * 1000.0 / duration);
+  printf("  #killed     : %lu (%f / s)\n", aborts_killed, aborts_killed * 1000.0 / duration);
+  printf("  #rw-conf    : %lu (%f / s)\n", aborts_rw_conflict, aborts_rw_conflict * 1000.0 / duration);
+  printf("  #irrevoc    : %lu (%f / s)\n", aborts_irrevocable, aborts_irrevocable * 1000.0 / duration);
+  printf("Abort rate    : %f\n", requests ? (double)aborts / (requests + resizes + aborts) : 0.0);
+  printf("Max retries   : %lu\n", max_retries);
+  printf("Allocator     : %s\n", store.gc ? "epoch-based GC" : "immediate free");
+  printf("  #malloc     : %lu (%lu bytes, %lu rolled back)\n", acct.nb_malloc, acct.bytes_malloc, malloc_tries - acct.nb_malloc);
+  printf("  #free       : %lu (%lu bytes)\n", acct.nb_free, acct.bytes_free);
+  printf("  #evicted    : %lu\n", acct.nb_evicted);
+  printf("  #expired    : %lu\n", acct.nb_expired);
+  printf("  #resizes    : %lu (max %lu items moved)\n", resizes, max_resize_items);
+  printf("Store size    : %ld items, %ld bytes, %ld buckets\n", store.nb_items, store.bytes, store.table->size);
+
+  ok = check_and_free(&nb_items, &bytes, &lru_items);
+  printf("Store check   : %ld items, %ld bytes, %ld in LRU list - %s\n", nb_items, bytes, lru_items, ok ? "OK" : "ERROR");
+  printf("Value errors  : %lu\n", errors);
+
+  /* Cleanup STM */
+  TM_EXIT;
+
+  free(zipf_cdf);
+  free(lat);
+  free(threads);
+  free(data);
+
+  return (ok && errors == 0 ? 0 : 1);
+}
@@ -0,0 +1,79 @@
+/*
+ * File:
+ *   tm_macros.h
+ * Author(s):
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *   Patrick Marlier <patrick.marlier@unine.ch>
+ * Description:
+ *   Lock-based baselines for the benchmarks (no STM involved).
+ *
+ * Copyright (c) 2007-2014.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * This program has a dual license and can also be distributed
+ * under the terms of the MIT license.
+ */
+
+/*
+ * One of the following must be defined:
+ *   TM_MUTEX: transactions acquire a single global mutex.
+ *   TM_RWLOCK: transactions acquire a single global reader-writer lock
+ *     (read-only transactions in shared mode).
+ *   TM_FINE_LOCKS: the benchmark provides its own fine-grained locking
+ *     implementation (per node, bucket or account).
+ *   TM_LOCK_FREE: the benchmark provides its own lock-free
+ *     implementation.
+ * With TM_FINE_LOCKS and TM_LOCK_FREE, TM_START/TM_COMMIT are not
+ * defined so that any code path without a dedicated implementation
+ * fails to compile.
+ */
+
+#ifndef _TM_MACROS_H_
+# define _TM_MACROS_H_
+
+# include <pthread.h>
+# include <stdlib.h>
+
+# define TM_LOCK
+
+# if defined(TM_MUTEX)
+static pthread_mutex_t tm_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+#  define TM_START(id,ro)                   { pthread_mutex_lock(&tm_mutex);
+#  define TM_COMMIT                         pthread_mutex_unlock(&tm_mutex); }
+# elif defined(TM_RWLOCK)
+static pthread_rwlock_t tm_rwlock = PTHREAD_RWLOCK_INITIALIZER;
+
+#  define TM_START(id,ro)                   { if (ro) pthread_rwlock_rdlock(&tm_rwlock); \
+                                              else pthread_rwlock_wrlock(&tm_rwlock);
+#  define TM_COMMIT                         pthread_rwlock_unlock(&tm_rwlock); }
+# elif !defined(TM_FINE_LOCKS) && !defined(TM_LOCK_FREE)
+#  error "Must define TM_MUTEX, TM_RWLOCK, TM_FINE_LOCKS or TM_LOCK_FREE"
+# endif /* !defined(TM_FINE_LOCKS) && !defined(TM_LOCK_FREE) */
+
+# define TM_LOAD(x)                         *x
+# define TM_STORE(x,y)                      *x=y
+/* Memory is only accessed while holding the lock: free immediately */
+# define TM_MALLOC(size)                    malloc(size)
+# define TM_FREE(addr)                      free(addr)
+# define TM_FREE2(addr, size)               free(addr)
+
+# define TM_INIT
+# define TM_EXIT
+# define TM_INIT_THREAD
+# define TM_EXIT_THREAD
+
+/* Define Annotations */
+# define TM_PURE
+# define TM_SAFE
+
+#endif /* _TM_MACROS_H_ */
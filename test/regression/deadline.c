@@ -0,0 +1,150 @@
+/*
+ * File:
+ *   deadline.c
+ * Author(s):
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *   Patrick Marlier <patrick.marlier@unine.ch>
+ * Description:
+ *   Regression test for transaction deadlines and cancellation.
+ *
+ * Copyright (c) 2007-2014.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * This program has a dual license and can also be distributed
+ * under the terms of the MIT license.
+ */
+
+#ifdef NDEBUG
+# undef NDEBUG
+#endif
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "stm.h"
+#include "wrappers.h"
+
+#define RETRIES                         3
+
+enum {
+  MODE_COMMIT,                          /* Commit */
+  MODE_ABORT,                           /* Abort explicitly at each execution */
+  MODE_CANCEL,                          /* Cancel itself before a load */
+  MODE_IRREVOCABLE                      /* Abort explicitly until irrevocable */
+};
+
+static long data;
+
+/*
+ * Execute a transaction that updates data, and return the value returned
+ * by sigsetjmp() when leaving the transaction without committing (0 if
+ * committed).  The number of executions of its code is stored in runs.
+ */
+static int run(int mode, volatile int *runs)
+{
+  sigjmp_buf *e;
+  int path;
+
+  *runs = 0;
+  e = stm_start((stm_tx_attr_t)0);
+  path = sigsetjmp(*e, 0);
+  if (path != 0 && (path & (STM_PATH_INSTRUMENTED | STM_PATH_UNINSTRUMENTED)) == 0) {
+    /* Gave up: code must not be executed */
+    assert(!stm_active());
+    return path;
+  }
+  (*runs)++;
+  if ((path & STM_PATH_UNINSTRUMENTED) != 0) {
+    data++;
+  } else {
+    if (mode == MODE_CANCEL)
+      stm_cancel(stm_current_tx());
+    stm_store_long(&data, stm_load_long(&data) + 1);
+  }
+  if (mode == MODE_ABORT || (mode == MODE_IRREVOCABLE && !stm_irrevocable()))
+    stm_abort(0);
+  stm_commit();
+
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  volatile int runs;
+  struct timeval now;
+  int path;
+
+  /* Init STM */
+  printf("Initializing STM\n");
+  stm_init();
+  stm_init_thread();
+
+  if (!stm_set_deadline(0, RETRIES, STM_DEADLINE_ABORT)) {
+    printf("DEADLINES not enabled: SKIPPED\n");
+    stm_exit_thread();
+    stm_exit();
+    return 0;
+  }
+
+  /* Give up after the maximal number of aborts */
+  printf("Testing maximal number of retries\n");
+  data = 0;
+  path = run(MODE_ABORT, &runs);
+  assert(path == STM_ABORT_DEADLINE);
+  assert(runs == RETRIES);
+  assert(data == 0);
+
+  /* Give up upon first abort once the deadline is exceeded */
+  printf("Testing exceeded deadline\n");
+  gettimeofday(&now, NULL);
+  assert(stm_set_deadline((uint64_t)now.tv_sec * 1000000 + now.tv_usec, 0, STM_DEADLINE_ABORT));
+  path = run(MODE_ABORT, &runs);
+  assert(path == STM_ABORT_DEADLINE);
+  assert(runs == 1);
+  assert(data == 0);
+
+  /* Give up when cancelled */
+  printf("Testing cancellation\n");
+  assert(stm_set_deadline(0, 0, STM_DEADLINE_ABORT));
+  path = run(MODE_CANCEL, &runs);
+  assert(path == STM_ABORT_CANCELLED);
+  assert(runs == 1);
+  assert(data == 0);
+
+  /* Subsequent transactions are not affected */
+  printf("Testing commit after giving up\n");
+  stm_cancel(stm_current_tx());
+  path = run(MODE_COMMIT, &runs);
+  assert(path == 0);
+  assert(runs == 1);
+  assert(data == 1);
+
+  /* Become irrevocable after the maximal number of aborts */
+  if (stm_set_deadline(0, RETRIES, STM_DEADLINE_IRREVOCABLE)) {
+    printf("Testing irrevocable action\n");
+    path = run(MODE_IRREVOCABLE, &runs);
+    assert(path == 0);
+    assert(runs == RETRIES + 1);
+    assert(data == 2);
+  }
+
+  printf("PASSED\n");
+
+  /* Cleanup STM */
+  stm_exit_thread();
+  stm_exit();
+
+  return 0;
+}
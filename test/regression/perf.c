@@ -28,6 +28,7 @@
 
 #include "stm.h"
 #include "mod_mem.h"
+#include "wrappers.h"
 
 /* Increment the value of the global clock (used for timestamps).
  * Hidden to tinySTM users. */
@@ -36,6 +37,9 @@ void stm_inc_clock(void);
 __attribute__((aligned(64)))
 stm_word_t global_ctr[1000] = {0};
 
+__attribute__((aligned(64)))
+long global_long[1000] = {0};
+
 #define MEASURE_NB 1000
 
 static inline uint64_t
@@ -317,6 +321,81 @@ static void testnloadnstore(size_t load_nb, size_t store_nb)
   printf("%12s %12lu %12.2f %12lu\n", "commit", (unsigned long)min, avg, (unsigned long)med);
 }
 
+static void testtyped(size_t load_nb, size_t store_nb)
+{
+  uint64_t m_r[MEASURE_NB];
+  uint64_t m_w[MEASURE_NB];
+  uint64_t m_rtx[MEASURE_NB];
+  uint64_t m_wtx[MEASURE_NB];
+  uint64_t m_rdtsc;
+  uint64_t start;
+  uint64_t min;
+  double avg;
+  uint64_t med;
+  unsigned long i;
+  size_t j;
+  stm_tx_attr_t _a = {{.read_only = 0}};
+
+  m_rdtsc = ~0UL;
+  for (i = 0; i < MEASURE_NB; i++) {
+    start = rdtsc();
+    start = rdtsc() - start;
+    if (start < m_rdtsc)
+      m_rdtsc = start;
+  } 
+
+  /* Implicit descriptor: TLS lookup on every access */
+  for (i = 0; i < MEASURE_NB; i++) {
+    sigjmp_buf *_e = stm_start(_a);
+    sigsetjmp(*_e, 0); 
+    start = rdtsc();
+    for (j = 0; j < load_nb; j++)
+      stm_load_long(&global_long[j]);
+    m_r[i] = rdtsc() - start;
+    start = rdtsc();
+    for (j = 0; j < store_nb; j++)
+      stm_store_long(&global_long[j], 0);
+    m_w[i] = rdtsc() - start;
+    stm_inc_clock();
+    stm_commit();
+  }
+
+  /* Explicit descriptor: inlined into the loop */
+  for (i = 0; i < MEASURE_NB; i++) {
+    struct stm_tx *tx;
+    sigjmp_buf *_e = stm_start(_a);
+    sigsetjmp(*_e, 0); 
+    tx = stm_current_tx();
+    start = rdtsc();
+    for (j = 0; j < load_nb; j++)
+      stm_load_long_tx(tx, &global_long[j]);
+    m_rtx[i] = rdtsc() - start;
+    start = rdtsc();
+    for (j = 0; j < store_nb; j++)
+      stm_store_long_tx(tx, &global_long[j], 0);
+    m_wtx[i] = rdtsc() - start;
+    stm_inc_clock();
+    stm_commit();
+  }
+
+  remove_cst_cost(m_r, MEASURE_NB, m_rdtsc);
+  remove_cst_cost(m_w, MEASURE_NB, m_rdtsc);
+  remove_cst_cost(m_rtx, MEASURE_NB, m_rdtsc);
+  remove_cst_cost(m_wtx, MEASURE_NB, m_rdtsc);
+
+  printf("RW transaction - %lu load_long - %lu store_long\n", (unsigned long)load_nb, (unsigned long)store_nb);
+
+  printf("%12s %12s %12s %12s\n", "", "min", "avg", "med");
+  stats(m_r, MEASURE_NB, &min, &avg, &med); 
+  printf("%12s %12lu %12.2f %12lu\n", "load", (unsigned long)min/load_nb, avg/load_nb, (unsigned long)med/load_nb);
+  stats(m_rtx, MEASURE_NB, &min, &avg, &med); 
+  printf("%12s %12lu %12.2f %12lu\n", "load_tx", (unsigned long)min/load_nb, avg/load_nb, (unsigned long)med/load_nb);
+  stats(m_w, MEASURE_NB, &min, &avg, &med); 
+  printf("%12s %12lu %12.2f %12lu\n", "store", (unsigned long)min/store_nb, avg/store_nb, (unsigned long)med/store_nb);
+  stats(m_wtx, MEASURE_NB, &min, &avg, &med); 
+  printf("%12s %12lu %12.2f %12lu\n", "store_tx", (unsigned long)min/store_nb, avg/store_nb, (unsigned long)med/store_nb);
+}
+
 /* TODO
  *  Add clock perturbation to avoid fast commit
  *  Add write after write / load after write measurements
@@ -338,6 +417,7 @@ int main(int argc, char **argv)
   testnload(0, 100);
   testnloadnstore(100, 20);
   testnloadnstore(100, 20);
+  testtyped(100, 20);
 
   /* Free transaction */
   stm_exit_thread();
@@ -0,0 +1,104 @@
+/*
+ * File:
+ *   range.c
+ * Author(s):
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *   Patrick Marlier <patrick.marlier@unine.ch>
+ * Description:
+ *   Regression test for range loads (read after write).
+ *
+ * Copyright (c) 2007-2014.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * This program has a dual license and can also be distributed
+ * under the terms of the MIT license.
+ */
+
+#ifdef NDEBUG
+# undef NDEBUG
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "stm.h"
+
+#define NB_WORDS                        64
+
+static stm_word_t data[NB_WORDS] __attribute__((aligned(NB_WORDS * sizeof(stm_word_t))));
+
+/*
+ * Check a range load of all words against the expected values.
+ */
+static void check(stm_word_t *expected)
+{
+  stm_word_t buf[NB_WORDS];
+  int i, off;
+
+  /* Aligned and unaligned ranges */
+  for (off = 0; off < 3; off++) {
+    stm_load_range(&data[off], buf, NB_WORDS - off);
+    for (i = 0; i < NB_WORDS - off; i++)
+      assert(buf[i] == expected[off + i]);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  stm_word_t expected[NB_WORDS];
+  sigjmp_buf *e;
+  int i;
+
+  /* Init STM */
+  printf("Initializing STM\n");
+  stm_init();
+  stm_init_thread();
+
+  for (i = 0; i < NB_WORDS; i++)
+    data[i] = expected[i] = i;
+
+  printf("Testing range load without writes\n");
+  e = stm_start((stm_tx_attr_t)0);
+  sigsetjmp(*e, 0);
+  check(expected);
+  stm_commit();
+
+  printf("Testing range load after writes\n");
+  e = stm_start((stm_tx_attr_t)0);
+  sigsetjmp(*e, 0);
+  for (i = 0; i < NB_WORDS; i++)
+    expected[i] = i;
+  /* First word of a stripe, other words only, and partial writes */
+  for (i = 0; i < NB_WORDS; i += 5) {
+    stm_store(&data[i], 1000 + i);
+    expected[i] = 1000 + i;
+  }
+  stm_store2(&data[NB_WORDS - 1], 0xFF00, 0xFF00);
+  expected[NB_WORDS - 1] = (expected[NB_WORDS - 1] & ~(stm_word_t)0xFF00) | 0xFF00;
+  check(expected);
+  stm_commit();
+
+  printf("Testing range load after commit\n");
+  e = stm_start((stm_tx_attr_t)0);
+  sigsetjmp(*e, 0);
+  check(expected);
+  stm_commit();
+
+  printf("PASSED\n");
+
+  /* Cleanup STM */
+  stm_exit_thread();
+  stm_exit();
+
+  return 0;
+}
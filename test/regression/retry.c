@@ -0,0 +1,128 @@
+/*
+ * File:
+ *   retry.c
+ * Author(s):
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *   Patrick Marlier <patrick.marlier@unine.ch>
+ * Description:
+ *   Regression test for retry policies.
+ *
+ * Copyright (c) 2007-2014.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, version 2
+ * of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * This program has a dual license and can also be distributed
+ * under the terms of the MIT license.
+ */
+
+#ifdef NDEBUG
+# undef NDEBUG
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "stm.h"
+
+#define RETRIES                         3
+
+/*
+ * Execute a transaction using a set of retry policies that aborts
+ * explicitly with the given reason during its first executions.  Return
+ * the number of executions of its code, and whether the last one was
+ * irrevocable.
+ */
+static int run(unsigned int set, int reason, int aborts, volatile int *irrevocable)
+{
+  stm_tx_attr_t attr;
+  sigjmp_buf *e;
+  volatile int runs = 0;
+
+  attr = (stm_tx_attr_t)0;
+  attr.retry_policy = set;
+  e = stm_start(attr);
+  sigsetjmp(*e, 0);
+  runs++;
+  *irrevocable = stm_irrevocable();
+  if (runs <= aborts && !*irrevocable) {
+    stm_abort(reason);
+    /* Only returns if the transaction does not retry */
+    assert((reason & STM_ABORT_NO_RETRY) == STM_ABORT_NO_RETRY);
+    return runs;
+  }
+  stm_commit();
+
+  return runs;
+}
+
+int main(int argc, char **argv)
+{
+  volatile int irrevocable;
+  unsigned int before, after;
+  int runs;
+
+  /* Init STM */
+  printf("Initializing STM\n");
+  stm_init();
+  stm_init_thread();
+
+  if (!stm_set_retry_policy(0, -1, STM_RETRY_DEFAULT, 0)) {
+    printf("RETRY_POLICIES not enabled: SKIPPED\n");
+    stm_exit_thread();
+    stm_exit();
+    return 0;
+  }
+
+  printf("Testing invalid arguments\n");
+  assert(!stm_set_retry_policy(16, -1, STM_RETRY_IMMEDIATE, 0));
+  assert(!stm_set_retry_policy(1, -1, 1000, 0));
+
+  printf("Testing default policies\n");
+  runs = run(1, 0, RETRIES, &irrevocable);
+  assert(runs == RETRIES + 1);
+  assert(!irrevocable);
+
+  if (stm_set_retry_policy(1, STM_ABORT_EXPLICIT, STM_RETRY_IRREVOCABLE, RETRIES)) {
+    printf("Testing irrevocable policy\n");
+    runs = run(1, 0, RETRIES * 2, &irrevocable);
+    assert(runs == RETRIES + 1);
+    assert(irrevocable);
+    /* Other sets are not affected */
+    runs = run(0, 0, RETRIES, &irrevocable);
+    assert(runs == RETRIES + 1);
+    assert(!irrevocable);
+  }
+
+  /* Explicit aborts without retry have their own policy, and do not
+   * use the policy of the conflicts sharing their detailed reason */
+  printf("Testing policies of aborts without retry\n");
+  assert(stm_set_retry_policy(2, STM_ABORT_RR_CONFLICT, STM_RETRY_IMMEDIATE, 0));
+  stm_get_stats("nb_retry_immediate", &before);
+  runs = run(2, STM_ABORT_NO_RETRY, 1, &irrevocable);
+  assert(runs == 1);
+  assert(!stm_active());
+  if (stm_get_stats("nb_retry_immediate", &after))
+    assert(after == before);
+  assert(stm_set_retry_policy(2, STM_ABORT_NO_RETRY, STM_RETRY_IMMEDIATE, 0));
+  runs = run(2, STM_ABORT_NO_RETRY, 1, &irrevocable);
+  assert(runs == 1);
+  if (stm_get_stats("nb_retry_immediate", &after))
+    assert(after == before + 1);
+
+  printf("PASSED\n");
+
+  /* Cleanup STM */
+  stm_exit_thread();
+  stm_exit();
+
+  return 0;
+}